@@ -35,12 +35,78 @@ const voltageEl = document.getElementById('voltage');
 const currentEl = document.getElementById('current');
 const powerEl = document.getElementById('power');
 const energyEl = document.getElementById('energy');
+const chargeEl = document.getElementById('charge');
 const resistanceEl = document.getElementById('resistance');
 const temperatureEl = document.getElementById('temperature');
 const fanSpeedEl = document.getElementById('fan-speed');
 const fanIconEl = document.getElementById('fan-icon'); // Added fan icon element
 const uptimeEl = document.getElementById('uptime-timer'); // Added uptime element
-
+const statsWindowEl = document.getElementById('stats-window');
+const statsBodyEl = document.getElementById('stats-body');
+let lastStats = null; // Latest rolling statistics, redrawn when the window changes
+
+
+// Calibration elements
+const calModeEl = document.getElementById('cal-mode');
+const calPointsEl = document.getElementById('cal-points');
+const calMaxEl = document.getElementById('cal-max');
+const calDegreeEl = document.getElementById('cal-degree');
+const calPointsBody = document.getElementById('cal-points-body');
+const calStatusEl = document.getElementById('cal-status');
+
+// I-V sweep elements
+const sweepModeEl = document.getElementById('sweep-mode');
+const sweepStartEl = document.getElementById('sweep-start');
+const sweepStopEl = document.getElementById('sweep-stop');
+const sweepPointsEl = document.getElementById('sweep-points');
+const sweepPlotEl = document.getElementById('sweep-plot');
+const sweepStatusEl = document.getElementById('sweep-status');
+const sweepSummaryEl = document.getElementById('sweep-summary');
+
+// Live V/I stream elements
+const streamDecimationEl = document.getElementById('stream-decimation');
+const streamPlotEl = document.getElementById('stream-plot');
+const streamStatusEl = document.getElementById('stream-status');
+const STREAM_PLOT_SAMPLES = 250; // Samples kept on the plot
+let streamSamples = [];
+
+// Battery test elements
+const batModeEl = document.getElementById('bat-mode');
+const batValueEl = document.getElementById('bat-value');
+const batCutoffEl = document.getElementById('bat-cutoff');
+const batStatusEl = document.getElementById('bat-status');
+const batProgressEl = document.getElementById('bat-progress');
+const batLastEl = document.getElementById('bat-last');
+
+// Stop condition elements
+const stopRowEls = document.querySelectorAll('.stop-row');
+const stopStatusEl = document.getElementById('stop-status');
+
+// Test sequence elements
+const seqSourceEl = document.getElementById('seq-source');
+const seqStatusEl = document.getElementById('seq-status');
+const seqLogEl = document.getElementById('seq-log');
+
+// MPPT elements
+const mpptAlgorithmEl = document.getElementById('mppt-algorithm');
+const mpptStepEl = document.getElementById('mppt-step');
+const mpptMaxEl = document.getElementById('mppt-max');
+const mpptStatusEl = document.getElementById('mppt-status');
+const mpptPowerEl = document.getElementById('mppt-power');
+const mpptQualityEl = document.getElementById('mppt-quality');
+
+// Safety elements
+const safetyVoltageEl = document.getElementById('safety-voltage');
+const safetyCurrentEl = document.getElementById('safety-current');
+const safetyPowerEl = document.getElementById('safety-power');
+const safetyTemperatureEl = document.getElementById('safety-temperature');
+const safetyMarginEl = document.getElementById('safety-margin');
+const safetyStatusEl = document.getElementById('safety-status');
+const soaStatusEl = document.getElementById('soa-status');
+const safetyLatencyEl = document.getElementById('safety-latency');
+const safetyFastEl = document.getElementById('safety-fast');
+const blackboxStatusEl = document.getElementById('blackbox-status');
+const blackboxListEl = document.getElementById('blackbox-list');
 
 // Warning banner elements
 const warningBanner = document.getElementById('warning-banner');
@@ -72,11 +138,20 @@ function connectWebSocket() {
     }
     // Replace with your ESP32's IP address or hostname
     ws = new WebSocket('ws://' + window.location.hostname + '/ws');
+    ws.binaryType = 'arraybuffer'; // I-V curves arrive as binary frames
 
     ws.onopen = function() {
         statusTextEl.textContent = 'Connected to device'; // Update text content
         connectionStatusIndicator.classList.add('connected'); // Add 'connected' class to dot
         resetHeartbeatTimeout(); // Start the timeout check
+        sendCommand('getCalibration', null); // Load stored calibration status
+        sendCommand('getBattery', null); // Load the last battery test result
+        sendCommand('getSequence', null); // Show the stored test sequence
+        sendCommand('getStops', null); // Show the active stop conditions
+        sendCommand('getSafety', null); // Show the safety limits and trip latencies
+        sendCommand('getBlackbox', null); // List the recorded safety trips
+        sendCommand('getSweep', null); // Load the last I-V curve
+        if (telemetrySchema) sendJson({ command: 'telemetry', format: 'binary' }); // Periodic state as packed frames
     };
 
     ws.onclose = function() {
@@ -87,11 +162,16 @@ function connectWebSocket() {
             clearTimeout(heartbeatTimeout);
             heartbeatTimeout = null;
         }
+        telemetryKeyframe = null; // Deltas only apply to the keyframe of this connection
         setTimeout(connectWebSocket, 2000); // Try to reconnect
     };
 
     ws.onmessage = function(event) {
-        handleMessage(event.data);
+        if (event.data instanceof ArrayBuffer) {
+            handleBinaryMessage(event.data);
+        } else {
+            handleMessage(event.data);
+        }
     };
 
     // Handle potential errors
@@ -110,99 +190,502 @@ function connectWebSocket() {
 
 // Handle incoming WebSocket messages
 function handleMessage(message) {
-    // Reset the timeout since we received a message
-    resetHeartbeatTimeout();
+    markConnected();
+    try {
+        handleData(JSON.parse(message));
+    } catch (e) {
+        console.error('Error parsing message:', e);
+        statusTextEl.textContent = 'Error processing message'; // Update text content
+        // Don't change connection dot color here, let timeout/onclose handle it
+    }
+}
 
-    // Ensure status is shown as connected if it was previously marked as lost
+// Reset the timeout since we received a message, and show the status as connected if it was marked as lost
+function markConnected() {
+    resetHeartbeatTimeout();
     if (!connectionStatusIndicator.classList.contains('connected')) {
         statusTextEl.textContent = 'Connected to device';
         connectionStatusIndicator.classList.add('connected');
     }
+}
 
-    try {
-        const data = JSON.parse(message);
-        console.log("Received data:", data); // Log received data
-
-        // Update measurements
-        if (data.measurements) {
-            voltageEl.textContent = data.measurements.voltage.toFixed(3) + ' V';
-            currentEl.textContent = data.measurements.current.toFixed(3) + ' A';
-            powerEl.textContent = data.measurements.power.toFixed(3) + ' W';
-            energyEl.textContent = data.measurements.energy.toFixed(3) + ' kJ';
-            // Ensure resistance is handled correctly (e.g., avoid Infinity)
-            const resistance = data.measurements.resistance;
-            resistanceEl.textContent = (isFinite(resistance) ? resistance.toFixed(3) : '---') + ' Ω';
-            temperatureEl.textContent = data.measurements.temperature.toFixed(1) + ' °C';
-            // Update Fan Speed display
-            const fanSpeed = data.measurements.fanSpeed;
-            fanSpeedEl.textContent = fanSpeed + ' %';
-            if (fanSpeed > 0) {
-                fanIconEl.classList.add("spinning");
-                // Calculate duration based on speed, ensuring a minimum duration for visibility
-                // Lower fan speed = slower animation (longer duration)
-                // Higher fan speed = faster animation (shorter duration)
-                // Example: 100% speed = 1s duration, 1% speed = 100s duration (adjust multiplier as needed)
-                const duration = Math.max(0.5, 100 / fanSpeed); // Ensure minimum 0.5s duration
-                fanIconEl.style.animationDuration = duration + 's';
-            }
-            else {
-                fanIconEl.classList.remove("spinning");
-            }
-            // Update Uptime display
-            uptimeEl.textContent = data.measurements.uptime;
-
-            // Check if maximum values have been exceeded
-            if (data.measurements.voltage > maxValues.CV * 1.1) {
-                showWarning("Safety limit: " + maxValues.CV.toFixed(1) + "V");
-                setTimeout(hideWarning, 2000);
-            } else if (data.measurements.current > maxValues.CC * 1.1) {
-                showWarning("Safety limit: " + maxValues.CC.toFixed(1) + "A");
-                setTimeout(hideWarning, 2000);
-            } else if (data.measurements.power > maxValues.CW * 1.1) {
-                showWarning("Safety limit: " + maxValues.CW.toFixed(1) + "W");
-                setTimeout(hideWarning, 2000);
-            } else if (data.measurements.temperature > maxValues.T * 1.1) {
-                showWarning("Safety limit: " + maxValues.T.toFixed(1) + "°C");
-                setTimeout(hideWarning, 2000);
-            }
+// Apply a device update: a parsed JSON message or a decoded telemetry frame
+function handleData(data) {
+    // Update measurements
+    if (data.measurements) {
+        voltageEl.textContent = data.measurements.voltage.toFixed(3) + ' V';
+        currentEl.textContent = data.measurements.current.toFixed(3) + ' A';
+        powerEl.textContent = data.measurements.power.toFixed(3) + ' W';
+        energyEl.textContent = data.measurements.Wh.toFixed(3) + ' Wh';
+        energyEl.title = data.measurements.energy.toFixed(1) + ' J';
+        chargeEl.textContent = data.measurements.Ah.toFixed(3) + ' Ah';
+        chargeEl.title = data.measurements.charge.toFixed(1) + ' C';
+        // Ensure resistance is handled correctly (e.g., avoid Infinity)
+        const resistance = data.measurements.resistance;
+        resistanceEl.textContent = (isFinite(resistance) ? resistance.toFixed(3) : '---') + ' Ω';
+        temperatureEl.textContent = data.measurements.temperature.toFixed(1) + ' °C';
+        // Update Fan Speed display
+        const fanSpeed = data.measurements.fanSpeed;
+        fanSpeedEl.textContent = fanSpeed + ' %';
+        if (fanSpeed > 0) {
+            fanIconEl.classList.add("spinning");
+            // Calculate duration based on speed, ensuring a minimum duration for visibility
+            // Lower fan speed = slower animation (longer duration)
+            // Higher fan speed = faster animation (shorter duration)
+            // Example: 100% speed = 1s duration, 1% speed = 100s duration (adjust multiplier as needed)
+            const duration = Math.max(0.5, 100 / fanSpeed); // Ensure minimum 0.5s duration
+            fanIconEl.style.animationDuration = duration + 's';
         }
+        else {
+            fanIconEl.classList.remove("spinning");
+        }
+        // Update Uptime display
+        uptimeEl.textContent = data.measurements.uptime;
+
+        // Check if maximum values have been exceeded
+        if (data.measurements.voltage > maxValues.CV * 1.1) {
+            showWarning("Safety limit: " + maxValues.CV.toFixed(1) + "V");
+            setTimeout(hideWarning, 2000);
+        } else if (data.measurements.current > maxValues.CC * 1.1) {
+            showWarning("Safety limit: " + maxValues.CC.toFixed(1) + "A");
+            setTimeout(hideWarning, 2000);
+        } else if (data.measurements.power > maxValues.CW * 1.1) {
+            showWarning("Safety limit: " + maxValues.CW.toFixed(1) + "W");
+            setTimeout(hideWarning, 2000);
+        } else if (data.measurements.temperature > maxValues.T * 1.1) {
+            showWarning("Safety limit: " + maxValues.T.toFixed(1) + "°C");
+            setTimeout(hideWarning, 2000);
+        }
+    }
 
-        // Update state
-        if (data.state) {
-            // Check if returning to MENU
-            if (data.state.mode === "MENU") {
-                valueDisplay.classList.add('hidden'); // Hide controls
-                // Deactivate all mode buttons
-                modeButtons.forEach(button => {
-                    button.classList.remove('active');
-                });
-                currentMode = "MENU"; // Update local mode state
-            } else if (data.state.mode && data.state.mode !== currentMode) {
-                // Update Mode (if not MENU and different from current)
-                setMode(data.state.mode); // Update mode buttons and unit
-            }
-            // Update Relay State (affects combined button)
-            if (data.state.outputActive !== undefined && data.state.outputActive !== relayEnabled) {
-                relayEnabled = data.state.outputActive;
-                updateOperationButton(); // Update the combined button
+    // Update calibration
+    if (data.calibration) {
+        updateCalibration(data.calibration);
+    }
+
+    // Update I-V sweep status
+    if (data.sweep) {
+        sweepStatusEl.textContent = 'Status: ' + data.sweep.status + ' (' + data.sweep.mode + ', '
+            + data.sweep.completed + '/' + data.sweep.total + ' points)';
+    }
+
+    // Update battery test
+    if (data.stream) {
+        streamStatusEl.textContent = data.stream.active
+            ? 'Status: STREAMING (' + data.stream.rateHz + ' Hz, ' + data.stream.batch + ' samples per frame)'
+            : 'Status: STOPPED (' + data.stream.dropped + ' samples dropped)';
+    }
+
+    if (data.battery) {
+        updateBattery(data.battery);
+    }
+
+    // Update rolling statistics
+    if (data.stats) {
+        lastStats = data.stats;
+        updateStats();
+    }
+
+    // Update stop conditions
+    if (data.stops) {
+        updateStops(data.stops);
+    }
+
+    // Update the safe-operating-area envelope
+    if (data.soa) {
+        soaStatusEl.textContent = 'SOA: ' + data.soa.allowed.toFixed(1) + ' W allowed, junction ' + data.soa.junction.toFixed(1)
+            + ' °C' + (data.soa.limiting ? ' - setpoint limited' : '');
+        soaStatusEl.classList.toggle('limiting', data.soa.limiting);
+    }
+
+    // Update safety supervisor
+    if (data.safety) {
+        updateSafety(data.safety);
+    }
+
+    // Update black box trip list
+    if (data.blackbox) {
+        updateBlackbox(data.blackbox);
+    }
+
+    // Update test sequence
+    if (data.sequence) {
+        updateSequence(data.sequence);
+    }
+
+    // Update MPPT
+    if (data.mppt) {
+        updateMppt(data.mppt);
+    }
+
+    // Update state
+    if (data.state) {
+        // Check if returning to MENU (calibration, tests, sweeps and MPPT have no value display either)
+        if (data.state.mode === "MENU" || data.state.mode === "CAL" || data.state.mode === "BAT" || data.state.mode === "IV" || data.state.mode === "MPPT") {
+            valueDisplay.classList.add('hidden'); // Hide controls
+            // Deactivate all mode buttons
+            modeButtons.forEach(button => {
+                button.classList.remove('active');
+            });
+            currentMode = data.state.mode; // Update local mode state
+        } else if (data.state.mode && data.state.mode !== currentMode) {
+            // Update Mode (if not MENU and different from current)
+            setMode(data.state.mode); // Update mode buttons and unit
+        }
+        // Update Relay State (affects combined button)
+        if (data.state.outputActive !== undefined && data.state.outputActive !== relayEnabled) {
+            relayEnabled = data.state.outputActive;
+            updateOperationButton(); // Update the combined button
+        }
+        // Update Value Display (Digits)
+        // Only update digits if the mode matches and output is NOT active (to avoid overwriting user input)
+        // Or if the value received is significantly different from the current display
+        const currentValueDisplayed = convertDigitsToNumber();
+        if (data.state.value !== undefined && data.state.mode === currentMode) {
+            // Update digits if value changed significantly or if output is off
+            // (prevents minor fluctuations during active output from resetting digits)
+            // Also check if digits array is populated for the current mode
+            if (digits.length > 0 && (!relayEnabled || Math.abs(data.state.value - currentValueDisplayed) > 1e-4)) {
+                updateValueFromNumber(data.state.value);
             }
-            // Update Value Display (Digits)
-            // Only update digits if the mode matches and output is NOT active (to avoid overwriting user input)
-            // Or if the value received is significantly different from the current display
-            const currentValueDisplayed = convertDigitsToNumber();
-            if (data.state.value !== undefined && data.state.mode === currentMode) {
-                // Update digits if value changed significantly or if output is off
-                // (prevents minor fluctuations during active output from resetting digits)
-                // Also check if digits array is populated for the current mode
-                if (digits.length > 0 && (!relayEnabled || Math.abs(data.state.value - currentValueDisplayed) > 1e-4)) {
-                    updateValueFromNumber(data.state.value);
+        }
+    }
+}
+
+// Rebuild the calibration table from a device update
+function updateCalibration(cal) {
+    calStatusEl.textContent = 'Status: ' + cal.status + ' (' + cal.mode + ', ' + cal.completed + '/' + cal.total + ' points'
+        + (cal.stored ? ', stored calibration)' : ', default calibration)');
+    calPointsBody.innerHTML = '';
+    cal.points.forEach((point, index) => {
+        const row = document.createElement('tr');
+        row.innerHTML = '<td>' + (index + 1) + '</td><td>' + point.code + '</td><td>' + point.voltage.toFixed(4)
+            + '</td><td>' + point.current.toFixed(4) + '</td>';
+        const refCell = document.createElement('td');
+        const refInput = document.createElement('input');
+        refInput.type = 'number';
+        refInput.step = 'any';
+        refInput.placeholder = cal.mode === 'CC' ? 'A' : 'V';
+        if (point.reference !== undefined) refInput.value = point.reference;
+        refInput.addEventListener('change', () => {
+            sendJson({ command: 'calReference', index: index, value: parseFloat(refInput.value) });
+        });
+        refCell.appendChild(refInput);
+        row.appendChild(refCell);
+        calPointsBody.appendChild(row);
+    });
+}
+
+// Handle binary frames: telemetry ("TM", telemetry.h) or I-V curves ("IV", iv_sweep.h)
+function handleBinaryMessage(buffer) {
+    markConnected();
+    const view = new DataView(buffer);
+    const magic = buffer.byteLength >= 2 ? String.fromCharCode(view.getUint8(0), view.getUint8(1)) : '';
+    if (magic === 'TM') {
+        const data = decodeTelemetry(view);
+        if (data) {
+            telemetryKeyframe = new Uint8Array(buffer.slice(0, telemetrySchema.frameSize));
+            handleData(data);
+        }
+    } else if (magic === 'TD') {
+        const data = applyTelemetryDelta(view);
+        if (data) handleData(data);
+    } else if (magic === 'SS') {
+        handleStreamFrame(view);
+    } else if (magic === 'IV') {
+        handleSweepFrame(view);
+    } else {
+        console.warn('Unknown binary frame');
+    }
+}
+
+// Telemetry frames are decoded with the field table served at /telemetry/schema (telemetryFields in telemetry.h)
+const TELEMETRY_WORD_OFFSET = 8;
+const TELEMETRY_DELTA_HEADER_SIZE = 18;
+let telemetrySchema = null; // Binary state is only requested once the schema is known
+let telemetryKeyframe = null; // Last full frame, patched by every delta
+
+function loadTelemetrySchema() {
+    return fetch('/telemetry/schema')
+        .then(response => response.json())
+        .then(schema => { telemetrySchema = schema; })
+        .catch(error => console.warn('Telemetry schema unavailable, using JSON state', error));
+}
+
+// Decode a telemetry frame into the same shape as the JSON state
+function decodeTelemetry(view) {
+    if (!telemetrySchema || view.byteLength < telemetrySchema.frameSize || view.getUint8(2) !== telemetrySchema.schema) {
+        console.warn('Unsupported telemetry frame', view.byteLength, view.getUint8(2));
+        return null;
+    }
+    const f32 = offset => view.getFloat32(offset, true);
+    const data = {};
+    telemetrySchema.fields.forEach(field => {
+        const group = data[field.group] || (data[field.group] = {});
+        switch (field.type) {
+            case 'f32': group[field.name] = f32(field.offset); break;
+            case 'u8': group[field.name] = view.getUint8(field.offset); break;
+            case 'flag': group[field.name] = (view.getUint8(field.offset) & (1 << field.bit)) !== 0; break;
+            case 'mode': group[field.name] = telemetrySchema.modes[view.getUint8(field.offset)] || 'UNKNOWN'; break;
+            case 'duration': group[field.name] = formatDuration(view.getUint32(field.offset, true)); break;
+            case 'stats': {
+                const windows = telemetrySchema.statistics.windows.length, values = telemetrySchema.statistics.values.length;
+                group[field.name] = [];
+                for (let w = 0; w < windows; w++) {
+                    const row = [];
+                    for (let k = 0; k < values; k++) row.push(f32(field.offset + (w * values + k) * 4));
+                    group[field.name].push(row);
                 }
+                break;
             }
         }
-    } catch (e) {
-        console.error('Error parsing message:', e);
-        statusTextEl.textContent = 'Error processing message'; // Update text content
-        // Don't change connection dot color here, let timeout/onclose handle it
+    });
+    return data;
+}
+
+// Patch the last keyframe with the changed words of a delta frame and decode it
+function applyTelemetryDelta(view) {
+    if (!telemetryKeyframe || view.byteLength < TELEMETRY_DELTA_HEADER_SIZE || view.getUint8(2) !== telemetrySchema.schema) {
+        return null; // A keyframe follows within TELEMETRY_KEYFRAME_INTERVAL_MS
+    }
+    const bytes = new Uint8Array(view.buffer, view.byteOffset, view.byteLength);
+    const count = view.getUint16(6, true);
+    if (view.byteLength < TELEMETRY_DELTA_HEADER_SIZE + count * 4) return null;
+
+    telemetryKeyframe.set(bytes.subarray(2, 6), 2); // Schema, state, flags, fan speed
+    let source = TELEMETRY_DELTA_HEADER_SIZE;
+    const wordCount = (telemetrySchema.frameSize - TELEMETRY_WORD_OFFSET) / 4;
+    for (let word = 0; word < wordCount; word++) {
+        if (!(bytes[8 + (word >> 3)] & (1 << (word & 7)))) continue;
+        telemetryKeyframe.set(bytes.subarray(source, source + 4), TELEMETRY_WORD_OFFSET + word * 4);
+        source += 4;
+    }
+    return decodeTelemetry(new DataView(telemetryKeyframe.buffer));
+}
+
+// Draw a finished I-V curve frame
+function handleSweepFrame(view) {
+    const buffer = view.buffer;
+    if (buffer.byteLength < 8) return;
+    if (view.getUint8(2) !== 1) {
+        console.warn('Unsupported I-V frame version', view.getUint8(2));
+        return;
+    }
+    const mode = view.getUint8(3) === 0 ? 'CC' : 'CV';
+    const count = view.getUint16(4, true);
+    const unsettled = view.getUint16(6, true);
+    if (buffer.byteLength < 8 + count * 12) return;
+
+    const points = [];
+    for (let i = 0; i < count; i++) {
+        const offset = 8 + i * 12;
+        points.push({
+            voltage: view.getFloat32(offset, true),
+            current: view.getFloat32(offset + 4, true),
+            power: view.getFloat32(offset + 8, true)
+        });
+    }
+    drawSweep(points);
+
+    const maxPoint = points.reduce((best, p) => (p.power > best.power ? p : best), points[0]);
+    sweepSummaryEl.textContent = mode + ' sweep, ' + count + ' points' + (unsettled ? ' (' + unsettled + ' unsettled)' : '')
+        + ' | Pmax ' + maxPoint.power.toFixed(3) + ' W at ' + maxPoint.voltage.toFixed(3) + ' V, ' + maxPoint.current.toFixed(3) + ' A';
+}
+
+// Append a batch of streamed samples (see sample_stream.h for the layout) and redraw
+function handleStreamFrame(view) {
+    if (view.byteLength < 12 || view.getUint8(2) !== 1) return;
+    const count = view.getUint8(3);
+    const dropped = view.getUint32(8, true);
+    if (view.byteLength < 12 + count * 12) return;
+    for (let i = 0; i < count; i++) {
+        const offset = 12 + i * 12;
+        streamSamples.push({ voltage: view.getFloat32(offset + 4, true), current: view.getFloat32(offset + 8, true) });
+    }
+    if (streamSamples.length > STREAM_PLOT_SAMPLES) streamSamples.splice(0, streamSamples.length - STREAM_PLOT_SAMPLES);
+    if (dropped) streamStatusEl.textContent = 'Status: STREAMING (' + dropped + ' samples dropped)';
+    drawStream();
+}
+
+// Plot the streamed voltage and current against time, each on its own scale
+function drawStream() {
+    const ctx = streamPlotEl.getContext('2d');
+    const width = streamPlotEl.width, height = streamPlotEl.height, margin = 30;
+    ctx.clearRect(0, 0, width, height);
+    ctx.strokeStyle = '#888';
+    ctx.strokeRect(margin, margin, width - 2 * margin, height - 2 * margin);
+    if (streamSamples.length < 2) return;
+
+    const plot = (key, color, unit, labelX) => {
+        const values = streamSamples.map(s => s[key]);
+        const min = Math.min(...values), max = Math.max(...values);
+        const span = Math.max(max - min, 1e-3);
+        ctx.fillStyle = color;
+        ctx.fillText(max.toFixed(3) + ' ' + unit, labelX, margin - 10);
+        ctx.fillText(min.toFixed(3) + ' ' + unit, labelX, height - 10);
+        ctx.strokeStyle = color;
+        ctx.beginPath();
+        values.forEach((value, i) => {
+            const x = margin + (i / (STREAM_PLOT_SAMPLES - 1)) * (width - 2 * margin);
+            const y = height - margin - ((value - min) / span) * (height - 2 * margin);
+            if (i === 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);
+        });
+        ctx.stroke();
+    };
+    plot('voltage', '#e2662a', 'V', margin);
+    plot('current', '#2a7ae2', 'A', width - margin - 60);
+}
+
+// Plot current (and power) against voltage
+function drawSweep(points) {
+    const ctx = sweepPlotEl.getContext('2d');
+    const width = sweepPlotEl.width, height = sweepPlotEl.height, margin = 30;
+    ctx.clearRect(0, 0, width, height);
+    if (points.length === 0) return;
+
+    const maxV = Math.max(...points.map(p => p.voltage), 1e-3);
+    const maxI = Math.max(...points.map(p => p.current), 1e-3);
+    const maxP = Math.max(...points.map(p => p.power), 1e-3);
+    const x = (v) => margin + (v / maxV) * (width - 2 * margin);
+
+    ctx.strokeStyle = '#888';
+    ctx.strokeRect(margin, margin, width - 2 * margin, height - 2 * margin);
+    ctx.fillStyle = '#888';
+    ctx.fillText(maxV.toFixed(2) + ' V', width - margin - 40, height - 10);
+    ctx.fillText(maxI.toFixed(2) + ' A', 2, margin - 10);
+    ctx.fillText(maxP.toFixed(2) + ' W', width - margin - 40, margin - 10);
+
+    const sorted = [...points].sort((a, b) => a.voltage - b.voltage);
+    const plot = (key, max, color) => {
+        ctx.strokeStyle = color;
+        ctx.beginPath();
+        sorted.forEach((p, i) => {
+            const y = height - margin - (p[key] / max) * (height - 2 * margin);
+            if (i === 0) ctx.moveTo(x(p.voltage), y); else ctx.lineTo(x(p.voltage), y);
+        });
+        ctx.stroke();
+    };
+    plot('current', maxI, '#2a7ae2');
+    plot('power', maxP, '#e2662a');
+}
+
+// Format milliseconds as hh:mm:ss
+function formatDuration(ms) {
+    const seconds = Math.floor(ms / 1000);
+    const pad = (n) => String(n).padStart(2, '0');
+    return pad(Math.floor(seconds / 3600)) + ':' + pad(Math.floor(seconds / 60) % 60) + ':' + pad(seconds % 60);
+}
+
+// Show the active stop conditions and which one ended the last session
+function updateStops(stops) {
+    stopRowEls.forEach((row, i) => {
+        const condition = stops.conditions[i];
+        row.querySelector('.stop-var').value = condition ? condition[0] : '';
+        if (condition) {
+            row.querySelector('.stop-cmp').value = condition[1];
+            row.querySelector('.stop-value').value = condition[2];
+        }
+    });
+    if (stops.conditions.length === 0) {
+        stopStatusEl.textContent = 'No stop conditions';
+    } else if (stops.fired >= 0) {
+        const condition = stops.conditions[stops.fired];
+        stopStatusEl.textContent = 'Stopped by ' + condition[0] + ' ' + condition[1] + ' ' + condition[2]
+            + ' (' + stops.firedValue.toFixed(3) + ') after ' + stops.elapsed.toFixed(1) + ' s, ' + stops.Ah.toFixed(4) + ' Ah';
+    } else {
+        stopStatusEl.textContent = stops.conditions.length + ' active | ' + stops.elapsed.toFixed(1) + ' s, '
+            + stops.Ah.toFixed(4) + ' Ah, ' + stops.dVdt.toFixed(3) + ' V/s';
+    }
+}
+
+// Show sequencer status, program size and the last LOG message
+function updateSequence(seq) {
+    seqStatusEl.textContent = 'Status: ' + seq.status + (seq.loaded ? ' (' + seq.size + ' bytes, at ' + seq.pc + ')' : ' (no program)')
+        + (seq.error ? ' - ' + seq.error : '');
+    seqLogEl.textContent = 'Log: ' + (seq.log || '-');
+}
+
+// Compile the script on the device; errors come back with the line number
+function uploadSequence() {
+    fetch('/sequence', { method: 'POST', headers: { 'Content-Type': 'text/plain' }, body: seqSourceEl.value })
+        .then(response => response.json())
+        .then(data => {
+            if (data.sequence) updateSequence(data.sequence);
+            else if (data.error) seqStatusEl.textContent = 'Status: ' + data.error;
+        })
+        .catch(error => console.error('Sequence upload failed:', error));
+}
+
+// Show MPPT state, tracking speed and steady-state oscillation
+function updateMppt(mppt) {
+    mpptStatusEl.textContent = 'Status: ' + mppt.status + ' (' + mppt.algorithm + ', ' + mppt.iterations + ' iterations)';
+    mpptPowerEl.textContent = mppt.power.toFixed(3) + ' W at ' + mppt.setpoint.toFixed(3) + ' A';
+    mpptQualityEl.textContent = 'Tracking time: ' + (mppt.trackingMs ? mppt.trackingMs + ' ms' : '-')
+        + ' | Ripple: ' + mppt.powerRipple.toFixed(3) + ' W / ' + mppt.currentRipple.toFixed(3) + ' A';
+}
+
+// Show min/max/mean/deviation of every channel over the selected window
+function updateStats() {
+    if (!lastStats) return;
+    const channels = [['V', 'V', 3], ['I', 'A', 3], ['P', 'W', 3], ['T', '°C', 1]];
+    const window = parseInt(statsWindowEl.value);
+    statsBodyEl.innerHTML = '';
+    channels.forEach(([name, unit, digits]) => {
+        const [min, max, mean, stddev] = lastStats[name][window];
+        const row = document.createElement('tr');
+        row.innerHTML = '<th>' + name + '</th><td>' + min.toFixed(digits) + '</td><td>' + max.toFixed(digits) + '</td><td>'
+            + mean.toFixed(digits) + '</td><td>' + stddev.toFixed(digits + 1) + ' ' + unit + '</td>';
+        statsBodyEl.appendChild(row);
+    });
+}
+
+// Show safety limits, supervisor load and the measured shutdown latencies
+function updateSafety(safety) {
+    safetyVoltageEl.value = safety.limits.voltage;
+    safetyCurrentEl.value = safety.limits.current;
+    safetyPowerEl.value = safety.limits.power;
+    safetyTemperatureEl.value = safety.limits.temperature;
+    safetyMarginEl.value = Math.round(safety.margins.current * 100);
+    safetyStatusEl.textContent = 'Trips: ' + safety.trips + ' (' + safety.timeouts + ' stalls) | Checks: ' + safety.checks
+        + ', max ' + safety.maxCheckUs + ' us after the sample';
+    const latency = safety.latency;
+    safetyLatencyEl.textContent = 'Shutdown latency: ' + (latency.count ? 'last ' + latency.lastUs + ' us, min ' + latency.minUs
+        + ' / mean ' + latency.meanUs + ' / max ' + latency.maxUs + ' us over ' + latency.count + ' trips' : '-');
+    const fast = safety.fastTrip;
+    safetyFastEl.textContent = 'Over-current trip at ' + fast.limit.toFixed(1) + ' A: ' + (fast.trips ? fast.trips
+        + ' trips, detect ' + fast.detectUs + ' us, relay ' + fast.relayUs + ' us, DAC ' + fast.dacUs + ' us (max ' + fast.maxDacUs + ' us)' : 'no trips');
+}
+
+// List the recorded trips, newest first, each as a CSV download
+function updateBlackbox(bb) {
+    const trips = bb.trips.slice().sort((a, b) => b.trip - a.trip);
+    blackboxStatusEl.textContent = 'Black box: ' + (trips.length ? trips.length + ' recorded trips' : 'no recorded trips')
+        + (bb.pending ? ' (saving)' : '') + (bb.dropped ? ', ' + bb.dropped + ' not recorded' : '');
+    blackboxListEl.innerHTML = '';
+    trips.forEach(trip => {
+        const time = new Date(Date.UTC(2000, 0, 1) + trip.time); // RTC counts from 2000-01-01
+        const link = document.createElement('a');
+        link.href = '/blackbox?trip=' + trip.trip;
+        link.download = 'trip' + trip.trip + '.csv';
+        link.textContent = '#' + trip.trip + ' ' + time.toISOString().replace('T', ' ').slice(0, 19) + ' - '
+            + trip.reason + ' (' + trip.samples + ' samples)';
+        const item = document.createElement('li');
+        item.appendChild(link);
+        blackboxListEl.appendChild(item);
+    });
+}
+
+// Show battery test progress and the last stored result
+function updateBattery(bat) {
+    const unit = bat.mode === 'CC' ? 'A' : 'W';
+    batStatusEl.textContent = 'Status: ' + bat.status + ' (' + bat.mode + ' ' + bat.value.toFixed(2) + unit
+        + ', cutoff ' + bat.cutoff.toFixed(2) + 'V)';
+    batProgressEl.textContent = formatDuration(bat.elapsedMs) + ' | ' + bat.mAh.toFixed(1) + ' mAh | ' + bat.Wh.toFixed(3) + ' Wh';
+    if (bat.last) {
+        const last = bat.last;
+        batLastEl.textContent = 'Last result: ' + last.mAh.toFixed(1) + ' mAh, ' + last.Wh.toFixed(3) + ' Wh in '
+            + formatDuration(last.elapsedMs) + ' (' + last.mode + ' ' + last.value.toFixed(2) + (last.mode === 'CC' ? 'A' : 'W')
+            + ', ' + (last.cutoffReached ? 'cutoff reached at ' : 'stopped at ') + last.endVoltage.toFixed(2) + 'V)';
     }
 }
 
@@ -230,6 +713,13 @@ function sendCommand(command, value) {
     }
 }
 
+// Send a command with its own fields to ESP32
+function sendJson(payload) {
+    if (ws && ws.readyState === WebSocket.OPEN) {
+        ws.send(JSON.stringify(payload));
+    }
+}
+
 // Function to dynamically create digits based on mode
 function updateDigitDisplay(mode) {
     const config = modeConfig[mode];
@@ -320,7 +810,64 @@ function init() {
         digits = []; // Clear digits array
     });
 
-    connectWebSocket();
+    statsWindowEl.addEventListener('change', updateStats);
+
+    document.getElementById('cal-start').addEventListener('click', () => {
+        sendJson({ command: 'calStart', mode: calModeEl.value, points: parseInt(calPointsEl.value), max: parseFloat(calMaxEl.value) });
+    });
+    document.getElementById('cal-abort').addEventListener('click', () => { sendCommand('calAbort', null); });
+    document.getElementById('cal-fit').addEventListener('click', () => {
+        sendJson({ command: 'calFit', degree: parseInt(calDegreeEl.value) });
+    });
+    document.getElementById('cal-reset').addEventListener('click', () => { sendCommand('calReset', null); });
+
+    document.getElementById('sweep-start-btn').addEventListener('click', () => {
+        sendJson({ command: 'sweepStart', mode: sweepModeEl.value, start: parseFloat(sweepStartEl.value),
+            stop: parseFloat(sweepStopEl.value), points: parseInt(sweepPointsEl.value) });
+    });
+    document.getElementById('sweep-abort').addEventListener('click', () => { sendCommand('sweepAbort', null); });
+
+    document.getElementById('stream-start').addEventListener('click', () => {
+        streamSamples = [];
+        sendJson({ command: 'streamStart', decimation: parseInt(streamDecimationEl.value), batch: 10 });
+    });
+    document.getElementById('stream-stop').addEventListener('click', () => { sendCommand('streamStop', null); });
+
+    document.getElementById('bat-start').addEventListener('click', () => {
+        sendJson({ command: 'batStart', mode: batModeEl.value, value: parseFloat(batValueEl.value), cutoff: parseFloat(batCutoffEl.value) });
+    });
+    document.getElementById('bat-stop').addEventListener('click', () => { sendCommand('batStop', null); });
+
+    document.getElementById('stop-apply').addEventListener('click', () => {
+        const conditions = [];
+        stopRowEls.forEach(row => {
+            const variable = row.querySelector('.stop-var').value;
+            if (variable) {
+                conditions.push([variable, row.querySelector('.stop-cmp').value, parseFloat(row.querySelector('.stop-value').value)]);
+            }
+        });
+        sendJson({ command: 'stopSet', conditions: conditions });
+    });
+    document.getElementById('stop-clear').addEventListener('click', () => { sendJson({ command: 'stopSet', conditions: [] }); });
+
+    document.getElementById('seq-upload').addEventListener('click', uploadSequence);
+    document.getElementById('seq-start').addEventListener('click', () => { sendCommand('seqStart', null); });
+    document.getElementById('seq-stop').addEventListener('click', () => { sendCommand('seqStop', null); });
+
+    document.getElementById('mppt-start').addEventListener('click', () => {
+        sendJson({ command: 'mpptStart', algorithm: mpptAlgorithmEl.value, step: parseFloat(mpptStepEl.value), max: parseFloat(mpptMaxEl.value) });
+    });
+    document.getElementById('mppt-stop').addEventListener('click', () => { sendCommand('exit', null); });
+
+    document.getElementById('safety-apply').addEventListener('click', () => {
+        const margin = parseFloat(safetyMarginEl.value) / 100;
+        sendJson({ command: 'safetySet', voltage: parseFloat(safetyVoltageEl.value), current: parseFloat(safetyCurrentEl.value),
+            power: parseFloat(safetyPowerEl.value), temperature: parseFloat(safetyTemperatureEl.value),
+            voltageMargin: margin, currentMargin: margin, powerMargin: margin, temperatureMargin: margin });
+        sendCommand('getSafety', null);
+    });
+
+    loadTelemetrySchema().then(connectWebSocket);
     updateOperationButton(); // Set initial button state
     // Value display is hidden by default via HTML class
 }
@@ -6,8 +6,9 @@
  * to interface with an Analog-to-Digital Converter (ADC) module. The class
  * allows for initialization of the ADC, and reading current, temperature, and
  * voltage values from the Device Under Test (DUT) using I2C communication.
+ * DUT readings are corrected through the Calibration lookup tables.
  * 
- * @note This class requires an I2C instance for communication.
+ * @note This class requires an I2C instance and a Calibration instance.
  * 
  * @date 2025-05-02
  */
@@ -17,15 +18,24 @@
 #include <Arduino.h>
 #include <i2c.h>
 
+#include "calibration.h"
+#include "logger.h"
+
 #define ADS1115_ADDR 0x48
-#define ADC_CONVERSION_TIME 8
+#define ADC_DATA_RATE 6                 /*!< DR[7:5] = 110 (475 SPS) */
+#define ADC_CONVERSION_TIME_US 2200     /*!< Conversion time at 475 SPS (1/475 s plus margin) */
+#define ADC_CONVERSION_TIMEOUT_US 10000 /*!< Give up waiting for the OS bit after this time */
 #define ADC_CHANNEL_I_DUT 0  // Old name: rename to ADC_CHANNEL_I_DUT
 #define ADC_CHANNEL_TEMP 1
 #define ADC_CHANNEL_V_DUT 2  // Old name: rename to ADC_CHANNEL_V_DUT
 #define ADC_MAX_VALUE (1 << 16)
 #define ADC_PGA 6.144
+#define ADC_REG_LO_THRESH 0x02          /*!< Comparator low threshold register */
+#define ADC_REG_HI_THRESH 0x03          /*!< Comparator high threshold register */
+#define ADC_TRIP_HYSTERESIS 0.02        /*!< Lo_thresh below Hi_thresh as a fraction of it */
 
 /* ----------------- CORRECTION PARAMETERS ----------------- */
+// Defaults for the Calibration tables, used until a calibration is stored
 #define V_DUT_CORRECTION_PARAMETER_SLOPE 0.001 /*!< Correction parameter for DUT measurements */
 #define V_DUT_CORRECTION_PARAMETER_INTERCEPT 0.334 /*!< Correction parameter for DUT measurements */
 
@@ -59,8 +69,9 @@ public:
      * with the ADC over the I2C bus.
      * 
      * @param i2cPointer A pointer to an I2C instance used for communication with the ADC.
+     * @param calibrationPointer A pointer to the Calibration holding the correction tables.
      */
-    void init(I2C* i2cPointer);
+    void init(I2C* i2cPointer, Calibration* calibrationPointer);
 
     /**
      * @brief Reads the current from the Device Under Test (DUT).
@@ -91,12 +102,64 @@ public:
      */
     float read_v_dut();
 
+    /**
+     * @brief Reads the current from the DUT without calibration correction.
+     * 
+     * @return float The uncorrected current value in amperes.
+     */
+    float read_i_dut_raw();
+
+    /**
+     * @brief Reads the voltage from the DUT without calibration correction.
+     * 
+     * @return float The uncorrected voltage value in volts.
+     */
+    float read_v_dut_raw();
+
+    /**
+     * @brief Programs the comparator to assert ALERT on current conversions above a limit.
+     *
+     * The limit is converted through the inverse of the current correction, written
+     * to Hi_thresh (with Lo_thresh slightly below) and the comparator is enabled in
+     * latching mode, active low, for the current channel only. Conversions of the
+     * other channels keep the comparator disabled, which releases ALERT.
+     *
+     * @param amps Corrected current limit in amperes.
+     */
+    void set_current_trip(float amps);
+
+    /** @brief esp_timer time at which the last current conversion was started (µs). */
+    int64_t get_current_conversion_start_us() const;
+
 private:
     /**
      * @brief Pointer to an I2C instance used for communication.
      */
     I2C* i2c;
 
+    /**
+     * @brief Pointer to the Calibration holding the correction tables.
+     */
+    Calibration* calibration;
+
+    /**
+     * @brief Comparator threshold for the current channel (0 = comparator disabled).
+     */
+    int16_t currentTripCode;
+
+    /**
+     * @brief Start time of the last current conversion, for the trip latency.
+     */
+    volatile int64_t currentConversionStartUs;
+
+    /**
+     * @brief Writes a 16-bit ADS1115 register.
+     * 
+     * @param reg Register address.
+     * @param value Register value.
+     */
+    void write_register(uint8_t reg, uint16_t value);
+
     /**
      * @brief Reads the ADC value from the specified channel.
      * 
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "logger.h"
 
 #define ANALOG_SW1_ENABLE GPIO_NUM_23    // ADG1219BRJZ-REEL Analog Switch | Analog SW1 Enable - DAC Enable
 #define ANALOG_SW4_ENABLE GPIO_NUM_19   // ADG1334BRSZ-REEL Analog Switch | Analog SW4 Enable - Power
@@ -102,4 +103,11 @@ public:
      * effectively disconnecting the DUT from the circuit.
      */
     void relay_dut_disable();
+
+    /**
+     * @brief Disables the DUT relay from an interrupt handler.
+     *
+     * Same as relay_dut_disable() without logging, for the over-current trip ISR.
+     */
+    static void IRAM_ATTR relay_dut_disable_from_isr();
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+/**
+ * @file battery_test.h
+ * @brief Header file for the BatteryTest class.
+ *
+ * This file contains the declaration of the BatteryTest class, which runs a
+ * battery discharge test: the battery is loaded in CC or CW mode until its
+ * voltage stays below a cutoff, while the delivered charge (mAh) and energy
+ * (Wh) are integrated on every control period sample. The result of the last
+ * test is stored in SPIFFS and loaded at boot.
+ *
+ * @note Call init() after SPIFFS is mounted.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "logger.h"
+#include "integrator.h"
+#include <SPIFFS.h>
+
+class DAC;
+class AnalogSws;
+class SoaLimiter;
+
+#define BAT_RESULT_PATH "/battery.json"    /*!< SPIFFS file holding the last test result */
+
+#define BAT_CUTOFF_HYSTERESIS 0.05  /*!< Volts above the cutoff that re-arm the cutoff filter */
+#define BAT_CUTOFF_SAMPLES 25       /*!< Consecutive samples below the cutoff that end the test */
+#define BAT_MIN_CUTOFF_VOLTAGE 0.5  /*!< Lowest accepted cutoff voltage in volts */
+#define BAT_MAX_CUTOFF_VOLTAGE 60.0 /*!< Highest accepted cutoff voltage in volts */
+
+/**
+ * @enum BAT_MODE
+ * @brief Load mode used to discharge the battery.
+ */
+enum BAT_MODE {
+    BAT_MODE_CC,
+    BAT_MODE_CW
+};
+
+/**
+ * @enum BAT_STATUS
+ * @brief State of the discharge test.
+ */
+enum BAT_STATUS {
+    BAT_IDLE,
+    BAT_STARTING,
+    BAT_RUNNING,
+    BAT_DONE,       ///< Stopped at the cutoff voltage
+    BAT_STOPPED,    ///< Stopped by the user
+    BAT_ABORTED     ///< Stopped by a safety trip
+};
+
+/**
+ * @struct BatteryResult
+ * @brief Summary of a discharge test.
+ */
+struct BatteryResult {
+    BAT_MODE mode;          ///< Load mode
+    BAT_STATUS status;      ///< How the test ended
+    float setpoint;         ///< Discharge current (A) or power (W)
+    float cutoff;           ///< Cutoff voltage in volts
+    uint32_t elapsedMs;     ///< Test duration in milliseconds
+    float capacityMah;      ///< Delivered charge in mAh
+    float energyWh;         ///< Delivered energy in Wh
+    float endVoltage;       ///< Last voltage reading in volts
+};
+
+/**
+ * @class BatteryTest
+ * @brief Battery discharge test with cutoff and capacity accounting.
+ *
+ * Like the calibration sweep, the test is non-blocking: run() is called from
+ * the control task with every new voltage/current sample and integrates them
+ * with the trapezoidal rule over the measured sample interval. The cutoff is
+ * filtered with a hysteresis band and a sample count, so load steps and noise
+ * do not end the test early. Writing the result to flash is left to the UI
+ * task through save_pending().
+ */
+class BatteryTest {
+public:
+    /** @brief Constructor for the BatteryTest class. */
+    BatteryTest();
+
+    /**
+     * @brief Loads the last stored result and keeps the peripherals for tests.
+     * @param dacPointer Pointer to the DAC used to set the discharge current or power.
+     * @param swsPointer Pointer to the analog switches used to select CC mode.
+     * @param soaPointer Pointer to the SOA limiter clamping the current or power.
+     */
+    void init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer);
+
+    /**
+     * @brief Starts a discharge test (control task).
+     * @param mode CC or CW discharge.
+     * @param setpoint Discharge current (A) or power (W).
+     * @param cutoff Cutoff voltage in volts.
+     * @return true if the test was started.
+     */
+    bool start(BAT_MODE mode, float setpoint, float cutoff);
+
+    /**
+     * @brief Checks the parameters of a test without starting it.
+     * @param mode CC or CW discharge.
+     * @param setpoint Discharge current (A) or power (W).
+     * @param cutoff Cutoff voltage in volts.
+     * @return true if start() would accept them.
+     */
+    static bool is_valid_test(BAT_MODE mode, float setpoint, float cutoff);
+
+    /**
+     * @brief Configures a started test, integrates the sample and checks the cutoff (control task).
+     * @param voltage Latest DUT voltage in volts.
+     * @param current Latest DUT current in amperes.
+     * @param timeUs esp_timer time at which the sample was taken.
+     */
+    void run(float voltage, float current, int64_t timeUs);
+
+    /** @brief Ends a running test on user request (control task). */
+    void stop();
+
+    /** @brief Ends a running test after a safety trip (control task). */
+    void abort();
+
+    /**
+     * @brief Writes the result of a finished test to SPIFFS (UI task).
+     * @return true if a result was written.
+     */
+    bool save_pending();
+
+    /** @brief Whether a test is currently running. */
+    bool is_running() const;
+
+    /** @brief Whether a result was stored in SPIFFS (now or at boot). */
+    bool has_stored_result() const;
+
+    BAT_STATUS get_status() const;
+    const char* get_status_name() const;
+    BAT_MODE get_mode() const;
+    float get_setpoint() const;
+    float get_cutoff() const;
+    uint32_t get_elapsed_ms() const;
+    float get_capacity_mah() const;
+    float get_energy_wh() const;
+
+    /** @brief Result of the last finished test (stored or from this boot). */
+    const BatteryResult& get_last_result() const;
+
+private:
+    DAC* dac;
+    AnalogSws* sws;
+    SoaLimiter* soa;
+
+    BAT_MODE mode;
+    volatile BAT_STATUS status;
+    float setpoint;
+    float cutoff;
+
+    EnergyIntegrator integrator; ///< Charge and energy since the first sample, same engine as the LCD totals
+    float lastVoltage;          ///< Previous voltage sample
+    uint16_t belowCutoff;       ///< Consecutive samples below the cutoff
+
+    // Published copies for other tasks (single 32-bit stores)
+    volatile uint32_t elapsedMs;
+    volatile float capacityMah;
+    volatile float energyWh;
+
+    BatteryResult lastResult;
+    bool stored;
+    volatile bool savePending;
+
+    void apply_setpoint(float voltage);
+    void finish(BAT_STATUS finalStatus, float voltage);
+    bool load();
+    bool save();
+};
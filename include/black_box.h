@@ -0,0 +1,129 @@
+/**
+ * @file black_box.h
+ * @brief Header file for the BlackBox class.
+ *
+ * This file contains the declaration of the BlackBox class, the safety flight
+ * recorder. The control task records every sample (V, I, temperature,
+ * setpoint, output) into a RAM ring covering the last few seconds. On a safety
+ * shutdown the ring is frozen together with the reason and the trip time, and
+ * the UI task later writes it to SPIFFS as CSV. The last BLACKBOX_MAX_TRIPS
+ * trips are kept and can be downloaded over HTTP.
+ *
+ * @note Call init() after SPIFFS is mounted.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+
+class RTC;
+
+#define BLACKBOX_SAMPLES 250            /*!< Ring length: 5 s of history at the 20 ms control period */
+#define BLACKBOX_MAX_TRIPS 4            /*!< Trips kept in SPIFFS, the oldest is overwritten */
+#define BLACKBOX_PATH_FORMAT "/blackbox%u.csv"  /*!< SPIFFS file of a slot (trip number % BLACKBOX_MAX_TRIPS) */
+
+/**
+ * @struct BlackBoxSample
+ * @brief One control period as seen by the recorder.
+ */
+struct BlackBoxSample {
+    uint32_t timeUs;        ///< Low 32 bits of the esp_timer time of the sample
+    float voltage;          ///< DUT voltage in volts
+    float current;          ///< DUT current in amperes
+    float temperature;      ///< Heatsink temperature in °C
+    float setpoint;         ///< Setpoint of the current mode
+    bool outputActive;      ///< Output state when the sample was taken
+};
+
+/**
+ * @struct BlackBoxTrip
+ * @brief Index entry of a stored trip.
+ */
+struct BlackBoxTrip {
+    uint32_t number;        ///< Trip number since the first boot (0 = slot unused)
+    uint64_t timestampMs;   ///< RTC time of the trip (ms since 2000-01-01)
+    uint16_t samples;       ///< Samples stored before the trip
+    char reason[32];        ///< Shutdown reason
+};
+
+/**
+ * @class BlackBox
+ * @brief Pre-trip sample history frozen on a safety shutdown.
+ *
+ * freeze() only sets a few fields and a flag, so it can be called from the
+ * shutdown path without blocking it. While frozen the control task stops
+ * recording; save_pending() writes the ring from the UI task and re-arms the
+ * recorder. A trip that happens while the previous one is still being written
+ * is counted but not recorded.
+ */
+class BlackBox {
+public:
+    /** @brief Constructor for the BlackBox class. */
+    BlackBox();
+
+    /**
+     * @brief Restores the index of the stored trips from SPIFFS.
+     * @param rtcPointer Pointer to the RTC that timestamps the trips.
+     */
+    void init(RTC* rtcPointer);
+
+    /**
+     * @brief Appends a sample to the ring unless it is frozen (control task).
+     * @param sample The sample.
+     */
+    void record(const BlackBoxSample& sample);
+
+    /**
+     * @brief Freezes the ring after a shutdown (safety supervisor).
+     * @param reason Shutdown reason.
+     * @param timeUs esp_timer time of the trip.
+     */
+    void freeze(const char* reason, int64_t timeUs);
+
+    /**
+     * @brief Writes a frozen ring to SPIFFS and re-arms the recorder (UI task).
+     * @return true if a trip was written.
+     */
+    bool save_pending();
+
+    /**
+     * @brief Stored trip of a slot.
+     * @param slot 0 to BLACKBOX_MAX_TRIPS - 1.
+     */
+    const BlackBoxTrip& get_trip(uint8_t slot) const;
+
+    /**
+     * @brief SPIFFS path of a stored trip.
+     * @param number Trip number.
+     * @param path Buffer of at least 24 bytes.
+     * @return true if the trip is still stored.
+     */
+    bool get_trip_path(uint32_t number, char* path) const;
+
+    /** @brief Trips lost because the previous one was still being written. */
+    uint32_t get_dropped_count() const;
+
+    /** @brief true while a trip waits to be written. */
+    bool is_frozen() const;
+
+private:
+    BlackBoxSample ring[BLACKBOX_SAMPLES];
+    volatile uint16_t head;             ///< Next slot to write
+    volatile uint16_t count;            ///< Valid samples, up to BLACKBOX_SAMPLES
+    volatile bool writing;              ///< Control task is inside record()
+    volatile bool frozen;
+
+    RTC* rtc;
+
+    int64_t tripUs;
+    char tripReason[32];
+    uint32_t nextNumber;
+    volatile uint32_t droppedCount;
+
+    BlackBoxTrip trips[BLACKBOX_MAX_TRIPS];
+
+    bool save(const BlackBoxTrip& trip, uint16_t first);
+    bool load_header(uint8_t slot);
+};
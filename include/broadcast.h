@@ -0,0 +1,103 @@
+/**
+ * @file broadcast.h
+ * @brief Header file for the BroadcastScheduler class.
+ *
+ * This file contains the declaration of the BroadcastScheduler class, which
+ * decides when the state is broadcast to the WebSocket clients. Any task asks
+ * for a broadcast with request(); requests made while one is already pending
+ * are coalesced into a single frame. Normal requests are sent no faster than
+ * the configured maximum rate, urgent ones (mode and output changes) on the
+ * next UI pass, and an idle connection still gets a refresh every
+ * BROADCAST_INTERVAL. Counters of frames sent and requests suppressed are
+ * printed with the "broadcast" serial command.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define BROADCAST_DEFAULT_RATE_HZ 10    /*!< Default maximum rate of normal broadcasts */
+#define BROADCAST_MIN_RATE_HZ 1         /*!< Lowest configurable maximum rate */
+#define BROADCAST_MAX_RATE_HZ 50        /*!< Highest configurable maximum rate */
+
+/**
+ * @enum BROADCAST_PRIORITY
+ * @brief Urgency of a broadcast request.
+ */
+enum BROADCAST_PRIORITY : uint8_t {
+    BROADCAST_NORMAL,   ///< Setpoint or settings change, rate limited
+    BROADCAST_URGENT    ///< Mode or output change, sent on the next UI pass
+};
+
+/**
+ * @struct BroadcastStats
+ * @brief Counters of the scheduler since boot or the last reset.
+ */
+struct BroadcastStats {
+    uint32_t requests;      ///< Requests received
+    uint32_t suppressed;    ///< Requests coalesced into a frame that was already pending
+    uint32_t sent;          ///< Frames sent
+    uint32_t urgent;        ///< Frames sent ahead of the rate limit
+    uint32_t refreshes;     ///< Frames sent with no request pending
+};
+
+/**
+ * @class BroadcastScheduler
+ * @brief Coalesces and rate limits the state broadcasts.
+ *
+ * request() may be called from any task (UI, AsyncTCP); poll() is called once
+ * per pass by the UI task, which sends the frame when it returns true. The
+ * pending flags and counters are guarded by a spinlock.
+ */
+class BroadcastScheduler {
+public:
+    /**
+     * @brief Constructor for the BroadcastScheduler class.
+     * @param refreshIntervalMs Longest time without a broadcast (milliseconds).
+     */
+    explicit BroadcastScheduler(uint32_t refreshIntervalMs);
+
+    /**
+     * @brief Asks for a broadcast (any task).
+     * @param priority BROADCAST_URGENT to bypass the rate limit.
+     */
+    void request(BROADCAST_PRIORITY priority = BROADCAST_NORMAL);
+
+    /**
+     * @brief Decides whether a frame is due and clears the pending request (UI task).
+     * @param now Current time in milliseconds.
+     * @return True if the caller must broadcast the state now.
+     */
+    bool poll(uint32_t now);
+
+    /**
+     * @brief Sets the maximum rate of normal broadcasts.
+     * @param hz Rate between BROADCAST_MIN_RATE_HZ and BROADCAST_MAX_RATE_HZ.
+     * @return False if the rate is out of range.
+     */
+    bool set_max_rate(uint8_t hz);
+
+    /** @brief Maximum rate of normal broadcasts in Hz. */
+    uint8_t get_max_rate() const { return maxRateHz; }
+
+    /** @brief Copies the counters (any task). */
+    BroadcastStats get_stats() const;
+
+    /** @brief Clears the counters (any task). */
+    void reset_stats();
+
+    /** @brief Prints the rate and counters on the serial port. */
+    void print_report() const;
+
+private:
+    const uint32_t refreshIntervalMs;
+    volatile uint32_t minIntervalMs;    ///< 1000 / maxRateHz
+    volatile uint8_t maxRateHz;
+    bool pending;
+    bool urgentPending;
+    bool sentOnce;
+    uint32_t lastSentMs;
+    BroadcastStats stats;
+    mutable portMUX_TYPE lock;          ///< Guards the pending flags and counters against the AsyncTCP task
+};
@@ -0,0 +1,286 @@
+/**
+ * @file calibration.h
+ * @brief Header file for the Calibration class.
+ *
+ * This file contains the declaration of the Calibration class, which owns the
+ * correction tables used by the ADC and DAC classes. The tables are built from
+ * the default correction parameters in adc.h and dac.h, and can be replaced at
+ * runtime by an automated sweep: the DAC is stepped across its range in CC or
+ * CV mode, the ADC readings are recorded (optionally together with reference
+ * meter values entered through the web UI), and a least-squares polynomial is
+ * fitted on the device. The fit is sampled into fixed-size lookup tables that
+ * are stored in SPIFFS and loaded at boot.
+ *
+ * @note Call init() after SPIFFS is mounted and before using the ADC or DAC.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "logger.h"
+
+class DAC;
+class ADC;
+class AnalogSws;
+
+#define CAL_FILE_PATH "/calibration.bin"  /*!< SPIFFS file holding the calibration tables */
+#define CAL_FILE_MAGIC 0x4C41434C         /*!< "LCAL" */
+#define CAL_FILE_VERSION 1                /*!< Bump when CalibrationData changes */
+
+#define CAL_TABLE_SIZE 33           /*!< Points per lookup table (32 linear segments) */
+#define CAL_MAX_POINTS 16           /*!< Maximum number of sweep points */
+#define CAL_MIN_POINTS 2            /*!< Minimum number of sweep points */
+#define CAL_MAX_FIT_DEGREE 3        /*!< Highest polynomial degree allowed for a fit */
+#define CAL_SETTLE_MS 500           /*!< Settling time after each DAC step in milliseconds */
+#define CAL_SAMPLES_PER_POINT 8     /*!< ADC samples averaged per sweep point */
+
+#define CAL_V_RAW_MAX 120.0         /*!< Upper bound of the raw DUT voltage table in volts */
+#define CAL_I_RAW_MAX 24.0          /*!< Upper bound of the raw DUT current table in amperes */
+
+/**
+ * @struct CalTable
+ * @brief Uniformly spaced lookup table with linear interpolation.
+ *
+ * Values outside [xMin, xMax] are extrapolated from the first or last segment.
+ */
+struct CalTable {
+    float xMin;                 ///< Input value of the first entry
+    float xMax;                 ///< Input value of the last entry
+    float scale;                ///< (CAL_TABLE_SIZE - 1) / (xMax - xMin), cached for lookup()
+    float y[CAL_TABLE_SIZE];    ///< Output values
+
+    /**
+     * @brief Interpolates the table at the given input.
+     * @param x Input value.
+     * @return float Interpolated output value.
+     */
+    float lookup(float x) const;
+};
+
+/**
+ * @enum CAL_MODE
+ * @brief Operating mode used for a calibration sweep.
+ */
+enum CAL_MODE {
+    CAL_MODE_CC,
+    CAL_MODE_CV
+};
+
+/**
+ * @enum CAL_STATUS
+ * @brief State of the calibration sweep.
+ */
+enum CAL_STATUS {
+    CAL_IDLE,
+    CAL_STARTING,
+    CAL_SETTLING,
+    CAL_SAMPLING,
+    CAL_DONE,
+    CAL_ABORTED
+};
+
+/**
+ * @enum CAL_FILE_ACTION
+ * @brief Change of the calibration file left to the UI task.
+ */
+enum CAL_FILE_ACTION : uint8_t {
+    CAL_FILE_NONE,
+    CAL_FILE_WRITE,
+    CAL_FILE_REMOVE
+};
+
+/**
+ * @struct CalPoint
+ * @brief A single sweep point.
+ */
+struct CalPoint {
+    uint16_t code;          ///< DAC code applied
+    float rawVoltage;       ///< Averaged uncorrected DUT voltage in volts
+    float rawCurrent;       ///< Averaged uncorrected DUT current in amperes
+    float reference;        ///< Reference meter value (A in CC, V in CV)
+    bool hasReference;      ///< Whether a reference value was entered
+};
+
+/**
+ * @class Calibration
+ * @brief Correction tables and automated calibration sweep.
+ *
+ * The ADC and DAC classes call the lookup methods on every conversion, so the
+ * tables are kept as plain arrays with a cached scale factor. The sweep is
+ * non-blocking: run() advances it one step per call. start(), run(), abort(),
+ * fit() and reset() are only called from the control task (other tasks post
+ * events to the FSM), so the tables only change between two conversions.
+ * Flash access is left to the UI task through save_pending().
+ */
+class Calibration {
+public:
+    /** @brief Constructor for the Calibration class. */
+    Calibration();
+
+    /**
+     * @brief Loads the stored tables (or the defaults) and keeps the peripherals for sweeps.
+     * @param dacPointer Pointer to the DAC used to step the setpoint.
+     * @param adcPointer Pointer to the ADC used to record readings.
+     * @param swsPointer Pointer to the analog switches used to select CC/CV mode.
+     */
+    void init(DAC* dacPointer, ADC* adcPointer, AnalogSws* swsPointer);
+
+    /**
+     * @brief Starts a calibration sweep.
+     * @param mode CC or CV sweep.
+     * @param points Number of sweep points (CAL_MIN_POINTS..CAL_MAX_POINTS).
+     * @param maxValue Highest setpoint of the sweep (A in CC, V in CV).
+     * @return true if the sweep was started.
+     */
+    bool start(CAL_MODE mode, uint8_t points, float maxValue);
+
+    /**
+     * @brief Checks the parameters of a sweep without starting it.
+     * @param mode CC or CV sweep.
+     * @param points Number of sweep points.
+     * @param maxValue Highest setpoint of the sweep (A in CC, V in CV).
+     * @return true if start() would accept them.
+     */
+    static bool is_valid_sweep(CAL_MODE mode, uint8_t points, float maxValue);
+
+    /** @brief Configures a started sweep and advances it. Must be called periodically while running. */
+    void run();
+
+    /** @brief Aborts a running sweep and sets the DAC to zero. */
+    void abort();
+
+    /**
+     * @brief Stores a reference meter value for a sweep point.
+     * @param index Sweep point index.
+     * @param value Reference value (A in CC, V in CV).
+     * @return true if the value was stored.
+     */
+    bool set_reference(uint8_t index, float value);
+
+    /**
+     * @brief Fits the sweep results and replaces the tables (control task).
+     *
+     * If at least two reference values are present, the ADC table of the swept
+     * quantity is fitted to them first. The DAC table is then fitted against the
+     * reference values, or the corrected ADC readings where none was entered.
+     * The new tables are written to SPIFFS by save_pending().
+     *
+     * @param degree Polynomial degree (1..CAL_MAX_FIT_DEGREE).
+     * @return true if the fit succeeded.
+     */
+    bool fit(uint8_t degree);
+
+    /**
+     * @brief Restores the default tables (control task); save_pending() deletes the stored calibration.
+     * @return true if the defaults were restored (not allowed while a sweep is running or a file change is pending).
+     */
+    bool reset();
+
+    /**
+     * @brief Writes or deletes the calibration file after fit() or reset(). Called by the UI task.
+     * @return true if the file was changed or the write failed.
+     */
+    bool save_pending();
+
+    /** @brief Whether a sweep is currently running. */
+    bool is_running() const;
+
+    /** @brief Whether the tables were loaded from SPIFFS (true) or are the defaults. */
+    bool is_stored() const;
+
+    CAL_STATUS get_status() const;
+    const char* get_status_name() const;
+    CAL_MODE get_mode() const;
+    uint8_t get_point_count() const;
+    uint8_t get_completed_points() const;
+    const CalPoint& get_point(uint8_t index) const;
+
+    /**
+     * @brief Corrects a raw DUT voltage reading.
+     * @param raw Uncorrected voltage in volts.
+     * @return float Corrected voltage in volts.
+     */
+    float correct_v_dut(float raw) const;
+
+    /**
+     * @brief Corrects a raw DUT current reading.
+     * @param raw Uncorrected current in amperes.
+     * @return float Corrected current in amperes.
+     */
+    float correct_i_dut(float raw) const;
+
+    /**
+     * @brief DAC code for a CC mode setpoint.
+     * @param current Target current in amperes.
+     * @return uint16_t DAC code, clamped to the DAC range.
+     */
+    uint16_t cc_code(float current) const;
+
+    /**
+     * @brief DAC code for a CV mode setpoint.
+     * @param voltage Target voltage in volts.
+     * @return uint16_t DAC code, clamped to the DAC range.
+     */
+    uint16_t cv_code(float voltage) const;
+
+private:
+    /**
+     * @struct CalibrationData
+     * @brief On-flash layout of the calibration file.
+     */
+    struct CalibrationData {
+        uint32_t magic;
+        uint16_t version;
+        CalTable vDut;      ///< Raw DUT voltage -> corrected voltage
+        CalTable iDut;      ///< Raw DUT current -> corrected current
+        CalTable ccDac;     ///< CC setpoint in A -> DAC code
+        CalTable cvDac;     ///< CV setpoint in V -> DAC code
+        uint32_t crc;       ///< CRC-32 of all preceding bytes
+    };
+
+    /**
+     * @struct Polynomial
+     * @brief Least-squares polynomial in a normalized input variable.
+     */
+    struct Polynomial {
+        double coeffs[CAL_MAX_FIT_DEGREE + 1];
+        uint8_t degree;
+        double center;      ///< Input offset applied before evaluation
+        double halfRange;   ///< Input scale applied before evaluation
+        double eval(double x) const;
+    };
+
+    DAC* dac;
+    ADC* adc;
+    AnalogSws* sws;
+
+    CalibrationData data;
+    CalibrationData fileData;       ///< Fit workspace, then the copy written by save_pending()
+    volatile CAL_FILE_ACTION fileAction;
+    bool stored;
+
+    CAL_MODE mode;
+    CAL_STATUS status;
+    CalPoint points[CAL_MAX_POINTS];
+    uint8_t pointCount;
+    uint8_t currentPoint;
+    uint16_t maxCode;
+    unsigned long stepStart;
+    uint8_t sampleCount;
+    float voltageSum;
+    float currentSum;
+
+    void load_defaults();
+    bool load();
+    bool save();
+    void begin_point(uint8_t index);
+    void finish(CAL_STATUS finalStatus);
+
+    static bool fit_polynomial(const float* x, const float* y, uint8_t n, uint8_t degree, Polynomial& poly);
+    static void fill_table(CalTable& table, float xMin, float xMax, const Polynomial& poly);
+    static void finalize_table(CalTable& table);
+    static bool table_is_valid(const CalTable& table);
+    static uint32_t crc32(const uint8_t* bytes, size_t length);
+};
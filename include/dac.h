@@ -6,7 +6,8 @@
  * to initialize and control a Digital-to-Analog Converter (DAC) over an I2C bus.
  * It includes functions to set the output voltage and write digital values to the DAC.
  * 
- * The DAC class requires an I2C instance for communication.
+ * The DAC class requires an I2C instance for communication and a Calibration
+ * instance that maps CC/CV setpoints to DAC codes.
  * 
  * @note The DAC resolution is 12 bits, with a reference voltage of 4.096V.
  * The maximum output voltage is 0.5V, and the maximum digital value is 4095.
@@ -19,6 +20,8 @@
 #include <Arduino.h>
 
 #include "i2c.h"
+#include "calibration.h"
+#include "logger.h"
 
 #define MCP4725_ADDR 0x60   /*!< MCP4725 I2C address */
 #define CANT_MOSFET 4
@@ -39,6 +42,7 @@
 #define DAC_CW_MAX_POWER 200
 
 /* ----------------- CORRECTION PARAMETERS ----------------- */
+// Defaults for the Calibration tables, used until a calibration is stored
 #define CC_CORRECTION_PARAMETER_SLOPE -0.019 /*!< Correction parameter for CC mode */
 #define CC_CORRECTION_PARAMETER_INTERCEPT 0.040 /*!< Correction parameter for CC mode */
 
@@ -53,7 +57,7 @@
  * over an I2C bus. It allows setting the output voltage and writing digital
  * values to the DAC.
  * 
- * @note This class requires an I2C instance for communication.
+ * @note This class requires an I2C instance and a Calibration instance.
  */
 class DAC {
 public:
@@ -72,8 +76,9 @@ public:
      * with the DAC over the I2C bus.
      * 
      * @param i2cPointer A pointer to an I2C instance used for communication with the DAC.
+     * @param calibrationPointer A pointer to the Calibration holding the setpoint tables.
      */
-    void init(I2C* i2cPointer);
+    void init(I2C* i2cPointer, Calibration* calibrationPointer);
 
     /**
      * @brief Sets the output voltage of the DAC.
@@ -128,4 +133,6 @@ public:
 
 private:
     I2C* i2c; /*!< Pointer to I2C communication interface */
+    Calibration* calibration; /*!< Pointer to the setpoint correction tables */
+    uint16_t lastDigitalValue; /*!< Last code written, used to skip redundant writes */
 };
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+ * @file distribution.h
+ * @brief Header file for the Distribution class.
+ *
+ * This file contains the declaration of the Distribution class, which tracks
+ * the distribution of the DUT voltage and current samples for noise
+ * measurements. The p50/p95/p99/p99.9 quantiles are estimated with the P²
+ * algorithm (five markers per quantile, no stored samples), and a fixed-bin
+ * histogram centred on the signal is kept next to them. Memory is bounded
+ * whatever the length of the session. Results are served at GET /distribution.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define DIST_HISTOGRAM_BINS 64          /*!< Histogram bins between the underflow and overflow counters */
+#define DIST_WARMUP_SAMPLES 50          /*!< Samples used to place the histogram range (1 s) */
+#define DIST_RANGE_FACTOR 2.0           /*!< Histogram half-width = factor × largest warm-up deviation */
+#define DIST_MIN_HALF_WIDTH_V 0.002     /*!< Smallest histogram half-width for the voltage (V) */
+#define DIST_MIN_HALF_WIDTH_I 0.002     /*!< Smallest histogram half-width for the current (A) */
+
+/**
+ * @enum DIST_CHANNEL
+ * @brief Channels with a distribution.
+ */
+enum DIST_CHANNEL : uint8_t {
+    DIST_VOLTAGE,
+    DIST_CURRENT,
+    DIST_CHANNEL_COUNT
+};
+
+/**
+ * @enum DIST_QUANTILE
+ * @brief Estimated quantiles.
+ */
+enum DIST_QUANTILE : uint8_t {
+    DIST_P50,
+    DIST_P95,
+    DIST_P99,
+    DIST_P999,
+    DIST_QUANTILE_COUNT
+};
+
+/**
+ * @class P2Quantile
+ * @brief P² streaming estimate of one quantile (Jain & Chlamtac, 1985).
+ *
+ * Five markers track the minimum, p/2, p, (1+p)/2 and the maximum. Each sample
+ * moves the marker positions, and markers that drift from their ideal position
+ * are adjusted with a piecewise-parabolic prediction. O(1) time, 40 bytes.
+ */
+class P2Quantile {
+public:
+    /** @brief Constructor for the P2Quantile class. */
+    P2Quantile();
+
+    /**
+     * @brief Sets the quantile and clears the markers.
+     * @param quantile Quantile between 0 and 1, e.g. 0.99.
+     */
+    void init(float quantile);
+
+    /** @brief Clears the markers, keeping the quantile. */
+    void reset();
+
+    /** @brief Adds a sample. */
+    void add(float x);
+
+    /** @brief Current estimate (exact for fewer than five samples). */
+    float get() const;
+
+private:
+    float p;
+    float q[5];             ///< Marker heights
+    int32_t n[5];           ///< Marker positions (1-based)
+    uint32_t count;
+
+    float parabolic(uint8_t i, int8_t d) const;
+    float linear(uint8_t i, int8_t d) const;
+};
+
+/**
+ * @struct DistributionSnapshot
+ * @brief Quantiles and histogram of one channel.
+ */
+struct DistributionSnapshot {
+    uint32_t count;                         ///< Samples since the last reset
+    float min;
+    float max;
+    float quantiles[DIST_QUANTILE_COUNT];   ///< p50, p95, p99, p99.9
+    bool histogramReady;                    ///< false during the warm-up
+    float histogramLow;                     ///< Lower edge of the first bin
+    float binWidth;
+    uint32_t underflow;                     ///< Samples below the first bin
+    uint32_t overflow;                      ///< Samples above the last bin
+    uint32_t bins[DIST_HISTOGRAM_BINS];
+};
+
+/**
+ * @class Distribution
+ * @brief Streaming quantiles and histograms of V and I.
+ *
+ * The control task adds every sample. The histogram range is placed after
+ * DIST_WARMUP_SAMPLES samples: centred on their median, DIST_RANGE_FACTOR
+ * times their largest deviation wide, and then fixed until the next reset. The
+ * warm-up samples are kept and binned at that point. Readers on other tasks copy
+ * a channel under a spinlock. reset() only raises a flag that the control task
+ * honours on its next sample.
+ */
+class Distribution {
+public:
+    /** @brief Constructor for the Distribution class. */
+    Distribution();
+
+    /**
+     * @brief Adds one sample of each channel (control task).
+     * @param voltage DUT voltage in volts.
+     * @param current DUT current in amperes.
+     */
+    void add_sample(float voltage, float current);
+
+    /** @brief Starts a new session at the next sample (any task). */
+    void reset();
+
+    /**
+     * @brief Copies the distribution of a channel (any task).
+     * @param channel The channel.
+     * @param snapshot Receives the distribution.
+     */
+    void get_snapshot(DIST_CHANNEL channel, DistributionSnapshot& snapshot) const;
+
+    /** @brief Quantile level, e.g. 0.999 for DIST_P999. */
+    static float get_quantile_level(DIST_QUANTILE quantile);
+
+private:
+    struct Channel {
+        P2Quantile estimators[DIST_QUANTILE_COUNT];
+        DistributionSnapshot data;
+        float warmup[DIST_WARMUP_SAMPLES];
+    };
+
+    Channel channels[DIST_CHANNEL_COUNT];
+    volatile bool resetRequested;
+    mutable portMUX_TYPE lock;      ///< Guards the channels against readers on the other core
+
+    void clear();
+    void add(Channel& channel, float value, float minHalfWidth);
+    static void bin(DistributionSnapshot& data, float value);
+};
@@ -7,6 +7,11 @@
  * Encoder class includes methods for initializing the encoder, checking button 
  * presses, retrieving and setting the encoder position, and handling interrupts.
  * 
+ * The ISRs only push EVENT_ENCODER_STEP/EVENT_ENCODER_PRESS into the event
+ * queue. The FSM forwards them with apply_step()/apply_press(), and the UI task
+ * folds them into the position when it reads the encoder, so the position and
+ * its limits are only touched by the UI task.
+ * 
  * @note This class assumes that the underlying hardware supports rotary encoders.
  * @note This class assumes only one encoder is used.
  * 
@@ -15,6 +20,9 @@
 #pragma once
 
 #include <Arduino.h>
+#include <atomic>
+#include "event_queue.h"
+#include "logger.h"
 
 // Hardware pin definitions
 #define ENCODER_CLK GPIO_NUM_32
@@ -52,8 +60,19 @@ public:
      * 
      * This function sets up the necessary configurations and initializes the encoder
      * for use. It should be called before any other encoder-related functions.
+     * 
+     * @param eventQueue Queue receiving the encoder events from the ISRs.
      */
-    void init();
+    void init(EventQueue* eventQueue);
+
+    /**
+     * @brief Records a rotation step forwarded from the event queue.
+     * @param direction +1 for clockwise, -1 for counter-clockwise.
+     */
+    void apply_step(int direction);
+
+    /** @brief Records a button press forwarded from the event queue. */
+    void apply_press();
 
     /**
      * @brief Checks if the button is pressed.
@@ -134,12 +153,20 @@ private:
      */
     static void IRAM_ATTR handle_button_interrupt();
 
+    /**
+     * @brief Folds the forwarded steps and presses into the position (UI task).
+     */
+    void collect();
+
     static Encoder* instance;         // Global instance pointer
+    static EventQueue* events;        // Queue receiving the ISR events
     volatile int lastState;           // State of the CLK pin
-    volatile int position;            // Encoder position (marked volatile)
-    volatile int lastPosition;        // Last encoder position (marked volatile)
-    volatile bool buttonPressed;      // Button press status (marked volatile)
+    int position;                     // Encoder position (UI task only)
+    int lastPosition;                 // Last encoder position (UI task only)
+    bool buttonPressed;               // Button press status (UI task only)
     int encoderMaxPosition;           // Maximum position value for the encoder
     int encoderMinPosition;           // Minimum position value for the encoder
     volatile int lastStateDT;         // State of the DT pin for better direction detection
+    std::atomic<int> pendingSteps;    // Steps forwarded by the FSM, not yet collected
+    std::atomic<int> pendingPresses;  // Presses forwarded by the FSM, not yet collected
 };
@@ -0,0 +1,143 @@
+/**
+ * @file event_queue.h
+ * @brief Header file for the EventQueue class and event definitions.
+ *
+ * This file contains the declaration of the EventQueue class, a bounded
+ * lock-free multi-producer/single-consumer queue of typed input events. The
+ * encoder ISRs, the UI task, the AsyncTCP (WebSocket) task and the safety check
+ * push events; the FSM pops them at the start of every control period, so all
+ * changes to the FSM state happen in the control task.
+ *
+ * @note push() may be called from any task or ISR; pop() only from the consumer.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#define EVENT_QUEUE_SIZE 32 /*!< Number of slots, must be a power of two */
+
+/**
+ * @enum EVENT_TYPE
+ * @brief Types of input events.
+ */
+enum EVENT_TYPE : uint8_t {
+    EVENT_ENCODER_STEP,         ///< value.i: +1 clockwise, -1 counter-clockwise
+    EVENT_ENCODER_PRESS,        ///< Encoder button pressed
+    EVENT_SET_STATE,            ///< value.i: FSM_MAIN_STATES to enter
+    EVENT_SET_SETPOINT,         ///< value.f: new setpoint
+    EVENT_ADJUST_SETPOINT,      ///< value.f: amount added to the setpoint
+    EVENT_SET_OUTPUT,           ///< value.i: 1 to enable the output, 0 to disable it
+    EVENT_TOGGLE_OUTPUT,        ///< Toggle the output
+    EVENT_CALIBRATION_START,    ///< arg[0]: CAL_MODE, arg[1]: points, value.f: max setpoint
+    EVENT_CALIBRATION_ABORT,    ///< Abort a running calibration sweep
+    EVENT_CALIBRATION_FIT,      ///< arg[0]: polynomial degree
+    EVENT_CALIBRATION_RESET,    ///< Restore the default correction tables
+    EVENT_BATTERY_START,        ///< arg[0]: BAT_MODE, value.f: setpoint, aux: cutoff voltage
+    EVENT_BATTERY_STOP,         ///< Stop a running battery discharge test
+    EVENT_SWEEP_START,          ///< arg[0]: IV_MODE, arg[1]: points, value.f: start, aux: stop
+    EVENT_SWEEP_ABORT,          ///< Abort a running I-V sweep
+    EVENT_MPPT_START,           ///< arg[0]: MPPT_ALGORITHM, value.f: current step, aux: max current
+    EVENT_STOP_ADD,             ///< arg[0]: STOP_VARIABLE, arg[1]: '<' or '>', value.f: threshold
+    EVENT_STOP_CLEAR,           ///< Remove all stop conditions
+    EVENT_CURRENT_TRIP,         ///< value.f: new hardware trip current
+    EVENT_SAFETY_TRIP           ///< Safety limit exceeded
+};
+
+/**
+ * @struct Event
+ * @brief A single input event (12 bytes).
+ */
+struct Event {
+    EVENT_TYPE type;            ///< Event type
+    uint8_t arg[3];             ///< Small arguments, see EVENT_TYPE
+    union {
+        int32_t i;
+        float f;
+    } value;                    ///< Main argument, see EVENT_TYPE
+    float aux;                  ///< Second float argument, see EVENT_TYPE
+};
+
+/**
+ * @brief Builds an event with an integer argument.
+ * @param type Event type.
+ * @param value Integer argument.
+ * @return Event The event.
+ */
+inline Event make_event(EVENT_TYPE type, int32_t value = 0) {
+    Event event = {type, {0, 0, 0}, {0}, 0.0f};
+    event.value.i = value;
+    return event;
+}
+
+/**
+ * @brief Builds an event with a float argument.
+ * @param type Event type.
+ * @param value Float argument.
+ * @return Event The event.
+ */
+inline Event make_event_f(EVENT_TYPE type, float value) {
+    Event event = {type, {0, 0, 0}, {0}, 0.0f};
+    event.value.f = value;
+    return event;
+}
+
+/**
+ * @brief Builds an event with two float arguments.
+ * @param type Event type.
+ * @param value Main float argument.
+ * @param aux Second float argument.
+ * @return Event The event.
+ */
+inline Event make_event_f2(EVENT_TYPE type, float value, float aux) {
+    Event event = make_event_f(type, value);
+    event.aux = aux;
+    return event;
+}
+
+/**
+ * @class EventQueue
+ * @brief Bounded lock-free MPSC queue of events.
+ *
+ * Each slot carries a sequence number: producers claim a position with a
+ * compare-and-swap on the head and publish the slot by advancing its sequence,
+ * so a producer preempted by an ISR never blocks the ISR. The consumer stops at
+ * the first slot not yet published.
+ */
+class EventQueue {
+public:
+    /** @brief Constructor for the EventQueue class. */
+    EventQueue();
+
+    /**
+     * @brief Adds an event to the queue. Safe from any task or ISR.
+     * @param event The event to add.
+     * @return true if the event was queued, false if the queue was full.
+     */
+    bool push(const Event& event);
+
+    /**
+     * @brief Removes the oldest event from the queue (consumer only).
+     * @param event Receives the event.
+     * @return true if an event was removed, false if the queue was empty.
+     */
+    bool pop(Event& event);
+
+    /** @brief Number of events dropped because the queue was full. */
+    uint32_t get_dropped() const;
+
+private:
+    static_assert((EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) == 0, "EVENT_QUEUE_SIZE must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> sequence; ///< Position + 1 when published, position + size when free
+        Event event;
+    };
+
+    Slot slots[EVENT_QUEUE_SIZE];
+    std::atomic<uint32_t> head;         ///< Next position to claim (producers)
+    uint32_t tail;                      ///< Next position to read (consumer)
+    std::atomic<uint32_t> dropped;      ///< Events lost because the queue was full
+};
@@ -0,0 +1,96 @@
+/**
+ * @file fast_trip.h
+ * @brief Header file for the FastTrip class.
+ *
+ * This file contains the declaration of the FastTrip class, the hardware
+ * over-current trip. The ADS1115 comparator is programmed with the current
+ * limit and its ALERT/RDY output is wired to FAST_TRIP_ALERT_PIN: the ISR opens
+ * the DUT relay directly and wakes the SafetySupervisor, which zeroes the DAC
+ * over I2C and reports the trip to the FSM. Trip latencies are measured in
+ * microseconds.
+ *
+ * @note ALERT/RDY is open drain and GPIO 34 has no internal pull-up, so the
+ *       board needs an external pull-up on that line.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "logger.h"
+
+class ADC;
+class SafetySupervisor;
+
+#define FAST_TRIP_ALERT_PIN GPIO_NUM_34     /*!< ADS1115 ALERT/RDY input (active low) */
+
+/**
+ * @class FastTrip
+ * @brief Over-current trip driven by the ADS1115 comparator.
+ *
+ * The comparator only sees conversions of the current channel, so a spike is
+ * detected at the end of the next current conversion (one ADS1115 conversion
+ * time, about 2 ms at 475 SPS, instead of a whole control period plus the time
+ * to the software check). From there the relay is opened in the ISR.
+ */
+class FastTrip {
+public:
+    /** @brief Constructor for the FastTrip class. */
+    FastTrip();
+
+    /**
+     * @brief Programs the comparator and attaches the ALERT interrupt.
+     * @param adcPointer Pointer to the ADC whose comparator watches the current.
+     * @param supervisorPointer Pointer to the supervisor completing the shutdown.
+     * @param tripCurrent Current limit in amperes.
+     */
+    void init(ADC* adcPointer, SafetySupervisor* supervisorPointer, float tripCurrent);
+
+    /**
+     * @brief Reprograms the comparator with a new limit (control task, which owns the ADC).
+     * @param current Current limit in amperes.
+     */
+    void set_trip_current(float current);
+
+    /**
+     * @brief Records the latencies of a trip once the DAC is at zero (supervisor task).
+     * @param dacUs esp_timer time at which the DAC write completed, as returned by the shutdown.
+     */
+    void record_shutdown(int64_t dacUs);
+
+    /** @brief Number of trips since boot; changes on every trip. */
+    uint32_t get_trip_count() const;
+
+    /** @brief Current limit in amperes. */
+    float get_trip_current() const;
+
+    /** @brief Start of the current conversion to ALERT interrupt of the last trip (µs). */
+    uint32_t get_detect_us() const;
+
+    /** @brief ALERT interrupt to relay open of the last trip (µs). */
+    uint32_t get_relay_us() const;
+
+    /** @brief ALERT interrupt to DAC at zero of the last trip (µs). */
+    uint32_t get_dac_us() const;
+
+    /** @brief Longest ALERT interrupt to DAC at zero since boot (µs). */
+    uint32_t get_max_dac_us() const;
+
+private:
+    static FastTrip* instance;
+
+    ADC* adc;
+    SafetySupervisor* supervisor;
+    float tripCurrent;
+
+    volatile int64_t alertUs;
+    volatile int64_t relayUs;
+
+    volatile uint32_t tripCount;
+    volatile uint32_t detectUs;
+    volatile uint32_t relayLatencyUs;
+    volatile uint32_t dacLatencyUs;
+    volatile uint32_t maxDacLatencyUs;
+
+    static void IRAM_ATTR handle_alert();
+};
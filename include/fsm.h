@@ -7,7 +7,7 @@
  * operation modes: Constant Current (CC), Constant Voltage (CV),
  * Constant Resistance (CR), and Constant Power (CW). It handles state
  * transitions and execution logic using DAC and analog switches, and reads
- * measurements via ADC.
+ * measurements via ADC. All requests reach it through the event queue.
  *
  * @note Ensure to call init() before run().
  *
@@ -29,6 +29,10 @@ enum FSM_MAIN_STATES {
     CR,
     CW,
     SETTINGS,
+    CALIBRATION,
+    BATTERY,
+    SWEEP,
+    MPPT,
     FINAL
 };
 
@@ -51,40 +55,266 @@ enum FSM_MAIN_STATES {
  * @brief A finite state machine for electronic load control.
  *
  * The FSM class manages operation modes (CC, CV, CR, CW) of the electronic load.
- * It transitions between states, applies output settings via DAC and switches,
- * and reads inputs via ADC.
+ * Each state has on_enter/on_control/on_exit hardware handlers, on_ui/on_ui_exit
+ * screen handlers, a setpoint limit and a mask of allowed next states, all kept
+ * in a constant table.
+ *
+ * The FSM is shared by two tasks. Requests from the encoder, the UI, the
+ * WebSocket clients and the safety check are posted to the event queue, and
+ * run_control() drains the queue at the start of every control period, so the
+ * state, setpoint and output only ever change in the control task and are
+ * applied to the hardware in the same period. run_ui() runs the screen handlers
+ * in the UI task and follows the state the control task has settled on.
  */
 class FSM {
 public:
-    /** @brief Constructor for FSM. */
-    FSM();
+    /**
+     * @brief Constructor for FSM.
+     * @param dac Reference to the DAC controller.
+     * @param sws Reference to the AnalogSws controller.
+     * @param calibration Reference to the calibration run by the CALIBRATION state.
+     * @param battery Reference to the discharge test run by the BATTERY state.
+     * @param sweep Reference to the I-V tracer run by the SWEEP state.
+     * @param mppt Reference to the maximum power point tracker run by the MPPT state.
+     * @param stops Reference to the stop conditions checked in the load modes.
+     * @param soa Reference to the SOA limiter clamping the CC, CR and CW setpoints.
+     * @param fastTrip Reference to the hardware over-current trip re-armed on limit and calibration changes.
+     * @param encoder Reference to the encoder receiving the forwarded encoder events.
+     * @param events Reference to the event queue drained by run_control().
+     */
+    FSM(DAC& dac, AnalogSws& sws, Calibration& calibration, BatteryTest& battery, IvSweep& sweep, MpptTracker& mppt, StopConditions& stops, SoaLimiter& soa, FastTrip& fastTrip, Encoder& encoder, EventQueue& events);
 
     /** @brief Initialize the FSM to the default state. */
     void init();
 
     /**
-     * @brief Execute the FSM logic for the current state.
-     * @param input The target input value (current, voltage, etc.).
-     * @param dac Reference to the DAC controller.
-     * @param sws Reference to the AnalogSws controller.
-     * @param output_active Pointer to the output active flag.
-     * @param adc Reference to the ADC controller.
+     * @brief Control part of the FSM: handles the queued events, then applies setpoint and relay.
+     * @param dutVoltage Latest DUT voltage reading, used by the CR, CW and BATTERY modes.
+     * @param dutCurrent Latest DUT current reading, used by the BATTERY, SWEEP and MPPT modes.
+     * @param sampleUs esp_timer time at which the reading was taken, used for charge and time integration.
+     * @note Call only from the control task.
      */
-    void run(float input, DAC dac, AnalogSws sws, bool* output_active, ADC adc);
+    void run_control(float dutVoltage, float dutCurrent, int64_t sampleUs);
 
     /**
-     * @brief Change the current state of the FSM.
+     * @brief UI part of the FSM: runs the screen handlers of the current state.
+     * @note Call only from the UI task.
+     */
+    void run_ui();
+
+    /**
+     * @brief Request a transition to another state.
      * @param newState The state to transition to.
+     * @return true if the request was queued; disallowed transitions are dropped by run_control().
      */
-    void change_state(FSM_MAIN_STATES newState);
+    bool change_state(FSM_MAIN_STATES newState);
 
-    /** @brief Check if the state has changed since last check. */
+    /** @brief Check if the current state was entered since the last check (UI task only). */
     bool has_changed();
 
     /** @brief Get the current FSM state. */
     FSM_MAIN_STATES get_current_state();
 
+    /**
+     * @brief Request a new target input value (current, voltage, etc.).
+     * @param value New setpoint, clamped to [0, get_max_setpoint()].
+     */
+    void set_setpoint(float value);
+
+    /**
+     * @brief Request a change of the target input value.
+     * @param delta Amount added to the setpoint; the result is clamped like set_setpoint().
+     */
+    void adjust_setpoint(float delta);
+
+    /** @brief Get the target input value. */
+    float get_setpoint();
+
+    /** @brief Highest setpoint of the current state (0 in states without a setpoint). */
+    float get_max_setpoint();
+
+    /**
+     * @brief Request to enable or disable the DUT relay.
+     * @param active New output state.
+     */
+    void set_output_active(bool active);
+
+    /** @brief Request to toggle the DUT relay. */
+    void toggle_output();
+
+    /** @brief Whether the output is enabled. */
+    bool is_output_active();
+
+    /**
+     * @brief Request a calibration sweep; enters CALIBRATION if the sweep starts.
+     * @param mode CC or CV sweep.
+     * @param points Number of sweep points.
+     * @param maxValue Highest setpoint of the sweep (A in CC, V in CV).
+     * @return true if the request was queued.
+     */
+    bool start_calibration(CAL_MODE mode, uint8_t points, float maxValue);
+
+    /** @brief Request to abort a running calibration sweep. */
+    void abort_calibration();
+
+    /**
+     * @brief Request to reprogram the hardware over-current trip.
+     * @param current New trip current in amperes.
+     * @return true if the request was queued.
+     */
+    bool set_current_trip(float current);
+
+    /**
+     * @brief Request a fit of the completed calibration sweep.
+     * @param degree Polynomial degree.
+     * @return true if the request was queued.
+     */
+    bool fit_calibration(uint8_t degree);
+
+    /**
+     * @brief Request to restore the default correction tables.
+     * @return true if the request was queued.
+     */
+    bool reset_calibration();
+
+    /**
+     * @brief Request a battery discharge test; enters BATTERY if the test starts.
+     * @param mode CC or CW discharge.
+     * @param setpoint Discharge current (A) or power (W).
+     * @param cutoff Cutoff voltage in volts.
+     * @return true if the request was queued.
+     */
+    bool start_battery_test(BAT_MODE mode, float setpoint, float cutoff);
+
+    /** @brief Request to stop a running battery discharge test (the state is kept to show the result). */
+    void stop_battery_test();
+
+    /**
+     * @brief Request an I-V sweep; enters SWEEP if the sweep starts.
+     * @param mode CC or CV sweep.
+     * @param startValue First setpoint (A in CC, V in CV).
+     * @param stopValue Last setpoint (A in CC, V in CV).
+     * @param points Number of points.
+     * @return true if the request was queued.
+     */
+    bool start_sweep(IV_MODE mode, float startValue, float stopValue, uint8_t points);
+
+    /** @brief Request to abort a running I-V sweep. */
+    void abort_sweep();
+
+    /**
+     * @brief Request maximum power point tracking; enters MPPT if tracking starts.
+     * @param algorithm Tracking algorithm.
+     * @param step Current step per iteration in amperes.
+     * @param maxCurrent Highest current setpoint in amperes.
+     * @return true if the request was queued.
+     */
+    bool start_mppt(MPPT_ALGORITHM algorithm, float step, float maxCurrent);
+
+    /**
+     * @brief Request a stop condition for the CC/CV/CR/CW sessions.
+     * @param variable Quantity to compare.
+     * @param comparison '<' or '>'.
+     * @param threshold Value compared against.
+     * @return true if the request was queued.
+     */
+    bool add_stop_condition(STOP_VARIABLE variable, char comparison, float threshold);
+
+    /** @brief Request to remove all stop conditions. */
+    void clear_stop_conditions();
+
+    /** @brief Report a safety trip: stops calibration, tests, sweeps and tracking, disables the output and zeroes the setpoint. */
+    void trip();
+
 private:
-    FSM_MAIN_STATES currentState;  ///< Current state
-    FSM_MAIN_STATES lastState;     ///< Previous state
-};
\ No newline at end of file
+    /**
+     * @struct StateHandlers
+     * @brief Handlers, setpoint limit and allowed transitions of a state.
+     */
+    struct StateHandlers {
+        void (FSM::*onEnter)();     ///< Control task, once when entering the state (may be nullptr)
+        void (FSM::*onControl)();   ///< Control task, every period while in the state (may be nullptr)
+        void (FSM::*onExit)();      ///< Control task, once when leaving the state (may be nullptr)
+        void (FSM::*onUi)();        ///< UI task, every pass while in the state (may be nullptr)
+        void (FSM::*onUiExit)();    ///< UI task, once when the UI leaves the state (may be nullptr)
+        float maxSetpoint;          ///< Highest setpoint accepted in the state
+        uint16_t allowedNext;       ///< Bit mask of states reachable from this one
+    };
+
+    static const StateHandlers stateTable[];
+
+    DAC& dac;                       ///< DAC controller
+    AnalogSws& sws;                 ///< Analog switches and DUT relay
+    Calibration& calibration;       ///< Calibration sweep
+    BatteryTest& battery;           ///< Battery discharge test
+    IvSweep& sweep;                 ///< I-V curve tracer
+    MpptTracker& mppt;              ///< Maximum power point tracker
+    StopConditions& stops;          ///< Stop conditions of the load modes
+    SoaLimiter& soa;                ///< Safe-operating-area envelope of the load modes
+    FastTrip& fastTrip;             ///< Hardware over-current trip
+    Encoder& encoder;               ///< Encoder fed with the forwarded encoder events
+    EventQueue& events;             ///< Input events, drained by run_control()
+
+    volatile FSM_MAIN_STATES currentState;  ///< Written by the control task only
+    FSM_MAIN_STATES uiState;                ///< State whose screen the UI task shows
+    bool uiEntered;                         ///< uiState was entered and has_changed() has not reported it
+
+    volatile float setpoint;        ///< Target input value
+    bool setpointDirty;             ///< Setpoint changed since it was last applied
+    volatile bool outputActive;     ///< DUT relay state
+    bool outputDirty;               ///< Output changed since it was last applied
+    float dutVoltage;               ///< Latest DUT voltage passed to run_control()
+    float dutCurrent;               ///< Latest DUT current passed to run_control()
+    int64_t sampleUs;               ///< Time of the latest reading passed to run_control()
+
+    /** @brief Applies one event (control task). */
+    void handle_event(const Event& event);
+
+    /** @brief Runs the exit and enter handlers if the transition is allowed (control task). */
+    bool transition(FSM_MAIN_STATES newState);
+
+    /** @brief Whether the table allows a transition from the current state. */
+    bool is_allowed(FSM_MAIN_STATES newState) const;
+
+    void apply_setpoint(float value);
+    void apply_output(bool active);
+
+    /** @brief Returns true once per setpoint change. */
+    bool take_setpoint();
+
+    void enter_cc_mode();
+    void enter_cv_mode();
+    void exit_output_stage();
+    void exit_calibration();
+    void exit_battery();
+    void exit_sweep();
+    void exit_mppt();
+
+    void control_cc();
+    void control_cv();
+    void control_cr();
+    void control_cw();
+    void control_calibration();
+    void control_battery();
+    void control_sweep();
+    void control_mppt();
+
+    void ui_main_menu();
+    void ui_cc();
+    void ui_cv();
+    void ui_cr();
+    void ui_cw();
+    void ui_settings();
+    void ui_calibration();
+    void ui_battery();
+    void ui_sweep();
+    void ui_mppt();
+
+    void ui_exit_main_menu();
+    void ui_exit_cx();
+    void ui_exit_settings();
+    void ui_exit_calibration();
+    void ui_exit_battery();
+    void ui_exit_sweep();
+    void ui_exit_mppt();
+};
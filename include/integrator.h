@@ -0,0 +1,70 @@
+/**
+ * @file integrator.h
+ * @brief Header file for the EnergyIntegrator class.
+ *
+ * This file contains the declaration of the EnergyIntegrator class, which
+ * accumulates the energy (J, Wh) and charge (C, Ah) delivered by the DUT over
+ * every control period sample while the output is enabled. Samples are
+ * integrated with the trapezoidal rule over their real esp_timer timestamps.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class EnergyIntegrator
+ * @brief Trapezoidal energy and charge integration in 64-bit fixed point.
+ *
+ * Voltage and current are converted to µV and µA; each trapezoid is computed
+ * exactly in half pJ (µW·µs / 2) and half pC (µA·µs / 2) and added to nJ and nC
+ * accumulators with the sub-unit remainder carried over, so no resolution is
+ * lost however long a test runs (int64 nJ holds 2.5 MWh). The integrator
+ * belongs to the control task, which publishes the totals in the Measurements
+ * snapshot.
+ */
+class EnergyIntegrator {
+public:
+    /** @brief Constructor for the EnergyIntegrator class. */
+    EnergyIntegrator();
+
+    /** @brief Clears the totals and the previous sample. */
+    void reset();
+
+    /**
+     * @brief Integrates the interval since the previous sample.
+     * @param voltage DUT voltage in volts.
+     * @param current DUT current in amperes.
+     * @param timeUs esp_timer time at which the sample was taken.
+     * @param active false while the output is disabled: nothing is integrated and the next active sample starts a new interval.
+     */
+    void add_sample(float voltage, float current, int64_t timeUs, bool active);
+
+    /** @brief Energy in joules. */
+    double get_energy_j() const;
+
+    /** @brief Energy in watt-hours. */
+    double get_energy_wh() const;
+
+    /** @brief Charge in coulombs. */
+    double get_charge_c() const;
+
+    /** @brief Charge in ampere-hours. */
+    double get_charge_ah() const;
+
+    /** @brief Integrated time with the output enabled in milliseconds. */
+    uint64_t get_active_ms() const;
+
+private:
+    bool hasPrevious;
+    int64_t previousUs;
+    int64_t previousPowerUw;
+    int64_t previousCurrentUa;
+
+    int64_t energyNj;
+    int64_t energyRemainder;        ///< Half pJ, always within (-2000, 2000)
+    int64_t chargeNc;
+    int64_t chargeRemainder;        ///< Half pC, always within (-2000, 2000)
+    int64_t activeUs;
+};
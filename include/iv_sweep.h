@@ -0,0 +1,180 @@
+/**
+ * @file iv_sweep.h
+ * @brief Header file for the IvSweep class.
+ *
+ * This file contains the declaration of the IvSweep class, which traces the
+ * I-V curve of the DUT: the CC or CV setpoint is stepped from a start to a stop
+ * value in N points, each point is recorded once the readings have settled, and
+ * the finished curve is packed into a single binary WebSocket frame.
+ *
+ * Frame layout (little endian):
+ * | Offset | Size | Content                                  |
+ * |--------|------|------------------------------------------|
+ * | 0      | 2    | Magic "IV"                               |
+ * | 2      | 1    | Frame version (IV_FRAME_VERSION)         |
+ * | 3      | 1    | Mode (0 = CC, 1 = CV)                    |
+ * | 4      | 2    | Point count N                            |
+ * | 6      | 2    | Points recorded without settling         |
+ * | 8      | 12*N | N x (voltage, current, power) as float32 |
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include "logger.h"
+
+class DAC;
+class AnalogSws;
+class SoaLimiter;
+
+#define IV_MAX_POINTS 200               /*!< Maximum number of sweep points */
+#define IV_MIN_POINTS 2                 /*!< Minimum number of sweep points */
+#define IV_SETTLE_SAMPLES 8             /*!< Sliding window used to detect settling */
+#define IV_SETTLE_V_TOLERANCE 0.005     /*!< Settled when the voltage std dev is below this (V) ... */
+#define IV_SETTLE_I_TOLERANCE 0.002     /*!< ... and the current std dev below this (A) ... */
+#define IV_SETTLE_REL_TOLERANCE 0.002   /*!< ... each plus this fraction of the mean */
+#define IV_SETTLE_TIMEOUT_MS 2000       /*!< A point is recorded unsettled after this time */
+
+#define IV_FRAME_VERSION 1                                  /*!< Bump when the frame layout changes */
+#define IV_FRAME_HEADER_SIZE 8                              /*!< Bytes before the first point */
+#define IV_FRAME_POINT_SIZE 12                              /*!< Bytes per point */
+#define IV_FRAME_MAX_SIZE (IV_FRAME_HEADER_SIZE + IV_MAX_POINTS * IV_FRAME_POINT_SIZE)
+
+/**
+ * @enum IV_MODE
+ * @brief Setpoint stepped by the sweep.
+ */
+enum IV_MODE {
+    IV_MODE_CC,
+    IV_MODE_CV
+};
+
+/**
+ * @enum IV_STATUS
+ * @brief State of the I-V sweep.
+ */
+enum IV_STATUS {
+    IV_IDLE,
+    IV_STARTING,
+    IV_SETTLING,
+    IV_DONE,
+    IV_ABORTED
+};
+
+/**
+ * @struct IvPoint
+ * @brief A single recorded point of the curve.
+ */
+struct IvPoint {
+    float voltage;  ///< Mean DUT voltage of the settled window in volts
+    float current;  ///< Mean DUT current of the settled window in amperes
+    float power;    ///< voltage * current in watts
+};
+
+/**
+ * @class IvSweep
+ * @brief Automated I-V curve tracer.
+ *
+ * Like the calibration sweep, the tracer is non-blocking: run() is called from
+ * the control task with every new sample. After each setpoint step the last
+ * IV_SETTLE_SAMPLES readings are kept in a window, and the point is recorded
+ * (as the window mean) as soon as the variance of both voltage and current is
+ * within tolerance, so fast DUTs are swept at the control rate and slow ones
+ * are given the time they need. All storage is preallocated.
+ */
+class IvSweep {
+public:
+    /** @brief Constructor for the IvSweep class. */
+    IvSweep();
+
+    /**
+     * @brief Keeps the peripherals used for sweeps.
+     * @param dacPointer Pointer to the DAC used to step the setpoint.
+     * @param swsPointer Pointer to the analog switches used to select CC/CV mode.
+     * @param soaPointer Pointer to the SOA limiter clamping the CC sweep current.
+     */
+    void init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer);
+
+    /**
+     * @brief Starts a sweep (control task).
+     * @param mode CC or CV sweep.
+     * @param startValue First setpoint (A in CC, V in CV).
+     * @param stopValue Last setpoint (A in CC, V in CV), may be below startValue.
+     * @param points Number of points (IV_MIN_POINTS..IV_MAX_POINTS).
+     * @return true if the sweep was started.
+     */
+    bool start(IV_MODE mode, float startValue, float stopValue, uint8_t points);
+
+    /**
+     * @brief Checks the parameters of a sweep without starting it.
+     * @return true if start() would accept them.
+     */
+    static bool is_valid_sweep(IV_MODE mode, float startValue, float stopValue, uint8_t points);
+
+    /**
+     * @brief Configures a started sweep and advances it with a new sample (control task).
+     * @param voltage Latest DUT voltage in volts.
+     * @param current Latest DUT current in amperes.
+     */
+    void run(float voltage, float current);
+
+    /** @brief Aborts a running sweep and sets the DAC to zero (control task). */
+    void abort();
+
+    /**
+     * @brief Returns the frame of a newly finished sweep once.
+     * @param size Receives the frame size in bytes.
+     * @return const uint8_t* The frame, or nullptr if no new frame is pending.
+     */
+    const uint8_t* take_frame(size_t& size);
+
+    /**
+     * @brief Returns the frame of the last finished sweep.
+     * @param size Receives the frame size in bytes (0 if no sweep has finished).
+     * @return const uint8_t* The frame.
+     */
+    const uint8_t* get_frame(size_t& size) const;
+
+    /** @brief Whether a sweep is currently running. */
+    bool is_running() const;
+
+    IV_STATUS get_status() const;
+    const char* get_status_name() const;
+    IV_MODE get_mode() const;
+    uint8_t get_point_count() const;
+    uint8_t get_completed_points() const;
+
+private:
+    DAC* dac;
+    AnalogSws* sws;
+    SoaLimiter* soa;
+
+    IV_MODE mode;
+    volatile IV_STATUS status;
+    float startValue;
+    float stopValue;
+    uint8_t pointCount;
+    volatile uint8_t currentPoint;
+    float pointValue;           ///< Setpoint of the current point (A in CC, V in CV)
+    uint16_t unsettledPoints;
+
+    IvPoint points[IV_MAX_POINTS];
+
+    float windowVoltage[IV_SETTLE_SAMPLES];
+    float windowCurrent[IV_SETTLE_SAMPLES];
+    uint8_t windowCount;
+    uint8_t windowIndex;
+    unsigned long stepStart;
+
+    uint8_t frame[IV_FRAME_MAX_SIZE];
+    size_t frameSize;
+    volatile bool framePending;
+
+    void begin_point(uint8_t index, float voltage);
+    void apply_point(float voltage);
+    bool window_settled(float& meanVoltage, float& meanCurrent) const;
+    void finish(IV_STATUS finalStatus);
+    void build_frame();
+};
@@ -0,0 +1,252 @@
+/**
+ * @file logger.h
+ * @brief Header file for the Logger class and the LOG_* macros.
+ *
+ * This file contains the declaration of the Logger class, a deferred logger.
+ * A LOG_E/LOG_W/LOG_I/LOG_D call only copies the address of its format string
+ * (the format id) and its arguments into a binary record in a lock-free ring;
+ * a low-priority task formats the records and writes them to the serial port.
+ * Logging therefore never blocks on the UART and is safe from ISRs.
+ *
+ * Levels above LOG_LEVEL_MAX are removed at compile time; below that, each
+ * module has a runtime level, changed with the "log <module> <level>" serial
+ * command.
+ *
+ * @note Format strings must be string literals: only their address is stored.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LOG_LEVEL_DEBUG   /*!< Levels above this are compiled out */
+#endif
+
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_INFO    /*!< Runtime level of every module at boot */
+#define LOG_QUEUE_SIZE 64           /*!< Number of records, must be a power of two */
+#define LOG_MAX_ARGS 6              /*!< Arguments per record */
+#define LOG_TEXT_SIZE 48            /*!< Bytes per record for copied string arguments */
+#define LOG_LINE_SIZE 192           /*!< Longest formatted line */
+#define LOG_TASK_PERIOD_MS 20       /*!< Delay between drains of the ring */
+#define LOG_TASK_PRIORITY 1         /*!< Same as the UI task, below everything else */
+#define LOG_TASK_CORE 0             /*!< Away from the control task */
+#define LOG_TASK_STACK 3072         /*!< Drain task stack size in bytes */
+
+/**
+ * @enum LOG_MODULE
+ * @brief Modules with their own runtime level.
+ */
+enum LOG_MODULE : uint8_t {
+    LOG_MAIN,
+    LOG_CONTROL,
+    LOG_ENCODER,
+    LOG_DAC,
+    LOG_ANALOG_SWS,
+    LOG_WEBSOCKET,
+    LOG_STOP,
+    LOG_SEQUENCER,
+    LOG_BATTERY,
+    LOG_SAFETY,
+    LOG_FAST_TRIP,
+    LOG_CALIBRATION,
+    LOG_FSM,
+    LOG_MPPT,
+    LOG_IV_SWEEP,
+    LOG_RTC,
+    LOG_ADC,
+    LOG_MODULE_COUNT
+};
+
+/**
+ * @enum LOG_ARG_TYPE
+ * @brief How a record argument is passed to the formatter.
+ */
+enum LOG_ARG_TYPE : uint8_t {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_FLOAT,
+    LOG_ARG_STRING              ///< Value is the offset of the copy in LogRecord::text
+};
+
+/**
+ * @struct LogRecord
+ * @brief Binary log record, formatted later by the drain task.
+ */
+struct LogRecord {
+    const char* format;         ///< Format string literal; its address is the format id
+    uint8_t level;
+    uint8_t module;
+    uint8_t argCount;
+    uint8_t textLength;         ///< Bytes of text used by string arguments
+    uint8_t types[LOG_MAX_ARGS];
+    union {
+        int32_t i;
+        uint32_t u;
+        float f;
+    } args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];   ///< Copies of the string arguments, '\0' separated
+};
+
+/**
+ * @class Logger
+ * @brief Deferred logger with per-module levels.
+ *
+ * The ring uses the same per-slot sequence scheme as EventQueue: writers claim
+ * a position with a compare-and-swap and publish the slot by advancing its
+ * sequence, so an ISR never waits for the task it interrupted. When the ring is
+ * full the record is dropped and counted; the drain task reports the drops.
+ * write() is forced inline and push() lives in IRAM, so an ISR never runs
+ * code from flash while logging.
+ */
+class Logger {
+public:
+    /** @brief Constructor for the Logger class. */
+    Logger();
+
+    /** @brief Starts the drain task. Records written earlier are kept. */
+    void init();
+
+    /**
+     * @brief True if a module logs at this level (checked before building a record).
+     * @param module The module.
+     * @param level The level of the record.
+     */
+    inline bool enabled(LOG_MODULE module, uint8_t level) const { return level <= levels[module]; }
+
+    /**
+     * @brief Queues a record. Safe from any task or ISR.
+     * @param level Level of the record.
+     * @param module Module that writes it.
+     * @param format printf format string literal.
+     * @param args Up to LOG_MAX_ARGS integer, floating point or string arguments.
+     */
+    template <typename... Args>
+    __attribute__((always_inline)) inline void write(uint8_t level, LOG_MODULE module, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+        LogRecord record;
+        record.format = format;
+        record.level = level;
+        record.module = module;
+        record.argCount = 0;
+        record.textLength = 0;
+        record.text[LOG_TEXT_SIZE - 1] = '\0';
+        int unpack[] = {0, (pack(record, args), 0)...};
+        (void)unpack;
+        push(record);
+    }
+
+    /**
+     * @brief Changes the runtime level of a module.
+     * @param module The module.
+     * @param level LOG_LEVEL_NONE to LOG_LEVEL_DEBUG.
+     */
+    void set_level(LOG_MODULE module, uint8_t level);
+
+    /** @brief Runtime level of a module. */
+    uint8_t get_level(LOG_MODULE module) const;
+
+    /**
+     * @brief Finds a module by its lowercase name ("dac", "websocket", ...).
+     * @param name The name.
+     * @param module Receives the module.
+     * @return true if found.
+     */
+    static bool find_module(const char* name, LOG_MODULE& module);
+
+    /** @brief Name of a module as printed in the line prefix ("DAC"). */
+    static const char* get_module_name(LOG_MODULE module);
+
+    /** @brief Name of a level ("error", "warn", "info", "debug", "none"). */
+    static const char* get_level_name(uint8_t level);
+
+    /**
+     * @brief Parses a level name.
+     * @param name The name.
+     * @param level Receives the level.
+     * @return true if valid.
+     */
+    static bool parse_level(const char* name, uint8_t& level);
+
+    /** @brief Number of records dropped because the ring was full. */
+    uint32_t get_dropped() const;
+
+private:
+    static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> sequence; ///< Position + 1 when published, position + size when free
+        LogRecord record;
+    };
+
+    Slot slots[LOG_QUEUE_SIZE];
+    std::atomic<uint32_t> head;         ///< Next position to claim (writers)
+    uint32_t tail;                      ///< Next position to read (drain task)
+    std::atomic<uint32_t> dropped;
+    uint32_t reportedDropped;
+    volatile uint8_t levels[LOG_MODULE_COUNT];
+    char line[LOG_LINE_SIZE];           ///< Drain task only
+
+    template <typename T>
+    __attribute__((always_inline)) static inline typename std::enable_if<std::is_floating_point<T>::value>::type pack(LogRecord& record, T value) {
+        record.types[record.argCount] = LOG_ARG_FLOAT;
+        record.args[record.argCount++].f = (float)value;
+    }
+
+    template <typename T>
+    __attribute__((always_inline)) static inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type pack(LogRecord& record, T value) {
+        record.types[record.argCount] = LOG_ARG_INT;
+        record.args[record.argCount++].i = (int32_t)value;
+    }
+
+    template <typename T>
+    __attribute__((always_inline)) static inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type pack(LogRecord& record, T value) {
+        record.types[record.argCount] = LOG_ARG_UINT;
+        record.args[record.argCount++].u = (uint32_t)value;
+    }
+
+    static void pack(LogRecord& record, const char* value);
+    bool push(const LogRecord& record);
+    bool pop(LogRecord& record);
+    void format(const LogRecord& record);
+    void drain();
+    static void task(void* parameter);
+};
+
+extern Logger logger;
+
+#define LOG_WRITE(level, module, format, ...) \
+    do { if (logger.enabled(module, level)) logger.write(level, module, format, ##__VA_ARGS__); } while (0)
+
+#if LOG_LEVEL_MAX >= LOG_LEVEL_ERROR
+#define LOG_E(module, format, ...) LOG_WRITE(LOG_LEVEL_ERROR, module, format, ##__VA_ARGS__)
+#else
+#define LOG_E(module, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL_MAX >= LOG_LEVEL_WARN
+#define LOG_W(module, format, ...) LOG_WRITE(LOG_LEVEL_WARN, module, format, ##__VA_ARGS__)
+#else
+#define LOG_W(module, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL_MAX >= LOG_LEVEL_INFO
+#define LOG_I(module, format, ...) LOG_WRITE(LOG_LEVEL_INFO, module, format, ##__VA_ARGS__)
+#else
+#define LOG_I(module, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL_MAX >= LOG_LEVEL_DEBUG
+#define LOG_D(module, format, ...) LOG_WRITE(LOG_LEVEL_DEBUG, module, format, ##__VA_ARGS__)
+#else
+#define LOG_D(module, format, ...) do {} while (0)
+#endif
@@ -14,6 +14,7 @@
 #include <TFT_eSPI.h>
 #include <vector>
 #include "fsm.h"
+#include "statistics.h"
 
 // Display buffer definitions
 #define TOTAL_PIXELS (TFT_HOR_RES * TFT_VER_RES) // 240*320 = 76800 pixels
@@ -86,7 +87,7 @@ public:
      * @param selection Currently selected digit position.
      * @param unit Unit of measurement (A, V, W, R).
      */
-    void create_cx_screen(int selection, String unit);
+    void create_cx_screen(int selection, const char* unit);
     
     /**
      * @brief Update the CX screen with new values.
@@ -102,9 +103,18 @@ public:
      * @param output_active Whether the output is currently active.
      * @param is_modifying Whether a digit is currently being modified.
      * @param temperatureDUT Temperature reading from DUT.
-     * @param energyDUT Energy reading from DUT.
+     * @param energyWh Energy delivered by the DUT in Wh.
+     * @param chargeAh Charge delivered by the DUT in Ah.
      */
-    void update_cx_screen(float current, int selection, String unit, float vDUT, float iDUT, int digitsBeforeDecimal, int totalDigits, String targetValueStr, bool output_active, bool is_modifying, float temperatureDUT, float energyDUT);
+    void update_cx_screen(float current, int selection, const char* unit, float vDUT, float iDUT, int digitsBeforeDecimal, int totalDigits, String targetValueStr, bool output_active, bool is_modifying, float temperatureDUT, float energyWh, float chargeAh);
+
+    /**
+     * @brief Update the rolling statistics line of the CX screen.
+     * @param window Name of the window shown, e.g. "10 s".
+     * @param voltage DUT voltage statistics over the window.
+     * @param current DUT current statistics over the window.
+     */
+    void update_cx_statistics(const char* window, const WindowStatistics& voltage, const WindowStatistics& current);
     
     /**
      * @brief Close and clean up the CX screen.
@@ -131,6 +141,91 @@ public:
      */
     void close_settings_menu();
 
+    /**
+     * @brief Create the calibration screen on the display.
+     * Shows sweep progress and live readings; the web UI drives the calibration.
+     */
+    void create_calibration_screen();
+
+    /**
+     * @brief Update the calibration screen.
+     * @param status Sweep status text.
+     * @param completedPoints Number of sweep points recorded.
+     * @param totalPoints Number of sweep points requested.
+     * @param vDUT Voltage reading from device under test.
+     * @param iDUT Current reading from device under test.
+     */
+    void update_calibration_screen(const char* status, int completedPoints, int totalPoints, float vDUT, float iDUT);
+
+    /**
+     * @brief Close and clean up the calibration screen.
+     */
+    void close_calibration_screen();
+
+    /**
+     * @brief Create the battery discharge screen on the display.
+     * Shows the test progress; the web UI starts the test.
+     */
+    void create_battery_screen();
+
+    /**
+     * @brief Update the battery discharge screen.
+     * @param status Test status text.
+     * @param elapsedMs Test duration in milliseconds.
+     * @param capacityMah Delivered charge in mAh.
+     * @param energyWh Delivered energy in Wh.
+     * @param vDUT Voltage reading from device under test.
+     * @param iDUT Current reading from device under test.
+     */
+    void update_battery_screen(const char* status, uint32_t elapsedMs, float capacityMah, float energyWh, float vDUT, float iDUT);
+
+    /**
+     * @brief Close and clean up the battery discharge screen.
+     */
+    void close_battery_screen();
+
+    /**
+     * @brief Create the I-V sweep screen on the display.
+     * Shows sweep progress and live readings; the web UI starts the sweep.
+     */
+    void create_sweep_screen();
+
+    /**
+     * @brief Update the I-V sweep screen.
+     * @param status Sweep status text.
+     * @param completedPoints Number of points recorded.
+     * @param totalPoints Number of points requested.
+     * @param vDUT Voltage reading from device under test.
+     * @param iDUT Current reading from device under test.
+     */
+    void update_sweep_screen(const char* status, int completedPoints, int totalPoints, float vDUT, float iDUT);
+
+    /**
+     * @brief Close and clean up the I-V sweep screen.
+     */
+    void close_sweep_screen();
+
+    /**
+     * @brief Create the MPPT screen on the display.
+     * Shows the tracker state and power; the web UI starts tracking.
+     */
+    void create_mppt_screen();
+
+    /**
+     * @brief Update the MPPT screen.
+     * @param status Tracker status text.
+     * @param power Power at the last iteration in watts.
+     * @param powerRipple Peak-to-peak power over the ripple window in watts.
+     * @param vDUT Voltage reading from device under test.
+     * @param iDUT Current reading from device under test.
+     */
+    void update_mppt_screen(const char* status, float power, float powerRipple, float vDUT, float iDUT);
+
+    /**
+     * @brief Close and clean up the MPPT screen.
+     */
+    void close_mppt_screen();
+
     /**
      * @brief Create a small popup warning that auto-deletes after a timeout.
      * @param message The warning message to display.
@@ -173,7 +268,8 @@ private:
     *buttons = nullptr, *outputButton = nullptr, *backButton = nullptr, // Buttons
     *enable_status_indicator = nullptr, // Enable status indicator
     *dutContainer = nullptr, *dutContainerRow1 = nullptr, *dutContainerRow2 = nullptr, *dutContainerRow3 = nullptr, // DUT container
-    *dutVoltage = nullptr, *dutCurrent = nullptr, *dutPower = nullptr, *dutResistance = nullptr, *dutTemperature = nullptr, *dutEnergy = nullptr; // DUT values
+    *dutVoltage = nullptr, *dutCurrent = nullptr, *dutPower = nullptr, *dutResistance = nullptr, *dutTemperature = nullptr, *dutEnergy = nullptr, *dutCharge = nullptr, // DUT values
+    *dutStatistics = nullptr; // Rolling statistics
 
     /* Common UI Elements */
     lv_obj_t *headerContainer = nullptr;
@@ -187,6 +283,36 @@ private:
     lv_obj_t *settingsPasswordLabel = nullptr;
     lv_obj_t *settingsIPLabel = nullptr;
 
+    // --- Calibration Screen UI Elements ---
+    lv_obj_t *calibrationScreen = nullptr;
+    lv_obj_t *calibrationStatusLabel = nullptr;
+    lv_obj_t *calibrationProgressLabel = nullptr;
+    lv_obj_t *calibrationVoltage = nullptr;
+    lv_obj_t *calibrationCurrent = nullptr;
+    lv_obj_t *calibrationBackButton = nullptr;
+
+    // Battery discharge screen
+    lv_obj_t *batteryScreen = nullptr;
+    lv_obj_t *batteryStatusLabel = nullptr;
+    lv_obj_t *batteryTimeLabel = nullptr;
+    lv_obj_t *batteryCapacity = nullptr;
+    lv_obj_t *batteryReadings = nullptr;
+    lv_obj_t *batteryBackButton = nullptr;
+
+    // I-V sweep screen
+    lv_obj_t *sweepScreen = nullptr;
+    lv_obj_t *sweepStatusLabel = nullptr;
+    lv_obj_t *sweepProgressLabel = nullptr;
+    lv_obj_t *sweepReadings = nullptr;
+    lv_obj_t *sweepBackButton = nullptr;
+
+    // MPPT screen
+    lv_obj_t *mpptScreen = nullptr;
+    lv_obj_t *mpptStatusLabel = nullptr;
+    lv_obj_t *mpptPower = nullptr;
+    lv_obj_t *mpptReadings = nullptr;
+    lv_obj_t *mpptBackButton = nullptr;
+
     /**
      * @brief Create a common header for screens.
      * 
@@ -14,13 +14,35 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <esp_timer.h>
 
+#include "event_queue.h"
 #include "encoder.h"
 #include "led.h"
 #include "i2c.h"
 #include "dac.h"
 #include "analog_sws.h"
 #include "adc.h"
+#include "calibration.h"
+#include "battery_test.h"
+#include "iv_sweep.h"
+#include "mppt.h"
+#include "sequencer.h"
+#include "stop_conditions.h"
+#include "soa.h"
+#include "integrator.h"
+#include "statistics.h"
+#include "distribution.h"
+#include "broadcast.h"
+#include "sample_stream.h"
+#include "telemetry.h"
+#include "fast_trip.h"
+#include "safety_supervisor.h"
+#include "black_box.h"
+#include "profiler.h"
+#include "logger.h"
 #include "lvgl_lcd.h"
 #include "fsm.h"
 #include "webserver.h"
@@ -40,25 +62,137 @@ const String PASSWORD = "pfi2025uade";        /*!< Wi-Fi network password */
 extern float ws_requested_value;    /*!< Last requested value from WebSocket */
 extern bool ws_value_updated;      /*!< Flag indicating a WebSocket value update */
 
-#define BROADCAST_INTERVAL 1000 // Interval for broadcasting state updates (in milliseconds)
+#define BROADCAST_INTERVAL 1000 // Longest interval without a state broadcast (in milliseconds)
+#define BATTERY_BROADCAST_INTERVAL 1000 // Interval for broadcasting battery test progress (in milliseconds)
+#define MPPT_BROADCAST_INTERVAL 500 // Interval for broadcasting MPPT state (in milliseconds)
+
+/* -- Task Configuration -- */
+#define CONTROL_TASK_PERIOD_MS 20       /*!< Fixed period of the control task (measure, safety, setpoint) */
+#define CONTROL_TASK_PRIORITY 10        /*!< Above the UI and AsyncTCP tasks */
+#define CONTROL_TASK_CORE 1             /*!< Application core, away from the Wi-Fi stack */
+#define CONTROL_TASK_STACK 4096         /*!< Control task stack size in bytes */
+#define CONTROL_TEMPERATURE_DIVIDER 10  /*!< Temperature is read every N control periods */
+#define CONTROL_RTC_DIVIDER (RTC_SYNC_INTERVAL_MS / CONTROL_TASK_PERIOD_MS) /*!< RTC is read over I2C every N control periods */
+#define CONTROL_STATS_INTERVAL_MS 10000 /*!< Interval for logging the control task timing */
+#define CONTROL_STATISTICS_DIVIDER 5    /*!< Rolling statistics are published every N control periods */
+#define UI_TASK_PERIOD_MS 10            /*!< Delay between UI passes */
+#define UI_TASK_PRIORITY 1              /*!< Lowest application priority */
+#define UI_TASK_CORE 0                  /*!< Shares the core with Wi-Fi and AsyncTCP */
+#define UI_TASK_STACK 8192              /*!< UI task stack size in bytes (LVGL, JSON, String) */
+#define SAFETY_ALERT_QUEUE_LENGTH 4     /*!< Pending safety alerts handed to the UI task */
+
+/**
+ * @struct Measurements
+ * @brief Snapshot published by the control task every period.
+ */
+struct Measurements {
+    float voltage;          ///< DUT voltage in volts
+    float current;          ///< DUT current in amperes
+    float power;            ///< DUT power in watts
+    float resistance;       ///< DUT resistance in ohms
+    float temperature;      ///< Heatsink temperature in degrees Celsius
+    float energyJ;          ///< DUT energy in joules
+    float energyWh;         ///< DUT energy in watt-hours
+    float chargeC;          ///< DUT charge in coulombs
+    float chargeAh;         ///< DUT charge in ampere-hours
+    int fanSpeed;           ///< Fan speed percentage
+    uint64_t outputTimeMs;  ///< Time with the output enabled in milliseconds
+};
+
+static_assert(STATISTICS_BLOCK_SAMPLES * CONTROL_TASK_PERIOD_MS == 1000, "Statistics blocks must last 1 s");
 
 /* -- Safety Limits -- */
 #define SAFETY_MAX_VOLTAGE 100.0    /*!< Maximum safe DUT voltage in volts */
 #define SAFETY_MAX_CURRENT 20.0     /*!< Maximum safe DUT current in amperes */
 #define SAFETY_MAX_POWER 200.0      /*!< Maximum safe DUT power in watts */
 #define SAFETY_MAX_TEMPERATURE 60.0 /*!< Maximum safe temperature in degrees Celsius */
+#define SAFETY_DEFAULT_MARGIN 0.1   /*!< Default margin above each limit (10 %) */
 
 /* -- Function Declarations -- */
+/**
+ * @brief Fixed-rate control task: measurements, safety, FSM control and fan PID.
+ * @param parameter Unused.
+ */
+void control_task(void* parameter);
+
+/**
+ * @brief UI task: LVGL, FSM screens, alerts and WebSocket broadcasts.
+ * @param parameter Unused.
+ */
+void ui_task(void* parameter);
+
+/**
+ * @brief Gets the latest snapshot published by the control task.
+ * @return Measurements Copy of the latest measurements (safe from any task).
+ */
+Measurements get_measurements();
+
+/**
+ * @brief Gets the latest rolling statistics published by the control task.
+ * @return StatisticsSnapshot Copy of the latest statistics (safe from any task).
+ */
+StatisticsSnapshot get_statistics();
+
 /**
  * @brief Displays and handles the main menu interface
  */
 void main_menu();
 
+/**
+ * @brief Closes the main menu when the FSM leaves MAIN_MENU
+ */
+void main_menu_exit();
+
 /**
  * @brief Displays and handles the settings menu interface
  */
 void setting();
 
+/**
+ * @brief Closes the settings menu when the FSM leaves SETTINGS
+ */
+void setting_exit();
+
+/**
+ * @brief Displays the progress of a running calibration sweep
+ */
+void calibration_menu();
+
+/**
+ * @brief Closes the calibration screen when the FSM leaves CALIBRATION
+ */
+void calibration_menu_exit();
+
+/**
+ * @brief Displays the progress of a battery discharge test
+ */
+void battery_menu();
+
+/**
+ * @brief Closes the battery screen when the FSM leaves BATTERY
+ */
+void battery_menu_exit();
+
+/**
+ * @brief Displays the progress of an I-V sweep
+ */
+void sweep_menu();
+
+/**
+ * @brief Closes the I-V sweep screen when the FSM leaves SWEEP
+ */
+void sweep_menu_exit();
+
+/**
+ * @brief Displays the state of the maximum power point tracker
+ */
+void mppt_menu();
+
+/**
+ * @brief Closes the MPPT screen when the FSM leaves MPPT
+ */
+void mppt_menu_exit();
+
 /**
  * @brief Handles constant mode operation (CC, CV, etc.)
  * @param unit Unit of measurement (e.g., "A", "V")
@@ -67,7 +201,12 @@ void setting();
  * @param totalDigits Total number of digits for the value
  * @param maxInputValue Maximum input value for the mode
  */
-void constant_x(String unit, int digitsBeforeDecimal, int digitsAfterDecimal, int totalDigits, int maxInputValue);
+void constant_x(const char* unit, int digitsBeforeDecimal, int digitsAfterDecimal, int totalDigits, float maxInputValue);
+
+/**
+ * @brief Closes the constant mode screen when the FSM leaves CC, CV, CR or CW
+ */
+void constant_x_exit();
 
 /**
  * @brief WebSocket event handler function.
@@ -87,6 +226,26 @@ void handle_ws_command(AsyncWebSocketClient *client, JsonDocument& doc);
  */
 void handle_get_measurements(AsyncWebSocketClient *client);
 
+/**
+ * @brief Handles the 'telemetry' command from WebSocket: chooses JSON or binary state updates for this client.
+ * @param client The client that sent the command.
+ * @param doc JSON document with "format": "json" or "binary".
+ */
+void handle_telemetry_format(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'streamStart' command from WebSocket: subscribes the client to the V/I sample stream.
+ * @param client The client that sent the command.
+ * @param doc JSON document with optional "decimation" and "batch".
+ */
+void handle_stream_start(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'streamStop' command from WebSocket.
+ * @param client The client that sent the command.
+ */
+void handle_stream_stop(AsyncWebSocketClient *client);
+
 /**
  * @brief Handles the 'setMode' command from WebSocket.
  * @param doc JSON document containing the new mode.
@@ -116,19 +275,193 @@ void handle_set_relay(JsonDocument& doc);
  */
 void handle_exit();
 
+/**
+ * @brief Handles the 'calStart' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the sweep mode ("CC"/"CV"), points and max value.
+ */
+void handle_cal_start(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'calReference' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the point index and the reference meter value.
+ */
+void handle_cal_reference(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'calFit' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the polynomial degree.
+ */
+void handle_cal_fit(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'batStart' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the discharge mode ("CC"/"CW"), value and cutoff voltage.
+ */
+void handle_bat_start(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Handles the 'sweepStart' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the sweep mode ("CC"/"CV"), start and stop values and points.
+ */
+void handle_sweep_start(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Gets the I-V sweep status as a JSON string (the curve itself is sent as a binary frame).
+ * @return String containing the JSON representation of the sweep status.
+ */
+String get_sweep_json();
+
+/**
+ * @brief Handles the 'mpptStart' command from WebSocket.
+ * @param client The client that sent the command.
+ * @param doc JSON document containing the algorithm ("PO"/"INC"), current step and max current.
+ */
+void handle_mppt_start(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Collects the body of a POST to /sequence (AsyncTCP task).
+ * @param request The HTTP request.
+ * @param data Body chunk.
+ * @param len Size of the chunk.
+ * @param index Offset of the chunk in the body.
+ * @param total Total size of the body.
+ */
+void handle_sequence_body(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+/**
+ * @brief Compiles and stores the uploaded script once the body is complete.
+ * @param request The HTTP request.
+ */
+void handle_sequence_upload(AsyncWebServerRequest *request);
+
+/**
+ * @brief Serves the black box: the list of stored trips, or one trip as CSV with ?trip=<number>.
+ * @param request The HTTP request.
+ */
+void handle_blackbox_request(AsyncWebServerRequest *request);
+
+/**
+ * @brief Serves the loop profiler statistics as JSON; ?reset clears them.
+ * @param request The HTTP request.
+ */
+void handle_profile_request(AsyncWebServerRequest *request);
+
+/**
+ * @brief Serves the V and I distributions (quantiles and histograms) as JSON; ?reset starts a new session.
+ * @param request The HTTP request.
+ */
+void handle_distribution_request(AsyncWebServerRequest *request);
+
+/**
+ * @brief Serves the telemetry schema (fields, offsets, units) generated from telemetryFields.
+ * @param request The HTTP request.
+ */
+void handle_telemetry_schema_request(AsyncWebServerRequest *request);
+
+/**
+ * @brief Reads commands typed on the serial monitor ("profile", "profile reset", "log ...").
+ */
+void handle_serial_input();
+
+/**
+ * @brief Handles the 'log' serial command: lists the module levels, or sets one with "log <module> <level>".
+ * @param args Text after "log".
+ */
+void handle_log_command(const char* args);
+
+/**
+ * @brief Gets the per-stage timings and histograms of the loop profiler as a JSON string.
+ * @return String containing the JSON representation of the profiler.
+ */
+String get_profile_json();
+
+/**
+ * @brief Handles the 'safetySet' command from WebSocket: changes the safety limits and margins.
+ * @param client The client that sent the command.
+ * @param doc JSON document with any of "voltage", "current", "power", "temperature" and the matching "...Margin" fields.
+ */
+void handle_safety_set(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Gets the safety limits, supervisor statistics and trip latencies as a JSON string.
+ * @return String containing the JSON representation of the safety supervisor.
+ */
+String get_safety_json();
+
+/**
+ * @brief Handles the 'stopSet' command from WebSocket: replaces the stop conditions.
+ * @param client The client that sent the command.
+ * @param doc JSON document with "conditions": an array of [variable, comparison, threshold].
+ */
+void handle_stop_set(AsyncWebSocketClient *client, JsonDocument& doc);
+
+/**
+ * @brief Gets the stop conditions and the state of the current session as a JSON string.
+ * @return String containing the JSON representation of the stop conditions.
+ */
+String get_stops_json();
+
+/**
+ * @brief Gets the sequencer state, program size and last log message as a JSON string.
+ * @return String containing the JSON representation of the sequencer.
+ */
+String get_sequence_json();
+
+/**
+ * @brief Gets the list of trips stored by the black box as a JSON string.
+ * @return String containing the JSON representation of the stored trips.
+ */
+String get_blackbox_json();
+
+/**
+ * @brief Gets the MPPT state, tracking time and steady-state oscillation as a JSON string.
+ * @return String containing the JSON representation of the tracker.
+ */
+String get_mppt_json();
+
+/**
+ * @brief Gets the battery test progress and the last stored result as a JSON string.
+ * @return String containing the JSON representation of the battery test.
+ */
+String get_battery_json();
+
+/**
+ * @brief Gets the calibration sweep status and points as a JSON string.
+ * @return String containing the JSON representation of the calibration.
+ */
+String get_calibration_json();
+
 /**
  * @brief Gets the current state of the electronic load as a JSON string.
+ *
+ * Written from the telemetry frame by the schema-driven writer (telemetry.h).
+ *
  * @return String containing the JSON representation of the current state.
  */
 String get_current_state_json();
 
 /**
- * @brief Sends the current state to all WebSocket clients.
+ * @brief Fills the binary telemetry frame with the current state.
+ * @param frame Receives the frame.
  */
-void broadcast_state();
+void build_telemetry_frame(TelemetryFrame& frame);
 
 /**
- * @brief Monitors DUT safety levels and automatically disconnects if limits are exceeded.
- * @return true if safety limits are exceeded and DUT was disconnected, false otherwise
+ * @brief Sends the current state to one WebSocket client in the format it asked for.
+ *
+ * JSON clients get the document at once; binary clients get a keyframe with
+ * the next broadcast, which is requested as urgent.
+ *
+ * @param client The client.
+ */
+void send_state(AsyncWebSocketClient *client);
+
+/**
+ * @brief Sends the current state to all WebSocket clients.
  */
-bool check_safety_limits();
\ No newline at end of file
+void broadcast_state();
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+ * @file mppt.h
+ * @brief Header file for the MpptTracker class.
+ *
+ * This file contains the declaration of the MpptTracker class, which loads a
+ * solar panel at its maximum power point. The load runs in CC mode and the
+ * current setpoint is moved one step per control period with either perturb
+ * and observe or incremental conductance. Tracking speed (time until the
+ * tracker starts oscillating around the MPP) and the steady-state oscillation
+ * are measured on the device and reported to the web UI.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include "logger.h"
+
+class DAC;
+class AnalogSws;
+class SoaLimiter;
+
+#define MPPT_MIN_STEP 0.001             /*!< Smallest accepted current step in amperes */
+#define MPPT_MAX_STEP 1.0               /*!< Largest accepted current step in amperes */
+#define MPPT_DV_EPSILON 0.002           /*!< Voltage changes below this (V) carry no slope information */
+#define MPPT_REVERSALS_TO_LOCK 3        /*!< Direction reversals that mark the MPP as reached */
+#define MPPT_RIPPLE_WINDOW 50           /*!< Iterations used for the steady-state oscillation (1 s at 20 ms) */
+
+/**
+ * @enum MPPT_ALGORITHM
+ * @brief Tracking algorithm.
+ */
+enum MPPT_ALGORITHM {
+    MPPT_PERTURB_OBSERVE,
+    MPPT_INCREMENTAL_CONDUCTANCE
+};
+
+/**
+ * @enum MPPT_STATUS
+ * @brief State of the tracker.
+ */
+enum MPPT_STATUS {
+    MPPT_IDLE,
+    MPPT_STARTING,
+    MPPT_TRACKING,  ///< Climbing towards the MPP
+    MPPT_LOCKED,    ///< Oscillating around the MPP
+    MPPT_STOPPED
+};
+
+/**
+ * @class MpptTracker
+ * @brief Maximum power point tracker over the CC mode.
+ *
+ * run() is called from the control task with every new sample, so the
+ * tracker iterates at the control rate: the sample reflects the setpoint
+ * written in the previous period. Perturb and observe reverses the step
+ * direction when the power drops; incremental conductance moves the current
+ * towards dP/dV = I + V * dI/dV = 0.
+ */
+class MpptTracker {
+public:
+    /** @brief Constructor for the MpptTracker class. */
+    MpptTracker();
+
+    /**
+     * @brief Keeps the peripherals used for tracking.
+     * @param dacPointer Pointer to the DAC used to set the current.
+     * @param swsPointer Pointer to the analog switches used to select CC mode.
+     * @param soaPointer Pointer to the SOA limiter capping the tracked current.
+     */
+    void init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer);
+
+    /**
+     * @brief Starts tracking (control task).
+     * @param algorithm Tracking algorithm.
+     * @param step Current step per iteration in amperes.
+     * @param maxCurrent Highest current setpoint in amperes.
+     * @return true if tracking was started.
+     */
+    bool start(MPPT_ALGORITHM algorithm, float step, float maxCurrent);
+
+    /**
+     * @brief Checks the parameters without starting.
+     * @return true if start() would accept them.
+     */
+    static bool is_valid(MPPT_ALGORITHM algorithm, float step, float maxCurrent);
+
+    /**
+     * @brief Configures a started tracker and runs one iteration (control task).
+     * @param voltage Latest DUT voltage in volts.
+     * @param current Latest DUT current in amperes.
+     */
+    void run(float voltage, float current);
+
+    /** @brief Stops tracking and sets the DAC to zero (control task). */
+    void stop();
+
+    /** @brief Whether the tracker is driving the load. */
+    bool is_running() const;
+
+    MPPT_STATUS get_status() const;
+    const char* get_status_name() const;
+    MPPT_ALGORITHM get_algorithm() const;
+    float get_setpoint() const;
+    float get_power() const;
+
+    /** @brief Time from start until the MPP was reached in milliseconds (0 while tracking). */
+    uint32_t get_tracking_ms() const;
+
+    /** @brief Peak-to-peak power over the last MPPT_RIPPLE_WINDOW iterations in watts. */
+    float get_power_ripple() const;
+
+    /** @brief Peak-to-peak current setpoint over the last MPPT_RIPPLE_WINDOW iterations in amperes. */
+    float get_current_ripple() const;
+
+    /** @brief Number of iterations since start. */
+    uint32_t get_iterations() const;
+
+private:
+    DAC* dac;
+    AnalogSws* sws;
+    SoaLimiter* soa;
+
+    MPPT_ALGORITHM algorithm;
+    volatile MPPT_STATUS status;
+    float step;
+    float maxCurrent;
+
+    volatile float setpoint;
+    int8_t direction;           ///< +1 raises the current, -1 lowers it
+    float lastVoltage;
+    float lastCurrent;
+    float lastPower;
+    volatile float power;
+
+    unsigned long startMs;
+    uint8_t reversals;
+    volatile uint32_t trackingMs;
+    volatile uint32_t iterations;
+
+    float ripplePower[MPPT_RIPPLE_WINDOW];
+    float rippleCurrent[MPPT_RIPPLE_WINDOW];
+    uint8_t rippleCount;
+    uint8_t rippleIndex;
+    volatile float powerRipple;
+    volatile float currentRipple;
+
+    int8_t next_direction(float voltage, float current, float samplePower) const;
+    void update_ripple(float samplePower);
+};
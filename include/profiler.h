@@ -0,0 +1,135 @@
+/**
+ * @file profiler.h
+ * @brief Header file for the Profiler class and the PROFILE_SCOPE probe.
+ *
+ * This file contains the declaration of the Profiler class, a lightweight
+ * per-stage profiler built on the CPU cycle counter. A PROFILE_SCOPE(stage)
+ * probe measures the cycles spent until the end of the enclosing block and
+ * adds them to the min/avg/max and the log2 histogram of that stage;
+ * PROFILE_BEGIN/PROFILE_END do the same for spans that are not a block. Results
+ * are printed with the "profile" serial command and served at GET /profile.
+ *
+ * @note Build with -D PROFILER_ENABLED=0 to compile every probe out.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1          /*!< Probes are compiled in unless the build sets 0 */
+#endif
+
+#define PROFILE_HISTOGRAM_BUCKETS 32    /*!< Bucket b counts durations of [2^b, 2^(b+1)) cycles */
+
+/**
+ * @enum PROFILE_STAGE
+ * @brief Profiled stages of the control and UI tasks.
+ */
+enum PROFILE_STAGE : uint8_t {
+    PROFILE_CONTROL_CYCLE,  ///< Whole control period (task core 1)
+    PROFILE_ADC_VOLTAGE,
+    PROFILE_ADC_CURRENT,
+    PROFILE_ADC_TEMPERATURE,
+    PROFILE_SAFETY,         ///< Handing the sample to the supervisor, including its check
+    PROFILE_SEQUENCER,
+    PROFILE_FSM_CONTROL,
+    PROFILE_PID,
+    PROFILE_STATISTICS,
+    PROFILE_UI_CYCLE,       ///< Whole UI pass (task core 0)
+    PROFILE_LCD_UPDATE,
+    PROFILE_LCD_HEADER,
+    PROFILE_FSM_UI,
+    PROFILE_BROADCAST,
+    PROFILE_STAGE_COUNT
+};
+
+/**
+ * @struct ProfileStats
+ * @brief Accumulated durations of one stage, in CPU cycles.
+ */
+struct ProfileStats {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint32_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @class Profiler
+ * @brief Cycle-counter statistics per stage.
+ *
+ * Every stage is recorded by a single task, so record() takes no lock; the
+ * cycle counter is per core and the profiled tasks are pinned, so a probe
+ * always starts and ends on the same counter. reset() only raises a flag per
+ * stage that the recording task honours on its next record(). Readers may see
+ * a stage mid-update, which is acceptable for statistics.
+ */
+class Profiler {
+public:
+    /** @brief Constructor for the Profiler class. */
+    Profiler();
+
+    /**
+     * @brief Adds a duration to a stage (recording task).
+     * @param stage The stage.
+     * @param cycles Duration in CPU cycles.
+     */
+    void IRAM_ATTR record(PROFILE_STAGE stage, uint32_t cycles);
+
+    /** @brief Clears all stages (any task). */
+    void reset();
+
+    /** @brief True if the stage has recorded durations since the last reset. */
+    bool has_samples(PROFILE_STAGE stage) const;
+
+    /** @brief Statistics of a stage. */
+    const ProfileStats& get_stats(PROFILE_STAGE stage) const;
+
+    /** @brief Short name of a stage ("adc_v", "lcd_update", ...). */
+    static const char* get_stage_name(PROFILE_STAGE stage);
+
+    /** @brief Converts cycles to microseconds at the current CPU clock. */
+    static float cycles_to_us(uint64_t cycles);
+
+    /** @brief Prints a table of all stages to the serial port. */
+    void print_report() const;
+
+    /** @brief Current value of the cycle counter of the calling core. */
+    static inline uint32_t IRAM_ATTR now() { return ESP.getCycleCount(); }
+
+private:
+    ProfileStats stats[PROFILE_STAGE_COUNT];
+    volatile bool resetRequested[PROFILE_STAGE_COUNT];
+};
+
+extern Profiler profiler;
+
+/**
+ * @class ProfileScope
+ * @brief Records the cycles from its construction to the end of the scope.
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(PROFILE_STAGE stage) : stage(stage), start(Profiler::now()) {}
+    ~ProfileScope() { profiler.record(stage, Profiler::now() - start); }
+
+private:
+    PROFILE_STAGE stage;
+    uint32_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#define PROFILE_BEGIN(start) uint32_t start = Profiler::now()
+#define PROFILE_END(start, stage) profiler.record(stage, Profiler::now() - start)
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#define PROFILE_BEGIN(start) do {} while (0)
+#define PROFILE_END(start, stage) do {} while (0)
+#endif
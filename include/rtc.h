@@ -2,10 +2,17 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <freertos/FreeRTOS.h>
 #include "i2c.h"
+#include "logger.h"
 
 #define MCP7941X_ADDRESS 0x6F // Dirección I2C del MCP7941X
 
+#define RTC_SYNC_INTERVAL_MS 60000  // Período de sincronización del reloj monotónico con el MCP7941X
+#define RTC_DEADBAND_MS 1000        // Errores menores se ignoran (el RTC tiene resolución de 1 s)
+#define RTC_STEP_THRESHOLD_MS 5000  // Errores hacia adelante mayores se corrigen con un salto
+#define RTC_MAX_SLEW_PPM 500        // Corrección máxima de la velocidad del reloj (30 ms por minuto)
+
 // Estructura para almacenar la fecha y hora
 struct DateTime {
     uint8_t seconds;    // Segundos (0-59)
@@ -31,8 +38,16 @@ public:
     // Lee la fecha y hora desde el dispositivo.
     DateTime get_time();
     
-    // Obtiene el tiempo actual en milisegundos desde el 1 de enero de 2000
+    // Obtiene el tiempo actual en milisegundos desde el 1 de enero de 2000.
+    // Usa el reloj monotónico basado en esp_timer: no accede al bus I2C y nunca retrocede.
     uint64_t get_timestamp_ms();
+
+    // Convierte un instante de esp_timer_get_time() a milisegundos desde el 1 de enero de 2000.
+    uint64_t get_timestamp_ms_at(int64_t timeUs);
+
+    // Lee el MCP7941X y corrige el reloj monotónico (lectura I2C).
+    // Llamar cada RTC_SYNC_INTERVAL_MS desde la tarea que usa el bus I2C.
+    void sync();
     
     // Calcula el tiempo transcurrido en milisegundos entre dos timestamps
     static uint64_t elapsed_ms(uint64_t start_time, uint64_t end_time);
@@ -42,11 +57,21 @@ private:
     static uint8_t dec_to_bcd(uint8_t val);
     static uint8_t bcd_to_dec(uint8_t val);
     
-    // Convierte una estructura DateTime a milisegundos desde el 1 de enero de 2000
+    // Convierte una estructura DateTime a milisegundos desde el 1 de enero de 2000 en O(1)
     static uint64_t datetime_to_ms(const DateTime &dt);
 
     /**
      * @brief Pointer to an I2C instance used for communication.
      */
     I2C* i2c;
+
+    // Reloj monotónico: baseMs en el instante baseUs, avanzando a 1 + slewPpm / 1e6
+    uint64_t baseMs;
+    int64_t baseUs;
+    int32_t slewPpm;
+    bool synced;
+    mutable portMUX_TYPE clockLock; // La base se lee desde otras tareas y núcleos
+
+    // Tiempo del reloj monotónico en timeUs (con clockLock tomado)
+    uint64_t clock_ms_at(int64_t timeUs) const;
 };
\ No newline at end of file
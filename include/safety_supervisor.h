@@ -0,0 +1,178 @@
+/**
+ * @file safety_supervisor.h
+ * @brief Header file for the SafetySupervisor class.
+ *
+ * This file contains the declaration of the SafetySupervisor class, which owns
+ * the emergency shutdown path. It runs in its own task at the highest
+ * application priority, checks every sample published by the control task
+ * against the V, I, P and temperature limits, handles the hardware over-current
+ * ALERT and shuts the load down when the control task stops publishing. The
+ * time from the sample (or interrupt) to the DAC at zero is recorded.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "logger.h"
+
+class DAC;
+class AnalogSws;
+class FSM;
+class FastTrip;
+class BlackBox;
+
+#define SAFETY_TASK_PRIORITY (configMAX_PRIORITIES - 1) /*!< Above every other application task */
+#define SAFETY_TASK_CORE 1                  /*!< Next to the control task, which it preempts */
+#define SAFETY_TASK_STACK 4096              /*!< Supervisor task stack size in bytes */
+#define SAFETY_SAMPLE_TIMEOUT_MS 100        /*!< Shut down if no sample arrives for this long (5 periods) */
+#define SAFETY_MAX_MARGIN 0.5               /*!< Largest accepted margin above a limit */
+
+#define SAFETY_NOTIFY_SAMPLE (1 << 0)       /*!< Task notification bit: new sample */
+#define SAFETY_NOTIFY_ALERT (1 << 1)        /*!< Task notification bit: hardware over-current */
+
+/**
+ * @struct SafetyAlert
+ * @brief Safety trip handed from the supervisor to the UI task.
+ */
+struct SafetyAlert {
+    char message[32];       ///< Exceeded limit, e.g. "20.0A"
+};
+
+/**
+ * @struct SafetySample
+ * @brief Sample checked by the supervisor.
+ */
+struct SafetySample {
+    float voltage;          ///< DUT voltage in volts
+    float current;          ///< DUT current in amperes
+    float power;            ///< DUT power in watts
+    float temperature;      ///< Heatsink temperature in °C
+    int64_t timeUs;         ///< esp_timer time at which V and I were read
+};
+
+/**
+ * @struct SafetyLimits
+ * @brief Limits and the margins allowed above them (fraction, 0.1 = 10 %).
+ */
+struct SafetyLimits {
+    float maxVoltage;
+    float maxCurrent;
+    float maxPower;
+    float maxTemperature;
+    float voltageMargin;
+    float currentMargin;
+    float powerMargin;
+    float temperatureMargin;
+};
+
+/**
+ * @struct SafetyLatency
+ * @brief Detection-to-shutdown statistics in microseconds.
+ */
+struct SafetyLatency {
+    uint32_t count;
+    uint32_t lastUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;       ///< For the mean
+};
+
+/**
+ * @class SafetySupervisor
+ * @brief Highest-priority safety task and emergency shutdown.
+ *
+ * The control task hands over each sample with submit(), which overwrites a
+ * one-slot mailbox and notifies the supervisor; as it runs at a higher priority
+ * on the same core, the check happens right away, before the control task
+ * continues. A shutdown opens the relay, zeroes the DAC, posts a safety trip to
+ * the FSM, freezes the black box and hands an alert to the UI task.
+ */
+class SafetySupervisor {
+public:
+    /** @brief Constructor for the SafetySupervisor class. */
+    SafetySupervisor();
+
+    /**
+     * @brief Keeps the shutdown path and starts the supervisor task.
+     * @param dacPointer Pointer to the DAC zeroed on a shutdown.
+     * @param swsPointer Pointer to the analog switches (relay).
+     * @param fsmPointer Pointer to the FSM told about the trip.
+     * @param fastTripPointer Pointer to the hardware over-current trip.
+     * @param blackBoxPointer Pointer to the recorder frozen on a shutdown.
+     * @param alerts Queue receiving a SafetyAlert per shutdown.
+     * @param limits Initial limits and margins.
+     */
+    void init(DAC* dacPointer, AnalogSws* swsPointer, FSM* fsmPointer, FastTrip* fastTripPointer,
+              BlackBox* blackBoxPointer, QueueHandle_t alerts, const SafetyLimits& limits);
+
+    /**
+     * @brief Hands the latest sample to the supervisor (control task).
+     * @param sample The sample.
+     */
+    void submit(const SafetySample& sample);
+
+    /** @brief Wakes the supervisor for a hardware over-current (ISR). */
+    void IRAM_ATTR notify_alert_from_isr();
+
+    /**
+     * @brief Requests a change of limits, merged and applied by the supervisor task (any task).
+     *
+     * Fields set to NAN are kept. Requests made before the supervisor wakes up
+     * accumulate, the latest value of each field wins.
+     *
+     * @param changes Limits and margins to change.
+     */
+    void update_limits(const SafetyLimits& changes);
+
+    /** @brief Limits currently applied (any task). */
+    SafetyLimits get_limits() const;
+
+    /** @brief Number of shutdowns since boot; changes on every shutdown. */
+    uint32_t get_trip_count() const;
+
+    /** @brief Number of samples checked since boot. */
+    uint32_t get_check_count() const;
+
+    /** @brief Longest time from a sample to its check in microseconds. */
+    uint32_t get_max_check_us() const;
+
+    /** @brief Shutdowns because the control task stopped publishing samples. */
+    uint32_t get_timeout_count() const;
+
+    /** @brief Detection-to-shutdown statistics of the limit checks. */
+    SafetyLatency get_latency() const;
+
+private:
+    DAC* dac;
+    AnalogSws* sws;
+    FSM* fsm;
+    FastTrip* fastTrip;
+    BlackBox* blackBox;
+    QueueHandle_t alertQueue;
+    QueueHandle_t sampleMailbox;
+    TaskHandle_t taskHandle;
+
+    SafetyLimits limits;            ///< Applied limits, written by the supervisor task
+    SafetyLimits pendingLimits;     ///< Accumulated update_limits() changes, NAN = keep
+    bool limitsPending;
+    mutable portMUX_TYPE limitsLock;    ///< Guards limits and pendingLimits across tasks
+    float thresholds[4];            ///< limit * (1 + margin) for V, I, P, T
+
+    volatile uint32_t tripCount;
+    volatile uint32_t checkCount;
+    volatile uint32_t maxCheckUs;
+    volatile uint32_t timeoutCount;
+    SafetyLatency latency;
+    mutable portMUX_TYPE latencyLock;   ///< Guards latency against readers on the other core
+
+    static void task(void* parameter);
+    void apply_limits(const SafetyLimits& newLimits);
+    void apply_pending_limits();
+    void check(const SafetySample& sample);
+    int64_t shutdown(const char* message); ///< Returns the esp_timer time at which the DAC reached zero
+    void record_latency(int64_t detectUs, int64_t doneUs);
+};
@@ -0,0 +1,136 @@
+/**
+ * @file sample_stream.h
+ * @brief Header file for the SampleStream class.
+ *
+ * This file contains the declaration of the SampleStream class, which streams
+ * the raw V/I samples of the control task to subscribed WebSocket clients. The
+ * control task appends every sample to a lock-free ring; the UI task reads the
+ * ring once per pass, decimates it per client and sends batches of samples as
+ * binary frames. A client whose send queue already holds
+ * STREAM_MAX_QUEUED_FRAMES frames loses the batch instead of delaying the
+ * others, and the samples lost are reported in every frame.
+ *
+ * Subscribe with {"command":"streamStart","decimation":1,"batch":10} and stop
+ * with {"command":"streamStop"}. The highest rate is the control rate
+ * (1000 / CONTROL_TASK_PERIOD_MS samples per second).
+ *
+ * Frame layout (little endian, STREAM_FRAME_HEADER_SIZE bytes plus 12 per sample):
+ * | Offset | Size | Content                                                     |
+ * |--------|------|-------------------------------------------------------------|
+ * | 0      | 2    | Magic "SS"                                                  |
+ * | 2      | 1    | Version (STREAM_FRAME_VERSION)                              |
+ * | 3      | 1    | Sample count n                                              |
+ * | 4      | 2    | Decimation (uint16)                                         |
+ * | 6      | 2    | Reserved (0)                                                |
+ * | 8      | 4    | Samples dropped for this client since it subscribed (uint32) |
+ * | 12     | 12 n | Samples: esp_timer time in µs (low 32 bits), V, I (float32) |
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#define STREAM_RING_SAMPLES 128         /*!< Control samples kept for the readers (2.56 s at 20 ms), power of two */
+#define STREAM_MAX_CLIENTS 4            /*!< Simultaneous subscriptions */
+#define STREAM_MAX_BATCH 25             /*!< Largest number of samples per frame */
+#define STREAM_MAX_DECIMATION 1000      /*!< Largest decimation factor */
+#define STREAM_MAX_QUEUED_FRAMES 4      /*!< Frames allowed in a client's send queue before batches are dropped */
+#define STREAM_FRAME_VERSION 1
+#define STREAM_FRAME_HEADER_SIZE 12
+#define STREAM_FRAME_MAX_SIZE (STREAM_FRAME_HEADER_SIZE + STREAM_MAX_BATCH * 12)
+
+static_assert((STREAM_RING_SAMPLES & (STREAM_RING_SAMPLES - 1)) == 0, "STREAM_RING_SAMPLES must be a power of two");
+
+/**
+ * @struct StreamSample
+ * @brief One control period in the stream ring.
+ */
+struct StreamSample {
+    uint32_t timeUs;        ///< Low 32 bits of the esp_timer time of the sample
+    float voltage;          ///< DUT voltage in volts
+    float current;          ///< DUT current in amperes
+};
+
+static_assert(sizeof(StreamSample) == 12, "StreamSample must match the documented frame layout");
+
+/**
+ * @brief Sends a frame to a client without blocking.
+ * @return false if the client is gone or its send queue is full.
+ */
+typedef bool (*StreamSendFunction)(uint32_t clientId, const uint8_t* frame, size_t length);
+
+/**
+ * @class SampleStream
+ * @brief Decimated, batched V/I sample stream with per-client backpressure.
+ *
+ * push() is called by the control task only and never blocks. subscribe() and
+ * unsubscribe() come from the AsyncTCP task and only touch the subscription
+ * table under a spinlock; service() runs in the UI task and owns the read
+ * cursors and batch buffers. A reader that falls more than STREAM_RING_SAMPLES
+ * behind skips the overwritten samples and counts them as dropped.
+ */
+class SampleStream {
+public:
+    /** @brief Constructor for the SampleStream class. */
+    SampleStream();
+
+    /**
+     * @brief Appends a sample to the ring (control task).
+     * @param sample The sample.
+     */
+    void push(const StreamSample& sample);
+
+    /**
+     * @brief Starts or changes the subscription of a client (any task).
+     * @param clientId WebSocket client id.
+     * @param decimation Send one sample out of this many (1 to STREAM_MAX_DECIMATION).
+     * @param batch Samples per frame (1 to STREAM_MAX_BATCH).
+     * @return false if the parameters are out of range or every slot is taken.
+     */
+    bool subscribe(uint32_t clientId, uint16_t decimation, uint8_t batch);
+
+    /**
+     * @brief Ends the subscription of a client (any task).
+     * @param clientId WebSocket client id.
+     * @return Samples dropped for the client, 0 if it was not subscribed.
+     */
+    uint32_t unsubscribe(uint32_t clientId);
+
+    /**
+     * @brief Reads the new samples and sends the full batches (UI task).
+     * @param send Non-blocking send to one client.
+     */
+    void service(StreamSendFunction send);
+
+    /** @brief Number of subscribed clients. */
+    uint8_t get_subscriber_count() const;
+
+private:
+    struct Subscription {
+        uint32_t clientId;      ///< 0 when free
+        uint16_t decimation;
+        uint8_t batch;
+        uint32_t generation;    ///< Incremented by every subscribe(), restarts the reader
+        uint32_t dropped;       ///< Samples lost, reported in every frame
+    };
+
+    struct Reader {
+        uint32_t generation;    ///< Subscription the reader state belongs to
+        uint32_t cursor;        ///< Next ring position to read
+        uint16_t phase;         ///< Samples skipped since the last kept one
+        uint8_t count;          ///< Samples in the frame
+        uint8_t frame[STREAM_FRAME_MAX_SIZE];
+    };
+
+    StreamSample ring[STREAM_RING_SAMPLES];
+    std::atomic<uint32_t> head;             ///< Samples pushed since boot; the next one goes to head % size
+    Subscription subscriptions[STREAM_MAX_CLIENTS];
+    uint32_t nextGeneration;
+    mutable portMUX_TYPE lock;              ///< Guards the subscriptions against the AsyncTCP task
+    Reader readers[STREAM_MAX_CLIENTS];     ///< Same index as subscriptions, UI task only
+
+    void add_dropped(uint8_t slot, uint32_t clientId, uint32_t samples);
+    size_t finish_frame(Reader& reader, uint16_t decimation, uint32_t dropped);
+};
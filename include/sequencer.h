@@ -0,0 +1,185 @@
+/**
+ * @file sequencer.h
+ * @brief Header file for the Sequencer class.
+ *
+ * This file contains the declaration of the Sequencer class, which runs
+ * multi-step test scripts on the device. A script is uploaded once as text,
+ * compiled into a compact bytecode, stored in SPIFFS and executed by a small
+ * interpreter in the control task, so step timing does not depend on Wi-Fi
+ * round trips.
+ *
+ * Script syntax (one instruction per line, '#' starts a comment):
+ * | Instruction              | Effect                                              |
+ * |--------------------------|-----------------------------------------------------|
+ * | MODE CC/CV/CR/CW         | Enter a load mode (setpoint and output are reset)   |
+ * | SET value                | Set the setpoint of the current mode                |
+ * | OUTPUT ON/OFF            | Enable or disable the output                        |
+ * | WAIT ms                  | Wait for a time                                     |
+ * | UNTIL V/I/P/T </> x [ms] | Wait until a reading crosses x, abort after ms      |
+ * | LOOP n ... END           | Repeat the enclosed block n times                   |
+ * | LOG text                 | Print a message                                     |
+ * | STOP                     | End the script (also implied at the end)            |
+ *
+ * Bytecode layout (little endian): "SQ", version, 0, uint16 code size, then
+ * the code. Every instruction is an opcode byte followed by its operands.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "logger.h"
+
+class FSM;
+
+#define SEQ_MAX_SOURCE_SIZE 4096        /*!< Largest accepted script text in bytes */
+#define SEQ_MAX_CODE_SIZE 1024          /*!< Largest bytecode program in bytes */
+#define SEQ_MAX_LOOP_DEPTH 4            /*!< Nesting depth of LOOP blocks */
+#define SEQ_MAX_STEPS_PER_CYCLE 16      /*!< Instructions executed per control period at most */
+#define SEQ_MAX_LOG_LENGTH 48           /*!< Longest LOG message */
+#define SEQ_HEADER_SIZE 6               /*!< Bytes before the code */
+#define SEQ_VERSION 1                   /*!< Bump when the bytecode changes */
+#define SEQ_PROGRAM_PATH "/sequence.bin"
+
+/**
+ * @enum SEQ_OPCODE
+ * @brief Bytecode instructions and their operands.
+ */
+enum SEQ_OPCODE : uint8_t {
+    SEQ_OP_MODE = 1,    ///< uint8 FSM_MAIN_STATES
+    SEQ_OP_SET,         ///< float setpoint
+    SEQ_OP_OUTPUT,      ///< uint8 1 = on, 0 = off
+    SEQ_OP_WAIT,        ///< uint32 milliseconds
+    SEQ_OP_UNTIL,       ///< uint8 SEQ_VARIABLE, uint8 '<' or '>', float threshold, uint32 timeout ms (0 = none)
+    SEQ_OP_LOOP,        ///< uint16 repetitions
+    SEQ_OP_END,         ///< Closes the innermost LOOP
+    SEQ_OP_LOG,         ///< uint8 length, characters
+    SEQ_OP_STOP         ///< End of the script
+};
+
+/**
+ * @enum SEQ_VARIABLE
+ * @brief Readings that UNTIL can wait on.
+ */
+enum SEQ_VARIABLE : uint8_t {
+    SEQ_VAR_VOLTAGE,
+    SEQ_VAR_CURRENT,
+    SEQ_VAR_POWER,
+    SEQ_VAR_TEMPERATURE
+};
+
+/**
+ * @enum SEQ_STATUS
+ * @brief State of the sequencer.
+ */
+enum SEQ_STATUS {
+    SEQ_IDLE,
+    SEQ_RUNNING,
+    SEQ_DONE,
+    SEQ_STOPPED,
+    SEQ_ABORTED     ///< Stopped by a safety trip, a timeout or by leaving the load mode
+};
+
+/**
+ * @class Sequencer
+ * @brief Bytecode interpreter for test scripts.
+ *
+ * run() is called from the control task before the FSM drains its events.
+ * Instructions post the same FSM requests as the WebSocket handlers
+ * (change_state, set_setpoint, set_output_active), so they are applied in the
+ * same control period. Execution continues until a WAIT or UNTIL blocks or
+ * SEQ_MAX_STEPS_PER_CYCLE instructions have run.
+ */
+class Sequencer {
+public:
+    /** @brief Constructor for the Sequencer class. */
+    Sequencer();
+
+    /**
+     * @brief Keeps the FSM driven by the scripts and loads the stored program.
+     * @param fsmPointer Pointer to the FSM.
+     */
+    void init(FSM* fsmPointer);
+
+    /**
+     * @brief Compiles a script into the program (not while running).
+     * @param source Script text.
+     * @param length Length of the script in bytes.
+     * @return true if the script compiled; otherwise get_error() tells why.
+     */
+    bool compile(const char* source, size_t length);
+
+    /**
+     * @brief Stores the program in SPIFFS.
+     * @return true if the program was written.
+     */
+    bool save();
+
+    /** @brief Requests the program to start in the next control period. */
+    bool request_start();
+
+    /** @brief Requests a running program to stop in the next control period. */
+    void request_stop();
+
+    /**
+     * @brief Runs the program for one control period (control task).
+     * @param voltage Latest DUT voltage in volts.
+     * @param current Latest DUT current in amperes.
+     * @param temperature Latest heatsink temperature in °C.
+     */
+    void run(float voltage, float current, float temperature);
+
+    /**
+     * @brief Aborts a running program without touching the FSM (control task).
+     * @param reason Shown as error.
+     */
+    void abort(const char* reason);
+
+    /** @brief Whether a program is running or about to start. */
+    bool is_running() const;
+
+    /** @brief Whether a program is loaded. */
+    bool is_loaded() const;
+
+    SEQ_STATUS get_status() const;
+    const char* get_status_name() const;
+    uint16_t get_code_size() const;
+    uint16_t get_pc() const;
+
+    /** @brief Number of LOG messages since boot; changes when a new message is logged. */
+    uint32_t get_log_count() const;
+    const char* get_last_log() const;
+    const char* get_error() const;
+
+private:
+    FSM* fsm;
+
+    uint8_t program[SEQ_HEADER_SIZE + SEQ_MAX_CODE_SIZE];
+    uint16_t codeSize;
+
+    volatile SEQ_STATUS status;
+    volatile bool startRequested;
+    volatile bool stopRequested;
+    volatile uint16_t pc;
+    uint8_t expectedState;          ///< FSM state the program last entered
+
+    unsigned long waitStart;
+    bool waiting;
+
+    struct LoopFrame {
+        uint16_t bodyStart;
+        uint16_t remaining;
+    };
+    LoopFrame loops[SEQ_MAX_LOOP_DEPTH];
+    uint8_t loopDepth;
+
+    char lastLog[SEQ_MAX_LOG_LENGTH + 1];
+    volatile uint32_t logCount;
+    char error[64];
+
+    bool load();
+    bool verify(const uint8_t* code, uint16_t size);
+    bool step(float voltage, float current, float temperature);
+    void finish(SEQ_STATUS finalStatus);
+    const uint8_t* code() const;
+};
@@ -0,0 +1,103 @@
+/**
+ * @file soa.h
+ * @brief Header file for the SoaLimiter class.
+ *
+ * This file contains the declaration of the SoaLimiter class, the dynamic
+ * safe-operating-area limiter of the CANT_MOSFET load MOSFETs. It estimates the
+ * junction temperature from the heatsink temperature and the dissipated power
+ * with a first-order thermal RC model and derives the power the load may
+ * dissipate right now: the DC SOA at the DUT voltage derated to the heatsink
+ * temperature, and what keeps the junction below its limit. CC, CR and CW
+ * setpoints are clamped to that envelope on every control period.
+ *
+ * @note The SOA_* device parameters are those of a generic 100 V TO-247 MOSFET
+ *       on an insulating pad; replace them with the datasheet values of the
+ *       fitted part.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+
+/* -- Device (per MOSFET) -- */
+#define SOA_TJ_MAX 150.0            /*!< Junction temperature limit in °C, with margin to the rating */
+#define SOA_RTH_JH 1.2              /*!< Junction-to-heatsink thermal resistance in °C/W (Rth_jc + pad) */
+#define SOA_TAU_S 0.8               /*!< Junction-to-heatsink thermal time constant in seconds */
+#define SOA_DC_CURRENT 10.0         /*!< DC drain current limit in amperes */
+#define SOA_DC_POWER 100.0          /*!< DC SOA power at 25 °C case in watts */
+#define SOA_SB_VOLTAGE 30.0         /*!< Voltage where the secondary breakdown line starts */
+#define SOA_SB_EXPONENT 0.6         /*!< Allowed power falls as (V_sb / V)^exponent above it */
+
+/* -- Evaluation -- */
+#define SOA_PERIOD_S 0.02           /*!< Update period (control period) */
+#define SOA_HORIZON_S 0.5           /*!< Junction must stay below SOA_TJ_MAX for this long at the allowed power */
+#define SOA_TABLE_MAX_VOLTAGE 100   /*!< Last entry of the DC SOA table */
+#define SOA_MIN_VOLTAGE 0.1         /*!< Below this voltage the current is not limited by power */
+
+/**
+ * @class SoaLimiter
+ * @brief Junction temperature estimate and live allowed-power envelope.
+ *
+ * The DC SOA power per volt is tabulated once in init(), and the RC model
+ * coefficients are precomputed, so update() and the clamps are a handful of
+ * multiplications and one table lookup. All methods run in the control task;
+ * the getters may be read by other tasks.
+ */
+class SoaLimiter {
+public:
+    /** @brief Constructor for the SoaLimiter class. */
+    SoaLimiter();
+
+    /** @brief Builds the DC SOA table and the thermal model coefficients. */
+    void init();
+
+    /**
+     * @brief Advances the thermal model and recomputes the envelope (control task).
+     * @param heatsinkTemperature Heatsink temperature in °C.
+     * @param voltage DUT voltage in volts.
+     * @param current DUT current in amperes.
+     */
+    void update(float heatsinkTemperature, float voltage, float current);
+
+    /**
+     * @brief Limits a CC setpoint to the envelope at the given voltage.
+     * @return The current to apply in amperes.
+     */
+    float clamp_current(float current, float voltage);
+
+    /**
+     * @brief Limits a CW setpoint to the envelope.
+     * @return The power to apply in watts.
+     */
+    float clamp_power(float power);
+
+    /**
+     * @brief Limits a CR setpoint (raises the resistance) to the envelope at the given voltage.
+     * @param resistance Resistance in kΩ.
+     * @param maxResistance Largest resistance the DAC accepts in kΩ.
+     * @return The resistance to apply in kΩ.
+     */
+    float clamp_resistance(float resistance, float voltage, float maxResistance);
+
+    /** @brief Total power the load may dissipate now in watts. */
+    float get_allowed_power() const;
+
+    /** @brief Estimated junction temperature of the hottest MOSFET in °C. */
+    float get_junction_temperature() const;
+
+    /** @brief true if the last clamp reduced the setpoint. */
+    bool is_limiting() const;
+
+private:
+    float dcPower[SOA_TABLE_MAX_VOLTAGE + 1];  ///< DC SOA power per MOSFET at 25 °C, 1 V steps
+    float alpha;                ///< RC step over one period
+    float inverseBeta;          ///< 1 / RC step over the horizon
+
+    float rise;                 ///< Junction rise above the heatsink in °C
+    volatile float junctionTemperature;
+    volatile float allowedPower;
+    volatile bool limiting;
+
+    float dc_power_at(float voltage) const;
+};
@@ -0,0 +1,199 @@
+/**
+ * @file statistics.h
+ * @brief Header file for the RollingStatistics class.
+ *
+ * This file contains the declaration of the RollingStatistics class, which
+ * keeps min, max, mean and standard deviation of V, I, P and T over a 1 s, a
+ * 10 s and a 60 s sliding window and over the whole session. Every update is
+ * O(1): means and variances are Welford accumulators that samples (or blocks
+ * of samples) are added to and removed from, and min/max come from monotonic
+ * deques.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <math.h>
+
+#define STATISTICS_BLOCK_SAMPLES 50     /*!< Samples per 1 s block (20 ms control period) */
+#define STATISTICS_MEDIUM_BLOCKS 10     /*!< 1 s blocks in the 10 s window */
+#define STATISTICS_SLOW_BLOCKS 60       /*!< 1 s blocks in the 60 s window */
+
+/**
+ * @enum STAT_CHANNEL
+ * @brief Measured channels.
+ */
+enum STAT_CHANNEL : uint8_t {
+    STAT_VOLTAGE,
+    STAT_CURRENT,
+    STAT_POWER,
+    STAT_TEMPERATURE,
+    STAT_CHANNEL_COUNT
+};
+
+/**
+ * @enum STAT_WINDOW
+ * @brief Windows kept for every channel.
+ */
+enum STAT_WINDOW : uint8_t {
+    STAT_WINDOW_1S,         ///< Last 50 samples, updated every sample
+    STAT_WINDOW_10S,        ///< Last 10 complete seconds, updated every second
+    STAT_WINDOW_60S,        ///< Last 60 complete seconds, updated every second
+    STAT_WINDOW_SESSION,    ///< Every sample since the last reset_session()
+    STAT_WINDOW_COUNT
+};
+
+/**
+ * @struct WindowStatistics
+ * @brief Result of one channel over one window.
+ */
+struct WindowStatistics {
+    float min;
+    float max;
+    float mean;
+    float stddev;           ///< Sample standard deviation (n - 1)
+    uint32_t count;         ///< Samples in the window
+};
+
+/**
+ * @struct StatisticsSnapshot
+ * @brief Every channel over every window, published to the UI task.
+ */
+struct StatisticsSnapshot {
+    WindowStatistics values[STAT_CHANNEL_COUNT][STAT_WINDOW_COUNT];
+};
+
+/**
+ * @struct StatSummary
+ * @brief Count, mean, sum of squared deviations, min and max of a set of samples.
+ */
+struct StatSummary {
+    uint32_t count;
+    float mean;
+    float m2;
+    float min;
+    float max;
+};
+
+/**
+ * @struct StatAccumulator
+ * @brief Welford accumulator that summaries can be merged into and removed from (Chan et al.).
+ */
+struct StatAccumulator {
+    uint32_t count;
+    double mean;
+    double m2;
+    float min;              ///< Of everything added; windows take min/max from their deques instead
+    float max;
+
+    void reset();
+    void add(const StatSummary& summary);
+    void remove(const StatSummary& summary);
+    StatSummary to_summary() const;
+    WindowStatistics result(float minValue, float maxValue) const;
+};
+
+/**
+ * @class SlidingWindow
+ * @brief Statistics over the last N summaries.
+ *
+ * Summaries are kept in a ring so the oldest one can be removed from the
+ * accumulator when a new one arrives. The min and max deques hold ring
+ * positions with increasing minima (decreasing maxima), so the front is always
+ * the extreme of the window. Floating point errors of repeated add/remove are
+ * discarded by recomputing the accumulator from the ring once per lap.
+ *
+ * @tparam N Number of summaries in the window (up to 255).
+ */
+template <uint8_t N>
+class SlidingWindow {
+public:
+    SlidingWindow() { reset(); }
+
+    void reset() {
+        accumulator.reset();
+        next = 0;
+        minHead = minSize = maxHead = maxSize = 0;
+    }
+
+    void add(const StatSummary& summary) {
+        uint8_t slot = next % N;
+        if (next >= N) accumulator.remove(ring[slot]);
+        ring[slot] = summary;
+        if (next >= N && slot == N - 1) { // Full lap: start over from the stored summaries
+            accumulator.reset();
+            for (uint8_t i = 0; i < N; i++) accumulator.add(ring[i]);
+        } else {
+            accumulator.add(summary);
+        }
+
+        // Expire the position that just left the window, then keep the deques monotonic
+        uint32_t oldest = next >= N - 1 ? next - (N - 1) : 0;
+        if (minSize && minQueue[minHead] < oldest) { minHead = (minHead + 1) % N; minSize--; }
+        if (maxSize && maxQueue[maxHead] < oldest) { maxHead = (maxHead + 1) % N; maxSize--; }
+        while (minSize && ring[minQueue[(minHead + minSize - 1) % N] % N].min >= summary.min) minSize--;
+        while (maxSize && ring[maxQueue[(maxHead + maxSize - 1) % N] % N].max <= summary.max) maxSize--;
+        minQueue[(minHead + minSize++) % N] = next;
+        maxQueue[(maxHead + maxSize++) % N] = next;
+        next++;
+    }
+
+    WindowStatistics result() const {
+        if (!minSize) return accumulator.result(0, 0);
+        return accumulator.result(ring[minQueue[minHead] % N].min, ring[maxQueue[maxHead] % N].max);
+    }
+
+private:
+    StatSummary ring[N];
+    StatAccumulator accumulator;
+    uint32_t next;          ///< Position of the next summary (count of summaries added)
+    uint32_t minQueue[N];   ///< Positions, oldest first, increasing minima
+    uint32_t maxQueue[N];   ///< Positions, oldest first, decreasing maxima
+    uint8_t minHead, minSize, maxHead, maxSize;
+};
+
+/**
+ * @class RollingStatistics
+ * @brief Rolling statistics of V, I, P and T.
+ *
+ * Every sample goes into the 1 s window and into the current 1 s block; each
+ * completed block is added as one summary to the 10 s and 60 s windows, which
+ * keeps them at 10 and 60 entries instead of 500 and 3000 samples. The object
+ * belongs to the control task, which publishes get_snapshot() to the UI task.
+ */
+class RollingStatistics {
+public:
+    /** @brief Constructor for the RollingStatistics class. */
+    RollingStatistics();
+
+    /**
+     * @brief Adds one sample of every channel.
+     * @param voltage DUT voltage in volts.
+     * @param current DUT current in amperes.
+     * @param power DUT power in watts.
+     * @param temperature Heatsink temperature in °C.
+     */
+    void add_sample(float voltage, float current, float power, float temperature);
+
+    /** @brief Restarts the session window. The sliding windows keep their history. */
+    void reset_session();
+
+    /**
+     * @brief Computes every channel over every window.
+     * @param snapshot Receives the results.
+     */
+    void get_snapshot(StatisticsSnapshot& snapshot) const;
+
+private:
+    struct Channel {
+        SlidingWindow<STATISTICS_BLOCK_SAMPLES> fast;
+        SlidingWindow<STATISTICS_MEDIUM_BLOCKS> medium;
+        SlidingWindow<STATISTICS_SLOW_BLOCKS> slow;
+        StatAccumulator block;      ///< Current 1 s block
+        StatAccumulator session;
+    };
+
+    Channel channels[STAT_CHANNEL_COUNT];
+    uint8_t blockSamples;
+};
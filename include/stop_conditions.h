@@ -0,0 +1,137 @@
+/**
+ * @file stop_conditions.h
+ * @brief Header file for the StopConditions class.
+ *
+ * This file contains the declaration of the StopConditions class, which ends a
+ * CC/CV/CR/CW session automatically. Up to STOP_MAX_CONDITIONS user conditions
+ * ("V < 3.0", "t > 600", "Ah > 2.5", "dV/dt < -0.5", ...) are checked on every
+ * control period sample while the output is enabled; the first one that holds
+ * opens the DUT relay in the same period.
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "logger.h"
+#include "integrator.h"
+
+#define STOP_MAX_CONDITIONS 4           /*!< Conditions checked per sample */
+#define STOP_DVDT_SAMPLES 10            /*!< dV/dt is taken over this many samples (200 ms at 20 ms) */
+
+/**
+ * @enum STOP_VARIABLE
+ * @brief Quantities a stop condition can compare.
+ */
+enum STOP_VARIABLE : uint8_t {
+    STOP_VAR_VOLTAGE,       ///< DUT voltage in volts
+    STOP_VAR_CURRENT,       ///< DUT current in amperes
+    STOP_VAR_POWER,         ///< DUT power in watts
+    STOP_VAR_TIME,          ///< Seconds since the output was enabled
+    STOP_VAR_CHARGE,        ///< Ampere-hours since the output was enabled
+    STOP_VAR_DVDT,          ///< Voltage slope in volts per second
+    STOP_VAR_COUNT
+};
+
+/**
+ * @struct StopCondition
+ * @brief A condition in its precompiled form: fires when sign * (value - threshold) > 0.
+ */
+struct StopCondition {
+    STOP_VARIABLE variable;
+    float sign;             ///< +1 for '>', -1 for '<'
+    float threshold;
+};
+
+/**
+ * @class StopConditions
+ * @brief Per-sample stop-condition engine for the load modes.
+ *
+ * Conditions are changed through FSM events, so add(), clear() and evaluate()
+ * all run in the control task and need no locking. Each condition is turned
+ * into a sign and a threshold when it is added, so a check is one subtraction,
+ * one multiplication and one comparison. The getters may be read by other tasks.
+ */
+class StopConditions {
+public:
+    /** @brief Constructor for the StopConditions class. */
+    StopConditions();
+
+    /**
+     * @brief Adds a condition (control task).
+     * @param variable Quantity to compare.
+     * @param comparison '<' or '>'.
+     * @param threshold Value compared against.
+     * @return true if the condition was added.
+     */
+    bool add(STOP_VARIABLE variable, char comparison, float threshold);
+
+    /**
+     * @brief Checks the parameters of a condition without adding it.
+     * @return true if add() would accept them (apart from a full list).
+     */
+    static bool is_valid(STOP_VARIABLE variable, char comparison);
+
+    /** @brief Removes all conditions (control task). */
+    void clear();
+
+    /**
+     * @brief Resets time, charge and slope when the output is enabled (control task).
+     * @param voltage DUT voltage of the sample taken before the relay closed.
+     * @param current DUT current of that sample.
+     * @param timeUs esp_timer time at which that sample was taken.
+     */
+    void begin_session(float voltage, float current, int64_t timeUs);
+
+    /**
+     * @brief Updates the derived quantities and checks all conditions (control task).
+     * @param voltage Latest DUT voltage in volts.
+     * @param current Latest DUT current in amperes.
+     * @param timeUs esp_timer time at which the sample was taken.
+     * @return true if a condition fired; the caller must open the relay.
+     */
+    bool evaluate(float voltage, float current, int64_t timeUs);
+
+    /** @brief Changes whenever the list of conditions changes. */
+    uint32_t get_revision() const;
+
+    uint8_t get_count() const;
+    const StopCondition& get_condition(uint8_t index) const;
+
+    /** @brief Number of conditions fired since boot; changes when one fires. */
+    uint32_t get_fire_count() const;
+
+    /** @brief Index of the condition that fired last (-1 if none since the output was enabled). */
+    int8_t get_fired_index() const;
+
+    /** @brief Value of the quantity when the last condition fired. */
+    float get_fired_value() const;
+
+    float get_elapsed_s() const;
+    float get_charge_ah() const;
+    float get_dvdt() const;
+
+    /** @brief Short name of a quantity ("V", "I", "P", "t", "Ah", "dV/dt"). */
+    static const char* get_variable_name(STOP_VARIABLE variable);
+
+private:
+    StopCondition conditions[STOP_MAX_CONDITIONS];
+    volatile uint8_t count;
+    volatile uint32_t revision;
+
+    int64_t startUs;
+    EnergyIntegrator integrator;    ///< Charge since the output was enabled, same engine as the LCD totals
+
+    float voltageHistory[STOP_DVDT_SAMPLES];
+    int64_t timeHistory[STOP_DVDT_SAMPLES];
+    uint8_t historyCount;
+    uint8_t historyIndex;
+
+    volatile float elapsedS;
+    volatile float chargeAh;
+    volatile float dvdt;
+
+    volatile uint32_t fireCount;
+    volatile int8_t firedIndex;
+    volatile float firedValue;
+};
@@ -0,0 +1,229 @@
+/**
+ * @file telemetry.h
+ * @brief Telemetry frame, its field table and the encoders built from it.
+ *
+ * The periodic state is described once, by the telemetryFields table: JSON
+ * group and name, type, frame offset, precision, delta deadband and unit. The
+ * control values are packed into a TelemetryFrame; the JSON state document,
+ * the delta encoder and the schema served at GET /telemetry/schema are all
+ * generated from the frame and the table, with no JSON DOM and no heap.
+ *
+ * Clients that send {"command":"telemetry","format":"binary"} receive the
+ * periodic state as this packed frame instead of the JSON state document.
+ * Everything else (calibration, safety, sequences...) is still JSON.
+ *
+ * A full frame ("TM", keyframe) is sent on connect, on request and every
+ * TELEMETRY_KEYFRAME_INTERVAL_MS; in between, a client only receives the
+ * 32-bit words that moved past their deadband since the last frame queued to
+ * it ("TD", delta). The client patches its copy of the keyframe with them.
+ *
+ * Frame layout (little endian, TELEMETRY_FRAME_SIZE bytes):
+ * | Offset | Size | Content                                                     |
+ * |--------|------|-------------------------------------------------------------|
+ * | 0      | 2    | Magic "TM"                                                  |
+ * | 2      | 1    | Schema id (TELEMETRY_SCHEMA_ID)                             |
+ * | 3      | 1    | FSM state (FSM_MAIN_STATES)                                 |
+ * | 4      | 1    | Flags: bit 0 output active, bit 1 SOA limiting              |
+ * | 5      | 1    | Fan speed in %                                              |
+ * | 6      | 2    | Reserved (0)                                                |
+ * | 8      | 4    | Output time in ms (uint32)                                  |
+ * | 12     | 4    | Setpoint                                                    |
+ * | 16     | 20   | Voltage, current, power, resistance, temperature            |
+ * | 36     | 16   | Energy (J, Wh), charge (C, Ah)                              |
+ * | 52     | 8    | SOA allowed power (W), junction temperature (°C)            |
+ * | 60     | 256  | Statistics: V, I, P, T x 1 s, 10 s, 60 s, session x         |
+ * |        |      | (min, max, mean, stddev)                                    |
+ *
+ * All values after offset 12 are float32. From offset 8 the frame is read as
+ * TELEMETRY_WORD_COUNT 32-bit words, word w at offset 8 + 4 w.
+ *
+ * Delta layout (TELEMETRY_DELTA_HEADER_SIZE bytes plus 4 per changed word):
+ * | Offset | Size | Content                                                     |
+ * |--------|------|-------------------------------------------------------------|
+ * | 0      | 2    | Magic "TD"                                                  |
+ * | 2      | 4    | Schema id, state, flags, fan speed (as in the keyframe)     |
+ * | 6      | 2    | Number of changed words (uint16)                            |
+ * | 8      | 10   | Bitmap of changed words, bit w % 8 of byte w / 8            |
+ * | 18     | 4 n  | Changed words in increasing order                           |
+ *
+ * @date 2026-10-18
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include "statistics.h"
+
+#define TELEMETRY_SCHEMA_ID 1               /*!< Bump when the frame layout changes */
+#define TELEMETRY_FLAG_OUTPUT_ACTIVE (1 << 0)
+#define TELEMETRY_FLAG_SOA_LIMITING (1 << 1)
+#define TELEMETRY_KEYFRAME_INTERVAL_MS 10000 /*!< Longest time between full frames to a client */
+#define TELEMETRY_TIME_RESOLUTION_MS 1000   /*!< Output time is only resent when the second changes */
+
+/**
+ * @struct TelemetryFrame
+ * @brief Packed state frame, sent as is (the ESP32 is little endian).
+ */
+struct __attribute__((packed)) TelemetryFrame {
+    char magic[2];
+    uint8_t schema;
+    uint8_t state;
+    uint8_t flags;
+    uint8_t fanSpeed;
+    uint16_t reserved;
+    uint32_t outputTimeMs;
+    float setpoint;
+    float voltage;
+    float current;
+    float power;
+    float resistance;
+    float temperature;
+    float energyJ;
+    float energyWh;
+    float chargeC;
+    float chargeAh;
+    float soaAllowed;
+    float soaJunction;
+    float statistics[STAT_CHANNEL_COUNT][STAT_WINDOW_COUNT][4];
+};
+
+#define TELEMETRY_FRAME_SIZE 316
+static_assert(sizeof(TelemetryFrame) == TELEMETRY_FRAME_SIZE, "TelemetryFrame must match the documented layout");
+
+#define TELEMETRY_WORD_OFFSET 8     /*!< First byte of the word-encoded part */
+#define TELEMETRY_WORD_COUNT ((TELEMETRY_FRAME_SIZE - TELEMETRY_WORD_OFFSET) / 4)
+#define TELEMETRY_BITMAP_SIZE ((TELEMETRY_WORD_COUNT + 7) / 8)
+#define TELEMETRY_DELTA_HEADER_SIZE (8 + TELEMETRY_BITMAP_SIZE)
+#define TELEMETRY_DELTA_MAX_SIZE (TELEMETRY_DELTA_HEADER_SIZE + TELEMETRY_WORD_COUNT * 4)
+#define TELEMETRY_JSON_MAX_SIZE 1536    /*!< Largest JSON state document */
+#define TELEMETRY_SCHEMA_MAX_SIZE 3072  /*!< Largest schema description */
+#define TELEMETRY_MODE_COUNT 12         /*!< FSM_MAIN_STATES values, INITAL to FINAL */
+
+/**
+ * @enum TELEMETRY_GROUP
+ * @brief JSON object a field belongs to.
+ */
+enum TELEMETRY_GROUP : uint8_t {
+    TELEMETRY_MEASUREMENTS,
+    TELEMETRY_STATE,
+    TELEMETRY_SOA,
+    TELEMETRY_STATS,
+    TELEMETRY_GROUP_COUNT
+};
+
+/**
+ * @enum TELEMETRY_TYPE
+ * @brief Encoding of a field in the frame and in JSON.
+ */
+enum TELEMETRY_TYPE : uint8_t {
+    TELEMETRY_F32,          ///< float32, JSON number with `argument` decimals
+    TELEMETRY_U8,           ///< uint8, JSON integer
+    TELEMETRY_FLAG,         ///< Bit `argument` of a byte, JSON boolean
+    TELEMETRY_MODE,         ///< FSM state byte, JSON mode name
+    TELEMETRY_DURATION,     ///< uint32 milliseconds, JSON "HH:MM:SS"
+    TELEMETRY_STATISTICS    ///< float32[STAT_WINDOW_COUNT][4], JSON [min, max, mean, stddev] per window, `argument` decimals
+};
+
+/**
+ * @struct TelemetryField
+ * @brief One entry of the telemetry schema.
+ */
+struct TelemetryField {
+    uint8_t group;          ///< TELEMETRY_GROUP
+    const char* name;       ///< JSON key
+    uint8_t type;           ///< TELEMETRY_TYPE
+    uint16_t offset;        ///< Byte offset in TelemetryFrame
+    uint8_t argument;       ///< Decimals (numbers) or bit (flags)
+    float deadband;         ///< Smallest change sent in a delta (stddev: a tenth of it), 0 = any change
+    const char* unit;       ///< Physical unit, "" if none
+};
+
+#define TELEMETRY_OFFSET(member) ((uint16_t)offsetof(TelemetryFrame, member))
+#define TELEMETRY_STATISTICS_OFFSET(channel) ((uint16_t)(offsetof(TelemetryFrame, statistics) + (channel) * STAT_WINDOW_COUNT * 4 * sizeof(float)))
+
+/** @brief The telemetry schema, in JSON order (fields of a group are contiguous). */
+static constexpr TelemetryField telemetryFields[] = {
+    {TELEMETRY_MEASUREMENTS, "voltage", TELEMETRY_F32, TELEMETRY_OFFSET(voltage), 4, 0.0005f, "V"},
+    {TELEMETRY_MEASUREMENTS, "current", TELEMETRY_F32, TELEMETRY_OFFSET(current), 4, 0.0005f, "A"},
+    {TELEMETRY_MEASUREMENTS, "power", TELEMETRY_F32, TELEMETRY_OFFSET(power), 4, 0.0005f, "W"},
+    {TELEMETRY_MEASUREMENTS, "resistance", TELEMETRY_F32, TELEMETRY_OFFSET(resistance), 3, 0.0005f, "ohm"},
+    {TELEMETRY_MEASUREMENTS, "temperature", TELEMETRY_F32, TELEMETRY_OFFSET(temperature), 2, 0.05f, "C"},
+    {TELEMETRY_MEASUREMENTS, "fanSpeed", TELEMETRY_U8, TELEMETRY_OFFSET(fanSpeed), 0, 0, "%"},
+    {TELEMETRY_MEASUREMENTS, "uptime", TELEMETRY_DURATION, TELEMETRY_OFFSET(outputTimeMs), 0, TELEMETRY_TIME_RESOLUTION_MS, "ms"},
+    {TELEMETRY_MEASUREMENTS, "energy", TELEMETRY_F32, TELEMETRY_OFFSET(energyJ), 2, 0.05f, "J"},
+    {TELEMETRY_MEASUREMENTS, "Wh", TELEMETRY_F32, TELEMETRY_OFFSET(energyWh), 5, 0.0005f, "Wh"},
+    {TELEMETRY_MEASUREMENTS, "charge", TELEMETRY_F32, TELEMETRY_OFFSET(chargeC), 2, 0.05f, "C"},
+    {TELEMETRY_MEASUREMENTS, "Ah", TELEMETRY_F32, TELEMETRY_OFFSET(chargeAh), 5, 0.0005f, "Ah"},
+    {TELEMETRY_STATE, "mode", TELEMETRY_MODE, TELEMETRY_OFFSET(state), 0, 0, ""},
+    {TELEMETRY_STATE, "outputActive", TELEMETRY_FLAG, TELEMETRY_OFFSET(flags), 0, 0, ""},
+    {TELEMETRY_STATE, "value", TELEMETRY_F32, TELEMETRY_OFFSET(setpoint), 4, 0, ""},
+    {TELEMETRY_SOA, "allowed", TELEMETRY_F32, TELEMETRY_OFFSET(soaAllowed), 2, 0.05f, "W"},
+    {TELEMETRY_SOA, "junction", TELEMETRY_F32, TELEMETRY_OFFSET(soaJunction), 2, 0.05f, "C"},
+    {TELEMETRY_SOA, "limiting", TELEMETRY_FLAG, TELEMETRY_OFFSET(flags), 1, 0, ""},
+    {TELEMETRY_STATS, "V", TELEMETRY_STATISTICS, TELEMETRY_STATISTICS_OFFSET(STAT_VOLTAGE), 5, 0.0005f, "V"},
+    {TELEMETRY_STATS, "I", TELEMETRY_STATISTICS, TELEMETRY_STATISTICS_OFFSET(STAT_CURRENT), 5, 0.0005f, "A"},
+    {TELEMETRY_STATS, "P", TELEMETRY_STATISTICS, TELEMETRY_STATISTICS_OFFSET(STAT_POWER), 5, 0.0005f, "W"},
+    {TELEMETRY_STATS, "T", TELEMETRY_STATISTICS, TELEMETRY_STATISTICS_OFFSET(STAT_TEMPERATURE), 3, 0.05f, "C"},
+};
+
+#define TELEMETRY_FIELD_COUNT (sizeof(telemetryFields) / sizeof(telemetryFields[0]))
+
+/** @brief Bytes a field takes in the frame. */
+constexpr uint16_t telemetry_field_size(const TelemetryField& field) {
+    return field.type == TELEMETRY_STATISTICS ? STAT_WINDOW_COUNT * 4 * sizeof(float) :
+           (field.type == TELEMETRY_F32 || field.type == TELEMETRY_DURATION) ? 4 : 1;
+}
+
+/** @brief Bytes of the word-encoded part of the frame covered by fields i and later. */
+constexpr uint16_t telemetry_word_bytes(size_t i = 0) {
+    return i == TELEMETRY_FIELD_COUNT ? 0 :
+           (telemetryFields[i].offset >= TELEMETRY_WORD_OFFSET ? telemetry_field_size(telemetryFields[i]) : 0) + telemetry_word_bytes(i + 1);
+}
+
+/** @brief true if the fields from i on are inside the frame, word aligned and grouped. */
+constexpr bool telemetry_fields_valid(size_t i = 0) {
+    return i == TELEMETRY_FIELD_COUNT ||
+           (telemetryFields[i].offset + telemetry_field_size(telemetryFields[i]) <= TELEMETRY_FRAME_SIZE &&
+            (telemetryFields[i].offset < TELEMETRY_WORD_OFFSET || telemetryFields[i].offset % 4 == 0) &&
+            telemetryFields[i].group < TELEMETRY_GROUP_COUNT &&
+            (i == 0 || telemetryFields[i].group >= telemetryFields[i - 1].group) &&
+            telemetry_fields_valid(i + 1));
+}
+
+static_assert(telemetry_fields_valid(), "telemetryFields: field outside the frame, misaligned or out of group order");
+static_assert(telemetry_word_bytes() == TELEMETRY_FRAME_SIZE - TELEMETRY_WORD_OFFSET, "telemetryFields must describe every word of TelemetryFrame once");
+
+/**
+ * @brief Encodes the words of a frame that moved past their deadband.
+ *
+ * The words that are written are copied into the baseline, so the baseline
+ * always holds what the client has. Deadbands come from telemetryFields;
+ * non-finite values are resent whenever their bits change.
+ *
+ * @param frame Current frame.
+ * @param baseline Last frame sent to the client, updated.
+ * @param out Receives the delta, TELEMETRY_DELTA_MAX_SIZE bytes.
+ * @return Delta size in bytes, or 0 if a keyframe is not larger (send the frame
+ *         and copy it into the baseline instead).
+ */
+size_t telemetry_encode_delta(const TelemetryFrame& frame, TelemetryFrame& baseline, uint8_t* out);
+
+/**
+ * @brief Writes the JSON state document of a frame.
+ * @param frame The frame.
+ * @param out Output buffer, TELEMETRY_JSON_MAX_SIZE bytes is always enough.
+ * @param size Buffer size in bytes.
+ * @return Length without the terminating null, 0 if the buffer is too small.
+ */
+size_t telemetry_write_json(const TelemetryFrame& frame, char* out, size_t size);
+
+/**
+ * @brief Writes the schema description (fields, offsets, units, mode names) as JSON.
+ * @param out Output buffer, TELEMETRY_SCHEMA_MAX_SIZE bytes is always enough.
+ * @param size Buffer size in bytes.
+ * @return Length without the terminating null, 0 if the buffer is too small.
+ */
+size_t telemetry_write_schema(char* out, size_t size);
+
+/** @brief Mode name of an FSM state, as used in JSON. */
+const char* telemetry_get_mode_name(uint8_t state);
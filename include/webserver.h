@@ -14,11 +14,39 @@
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
 #include <ArduinoJson.h> // Include ArduinoJson
+#include "telemetry.h"
 
 // Forward declaration
 class WebServerESP32;
 
 // Define the type for the WebSocket event handler function
+#define WS_MAX_CLIENTS 8 /*!< Clients whose telemetry format is tracked (AsyncWebSocket default limit) */
+
+/**
+ * @enum WS_FORMAT
+ * @brief Format of the periodic state sent to a WebSocket client.
+ */
+enum WS_FORMAT : uint8_t {
+    WS_FORMAT_JSON,     ///< JSON state document (default)
+    WS_FORMAT_BINARY    ///< Packed TelemetryFrame (telemetry.h)
+};
+
+/**
+ * @struct FanoutStats
+ * @brief Cost of the broadcasts sent from shared message buffers.
+ */
+struct FanoutStats {
+    uint32_t broadcasts;            ///< Fan-outs of one payload to several clients
+    uint32_t buffers;               ///< Shared message buffers allocated (one per payload)
+    uint32_t allocationFailures;    ///< Broadcasts lost because no buffer could be allocated
+    uint32_t deliveries;            ///< Client messages queued from the shared buffers
+    uint32_t bytes;                 ///< Payload bytes copied into the buffers, once per payload
+    uint32_t maxQueued;             ///< Longest client send queue seen by a state broadcast
+    uint32_t minUs;                 ///< Fastest fan-out
+    uint32_t maxUs;                 ///< Slowest fan-out
+    uint64_t totalUs;               ///< Sum of the fan-out times
+};
+
 typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)> WsEventHandler;
 
 class WebServerESP32 {
@@ -49,6 +77,16 @@ public:
      */
     void on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
 
+    /**
+     * @brief Registers a handler for requests with a body, e.g. uploads sent with POST.
+     * 
+     * @param uri The URI to match for the request.
+     * @param method The HTTP method to match for the request.
+     * @param onRequest The function that will be called once the whole body has been received.
+     * @param onBody The function that will be called with each chunk of the body.
+     */
+    void on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArBodyHandlerFunction onBody);
+
     /**
      * @brief Serves a static file from the file system.
      * 
@@ -93,10 +131,71 @@ public:
 
     /**
      * @brief Sends a message to all connected WebSocket clients.
+     *
+     * The message is copied once into a reference-counted message buffer that
+     * every client queues; the library frees it after the last send.
+     *
      * @param message The message string to send.
      */
     void notifyClients(const String& message);
 
+    /**
+     * @brief Sends a binary frame to all connected WebSocket clients.
+     * @param data Frame bytes (copied before returning).
+     * @param length Frame size in bytes.
+     */
+    void notifyClientsBinary(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Sends a binary frame to one client unless its send queue is too long.
+     * @param id Client id.
+     * @param data Frame bytes (copied before returning).
+     * @param length Frame size in bytes.
+     * @param maxQueued Messages the client may already have queued.
+     * @return false if the client is gone or busy; the frame is not sent.
+     */
+    bool try_send_binary(uint32_t id, const uint8_t* data, size_t length, size_t maxQueued);
+
+    /**
+     * @brief Sends the periodic state to every client in the format it asked for (UI task).
+     *
+     * Binary clients get a keyframe or a delta against the last frame queued to
+     * them (telemetry.h). A client whose send queue is full is skipped, so its
+     * baseline still matches what it will receive.
+     *
+     * JSON clients get the state document written from the same frame
+     * (telemetry_write_json), only if one of them is connected.
+     *
+     * @param frame Telemetry frame of the current state.
+     */
+    void notifyClientsState(const TelemetryFrame& frame);
+
+    /**
+     * @brief Sends a full telemetry frame to a binary client on the next state broadcast.
+     * @param id Client id.
+     */
+    void request_keyframe(uint32_t id);
+
+    /**
+     * @brief Sets the state format of a connected client.
+     * @param id Client id.
+     * @param format The format.
+     * @return true if the client is tracked.
+     */
+    bool set_client_format(uint32_t id, WS_FORMAT format);
+
+    /** @brief State format of a client (JSON if unknown). */
+    WS_FORMAT get_client_format(uint32_t id);
+
+    /** @brief Copies the fan-out counters (any task). */
+    FanoutStats get_fanout_stats();
+
+    /** @brief Clears the fan-out counters (any task). */
+    void reset_fanout_stats();
+
+    /** @brief Prints the fan-out counters on the serial port. */
+    void print_fanout_report();
+
     /**
      * @brief Cleans up disconnected WebSocket clients.
      */
@@ -109,7 +208,29 @@ private:
     AsyncWebServer _server;
     AsyncWebSocket _ws; // WebSocket server instance
     WsEventHandler _wsHandler; // Store the handler
-    
+
+    struct ClientSlot {
+        uint32_t id;        ///< 0 when free
+        WS_FORMAT format;
+        bool keyframeRequested;
+    };
+    ClientSlot _clients[WS_MAX_CLIENTS]; // Written by AsyncTCP, read by the UI task
+    portMUX_TYPE _clientsLock;
+
+    struct TelemetryBaseline {
+        uint32_t id;                ///< Client the baseline belongs to, 0 before its first keyframe
+        uint32_t keyframeMs;        ///< millis() of the last keyframe
+        TelemetryFrame frame;       ///< What the client holds
+    };
+    TelemetryBaseline _baselines[WS_MAX_CLIENTS]; // Same index as _clients, UI task only
+    char _stateJson[TELEMETRY_JSON_MAX_SIZE];     // UI task only
+
+    FanoutStats _fanout;
+    portMUX_TYPE _fanoutLock; // Broadcasts come from the UI and AsyncTCP tasks
+
     void setup_wifi();
     void setup_server();
+    AsyncWebSocketMessageBuffer* make_shared_buffer(const uint8_t* data, size_t length);
+    void record_fanout(int64_t startUs, uint32_t deliveries, uint32_t maxQueued);
+    void handle_ws_event(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
 };
\ No newline at end of file
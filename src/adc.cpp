@@ -1,16 +1,20 @@
 #include "adc.h"
+#include <esp_timer.h>
 
-ADC::ADC() : i2c(nullptr) {}
+ADC::ADC() : i2c(nullptr), calibration(nullptr), currentTripCode(0), currentConversionStartUs(0) {}
 
-void ADC::init(I2C* i2cPointer) {
+void ADC::init(I2C* i2cPointer, Calibration* calibrationPointer) {
     i2c = i2cPointer;
+    calibration = calibrationPointer;
     Serial.println("[ADC] Initialized ADC (ADS1115) module");
 }
 
 float ADC::read_i_dut() {
-    float current = (read_voltage(ADC_CHANNEL_I_DUT) / 5.0) * 20.0; // 5V ≡ 20A;
-    float correction = current * I_DUT_CORRECTION_PARAMETER_SLOPE + I_DUT_CORRECTION_PARAMETER_INTERCEPT;
-    return current + correction;  
+    return calibration->correct_i_dut(read_i_dut_raw());
+}
+
+float ADC::read_i_dut_raw() {
+    return (read_voltage(ADC_CHANNEL_I_DUT) / 5.0) * 20.0; // 5V ≡ 20A
 }
 
 float ADC::read_temperature() {
@@ -19,15 +23,48 @@ float ADC::read_temperature() {
 }
 
 float ADC::read_v_dut() {
-    float voltage = (read_voltage(ADC_CHANNEL_V_DUT) / 4.0) * 100.0; // 4V ≡ 100V
-    float correction = voltage * V_DUT_CORRECTION_PARAMETER_SLOPE + V_DUT_CORRECTION_PARAMETER_INTERCEPT;
-    return voltage + correction;
+    return calibration->correct_v_dut(read_v_dut_raw());
+}
+
+float ADC::read_v_dut_raw() {
+    return (read_voltage(ADC_CHANNEL_V_DUT) / 4.0) * 100.0; // 4V ≡ 100V
+}
+
+void ADC::set_current_trip(float amps) {
+    // Invert the (monotonic) current correction by bisection over the raw range
+    float low = 0.0, high = ADC_PGA / 5.0 * 20.0; // Full scale of the current channel
+    for (int i = 0; i < 24; i++) {
+        float mid = 0.5f * (low + high);
+        if (calibration->correct_i_dut(mid) < amps) low = mid;
+        else high = mid;
+    }
+    float volts = high / 20.0 * 5.0; // 5V ≡ 20A
+    long code = lroundf(volts * ADC_MAX_VALUE / (2 * ADC_PGA));
+    if (code > INT16_MAX) code = INT16_MAX;
+    if (code < 1) code = 1;
+
+    write_register(ADC_REG_LO_THRESH, (uint16_t)(code * (1.0 - ADC_TRIP_HYSTERESIS)));
+    write_register(ADC_REG_HI_THRESH, (uint16_t)code);
+    currentTripCode = code;
+    LOG_I(LOG_FAST_TRIP, "Current trip at %.2fA (raw %.3fA, code %ld)", amps, high, code); // Also runs in the control task
+}
+
+int64_t ADC::get_current_conversion_start_us() const {
+    return currentConversionStartUs;
+}
+
+void ADC::write_register(uint8_t reg, uint16_t value) {
+    uint8_t data[3];
+    data[0] = reg;
+    data[1] = (value >> 8) & 0xFF; // MSB
+    data[2] = value & 0xFF;        // LSB
+    i2c->write(ADS1115_ADDR, data, 3);
 }
 
 void ADC::read(uint8_t channel, int16_t* value) {
     // Validate the channel (0 to 3)
     if (channel > 3) {
-        Serial.printf("[ADC] ERROR: Invalid channel %d (valid range: 0-3)\n", channel);
+        LOG_E(LOG_ADC, "Invalid channel %d (valid range: 0-3)", channel);
         return;
     }
 
@@ -40,8 +77,14 @@ void ADC::read(uint8_t channel, int16_t* value) {
     config |= (mux << 12);    // MUX[14:12]: Selected channel with respect to GND
     config |= (0 << 9);       // PGA[11:9] = 000 (±6.144V)
     config |= (1 << 8);       // MODE = 1 (Single conversion mode)
-    config |= (4 << 5);       // DR[7:5] = 100 (128 SPS)
-    config |= (0x03);         // COMP_QUE[1:0] = 11 (Disable the comparator)
+    config |= (ADC_DATA_RATE << 5); // DR[7:5] = 110 (475 SPS)
+    if (channel == ADC_CHANNEL_I_DUT && currentTripCode != 0) {
+        config |= (1 << 2);   // COMP_LAT = 1 (Latching), COMP_MODE = 0, COMP_POL = 0 (Active low)
+        config |= (0x00);     // COMP_QUE[1:0] = 00 (Assert after one conversion)
+        currentConversionStartUs = esp_timer_get_time();
+    } else {
+        config |= (0x03);     // COMP_QUE[1:0] = 11 (Disable the comparator, releases ALERT)
+    }
 
     // Write to the configuration register
     uint8_t data[3];
@@ -50,8 +93,18 @@ void ADC::read(uint8_t channel, int16_t* value) {
     data[2] = config & 0xFF;          // LSB
     i2c->write(ADS1115_ADDR, data, 3);
 
-    // Wait for the conversion to complete (according to the selected data rate)
-    delay(ADC_CONVERSION_TIME * 3); // 8ms for 128 SPS
+    // Wait for the conversion to complete, then poll OS until the device reports it is idle
+    unsigned long start = micros();
+    delayMicroseconds(ADC_CONVERSION_TIME_US);
+    data[0] = 0x01; // Configuration register address
+    i2c->write(ADS1115_ADDR, data, 1);
+    do {
+        i2c->read(ADS1115_ADDR, data, 2);
+        if (data[0] & 0x80) break; // OS = 1: no conversion in progress
+    } while (micros() - start < ADC_CONVERSION_TIMEOUT_US);
+    if (!(data[0] & 0x80)) {
+        LOG_E(LOG_ADC, "Conversion timeout on channel %d", channel);
+    }
 
     // Read the conversion register
     data[0] = 0x00; // Conversion register address
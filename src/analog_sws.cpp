@@ -2,7 +2,7 @@
 
 AnalogSws::AnalogSws() {}
 
-bool relayEnabled = false;
+volatile bool relayEnabled = false; // Also cleared by the over-current trip ISR
 
 void AnalogSws::init() {
     // Set the pin modes for the analog switches
@@ -15,22 +15,22 @@ void AnalogSws::init() {
 
 void AnalogSws::v_dac_enable() { 
     digitalWrite(ANALOG_SW1_ENABLE, HIGH); 
-    Serial.println("[ANALOG_SWS] V_DAC enabled");
+    LOG_D(LOG_ANALOG_SWS, "V_DAC enabled");
 }
 
 void AnalogSws::v_dac_disable() { 
     digitalWrite(ANALOG_SW1_ENABLE, LOW); 
-    Serial.println("[ANALOG_SWS] V_DAC disabled");
+    LOG_D(LOG_ANALOG_SWS, "V_DAC disabled");
 }
 
 void AnalogSws::mosfet_input_cc_mode() {
     digitalWrite(ANALOG_SW4_ENABLE, HIGH); 
-    Serial.println("[ANALOG_SWS] MOSFET set to CC mode");
+    LOG_D(LOG_ANALOG_SWS, "MOSFET set to CC mode");
 }
 
 void AnalogSws::mosfet_input_cv_mode() { 
     digitalWrite(ANALOG_SW4_ENABLE, LOW); 
-    Serial.println("[ANALOG_SWS] MOSFET set to CV mode");
+    LOG_D(LOG_ANALOG_SWS, "MOSFET set to CV mode");
 }
 
 int AnalogSws::get_mosfet_input_mode() { return digitalRead(ANALOG_SW4_ENABLE); }
@@ -39,12 +39,17 @@ void AnalogSws::relay_dut_enable() {
     if (relayEnabled) return;
     relayEnabled = true;
     digitalWrite(DUT_ENABLE, HIGH); 
-    Serial.println("[ANALOG_SWS] DUT relay enabled");
+    LOG_I(LOG_ANALOG_SWS, "DUT relay enabled");
 }
 
 void AnalogSws::relay_dut_disable() { 
     if (!relayEnabled) return;
     relayEnabled = false;
     digitalWrite(DUT_ENABLE, LOW); 
-    Serial.println("[ANALOG_SWS] DUT relay disabled");
+    LOG_I(LOG_ANALOG_SWS, "DUT relay disabled");
+}
+
+void IRAM_ATTR AnalogSws::relay_dut_disable_from_isr() {
+    digitalWrite(DUT_ENABLE, LOW);
+    relayEnabled = false;
 }
\ No newline at end of file
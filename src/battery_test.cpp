@@ -0,0 +1,222 @@
+#include "battery_test.h"
+#include "dac.h"
+#include "analog_sws.h"
+#include "soa.h"
+#include <ArduinoJson.h>
+
+BatteryTest::BatteryTest()
+    : dac(nullptr), sws(nullptr), soa(nullptr), mode(BAT_MODE_CC), status(BAT_IDLE), setpoint(0), cutoff(0),
+      integrator(), lastVoltage(0), belowCutoff(0),
+      elapsedMs(0), capacityMah(0), energyWh(0), lastResult(), stored(false), savePending(false) {}
+
+void BatteryTest::init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer) {
+    dac = dacPointer;
+    sws = swsPointer;
+    soa = soaPointer;
+
+    stored = load();
+    if (stored) {
+        Serial.printf("[BATTERY] Last result: %.1f mAh, %.3f Wh in %lu s\n",
+                      lastResult.capacityMah, lastResult.energyWh, (unsigned long)(lastResult.elapsedMs / 1000));
+    } else {
+        Serial.println("[BATTERY] No stored discharge result");
+    }
+}
+
+bool BatteryTest::is_valid_test(BAT_MODE testMode, float testSetpoint, float testCutoff) {
+    float modeMax = (testMode == BAT_MODE_CC) ? DAC_CC_MAX_CURRENT : DAC_CW_MAX_POWER;
+    return testSetpoint > 0 && testSetpoint <= modeMax &&
+           testCutoff >= BAT_MIN_CUTOFF_VOLTAGE && testCutoff <= BAT_MAX_CUTOFF_VOLTAGE;
+}
+
+bool BatteryTest::start(BAT_MODE testMode, float testSetpoint, float testCutoff) {
+    if (is_running()) {
+        LOG_E(LOG_BATTERY, "Test already running");
+        return false;
+    }
+    if (!is_valid_test(testMode, testSetpoint, testCutoff)) {
+        LOG_E(LOG_BATTERY, "Invalid test - setpoint: %.3f, cutoff: %.3fV (%.1f-%.1fV)",
+              testSetpoint, testCutoff, BAT_MIN_CUTOFF_VOLTAGE, BAT_MAX_CUTOFF_VOLTAGE);
+        return false;
+    }
+
+    mode = testMode;
+    setpoint = testSetpoint;
+    cutoff = testCutoff;
+    integrator.reset();
+    belowCutoff = 0;
+    elapsedMs = 0;
+    capacityMah = 0;
+    energyWh = 0;
+    status = BAT_STARTING; // Hardware is configured by run()
+
+    LOG_I(LOG_BATTERY, "Starting %s discharge at %.3f%s down to %.3fV",
+          mode == BAT_MODE_CC ? "CC" : "CW", setpoint, mode == BAT_MODE_CC ? "A" : "W", cutoff);
+    return true;
+}
+
+void BatteryTest::run(float voltage, float current, int64_t timeUs) {
+    switch (status) {
+        case BAT_STARTING:
+            sws->mosfet_input_cc_mode(); // CW is closed over CC, like the CW mode
+            sws->v_dac_enable();
+            apply_setpoint(voltage);
+            integrator.add_sample(voltage, current, timeUs, true); // First point of the first interval
+            lastVoltage = voltage;
+            status = BAT_RUNNING;
+            break;
+        case BAT_RUNNING: {
+            integrator.add_sample(voltage, current, timeUs, true);
+            lastVoltage = voltage;
+
+            elapsedMs = (uint32_t)integrator.get_active_ms();
+            capacityMah = integrator.get_charge_ah() * 1000.0;
+            energyWh = integrator.get_energy_wh();
+
+            apply_setpoint(voltage); // Follows the SOA envelope; CW is closed loop on the measured voltage
+
+            // Cutoff filter: only a sustained dip below the cutoff ends the test
+            if (voltage < cutoff) {
+                if (++belowCutoff >= BAT_CUTOFF_SAMPLES) {
+                    finish(BAT_DONE, voltage);
+                    LOG_I(LOG_BATTERY, "Cutoff reached: %.1f mAh, %.3f Wh in %lu s",
+                          lastResult.capacityMah, lastResult.energyWh, (unsigned long)(lastResult.elapsedMs / 1000));
+                }
+            } else if (voltage > cutoff + BAT_CUTOFF_HYSTERESIS) {
+                belowCutoff = 0;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void BatteryTest::stop() {
+    if (!is_running()) return;
+    if (status == BAT_STARTING) { // Nothing was applied yet
+        status = BAT_STOPPED;
+    } else {
+        finish(BAT_STOPPED, lastVoltage);
+    }
+    LOG_I(LOG_BATTERY, "Test stopped");
+}
+
+void BatteryTest::abort() {
+    if (!is_running()) return;
+    if (status == BAT_STARTING) {
+        status = BAT_ABORTED;
+    } else {
+        finish(BAT_ABORTED, lastVoltage);
+    }
+    LOG_W(LOG_BATTERY, "Test aborted");
+}
+
+bool BatteryTest::save_pending() {
+    if (!savePending) return false;
+    savePending = false;
+    if (!save()) {
+        Serial.println("[BATTERY] ERROR: Failed to save result to " BAT_RESULT_PATH);
+        return false;
+    }
+    stored = true;
+    Serial.println("[BATTERY] Result saved to " BAT_RESULT_PATH);
+    return true;
+}
+
+bool BatteryTest::is_running() const {
+    return status == BAT_STARTING || status == BAT_RUNNING;
+}
+
+bool BatteryTest::has_stored_result() const { return stored; }
+
+BAT_STATUS BatteryTest::get_status() const { return status; }
+
+const char* BatteryTest::get_status_name() const {
+    switch (status) {
+        case BAT_STARTING: return "STARTING";
+        case BAT_RUNNING: return "RUNNING";
+        case BAT_DONE: return "DONE";
+        case BAT_STOPPED: return "STOPPED";
+        case BAT_ABORTED: return "ABORTED";
+        default: return "IDLE";
+    }
+}
+
+BAT_MODE BatteryTest::get_mode() const { return mode; }
+
+float BatteryTest::get_setpoint() const { return setpoint; }
+
+float BatteryTest::get_cutoff() const { return cutoff; }
+
+uint32_t BatteryTest::get_elapsed_ms() const { return elapsedMs; }
+
+float BatteryTest::get_capacity_mah() const { return capacityMah; }
+
+float BatteryTest::get_energy_wh() const { return energyWh; }
+
+const BatteryResult& BatteryTest::get_last_result() const { return lastResult; }
+
+void BatteryTest::apply_setpoint(float voltage) {
+    // The DAC is only written when the code changes
+    if (mode == BAT_MODE_CC) dac->cc_mode_set_current(soa->clamp_current(setpoint, voltage));
+    else dac->cw_mode_set_power(soa->clamp_power(setpoint), voltage);
+}
+
+void BatteryTest::finish(BAT_STATUS finalStatus, float voltage) {
+    dac->digital_write(0);
+    sws->mosfet_input_cc_mode();
+
+    lastResult.mode = mode;
+    lastResult.status = finalStatus;
+    lastResult.setpoint = setpoint;
+    lastResult.cutoff = cutoff;
+    lastResult.elapsedMs = elapsedMs;
+    lastResult.capacityMah = capacityMah;
+    lastResult.energyWh = energyWh;
+    lastResult.endVoltage = voltage;
+
+    status = finalStatus;
+    savePending = true; // Flash writes are left to the UI task
+}
+
+bool BatteryTest::load() {
+    File file = SPIFFS.open(BAT_RESULT_PATH, FILE_READ);
+    if (!file) return false;
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        Serial.println("[BATTERY] WARNING: Ignoring unreadable " BAT_RESULT_PATH);
+        return false;
+    }
+
+    lastResult.mode = strcmp(doc["mode"] | "CC", "CW") == 0 ? BAT_MODE_CW : BAT_MODE_CC;
+    lastResult.status = (BAT_STATUS)(doc["status"] | (int)BAT_DONE);
+    lastResult.setpoint = doc["setpoint"] | 0.0f;
+    lastResult.cutoff = doc["cutoff"] | 0.0f;
+    lastResult.elapsedMs = doc["elapsedMs"] | 0UL;
+    lastResult.capacityMah = doc["mAh"] | 0.0f;
+    lastResult.energyWh = doc["Wh"] | 0.0f;
+    lastResult.endVoltage = doc["endVoltage"] | 0.0f;
+    return true;
+}
+
+bool BatteryTest::save() {
+    JsonDocument doc;
+    doc["mode"] = lastResult.mode == BAT_MODE_CC ? "CC" : "CW";
+    doc["status"] = (int)lastResult.status;
+    doc["setpoint"] = lastResult.setpoint;
+    doc["cutoff"] = lastResult.cutoff;
+    doc["elapsedMs"] = lastResult.elapsedMs;
+    doc["mAh"] = lastResult.capacityMah;
+    doc["Wh"] = lastResult.energyWh;
+    doc["endVoltage"] = lastResult.endVoltage;
+
+    File file = SPIFFS.open(BAT_RESULT_PATH, FILE_WRITE);
+    if (!file) return false;
+    size_t written = serializeJson(doc, file);
+    file.close();
+    return written > 0;
+}
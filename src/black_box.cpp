@@ -0,0 +1,126 @@
+#include "black_box.h"
+#include "rtc.h"
+
+BlackBox::BlackBox()
+    : ring(), head(0), count(0), writing(false), frozen(false), rtc(nullptr), tripUs(0),
+      tripReason(), nextNumber(1), droppedCount(0), trips() {}
+
+void BlackBox::init(RTC* rtcPointer) {
+    rtc = rtcPointer;
+    uint8_t stored = 0;
+    for (uint8_t slot = 0; slot < BLACKBOX_MAX_TRIPS; slot++) {
+        if (!load_header(slot)) continue;
+        stored++;
+        if (trips[slot].number >= nextNumber) nextNumber = trips[slot].number + 1;
+    }
+    Serial.printf("[BLACKBOX] Initialized - %u stored trips, %u samples (%u bytes) of history\n",
+                  stored, BLACKBOX_SAMPLES, (unsigned)sizeof(ring));
+}
+
+void BlackBox::record(const BlackBoxSample& sample) {
+    writing = true;
+    if (!frozen) {
+        ring[head] = sample;
+        head = (head + 1) % BLACKBOX_SAMPLES;
+        if (count < BLACKBOX_SAMPLES) count++;
+    }
+    writing = false;
+}
+
+void BlackBox::freeze(const char* reason, int64_t timeUs) {
+    if (frozen) { // Previous trip not written yet: keep its history intact
+        droppedCount = droppedCount + 1;
+        return;
+    }
+    tripUs = timeUs;
+    snprintf(tripReason, sizeof(tripReason), "%s", reason);
+    frozen = true;
+}
+
+bool BlackBox::save_pending() {
+    if (!frozen) return false;
+    while (writing) vTaskDelay(1); // A record() started before the freeze finishes within microseconds
+
+    BlackBoxTrip trip = {};
+    trip.number = nextNumber++;
+    trip.timestampMs = rtc->get_timestamp_ms_at(tripUs);
+    trip.samples = count;
+    snprintf(trip.reason, sizeof(trip.reason), "%s", tripReason);
+    uint16_t first = (head + BLACKBOX_SAMPLES - count) % BLACKBOX_SAMPLES;
+
+    bool saved = save(trip, first);
+    if (saved) {
+        trips[trip.number % BLACKBOX_MAX_TRIPS] = trip;
+        Serial.printf("[BLACKBOX] Trip %lu (%s) saved with %u samples\n", (unsigned long)trip.number, trip.reason, trip.samples);
+    } else {
+        Serial.println("[BLACKBOX] ERROR: Failed to save trip");
+    }
+
+    // Start a fresh history for the next trip
+    count = 0;
+    frozen = false;
+    return saved;
+}
+
+const BlackBoxTrip& BlackBox::get_trip(uint8_t slot) const { return trips[slot]; }
+
+bool BlackBox::get_trip_path(uint32_t number, char* path) const {
+    uint8_t slot = number % BLACKBOX_MAX_TRIPS;
+    if (number == 0 || trips[slot].number != number) return false;
+    snprintf(path, 24, BLACKBOX_PATH_FORMAT, slot);
+    return true;
+}
+
+uint32_t BlackBox::get_dropped_count() const { return droppedCount; }
+
+bool BlackBox::is_frozen() const { return frozen; }
+
+bool BlackBox::save(const BlackBoxTrip& trip, uint16_t first) {
+    char path[24];
+    snprintf(path, sizeof(path), BLACKBOX_PATH_FORMAT, (unsigned)(trip.number % BLACKBOX_MAX_TRIPS));
+    File file = SPIFFS.open(path, FILE_WRITE);
+    if (!file) return false;
+
+    // First line is parsed back by load_header()
+    file.printf("# trip,%lu,%llu,%u,%s\n", (unsigned long)trip.number, (unsigned long long)trip.timestampMs,
+                trip.samples, trip.reason);
+    file.print("t_ms,voltage,current,temperature,setpoint,output\n");
+    uint32_t tripTime = (uint32_t)tripUs;
+    for (uint16_t n = 0; n < trip.samples; n++) {
+        const BlackBoxSample& sample = ring[(first + n) % BLACKBOX_SAMPLES];
+        int32_t relativeUs = (int32_t)(sample.timeUs - tripTime); // Negative: before the trip
+        file.printf("%.1f,%.4f,%.4f,%.1f,%.4f,%d\n", relativeUs / 1000.0f, sample.voltage, sample.current,
+                    sample.temperature, sample.setpoint, sample.outputActive ? 1 : 0);
+    }
+    file.close();
+    return true;
+}
+
+bool BlackBox::load_header(uint8_t slot) {
+    char path[24];
+    snprintf(path, sizeof(path), BLACKBOX_PATH_FORMAT, slot);
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) return false;
+
+    char line[80] = {};
+    file.read((uint8_t*)line, sizeof(line) - 1);
+    file.close();
+
+    BlackBoxTrip trip = {};
+    unsigned long number;
+    unsigned long long timestampMs;
+    unsigned samples;
+    int reasonStart = 0;
+    if (sscanf(line, "# trip,%lu,%llu,%u,%n", &number, &timestampMs, &samples, &reasonStart) != 3 || reasonStart == 0) {
+        Serial.printf("[BLACKBOX] WARNING: Ignoring unreadable %s\n", path);
+        return false;
+    }
+    trip.number = number;
+    trip.timestampMs = timestampMs;
+    trip.samples = samples;
+    size_t reasonLength = strcspn(&line[reasonStart], "\n");
+    if (reasonLength >= sizeof(trip.reason)) reasonLength = sizeof(trip.reason) - 1;
+    memcpy(trip.reason, &line[reasonStart], reasonLength);
+    trips[slot] = trip;
+    return true;
+}
@@ -0,0 +1,61 @@
+#include "broadcast.h"
+
+BroadcastScheduler::BroadcastScheduler(uint32_t refreshIntervalMs)
+    : refreshIntervalMs(refreshIntervalMs), minIntervalMs(1000 / BROADCAST_DEFAULT_RATE_HZ), maxRateHz(BROADCAST_DEFAULT_RATE_HZ),
+      pending(false), urgentPending(false), sentOnce(false), lastSentMs(0), stats(), lock(portMUX_INITIALIZER_UNLOCKED) {}
+
+void BroadcastScheduler::request(BROADCAST_PRIORITY priority) {
+    portENTER_CRITICAL(&lock);
+    stats.requests++;
+    if (pending) stats.suppressed++; // Folded into the frame already waiting
+    pending = true;
+    if (priority == BROADCAST_URGENT) urgentPending = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool BroadcastScheduler::poll(uint32_t now) {
+    portENTER_CRITICAL(&lock);
+    uint32_t elapsed = now - lastSentMs;
+    bool due = !sentOnce || urgentPending ||
+               (pending && elapsed >= minIntervalMs) ||
+               elapsed >= refreshIntervalMs;
+    if (due) {
+        stats.sent++;
+        if (urgentPending && pending && elapsed < minIntervalMs) stats.urgent++;
+        if (!pending) stats.refreshes++;
+        pending = false;
+        urgentPending = false;
+        sentOnce = true;
+        lastSentMs = now;
+    }
+    portEXIT_CRITICAL(&lock);
+    return due;
+}
+
+bool BroadcastScheduler::set_max_rate(uint8_t hz) {
+    if (hz < BROADCAST_MIN_RATE_HZ || hz > BROADCAST_MAX_RATE_HZ) return false;
+    maxRateHz = hz;
+    minIntervalMs = 1000 / hz;
+    return true;
+}
+
+BroadcastStats BroadcastScheduler::get_stats() const {
+    portENTER_CRITICAL(&lock);
+    BroadcastStats copy = stats;
+    portEXIT_CRITICAL(&lock);
+    return copy;
+}
+
+void BroadcastScheduler::reset_stats() {
+    portENTER_CRITICAL(&lock);
+    stats = BroadcastStats();
+    portEXIT_CRITICAL(&lock);
+}
+
+void BroadcastScheduler::print_report() const {
+    BroadcastStats copy = get_stats();
+    Serial.printf("[BROADCAST] Max rate %u Hz, refresh every %lu ms\n", maxRateHz, (unsigned long)refreshIntervalMs);
+    Serial.printf("[BROADCAST] Requests %lu, suppressed %lu, sent %lu (urgent %lu, refresh %lu)\n",
+                  (unsigned long)copy.requests, (unsigned long)copy.suppressed, (unsigned long)copy.sent,
+                  (unsigned long)copy.urgent, (unsigned long)copy.refreshes);
+}
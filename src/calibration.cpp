@@ -0,0 +1,454 @@
+#include "calibration.h"
+#include "dac.h"
+#include "adc.h"
+#include "analog_sws.h"
+#include <stddef.h>
+
+float CalTable::lookup(float x) const {
+    float position = (x - xMin) * scale;
+    int index = 0;
+    if (position > 0.0f) { // Also rejects NaN
+        index = (int)position;
+        if (index > CAL_TABLE_SIZE - 2) index = CAL_TABLE_SIZE - 2;
+    }
+    float fraction = position - index; // Outside [0, 1] extrapolates the end segments
+    return y[index] + (y[index + 1] - y[index]) * fraction;
+}
+
+double Calibration::Polynomial::eval(double x) const {
+    double u = (x - center) / halfRange;
+    double result = 0.0;
+    for (int i = degree; i >= 0; i--) { // Horner's method
+        result = result * u + coeffs[i];
+    }
+    return result;
+}
+
+Calibration::Calibration()
+    : dac(nullptr), adc(nullptr), sws(nullptr), fileAction(CAL_FILE_NONE), stored(false), mode(CAL_MODE_CC), status(CAL_IDLE),
+      pointCount(0), currentPoint(0), maxCode(0), stepStart(0), sampleCount(0), voltageSum(0), currentSum(0) {}
+
+void Calibration::init(DAC* dacPointer, ADC* adcPointer, AnalogSws* swsPointer) {
+    dac = dacPointer;
+    adc = adcPointer;
+    sws = swsPointer;
+
+    stored = load();
+    if (stored) {
+        Serial.println("[CALIBRATION] Loaded calibration tables from " CAL_FILE_PATH);
+    } else {
+        load_defaults();
+        Serial.println("[CALIBRATION] No stored calibration - using default correction parameters");
+    }
+}
+
+bool Calibration::start(CAL_MODE sweepMode, uint8_t points, float maxValue) {
+    if (is_running()) {
+        LOG_E(LOG_CALIBRATION, "Sweep already running");
+        return false;
+    }
+
+    if (!is_valid_sweep(sweepMode, points, maxValue)) {
+        LOG_E(LOG_CALIBRATION, "Invalid sweep - points: %d (%d-%d), max: %.3f (0-%.1f)",
+              points, CAL_MIN_POINTS, CAL_MAX_POINTS, maxValue,
+              (sweepMode == CAL_MODE_CC) ? DAC_CC_MAX_CURRENT : DAC_CV_MAX_VOLTAGE);
+        return false;
+    }
+
+    mode = sweepMode;
+    pointCount = points;
+    currentPoint = 0;
+    maxCode = (mode == CAL_MODE_CC) ? cc_code(maxValue) : cv_code(maxValue);
+    for (uint8_t i = 0; i < CAL_MAX_POINTS; i++) {
+        this->points[i] = {0, 0.0f, 0.0f, 0.0f, false};
+    }
+    status = CAL_STARTING; // Hardware is configured by run()
+
+    LOG_I(LOG_CALIBRATION, "Starting %s sweep: %d points up to %.3f%s (DAC code %d)",
+          mode == CAL_MODE_CC ? "CC" : "CV", pointCount, maxValue, mode == CAL_MODE_CC ? "A" : "V", maxCode);
+    return true;
+}
+
+bool Calibration::is_valid_sweep(CAL_MODE sweepMode, uint8_t points, float maxValue) {
+    float modeMax = (sweepMode == CAL_MODE_CC) ? DAC_CC_MAX_CURRENT : DAC_CV_MAX_VOLTAGE;
+    return points >= CAL_MIN_POINTS && points <= CAL_MAX_POINTS && maxValue > 0 && maxValue <= modeMax;
+}
+
+void Calibration::run() {
+    switch (status) {
+        case CAL_STARTING:
+            if (mode == CAL_MODE_CC) sws->mosfet_input_cc_mode();
+            else sws->mosfet_input_cv_mode();
+            sws->v_dac_enable();
+            begin_point(0);
+            break;
+        case CAL_SETTLING:
+            if (millis() - stepStart >= CAL_SETTLE_MS) status = CAL_SAMPLING;
+            break;
+        case CAL_SAMPLING: {
+            voltageSum += adc->read_v_dut_raw();
+            currentSum += adc->read_i_dut_raw();
+            if (++sampleCount < CAL_SAMPLES_PER_POINT) break;
+
+            CalPoint& point = points[currentPoint];
+            point.rawVoltage = voltageSum / sampleCount;
+            point.rawCurrent = currentSum / sampleCount;
+            LOG_I(LOG_CALIBRATION, "Point %d/%d: code %d, V_raw %.4fV, I_raw %.4fA",
+                  currentPoint + 1, pointCount, point.code, point.rawVoltage, point.rawCurrent);
+
+            if (++currentPoint >= pointCount) {
+                finish(CAL_DONE);
+                LOG_I(LOG_CALIBRATION, "Sweep completed - enter reference values or fit");
+            } else {
+                begin_point(currentPoint);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Calibration::abort() {
+    if (!is_running()) return;
+    if (status == CAL_STARTING) { // Nothing was applied yet
+        status = CAL_ABORTED;
+    } else {
+        finish(CAL_ABORTED);
+    }
+    LOG_W(LOG_CALIBRATION, "Sweep aborted");
+}
+
+bool Calibration::set_reference(uint8_t index, float value) {
+    if (index >= currentPoint || !(value >= 0) || isinf(value)) {
+        Serial.printf("[CALIBRATION] ERROR: Invalid reference for point %d: %.4f\n", index, value);
+        return false;
+    }
+    points[index].reference = value;
+    points[index].hasReference = true;
+    Serial.printf("[CALIBRATION] Reference for point %d set to %.4f\n", index, value);
+    return true;
+}
+
+bool Calibration::fit(uint8_t degree) {
+    if (status != CAL_DONE) {
+        LOG_E(LOG_CALIBRATION, "No completed sweep to fit");
+        return false;
+    }
+    if (fileAction != CAL_FILE_NONE) {
+        LOG_E(LOG_CALIBRATION, "Previous calibration not saved yet");
+        return false;
+    }
+    if (degree < 1) degree = 1;
+    if (degree > CAL_MAX_FIT_DEGREE) degree = CAL_MAX_FIT_DEGREE;
+
+    bool ccMode = (mode == CAL_MODE_CC);
+    fileData = data; // Built off the live tables, which are only replaced if every fit succeeds
+    CalTable& adcTable = ccMode ? fileData.iDut : fileData.vDut;
+    CalTable& dacTable = ccMode ? fileData.ccDac : fileData.cvDac;
+
+    float raw[CAL_MAX_POINTS];
+    float truth[CAL_MAX_POINTS];
+    float codes[CAL_MAX_POINTS];
+
+    // ADC: reference value as a function of the raw reading
+    uint8_t refCount = 0;
+    for (uint8_t i = 0; i < pointCount; i++) {
+        if (!points[i].hasReference) continue;
+        raw[refCount] = ccMode ? points[i].rawCurrent : points[i].rawVoltage;
+        truth[refCount] = points[i].reference;
+        refCount++;
+    }
+    if (refCount >= 2) {
+        Polynomial adcPoly;
+        if (!fit_polynomial(raw, truth, refCount, degree < refCount ? degree : refCount - 1, adcPoly)) {
+            LOG_E(LOG_CALIBRATION, "ADC fit failed");
+            return false;
+        }
+        fill_table(adcTable, 0.0f, ccMode ? CAL_I_RAW_MAX : CAL_V_RAW_MAX, adcPoly);
+        LOG_I(LOG_CALIBRATION, "ADC %s table fitted to %d reference points", ccMode ? "current" : "voltage", refCount);
+    }
+
+    // DAC: code as a function of the real value, using the reference where available
+    for (uint8_t i = 0; i < pointCount; i++) {
+        float rawValue = ccMode ? points[i].rawCurrent : points[i].rawVoltage;
+        truth[i] = points[i].hasReference ? points[i].reference : adcTable.lookup(rawValue);
+        codes[i] = points[i].code;
+    }
+    Polynomial dacPoly;
+    if (!fit_polynomial(truth, codes, pointCount, degree < pointCount ? degree : pointCount - 1, dacPoly)) {
+        LOG_E(LOG_CALIBRATION, "DAC fit failed");
+        return false;
+    }
+    fill_table(dacTable, 0.0f, ccMode ? DAC_CC_MAX_CURRENT : DAC_CV_MAX_VOLTAGE, dacPoly);
+
+    if (!table_is_valid(adcTable) || !table_is_valid(dacTable)) {
+        LOG_E(LOG_CALIBRATION, "Fit produced invalid table");
+        return false;
+    }
+
+    data = fileData;
+    fileAction = CAL_FILE_WRITE; // Flash writes are left to the UI task
+    status = CAL_IDLE;
+    LOG_I(LOG_CALIBRATION, "%s calibration fitted (degree %d)", ccMode ? "CC" : "CV", degree);
+    return true;
+}
+
+bool Calibration::reset() {
+    if (is_running() || fileAction != CAL_FILE_NONE) {
+        LOG_E(LOG_CALIBRATION, "Cannot reset while a sweep is running or a save is pending");
+        return false;
+    }
+    load_defaults();
+    fileAction = CAL_FILE_REMOVE;
+    status = CAL_IDLE;
+    LOG_I(LOG_CALIBRATION, "Restored default correction parameters");
+    return true;
+}
+
+bool Calibration::save_pending() {
+    CAL_FILE_ACTION action = fileAction;
+    if (action == CAL_FILE_NONE) return false;
+
+    if (action == CAL_FILE_WRITE) {
+        stored = save();
+        Serial.println(stored ? "[CALIBRATION] Saved calibration tables to " CAL_FILE_PATH
+                              : "[CALIBRATION] ERROR: Failed to save calibration tables");
+    } else {
+        SPIFFS.remove(CAL_FILE_PATH);
+        stored = false;
+    }
+    fileAction = CAL_FILE_NONE; // fileData may be reused by the next fit() from here on
+    return true;
+}
+
+bool Calibration::is_running() const {
+    return status == CAL_STARTING || status == CAL_SETTLING || status == CAL_SAMPLING;
+}
+
+bool Calibration::is_stored() const { return stored; }
+
+CAL_STATUS Calibration::get_status() const { return status; }
+
+const char* Calibration::get_status_name() const {
+    switch (status) {
+        case CAL_STARTING: return "STARTING";
+        case CAL_SETTLING: return "SETTLING";
+        case CAL_SAMPLING: return "SAMPLING";
+        case CAL_DONE: return "DONE";
+        case CAL_ABORTED: return "ABORTED";
+        default: return "IDLE";
+    }
+}
+
+CAL_MODE Calibration::get_mode() const { return mode; }
+
+uint8_t Calibration::get_point_count() const { return pointCount; }
+
+uint8_t Calibration::get_completed_points() const { return currentPoint; }
+
+const CalPoint& Calibration::get_point(uint8_t index) const { return points[index < CAL_MAX_POINTS ? index : 0]; }
+
+float Calibration::correct_v_dut(float raw) const { return data.vDut.lookup(raw); }
+
+float Calibration::correct_i_dut(float raw) const { return data.iDut.lookup(raw); }
+
+uint16_t Calibration::cc_code(float current) const {
+    float code = data.ccDac.lookup(current);
+    if (!(code > 0.0f)) return 0;
+    if (code > DAC_MAX_DIGITAL_VALUE) return DAC_MAX_DIGITAL_VALUE;
+    return (uint16_t)(code + 0.5f);
+}
+
+uint16_t Calibration::cv_code(float voltage) const {
+    float code = data.cvDac.lookup(voltage);
+    if (!(code > 0.0f)) return 0;
+    if (code > DAC_MAX_DIGITAL_VALUE) return DAC_MAX_DIGITAL_VALUE;
+    return (uint16_t)(code + 0.5f);
+}
+
+void Calibration::load_defaults() {
+    // Same linear corrections that used to be applied inline by the ADC and DAC classes
+    data.vDut.xMin = 0.0f;
+    data.vDut.xMax = CAL_V_RAW_MAX;
+    data.iDut.xMin = 0.0f;
+    data.iDut.xMax = CAL_I_RAW_MAX;
+    data.ccDac.xMin = 0.0f;
+    data.ccDac.xMax = DAC_CC_MAX_CURRENT;
+    data.cvDac.xMin = 0.0f;
+    data.cvDac.xMax = DAC_CV_MAX_VOLTAGE;
+
+    for (int i = 0; i < CAL_TABLE_SIZE; i++) {
+        float t = (float)i / (CAL_TABLE_SIZE - 1);
+
+        float v = data.vDut.xMin + t * (data.vDut.xMax - data.vDut.xMin);
+        data.vDut.y[i] = v + (v * V_DUT_CORRECTION_PARAMETER_SLOPE + V_DUT_CORRECTION_PARAMETER_INTERCEPT);
+
+        float c = data.iDut.xMin + t * (data.iDut.xMax - data.iDut.xMin);
+        data.iDut.y[i] = c + (c * I_DUT_CORRECTION_PARAMETER_SLOPE + I_DUT_CORRECTION_PARAMETER_INTERCEPT);
+
+        // Negative codes are kept so the kink at zero is clamped by cc_code() instead of the interpolation
+        float current = data.ccDac.xMin + t * (data.ccDac.xMax - data.ccDac.xMin);
+        float correctedCurrent = current - (current * CC_CORRECTION_PARAMETER_SLOPE + CC_CORRECTION_PARAMETER_INTERCEPT);
+        data.ccDac.y[i] = ((correctedCurrent * 100 / CANT_MOSFET) / 1000.0) / DAC_V_MAX_CC * (DAC_RESOLUTION - 1);
+
+        float voltage = data.cvDac.xMin + t * (data.cvDac.xMax - data.cvDac.xMin);
+        float correctedVoltage = voltage - (voltage * CV_CORRECTION_PARAMETER_SLOPE + CV_CORRECTION_PARAMETER_INTERCEPT);
+        data.cvDac.y[i] = ((correctedVoltage * 1000 / 200) / 1000.0) / DAC_V_MAX_CV * (DAC_RESOLUTION - 1);
+    }
+
+    finalize_table(data.vDut);
+    finalize_table(data.iDut);
+    finalize_table(data.ccDac);
+    finalize_table(data.cvDac);
+}
+
+bool Calibration::load() {
+    File file = SPIFFS.open(CAL_FILE_PATH, FILE_READ);
+    if (!file) return false;
+
+    CalibrationData loaded;
+    size_t readBytes = file.read((uint8_t*)&loaded, sizeof(loaded));
+    file.close();
+
+    if (readBytes != sizeof(loaded) || loaded.magic != CAL_FILE_MAGIC || loaded.version != CAL_FILE_VERSION) {
+        Serial.println("[CALIBRATION] WARNING: Ignoring calibration file with wrong size or version");
+        return false;
+    }
+    if (loaded.crc != crc32((const uint8_t*)&loaded, offsetof(CalibrationData, crc))) {
+        Serial.println("[CALIBRATION] WARNING: Ignoring calibration file with bad CRC");
+        return false;
+    }
+
+    CalTable* tables[] = {&loaded.vDut, &loaded.iDut, &loaded.ccDac, &loaded.cvDac};
+    for (CalTable* table : tables) {
+        if (!table_is_valid(*table)) {
+            Serial.println("[CALIBRATION] WARNING: Ignoring calibration file with invalid table");
+            return false;
+        }
+        finalize_table(*table);
+    }
+
+    data = loaded;
+    return true;
+}
+
+bool Calibration::save() {
+    fileData.magic = CAL_FILE_MAGIC;
+    fileData.version = CAL_FILE_VERSION;
+    fileData.crc = crc32((const uint8_t*)&fileData, offsetof(CalibrationData, crc));
+
+    File file = SPIFFS.open(CAL_FILE_PATH, FILE_WRITE);
+    if (!file) {
+        Serial.println("[CALIBRATION] ERROR: Failed to open " CAL_FILE_PATH " for writing");
+        return false;
+    }
+    size_t written = file.write((const uint8_t*)&fileData, sizeof(fileData));
+    file.close();
+    return written == sizeof(fileData);
+}
+
+void Calibration::begin_point(uint8_t index) {
+    uint16_t code = (uint32_t)maxCode * (index + 1) / pointCount;
+    points[index].code = code;
+    dac->digital_write(code);
+    stepStart = millis();
+    sampleCount = 0;
+    voltageSum = 0;
+    currentSum = 0;
+    status = CAL_SETTLING;
+}
+
+void Calibration::finish(CAL_STATUS finalStatus) {
+    dac->digital_write(0);
+    sws->mosfet_input_cc_mode();
+    status = finalStatus;
+}
+
+bool Calibration::fit_polynomial(const float* x, const float* y, uint8_t n, uint8_t degree, Polynomial& poly) {
+    if (n < degree + 1) return false;
+
+    // Normalize the input to [-1, 1] to keep the normal equations well conditioned
+    float xLow = x[0], xHigh = x[0];
+    for (uint8_t i = 1; i < n; i++) {
+        if (x[i] < xLow) xLow = x[i];
+        if (x[i] > xHigh) xHigh = x[i];
+    }
+    if (!(xHigh - xLow > 1e-6f)) return false;
+    poly.degree = degree;
+    poly.center = (xHigh + xLow) / 2.0;
+    poly.halfRange = (xHigh - xLow) / 2.0;
+
+    // Normal equations: (A^T A) c = A^T y, built from power sums
+    const int size = degree + 1;
+    double matrix[CAL_MAX_FIT_DEGREE + 1][CAL_MAX_FIT_DEGREE + 2] = {};
+    for (uint8_t i = 0; i < n; i++) {
+        double u = (x[i] - poly.center) / poly.halfRange;
+        double powers[2 * CAL_MAX_FIT_DEGREE + 1];
+        powers[0] = 1.0;
+        for (int p = 1; p <= 2 * degree; p++) powers[p] = powers[p - 1] * u;
+        for (int row = 0; row < size; row++) {
+            for (int col = 0; col < size; col++) matrix[row][col] += powers[row + col];
+            matrix[row][size] += powers[row] * y[i];
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int col = 0; col < size; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < size; row++) {
+            if (fabs(matrix[row][col]) > fabs(matrix[pivot][col])) pivot = row;
+        }
+        if (fabs(matrix[pivot][col]) < 1e-12) return false;
+        if (pivot != col) {
+            for (int k = 0; k <= size; k++) {
+                double tmp = matrix[col][k];
+                matrix[col][k] = matrix[pivot][k];
+                matrix[pivot][k] = tmp;
+            }
+        }
+        for (int row = col + 1; row < size; row++) {
+            double factor = matrix[row][col] / matrix[col][col];
+            for (int k = col; k <= size; k++) matrix[row][k] -= factor * matrix[col][k];
+        }
+    }
+    for (int row = size - 1; row >= 0; row--) {
+        double sum = matrix[row][size];
+        for (int k = row + 1; k < size; k++) sum -= matrix[row][k] * poly.coeffs[k];
+        poly.coeffs[row] = sum / matrix[row][row];
+    }
+    return true;
+}
+
+void Calibration::fill_table(CalTable& table, float xMin, float xMax, const Polynomial& poly) {
+    table.xMin = xMin;
+    table.xMax = xMax;
+    for (int i = 0; i < CAL_TABLE_SIZE; i++) {
+        double x = xMin + (double)i * (xMax - xMin) / (CAL_TABLE_SIZE - 1);
+        table.y[i] = poly.eval(x);
+    }
+    finalize_table(table);
+}
+
+void Calibration::finalize_table(CalTable& table) {
+    table.scale = (CAL_TABLE_SIZE - 1) / (table.xMax - table.xMin);
+}
+
+bool Calibration::table_is_valid(const CalTable& table) {
+    if (!(table.xMax > table.xMin) || isinf(table.xMax) || isinf(table.xMin)) return false;
+    for (int i = 0; i < CAL_TABLE_SIZE; i++) {
+        if (isnan(table.y[i]) || isinf(table.y[i])) return false;
+    }
+    return true;
+}
+
+uint32_t Calibration::crc32(const uint8_t* bytes, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
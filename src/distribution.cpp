@@ -0,0 +1,152 @@
+#include "distribution.h"
+
+static const float quantileLevels[DIST_QUANTILE_COUNT] = {0.5f, 0.95f, 0.99f, 0.999f};
+
+P2Quantile::P2Quantile() : p(0.5f) { reset(); }
+
+void P2Quantile::init(float quantile) {
+    p = quantile;
+    reset();
+}
+
+void P2Quantile::reset() {
+    count = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        q[i] = 0;
+        n[i] = i + 1;
+    }
+}
+
+void P2Quantile::add(float x) {
+    if (count < 5) { // Initial markers: the first five samples, sorted
+        uint8_t i = count++;
+        while (i > 0 && q[i - 1] > x) {
+            q[i] = q[i - 1];
+            i--;
+        }
+        q[i] = x;
+        return;
+    }
+    count++;
+
+    // Cell of the sample; the extreme markers follow new minima and maxima
+    uint8_t k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= q[k + 1]) k++;
+    }
+    for (uint8_t i = k + 1; i < 5; i++) n[i]++;
+
+    // Desired positions 1, 1 + (N-1)p/2, 1 + (N-1)p, 1 + (N-1)(1+p)/2, N computed afresh, so they do not drift
+    const float increments[3] = {p / 2, p, (1 + p) / 2};
+    for (uint8_t i = 1; i <= 3; i++) {
+        float desired = 1 + (double)(count - 1) * increments[i - 1];
+        float d = desired - n[i];
+        if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+            int8_t step = d > 0 ? 1 : -1;
+            float candidate = parabolic(i, step);
+            q[i] = (q[i - 1] < candidate && candidate < q[i + 1]) ? candidate : linear(i, step);
+            n[i] += step;
+        }
+    }
+}
+
+float P2Quantile::parabolic(uint8_t i, int8_t d) const {
+    float span = n[i + 1] - n[i - 1];
+    return q[i] + d / span * ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                              (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+float P2Quantile::linear(uint8_t i, int8_t d) const {
+    return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+}
+
+float P2Quantile::get() const {
+    if (count == 0) return 0;
+    if (count < 5) { // Exact: nearest rank over the sorted samples
+        uint8_t rank = (uint8_t)(p * (count - 1) + 0.5f);
+        return q[rank];
+    }
+    return q[2];
+}
+
+Distribution::Distribution() : resetRequested(false), lock(portMUX_INITIALIZER_UNLOCKED) {
+    for (uint8_t c = 0; c < DIST_CHANNEL_COUNT; c++) {
+        for (uint8_t i = 0; i < DIST_QUANTILE_COUNT; i++) channels[c].estimators[i].init(quantileLevels[i]);
+    }
+    clear();
+}
+
+void Distribution::clear() {
+    for (uint8_t c = 0; c < DIST_CHANNEL_COUNT; c++) {
+        for (uint8_t i = 0; i < DIST_QUANTILE_COUNT; i++) channels[c].estimators[i].reset();
+        memset(&channels[c].data, 0, sizeof(DistributionSnapshot));
+    }
+}
+
+void Distribution::add_sample(float voltage, float current) {
+    portENTER_CRITICAL(&lock);
+    if (resetRequested) {
+        clear();
+        resetRequested = false;
+    }
+    add(channels[DIST_VOLTAGE], voltage, DIST_MIN_HALF_WIDTH_V);
+    add(channels[DIST_CURRENT], current, DIST_MIN_HALF_WIDTH_I);
+    portEXIT_CRITICAL(&lock);
+}
+
+void Distribution::add(Channel& channel, float value, float minHalfWidth) {
+    DistributionSnapshot& data = channel.data;
+    for (uint8_t i = 0; i < DIST_QUANTILE_COUNT; i++) channel.estimators[i].add(value);
+    if (data.count == 0 || value < data.min) data.min = value;
+    if (data.count == 0 || value > data.max) data.max = value;
+    for (uint8_t i = 0; i < DIST_QUANTILE_COUNT; i++) data.quantiles[i] = channel.estimators[i].get();
+
+    if (data.histogramReady) {
+        bin(data, value);
+    } else {
+        channel.warmup[data.count] = value;
+        if (data.count + 1 == DIST_WARMUP_SAMPLES) { // Place the range, then bin the warm-up samples
+            float center = data.quantiles[DIST_P50];
+            float halfWidth = DIST_RANGE_FACTOR * max(data.max - center, center - data.min);
+            if (halfWidth < minHalfWidth) halfWidth = minHalfWidth;
+            data.histogramLow = center - halfWidth;
+            data.binWidth = 2 * halfWidth / DIST_HISTOGRAM_BINS;
+            data.histogramReady = true;
+            for (uint8_t i = 0; i < DIST_WARMUP_SAMPLES; i++) bin(data, channel.warmup[i]);
+        }
+    }
+    data.count++;
+}
+
+void Distribution::bin(DistributionSnapshot& data, float value) {
+    float position = (value - data.histogramLow) / data.binWidth;
+    if (position < 0) {
+        data.underflow++;
+    } else if (position >= DIST_HISTOGRAM_BINS) {
+        data.overflow++;
+    } else {
+        data.bins[(uint8_t)position]++;
+    }
+}
+
+void Distribution::reset() {
+    resetRequested = true;
+}
+
+void Distribution::get_snapshot(DIST_CHANNEL channel, DistributionSnapshot& snapshot) const {
+    portENTER_CRITICAL(&lock);
+    snapshot = channels[channel].data;
+    portEXIT_CRITICAL(&lock);
+    if (resetRequested) memset(&snapshot, 0, sizeof(snapshot)); // Reset not applied yet
+}
+
+float Distribution::get_quantile_level(DIST_QUANTILE quantile) {
+    return quantileLevels[quantile];
+}
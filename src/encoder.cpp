@@ -1,10 +1,12 @@
 #include "encoder.h"
 
 Encoder* Encoder::instance = nullptr;
+EventQueue* Encoder::events = nullptr;
 
-Encoder::Encoder() : lastState(LOW), position(0), lastPosition(0), buttonPressed(false), encoderMaxPosition(10), encoderMinPosition(1), lastStateDT(LOW) { }
+Encoder::Encoder() : lastState(LOW), position(0), lastPosition(0), buttonPressed(false), encoderMaxPosition(10), encoderMinPosition(1), lastStateDT(LOW), pendingSteps(0), pendingPresses(0) { }
 
-void Encoder::init() {
+void Encoder::init(EventQueue* eventQueue) {
+    events = eventQueue;
     pinMode(ENCODER_CLK, INPUT_PULLUP);
     pinMode(ENCODER_DT, INPUT_PULLUP);
     pinMode(ENCODER_SW, INPUT_PULLUP);
@@ -47,19 +49,13 @@ void IRAM_ATTR Encoder::handle_interrupt() {
                 if (currentStateDT == HIGH) {
                     // Clockwise rotation - check CW debounce
                     if (interruptTime - lastCWInterruptTime > ENCODER_ROTATION_DEBOUNCE_CW) {
-                        if (instance->position < instance->encoderMaxPosition) {
-                            instance->position++;
-                            Serial.printf("[ENCODER] CW - Position: %d\n", instance->position);
-                        }
+                        events->push(make_event(EVENT_ENCODER_STEP, 1));
                         lastCWInterruptTime = interruptTime;
                     }
                 } else {
                     // Counter-clockwise rotation - check CCW debounce
                     if (interruptTime - lastCCWInterruptTime > ENCODER_ROTATION_DEBOUNCE_CCW) {
-                        if (instance->position > instance->encoderMinPosition) {
-                            instance->position--;
-                            Serial.printf("[ENCODER] CCW - Position: %d\n", instance->position);
-                        }
+                        events->push(make_event(EVENT_ENCODER_STEP, -1));
                         lastCCWInterruptTime = interruptTime;
                     }
                 }
@@ -78,41 +74,58 @@ void IRAM_ATTR Encoder::handle_button_interrupt() {
     // Debounce: ignore interrupts that occur within 50ms of the last interrupt
     if (interruptTime - lastButtonInterruptTime > ENCODER_BUTTON_DEBOUNCE) {
         if (instance) {
-            instance->buttonPressed = true;
+            events->push(make_event(EVENT_ENCODER_PRESS));
         }
     }
     lastButtonInterruptTime = interruptTime;
 }
 
+void Encoder::apply_step(int direction) {
+    pendingSteps.fetch_add(direction, std::memory_order_relaxed);
+}
+
+void Encoder::apply_press() {
+    pendingPresses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Encoder::collect() {
+    int steps = pendingSteps.exchange(0, std::memory_order_relaxed);
+    for (; steps > 0; steps--) {
+        if (position < encoderMaxPosition) position++;
+    }
+    for (; steps < 0; steps++) {
+        if (position > encoderMinPosition) position--;
+    }
+    if (pendingPresses.exchange(0, std::memory_order_relaxed) > 0) {
+        buttonPressed = true;
+    }
+}
+
 bool Encoder::is_button_pressed() {
+    collect();
     bool wasPressed = buttonPressed;
     buttonPressed = false;  // Reset after reading
     if (wasPressed) {
-        Serial.println("[ENCODER] Button pressed");
+        LOG_D(LOG_ENCODER, "Button pressed");
     }
     return wasPressed;
 }
 
 int Encoder::get_position() {
-    // Disable interrupts temporarily to ensure atomic read
-    noInterrupts();
-    int currentPos = position;
-    interrupts();
-    return currentPos;
+    collect();
+    return position;
 }
 
 void Encoder::set_position(int pos) {
-    // Disable interrupts temporarily to ensure atomic write
-    noInterrupts();
+    collect(); // Steps made before the new position are discarded
     lastPosition = position;
     position = pos;
-    interrupts();
-    Serial.printf("[ENCODER] Position set to: %d\n", pos);
+    LOG_D(LOG_ENCODER, "Position set to: %d", pos);
 }
 
 void Encoder::set_max_position(int maxPos) {
     encoderMaxPosition = maxPos;
-    Serial.printf("[ENCODER] Max position set to: %d\n", maxPos);
+    LOG_D(LOG_ENCODER, "Max position set to: %d", maxPos);
 }
 
 void Encoder::set_min_position(int minPos) {
@@ -120,15 +133,17 @@ void Encoder::set_min_position(int minPos) {
 }
 
 bool Encoder::has_changed() {
-    // Disable interrupts temporarily to ensure atomic read/write
-    noInterrupts();
+    collect();
     bool changed = lastPosition != position;
     lastPosition = position;
-    interrupts();
+    if (changed) {
+        LOG_D(LOG_ENCODER, "Position: %d", position);
+    }
     return changed;
 }
 
 void Encoder::reset_button() {
+    pendingPresses.store(0, std::memory_order_relaxed);
     buttonPressed = false;
 }
 
@@ -0,0 +1,44 @@
+#include "event_queue.h"
+
+EventQueue::EventQueue() : head(0), tail(0), dropped(0) {
+    for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool IRAM_ATTR EventQueue::push(const Event& event) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[position & (EVENT_QUEUE_SIZE - 1)];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        int32_t difference = (int32_t)(sequence - position);
+
+        if (difference == 0) { // Slot is free for this position: try to claim it
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                slot.event = event;
+                slot.sequence.store(position + 1, std::memory_order_release); // Publish
+                return true;
+            }
+        } else if (difference < 0) { // Slot still holds an unread event: queue is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else { // Another producer claimed this position
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool EventQueue::pop(Event& event) {
+    Slot& slot = slots[tail & (EVENT_QUEUE_SIZE - 1)];
+    uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != tail + 1) return false; // Empty, or the producer has not published yet
+
+    event = slot.event;
+    slot.sequence.store(tail + EVENT_QUEUE_SIZE, std::memory_order_release); // Free for the next lap
+    tail++;
+    return true;
+}
+
+uint32_t EventQueue::get_dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
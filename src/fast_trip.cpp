@@ -0,0 +1,63 @@
+#include "fast_trip.h"
+#include "adc.h"
+#include "analog_sws.h"
+#include "safety_supervisor.h"
+#include <esp_timer.h>
+
+FastTrip* FastTrip::instance = nullptr;
+
+FastTrip::FastTrip()
+    : adc(nullptr), supervisor(nullptr), tripCurrent(0), alertUs(0), relayUs(0), tripCount(0), detectUs(0),
+      relayLatencyUs(0), dacLatencyUs(0), maxDacLatencyUs(0) {}
+
+void FastTrip::init(ADC* adcPointer, SafetySupervisor* supervisorPointer, float current) {
+    adc = adcPointer;
+    supervisor = supervisorPointer;
+    tripCurrent = current;
+    instance = this;
+
+    adc->set_current_trip(tripCurrent);
+    pinMode(FAST_TRIP_ALERT_PIN, INPUT); // External pull-up, see fast_trip.h
+    attachInterrupt(digitalPinToInterrupt(FAST_TRIP_ALERT_PIN), handle_alert, FALLING);
+
+    Serial.printf("[FAST_TRIP] Initialized - ALERT: %d, limit: %.2fA\n", FAST_TRIP_ALERT_PIN, tripCurrent);
+}
+
+void FastTrip::set_trip_current(float current) {
+    tripCurrent = current;
+    adc->set_current_trip(tripCurrent);
+}
+
+void FastTrip::record_shutdown(int64_t dacUs) {
+    detectUs = (uint32_t)(alertUs - adc->get_current_conversion_start_us());
+    relayLatencyUs = (uint32_t)(relayUs - alertUs);
+    dacLatencyUs = (uint32_t)(dacUs - alertUs);
+    if (dacLatencyUs > maxDacLatencyUs) maxDacLatencyUs = dacLatencyUs;
+    tripCount = tripCount + 1;
+
+    LOG_E(LOG_FAST_TRIP, "Over-current trip: detected %lu us after conversion start, relay open after %lu us, DAC zero after %lu us",
+          (unsigned long)detectUs, (unsigned long)relayLatencyUs, (unsigned long)dacLatencyUs);
+}
+
+uint32_t FastTrip::get_trip_count() const { return tripCount; }
+
+float FastTrip::get_trip_current() const { return tripCurrent; }
+
+uint32_t FastTrip::get_detect_us() const { return detectUs; }
+
+uint32_t FastTrip::get_relay_us() const { return relayLatencyUs; }
+
+uint32_t FastTrip::get_dac_us() const { return dacLatencyUs; }
+
+uint32_t FastTrip::get_max_dac_us() const { return maxDacLatencyUs; }
+
+void IRAM_ATTR FastTrip::handle_alert() {
+    int64_t now = esp_timer_get_time();
+    AnalogSws::relay_dut_disable_from_isr(); // No I2C here: the DAC is left to the supervisor
+
+    if (instance) {
+        instance->alertUs = now;
+        instance->relayUs = esp_timer_get_time();
+        instance->supervisor->notify_alert_from_isr();
+    }
+}
@@ -1,98 +1,485 @@
 #include "fsm.h"
 
-FSM::FSM() {}
+#define STATE_BIT(state) (1u << FSM_MAIN_STATES::state)
+#define LOAD_MODES (STATE_BIT(CC) | STATE_BIT(CV) | STATE_BIT(CR) | STATE_BIT(CW))
+
+const FSM::StateHandlers FSM::stateTable[] = {
+    /*                  onEnter                   onControl                  onExit                   onUi                   onUiExit                    maxSetpoint                    allowedNext */
+    /* INITAL      */ {nullptr,                 nullptr,                   nullptr,                 nullptr,               nullptr,                    0,                             STATE_BIT(MAIN_MENU)},
+    /* MAIN_MENU   */ {&FSM::exit_output_stage, nullptr,                   nullptr,                 &FSM::ui_main_menu,    &FSM::ui_exit_main_menu,    0,                             LOAD_MODES | STATE_BIT(SETTINGS) | STATE_BIT(CALIBRATION) | STATE_BIT(BATTERY) | STATE_BIT(SWEEP) | STATE_BIT(MPPT)},
+    /* CC          */ {&FSM::enter_cc_mode,     &FSM::control_cc,          &FSM::exit_output_stage, &FSM::ui_cc,           &FSM::ui_exit_cx,           DAC_CC_MAX_CURRENT,            LOAD_MODES | STATE_BIT(MAIN_MENU)},
+    /* CV          */ {&FSM::enter_cv_mode,     &FSM::control_cv,          &FSM::exit_output_stage, &FSM::ui_cv,           &FSM::ui_exit_cx,           DAC_CV_MAX_VOLTAGE,            LOAD_MODES | STATE_BIT(MAIN_MENU)},
+    /* CR          */ {&FSM::enter_cc_mode,     &FSM::control_cr,          &FSM::exit_output_stage, &FSM::ui_cr,           &FSM::ui_exit_cx,           DAC_CR_MAX_RESISTANCE / 1000,  LOAD_MODES | STATE_BIT(MAIN_MENU)},
+    /* CW          */ {&FSM::enter_cc_mode,     &FSM::control_cw,          &FSM::exit_output_stage, &FSM::ui_cw,           &FSM::ui_exit_cx,           DAC_CW_MAX_POWER,              LOAD_MODES | STATE_BIT(MAIN_MENU)},
+    /* SETTINGS    */ {nullptr,                 nullptr,                   nullptr,                 &FSM::ui_settings,     &FSM::ui_exit_settings,     0,                             STATE_BIT(MAIN_MENU)},
+    /* CALIBRATION */ {nullptr,                 &FSM::control_calibration, &FSM::exit_calibration,  &FSM::ui_calibration,  &FSM::ui_exit_calibration,  0,                             STATE_BIT(MAIN_MENU)}, // Entered only through EVENT_CALIBRATION_START
+    /* BATTERY     */ {nullptr,                 &FSM::control_battery,     &FSM::exit_battery,      &FSM::ui_battery,      &FSM::ui_exit_battery,      0,                             STATE_BIT(MAIN_MENU)}, // Entered only through EVENT_BATTERY_START
+    /* SWEEP       */ {nullptr,                 &FSM::control_sweep,       &FSM::exit_sweep,        &FSM::ui_sweep,        &FSM::ui_exit_sweep,        0,                             STATE_BIT(MAIN_MENU)}, // Entered only through EVENT_SWEEP_START
+    /* MPPT        */ {nullptr,                 &FSM::control_mppt,        &FSM::exit_mppt,         &FSM::ui_mppt,         &FSM::ui_exit_mppt,         0,                             STATE_BIT(MAIN_MENU)}, // Entered only through EVENT_MPPT_START
+};
+
+FSM::FSM(DAC& dac, AnalogSws& sws, Calibration& calibration, BatteryTest& battery, IvSweep& sweep, MpptTracker& mppt, StopConditions& stops, SoaLimiter& soa, FastTrip& fastTrip, Encoder& encoder, EventQueue& events)
+    : dac(dac), sws(sws), calibration(calibration), battery(battery), sweep(sweep), mppt(mppt), stops(stops), soa(soa), fastTrip(fastTrip), encoder(encoder), events(events),
+      currentState(FSM_MAIN_STATES::INITAL), uiState(FSM_MAIN_STATES::INITAL), uiEntered(false),
+      setpoint(0.0), setpointDirty(false), outputActive(false), outputDirty(false), dutVoltage(0.0), dutCurrent(0.0), sampleUs(0) {
+    static_assert(sizeof(stateTable) / sizeof(stateTable[0]) == FSM_MAIN_STATES::FINAL, "FSM state table must have one entry per state");
+}
 
 void FSM::init() {
-    currentState = FSM_MAIN_STATES::MAIN_MENU;
-    lastState = FSM_MAIN_STATES::INITAL;
+    currentState = FSM_MAIN_STATES::INITAL;
+    uiState = FSM_MAIN_STATES::INITAL;
+    change_state(FSM_MAIN_STATES::MAIN_MENU); // Applied on the first run_control()
     Serial.println("[FSM] Initialized - Starting in MAIN_MENU state");
 }
 
-void FSM::run(float input, DAC dac, AnalogSws sws, bool* output_active, ADC adc) {
+void FSM::run_control(float dutVoltage, float dutCurrent, int64_t sampleUs) {
+    this->dutVoltage = dutVoltage;
+    this->dutCurrent = dutCurrent;
+    this->sampleUs = sampleUs;
 
-    if (*output_active) {
-        sws.relay_dut_enable();
-    } else {
-        sws.relay_dut_disable();
+    Event event;
+    while (events.pop(event)) {
+        handle_event(event);
     }
 
-    static float lastInput = 0.0;
+    if (stateTable[currentState].onControl) (this->*stateTable[currentState].onControl)();
 
-    switch (currentState) {
-        case FSM_MAIN_STATES::MAIN_MENU:
-            main_menu();
-            if (lastInput != input) {
-                sws.mosfet_input_cc_mode();
-                sws.relay_dut_disable();
-                dac.cc_mode_set_current(0.0);
+    // Stop conditions are checked on every sample of a load mode session; a hit opens the relay below
+    bool loadMode = currentState >= FSM_MAIN_STATES::CC && currentState <= FSM_MAIN_STATES::CW;
+    bool stopped = loadMode && outputActive && !outputDirty && stops.evaluate(dutVoltage, dutCurrent, sampleUs);
+    if (stopped) {
+        apply_output(false);
+    }
 
-                *output_active = false;
-            }
+    if (outputDirty) {
+        outputDirty = false;
+        if (outputActive) {
+            sws.relay_dut_enable();
+            if (loadMode) stops.begin_session(dutVoltage, dutCurrent, sampleUs);
+        } else {
+            sws.relay_dut_disable();
+        }
+    }
+
+    if (stopped) { // Logged once the relay is open
+        int8_t index = stops.get_fired_index();
+        LOG_I(LOG_STOP, "Condition %d fired: %s = %.3f", index + 1,
+              StopConditions::get_variable_name(stops.get_condition(index).variable), stops.get_fired_value());
+    }
+}
+
+void FSM::run_ui() {
+    FSM_MAIN_STATES state = currentState;
+    if (state != uiState) {
+        if (stateTable[uiState].onUiExit) (this->*stateTable[uiState].onUiExit)();
+        uiState = state;
+        uiEntered = true;
+    }
+    if (stateTable[state].onUi) (this->*stateTable[state].onUi)();
+}
+
+void FSM::handle_event(const Event& event) {
+    switch (event.type) {
+        case EVENT_ENCODER_STEP:
+            encoder.apply_step(event.value.i);
             break;
-        case FSM_MAIN_STATES::CC:
-            constant_x(String("A"), CC_DIGITS_BEFORE_DECIMAL, CC_DIGITS_AFTER_DECIMAL, CC_DIGITS_TOTAL, DAC_CC_MAX_CURRENT);
-            if (lastInput != input) {
-                sws.mosfet_input_cc_mode();
-                sws.v_dac_enable();
-                dac.cc_mode_set_current(input);
-            }
+        case EVENT_ENCODER_PRESS:
+            encoder.apply_press();
+            break;
+        case EVENT_SET_STATE:
+            transition(static_cast<FSM_MAIN_STATES>(event.value.i));
+            break;
+        case EVENT_SET_SETPOINT:
+            apply_setpoint(event.value.f);
+            break;
+        case EVENT_ADJUST_SETPOINT:
+            apply_setpoint(setpoint + event.value.f);
+            break;
+        case EVENT_SET_OUTPUT:
+            apply_output(event.value.i != 0);
+            break;
+        case EVENT_TOGGLE_OUTPUT:
+            apply_output(!outputActive);
             break;
-        case FSM_MAIN_STATES::CV:
-            constant_x(String("V"), CV_DIGITS_BEFORE_DECIMAL, CV_DIGITS_AFTER_DECIMAL, CV_DIGITS_TOTAL, DAC_CV_MAX_VOLTAGE);
-            if (lastInput != input) {
-                sws.mosfet_input_cv_mode();
-                sws.v_dac_enable();
-                dac.cv_mode_set_voltage(input);
+        case EVENT_CALIBRATION_START:
+            if (!is_allowed(FSM_MAIN_STATES::CALIBRATION)) {
+                LOG_E(LOG_FSM, "Calibration can only be started from the main menu");
+                break;
             }
+            if (calibration.start(static_cast<CAL_MODE>(event.arg[0]), event.arg[1], event.value.f)) {
+                transition(FSM_MAIN_STATES::CALIBRATION);
+            }
+            break;
+        case EVENT_CALIBRATION_ABORT:
+            calibration.abort();
+            break;
+        case EVENT_CALIBRATION_FIT: // The ADC and DAC read the tables in this task only
+            if (calibration.fit(event.arg[0])) fastTrip.set_trip_current(fastTrip.get_trip_current());
+            break;
+        case EVENT_CALIBRATION_RESET: // The comparator threshold goes through the current table
+            if (calibration.reset()) fastTrip.set_trip_current(fastTrip.get_trip_current());
+            break;
+        case EVENT_CURRENT_TRIP: // The ADS1115 is only accessed by this task
+            fastTrip.set_trip_current(event.value.f);
             break;
-        case FSM_MAIN_STATES::CR:
-            constant_x(String("kR"), CR_DIGITS_BEFORE_DECIMAL, CR_DIGITS_AFTER_DECIMAL, CR_DIGITS_TOTAL, DAC_CR_MAX_RESISTANCE / 1000);
-            if (lastInput != input) {
-                sws.mosfet_input_cc_mode();
-                sws.v_dac_enable();
+        case EVENT_BATTERY_START: {
+            if (!is_allowed(FSM_MAIN_STATES::BATTERY)) {
+                LOG_E(LOG_FSM, "Battery test can only be started from the main menu");
+                break;
             }
-            dac.cr_mode_set_resistance(input, adc.read_v_dut());
+            if (battery.start(static_cast<BAT_MODE>(event.arg[0]), event.value.f, event.aux)) {
+                transition(FSM_MAIN_STATES::BATTERY);
+            }
+            break;
+        }
+        case EVENT_BATTERY_STOP:
+            battery.stop();
             break;
-        case FSM_MAIN_STATES::CW:
-            constant_x(String("W"), CW_DIGITS_BEFORE_DECIMAL, CW_DIGITS_AFTER_DECIMAL, CW_DIGITS_TOTAL, DAC_CW_MAX_POWER);
-            if (lastInput != input) {
-                sws.mosfet_input_cc_mode();
-                sws.v_dac_enable();
+        case EVENT_SWEEP_START:
+            if (!is_allowed(FSM_MAIN_STATES::SWEEP)) {
+                LOG_E(LOG_FSM, "I-V sweep can only be started from the main menu");
+                break;
+            }
+            if (sweep.start(static_cast<IV_MODE>(event.arg[0]), event.value.f, event.aux, event.arg[1])) {
+                transition(FSM_MAIN_STATES::SWEEP);
             }
-            dac.cw_mode_set_power(input, adc.read_v_dut());
             break;
-        case FSM_MAIN_STATES::SETTINGS:
-            setting();
+        case EVENT_SWEEP_ABORT:
+            sweep.abort();
             break;
-        default:
+        case EVENT_STOP_ADD:
+            stops.add(static_cast<STOP_VARIABLE>(event.arg[0]), static_cast<char>(event.arg[1]), event.value.f);
+            break;
+        case EVENT_STOP_CLEAR:
+            stops.clear();
+            break;
+        case EVENT_MPPT_START:
+            if (!is_allowed(FSM_MAIN_STATES::MPPT)) {
+                LOG_E(LOG_FSM, "MPPT can only be started from the main menu");
+                break;
+            }
+            if (mppt.start(static_cast<MPPT_ALGORITHM>(event.arg[0]), event.value.f, event.aux)) {
+                transition(FSM_MAIN_STATES::MPPT);
+            }
+            break;
+        case EVENT_SAFETY_TRIP:
+            calibration.abort();
+            battery.abort();
+            sweep.abort();
+            mppt.stop();
+            apply_output(false);
+            apply_setpoint(0.0);
             break;
     }
+}
 
-    if (lastInput != input) lastInput = input;
-
+bool FSM::is_allowed(FSM_MAIN_STATES newState) const {
+    return stateTable[currentState].allowedNext & (1u << newState);
 }
 
-void FSM::change_state(FSM_MAIN_STATES newState) {
-    if (newState < FSM_MAIN_STATES::INITAL || newState > FSM_MAIN_STATES::FINAL) return;
-    
-    // Log state change
-    const char* stateNames[] = {"INITIAL", "MAIN_MENU", "CC", "CV", "CR", "CW", "SETTINGS", "FINAL"};
-    if (newState != currentState) {
-        Serial.printf("[FSM] State change: %s -> %s\n", 
-                     stateNames[static_cast<int>(currentState)], 
-                     stateNames[static_cast<int>(newState)]);
+bool FSM::transition(FSM_MAIN_STATES newState) {
+    if (newState <= FSM_MAIN_STATES::INITAL || newState >= FSM_MAIN_STATES::FINAL) return false;
+    FSM_MAIN_STATES previousState = currentState;
+    if (newState == previousState) return true;
+
+    if (!is_allowed(newState)) {
+        LOG_E(LOG_FSM, "Transition %d -> %d not allowed", (int)previousState, (int)newState);
+        return false;
     }
-    
-    lastState = currentState;
+
+    const char* stateNames[] = {"INITIAL", "MAIN_MENU", "CC", "CV", "CR", "CW", "SETTINGS", "CALIBRATION", "BATTERY", "SWEEP", "MPPT", "FINAL"};
+    LOG_I(LOG_FSM, "State change: %s -> %s", stateNames[previousState], stateNames[newState]);
+
+    if (stateTable[previousState].onExit) (this->*stateTable[previousState].onExit)();
+    // Every state starts with the output off and a zero setpoint
+    apply_output(false);
+    setpoint = 0.0;
+    setpointDirty = true;
     currentState = newState;
+    if (stateTable[newState].onEnter) (this->*stateTable[newState].onEnter)();
+    return true;
+}
+
+bool FSM::change_state(FSM_MAIN_STATES newState) {
+    return events.push(make_event(EVENT_SET_STATE, newState));
 }
 
 bool FSM::has_changed() {
-    bool changed = lastState != currentState;
-    lastState = currentState;
-    return changed;
+    bool entered = uiEntered;
+    uiEntered = false;
+    return entered;
 }
 
 FSM_MAIN_STATES FSM::get_current_state() {
     return currentState;
-}
\ No newline at end of file
+}
+
+void FSM::set_setpoint(float value) {
+    events.push(make_event_f(EVENT_SET_SETPOINT, value));
+}
+
+void FSM::adjust_setpoint(float delta) {
+    events.push(make_event_f(EVENT_ADJUST_SETPOINT, delta));
+}
+
+float FSM::get_setpoint() {
+    return setpoint;
+}
+
+float FSM::get_max_setpoint() {
+    return stateTable[currentState].maxSetpoint;
+}
+
+void FSM::set_output_active(bool active) {
+    events.push(make_event(EVENT_SET_OUTPUT, active ? 1 : 0));
+}
+
+void FSM::toggle_output() {
+    events.push(make_event(EVENT_TOGGLE_OUTPUT));
+}
+
+bool FSM::is_output_active() {
+    return outputActive;
+}
+
+bool FSM::start_calibration(CAL_MODE mode, uint8_t points, float maxValue) {
+    Event event = make_event_f(EVENT_CALIBRATION_START, maxValue);
+    event.arg[0] = mode;
+    event.arg[1] = points;
+    return events.push(event);
+}
+
+void FSM::abort_calibration() {
+    events.push(make_event(EVENT_CALIBRATION_ABORT));
+}
+
+bool FSM::set_current_trip(float current) {
+    return events.push(make_event_f(EVENT_CURRENT_TRIP, current));
+}
+
+bool FSM::fit_calibration(uint8_t degree) {
+    Event event = make_event(EVENT_CALIBRATION_FIT);
+    event.arg[0] = degree;
+    return events.push(event);
+}
+
+bool FSM::reset_calibration() {
+    return events.push(make_event(EVENT_CALIBRATION_RESET));
+}
+
+bool FSM::start_battery_test(BAT_MODE mode, float setpoint, float cutoff) {
+    Event event = make_event_f2(EVENT_BATTERY_START, setpoint, cutoff);
+    event.arg[0] = mode;
+    return events.push(event);
+}
+
+void FSM::stop_battery_test() {
+    events.push(make_event(EVENT_BATTERY_STOP));
+}
+
+bool FSM::start_sweep(IV_MODE mode, float startValue, float stopValue, uint8_t points) {
+    Event event = make_event_f2(EVENT_SWEEP_START, startValue, stopValue);
+    event.arg[0] = mode;
+    event.arg[1] = points;
+    return events.push(event);
+}
+
+void FSM::abort_sweep() {
+    events.push(make_event(EVENT_SWEEP_ABORT));
+}
+
+bool FSM::start_mppt(MPPT_ALGORITHM algorithm, float step, float maxCurrent) {
+    Event event = make_event_f2(EVENT_MPPT_START, step, maxCurrent);
+    event.arg[0] = algorithm;
+    return events.push(event);
+}
+
+bool FSM::add_stop_condition(STOP_VARIABLE variable, char comparison, float threshold) {
+    Event event = make_event_f(EVENT_STOP_ADD, threshold);
+    event.arg[0] = variable;
+    event.arg[1] = comparison;
+    return events.push(event);
+}
+
+void FSM::clear_stop_conditions() {
+    events.push(make_event(EVENT_STOP_CLEAR));
+}
+
+void FSM::trip() {
+    events.push(make_event(EVENT_SAFETY_TRIP));
+}
+
+void FSM::apply_setpoint(float value) {
+    float maxValue = stateTable[currentState].maxSetpoint;
+    if (!(value > 0)) value = 0.0; // Also rejects NaN
+    if (value > maxValue) value = maxValue;
+    if (value == setpoint) return;
+    setpoint = value;
+    setpointDirty = true;
+}
+
+void FSM::apply_output(bool active) {
+    if (active == outputActive) return;
+    outputActive = active;
+    outputDirty = true;
+}
+
+bool FSM::take_setpoint() {
+    bool dirty = setpointDirty;
+    setpointDirty = false;
+    return dirty;
+}
+
+// --- Enter/exit handlers (control task) ---
+void FSM::enter_cc_mode() {
+    sws.mosfet_input_cc_mode();
+    sws.v_dac_enable();
+    setpointDirty = true;
+}
+
+void FSM::enter_cv_mode() {
+    sws.mosfet_input_cv_mode();
+    sws.v_dac_enable();
+    setpointDirty = true;
+}
+
+void FSM::exit_output_stage() {
+    sws.relay_dut_disable(); // Do not wait for the end of run_control()
+    sws.mosfet_input_cc_mode();
+    dac.cc_mode_set_current(0.0); // Zero current in CC mode is the idle state
+}
+
+void FSM::exit_calibration() {
+    calibration.abort();
+    exit_output_stage();
+}
+
+void FSM::exit_battery() {
+    battery.stop();
+    exit_output_stage();
+}
+
+void FSM::exit_sweep() {
+    sweep.abort();
+    exit_output_stage();
+}
+
+void FSM::exit_mppt() {
+    mppt.stop();
+    exit_output_stage();
+}
+
+// --- Control handlers (control task) ---
+void FSM::control_cc() {
+    take_setpoint();
+    dac.cc_mode_set_current(soa.clamp_current(setpoint, dutVoltage)); // The DAC is only written when the code changes
+}
+
+void FSM::control_cv() {
+    if (take_setpoint()) dac.cv_mode_set_voltage(setpoint);
+}
+
+void FSM::control_cr() {
+    take_setpoint();
+    if (!(setpoint > 0)) { // No resistance entered: sink nothing instead of the SOA minimum resistance
+        dac.cc_mode_set_current(soa.clamp_current(0.0, dutVoltage)); // Also clears the limiting flag
+        return;
+    }
+    float resistance = soa.clamp_resistance(setpoint, dutVoltage, DAC_CR_MAX_RESISTANCE / 1000);
+    dac.cr_mode_set_resistance(resistance, dutVoltage); // Closed loop on the measured voltage
+}
+
+void FSM::control_cw() {
+    take_setpoint();
+    dac.cw_mode_set_power(soa.clamp_power(setpoint), dutVoltage); // Closed loop on the measured voltage
+}
+
+void FSM::control_calibration() {
+    calibration.run();
+    apply_output(calibration.is_running()); // DUT is connected only while sweeping
+}
+
+void FSM::control_battery() {
+    battery.run(dutVoltage, dutCurrent, sampleUs);
+    apply_output(battery.is_running()); // DUT is disconnected at the cutoff
+}
+
+void FSM::control_sweep() {
+    sweep.run(dutVoltage, dutCurrent);
+    apply_output(sweep.is_running()); // DUT is connected only while sweeping
+}
+
+void FSM::control_mppt() {
+    mppt.run(dutVoltage, dutCurrent);
+    apply_output(mppt.is_running());
+}
+
+// --- UI handlers (UI task) ---
+void FSM::ui_main_menu() {
+    main_menu();
+}
+
+void FSM::ui_cc() {
+    constant_x("A", CC_DIGITS_BEFORE_DECIMAL, CC_DIGITS_AFTER_DECIMAL, CC_DIGITS_TOTAL, stateTable[FSM_MAIN_STATES::CC].maxSetpoint);
+}
+
+void FSM::ui_cv() {
+    constant_x("V", CV_DIGITS_BEFORE_DECIMAL, CV_DIGITS_AFTER_DECIMAL, CV_DIGITS_TOTAL, stateTable[FSM_MAIN_STATES::CV].maxSetpoint);
+}
+
+void FSM::ui_cr() {
+    constant_x("kR", CR_DIGITS_BEFORE_DECIMAL, CR_DIGITS_AFTER_DECIMAL, CR_DIGITS_TOTAL, stateTable[FSM_MAIN_STATES::CR].maxSetpoint);
+}
+
+void FSM::ui_cw() {
+    constant_x("W", CW_DIGITS_BEFORE_DECIMAL, CW_DIGITS_AFTER_DECIMAL, CW_DIGITS_TOTAL, stateTable[FSM_MAIN_STATES::CW].maxSetpoint);
+}
+
+void FSM::ui_settings() {
+    setting();
+}
+
+void FSM::ui_calibration() {
+    calibration_menu();
+}
+
+void FSM::ui_battery() {
+    battery_menu();
+}
+
+void FSM::ui_sweep() {
+    sweep_menu();
+}
+
+void FSM::ui_mppt() {
+    mppt_menu();
+}
+
+// --- UI exit handlers (UI task) ---
+void FSM::ui_exit_main_menu() {
+    main_menu_exit();
+}
+
+void FSM::ui_exit_cx() {
+    constant_x_exit();
+}
+
+void FSM::ui_exit_settings() {
+    setting_exit();
+}
+
+void FSM::ui_exit_calibration() {
+    calibration_menu_exit();
+}
+
+void FSM::ui_exit_battery() {
+    battery_menu_exit();
+}
+
+void FSM::ui_exit_sweep() {
+    sweep_menu_exit();
+}
+
+void FSM::ui_exit_mppt() {
+    mppt_menu_exit();
+}
@@ -0,0 +1,53 @@
+#include "integrator.h"
+
+EnergyIntegrator::EnergyIntegrator()
+    : hasPrevious(false), previousUs(0), previousPowerUw(0), previousCurrentUa(0), energyNj(0), energyRemainder(0),
+      chargeNc(0), chargeRemainder(0), activeUs(0) {}
+
+void EnergyIntegrator::reset() {
+    hasPrevious = false;
+    energyNj = energyRemainder = 0;
+    chargeNc = chargeRemainder = 0;
+    activeUs = 0;
+}
+
+void EnergyIntegrator::add_sample(float voltage, float current, int64_t timeUs, bool active) {
+    if (!active) {
+        hasPrevious = false;
+        return;
+    }
+
+    int64_t voltageUv = llroundf(voltage * 1e6f);
+    int64_t currentUa = llroundf(current * 1e6f);
+    int64_t powerUw = voltageUv * currentUa / 1000000; // 100 V * 20 A = 2e15 before the division
+
+    if (hasPrevious) {
+        int64_t dtUs = timeUs - previousUs;
+
+        // Trapezoids (a + b) * dt in half pJ and half pC; 400 W * 1 s = 4e14 fits easily
+        energyRemainder += (previousPowerUw + powerUw) * dtUs;
+        energyNj += energyRemainder / 2000;
+        energyRemainder %= 2000;
+
+        chargeRemainder += (previousCurrentUa + currentUa) * dtUs;
+        chargeNc += chargeRemainder / 2000;
+        chargeRemainder %= 2000;
+
+        activeUs += dtUs;
+    }
+
+    hasPrevious = true;
+    previousUs = timeUs;
+    previousPowerUw = powerUw;
+    previousCurrentUa = currentUa;
+}
+
+double EnergyIntegrator::get_energy_j() const { return energyNj * 1e-9; }
+
+double EnergyIntegrator::get_energy_wh() const { return energyNj / 3.6e12; }
+
+double EnergyIntegrator::get_charge_c() const { return chargeNc * 1e-9; }
+
+double EnergyIntegrator::get_charge_ah() const { return chargeNc / 3.6e12; }
+
+uint64_t EnergyIntegrator::get_active_ms() const { return activeUs / 1000; }
@@ -0,0 +1,195 @@
+#include "iv_sweep.h"
+#include "dac.h"
+#include "analog_sws.h"
+#include "soa.h"
+
+static_assert(sizeof(IvPoint) == IV_FRAME_POINT_SIZE, "IvPoint must match the frame point layout");
+
+IvSweep::IvSweep()
+    : dac(nullptr), sws(nullptr), soa(nullptr), mode(IV_MODE_CC), status(IV_IDLE), startValue(0), stopValue(0),
+      pointCount(0), currentPoint(0), pointValue(0), unsettledPoints(0), windowCount(0), windowIndex(0), stepStart(0),
+      frameSize(0), framePending(false) {}
+
+void IvSweep::init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer) {
+    dac = dacPointer;
+    sws = swsPointer;
+    soa = soaPointer;
+}
+
+bool IvSweep::is_valid_sweep(IV_MODE sweepMode, float sweepStart, float sweepStop, uint8_t points) {
+    float modeMax = (sweepMode == IV_MODE_CC) ? DAC_CC_MAX_CURRENT : DAC_CV_MAX_VOLTAGE;
+    return points >= IV_MIN_POINTS && points <= IV_MAX_POINTS &&
+           sweepStart >= 0 && sweepStart <= modeMax && sweepStop >= 0 && sweepStop <= modeMax &&
+           sweepStart != sweepStop;
+}
+
+bool IvSweep::start(IV_MODE sweepMode, float sweepStart, float sweepStop, uint8_t points) {
+    if (is_running()) {
+        LOG_E(LOG_IV_SWEEP, "Sweep already running");
+        return false;
+    }
+    if (!is_valid_sweep(sweepMode, sweepStart, sweepStop, points)) {
+        LOG_E(LOG_IV_SWEEP, "Invalid sweep - %.3f to %.3f, points: %d (%d-%d)",
+          sweepStart, sweepStop, points, IV_MIN_POINTS, IV_MAX_POINTS);
+        return false;
+    }
+
+    mode = sweepMode;
+    startValue = sweepStart;
+    stopValue = sweepStop;
+    pointCount = points;
+    currentPoint = 0;
+    unsettledPoints = 0;
+    status = IV_STARTING; // Hardware is configured by run()
+
+    LOG_I(LOG_IV_SWEEP, "Starting %s sweep: %.3f to %.3f%s in %d points",
+          mode == IV_MODE_CC ? "CC" : "CV", startValue, stopValue, mode == IV_MODE_CC ? "A" : "V", pointCount);
+    return true;
+}
+
+void IvSweep::run(float voltage, float current) {
+    switch (status) {
+        case IV_STARTING:
+            if (mode == IV_MODE_CC) sws->mosfet_input_cc_mode();
+            else sws->mosfet_input_cv_mode();
+            sws->v_dac_enable();
+            begin_point(0, voltage);
+            break;
+        case IV_SETTLING: {
+            apply_point(voltage); // Follows the SOA envelope while the point settles
+            windowVoltage[windowIndex] = voltage;
+            windowCurrent[windowIndex] = current;
+            windowIndex = (windowIndex + 1) % IV_SETTLE_SAMPLES;
+            if (windowCount < IV_SETTLE_SAMPLES) windowCount++;
+
+            float meanVoltage, meanCurrent;
+            bool settled = window_settled(meanVoltage, meanCurrent);
+            bool timedOut = millis() - stepStart >= IV_SETTLE_TIMEOUT_MS;
+            if (!settled && !timedOut) break;
+            if (!settled) unsettledPoints++;
+
+            points[currentPoint] = {meanVoltage, meanCurrent, meanVoltage * meanCurrent};
+            if (currentPoint + 1 >= pointCount) {
+                currentPoint = pointCount;
+                finish(IV_DONE);
+                LOG_I(LOG_IV_SWEEP, "Sweep completed in %d points (%d unsettled)", pointCount, unsettledPoints);
+            } else {
+                begin_point(currentPoint + 1, voltage);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void IvSweep::abort() {
+    if (!is_running()) return;
+    if (status == IV_STARTING) { // Nothing was applied yet
+        status = IV_ABORTED;
+    } else {
+        finish(IV_ABORTED);
+    }
+    LOG_W(LOG_IV_SWEEP, "Sweep aborted");
+}
+
+const uint8_t* IvSweep::take_frame(size_t& size) {
+    if (!framePending) {
+        size = 0;
+        return nullptr;
+    }
+    framePending = false;
+    size = frameSize;
+    return frame;
+}
+
+const uint8_t* IvSweep::get_frame(size_t& size) const {
+    size = frameSize;
+    return frame;
+}
+
+bool IvSweep::is_running() const {
+    return status == IV_STARTING || status == IV_SETTLING;
+}
+
+IV_STATUS IvSweep::get_status() const { return status; }
+
+const char* IvSweep::get_status_name() const {
+    switch (status) {
+        case IV_STARTING: return "STARTING";
+        case IV_SETTLING: return "SETTLING";
+        case IV_DONE: return "DONE";
+        case IV_ABORTED: return "ABORTED";
+        default: return "IDLE";
+    }
+}
+
+IV_MODE IvSweep::get_mode() const { return mode; }
+
+uint8_t IvSweep::get_point_count() const { return pointCount; }
+
+uint8_t IvSweep::get_completed_points() const { return currentPoint; }
+
+void IvSweep::begin_point(uint8_t index, float voltage) {
+    pointValue = startValue + (stopValue - startValue) * index / (pointCount - 1);
+    apply_point(voltage);
+
+    currentPoint = index;
+    windowCount = 0;
+    windowIndex = 0;
+    stepStart = millis();
+    status = IV_SETTLING;
+}
+
+void IvSweep::apply_point(float voltage) {
+    // The DAC is only written when the code changes
+    if (mode == IV_MODE_CC) dac->cc_mode_set_current(soa->clamp_current(pointValue, voltage));
+    else dac->cv_mode_set_voltage(pointValue); // CV is not clamped, like the CV mode
+}
+
+bool IvSweep::window_settled(float& meanVoltage, float& meanCurrent) const {
+    float sumVoltage = 0, sumCurrent = 0;
+    for (uint8_t i = 0; i < windowCount; i++) {
+        sumVoltage += windowVoltage[i];
+        sumCurrent += windowCurrent[i];
+    }
+    meanVoltage = sumVoltage / windowCount;
+    meanCurrent = sumCurrent / windowCount;
+    if (windowCount < IV_SETTLE_SAMPLES) return false;
+
+    float varVoltage = 0, varCurrent = 0;
+    for (uint8_t i = 0; i < windowCount; i++) {
+        float dv = windowVoltage[i] - meanVoltage;
+        float di = windowCurrent[i] - meanCurrent;
+        varVoltage += dv * dv;
+        varCurrent += di * di;
+    }
+    varVoltage /= windowCount - 1;
+    varCurrent /= windowCount - 1;
+
+    float tolVoltage = IV_SETTLE_V_TOLERANCE + IV_SETTLE_REL_TOLERANCE * fabsf(meanVoltage);
+    float tolCurrent = IV_SETTLE_I_TOLERANCE + IV_SETTLE_REL_TOLERANCE * fabsf(meanCurrent);
+    return varVoltage <= tolVoltage * tolVoltage && varCurrent <= tolCurrent * tolCurrent;
+}
+
+void IvSweep::finish(IV_STATUS finalStatus) {
+    dac->digital_write(0);
+    sws->mosfet_input_cc_mode();
+    status = finalStatus;
+    if (finalStatus == IV_DONE) {
+        build_frame();
+        framePending = true; // Sent by the UI task
+    }
+}
+
+void IvSweep::build_frame() {
+    uint16_t count = pointCount;
+    frame[0] = 'I';
+    frame[1] = 'V';
+    frame[2] = IV_FRAME_VERSION;
+    frame[3] = mode;
+    memcpy(&frame[4], &count, sizeof(count));               // ESP32 is little endian
+    memcpy(&frame[6], &unsettledPoints, sizeof(unsettledPoints));
+    memcpy(&frame[IV_FRAME_HEADER_SIZE], points, count * IV_FRAME_POINT_SIZE);
+    frameSize = IV_FRAME_HEADER_SIZE + count * IV_FRAME_POINT_SIZE;
+}
@@ -0,0 +1,175 @@
+#include "logger.h"
+
+Logger logger;
+
+static const char* const moduleNames[LOG_MODULE_COUNT] = {"MAIN", "CONTROL", "ENCODER", "DAC", "ANALOG_SWS", "WEBSOCKET",
+                                                          "STOP", "SEQUENCER", "BATTERY", "SAFETY", "FAST_TRIP", "CALIBRATION",
+                                                          "FSM", "MPPT", "IV_SWEEP", "RTC", "ADC"};
+static const char* const levelNames[] = {"none", "error", "warn", "info", "debug"};
+
+Logger::Logger() : head(0), tail(0), dropped(0), reportedDropped(0) {
+    for (uint32_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) levels[i] = LOG_LEVEL_DEFAULT;
+}
+
+void Logger::init() {
+    xTaskCreatePinnedToCore(task, "log", LOG_TASK_STACK, this, LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE);
+}
+
+void IRAM_ATTR Logger::pack(LogRecord& record, const char* value) {
+    record.types[record.argCount] = LOG_ARG_STRING;
+    if (!value) value = "(null)";
+
+    // Truncated to the space left; a full buffer leaves the offset on the final '\0'
+    uint8_t offset = record.textLength < LOG_TEXT_SIZE - 1 ? record.textLength : LOG_TEXT_SIZE - 1;
+    uint8_t end = offset;
+    while (end < LOG_TEXT_SIZE - 1 && *value) record.text[end++] = *value++;
+    record.text[end] = '\0';
+    record.textLength = end < LOG_TEXT_SIZE - 1 ? end + 1 : LOG_TEXT_SIZE - 1;
+    record.args[record.argCount++].u = offset;
+}
+
+bool IRAM_ATTR Logger::push(const LogRecord& record) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[position & (LOG_QUEUE_SIZE - 1)];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        int32_t difference = (int32_t)(sequence - position);
+
+        if (difference == 0) { // Slot is free for this position: try to claim it
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                slot.record = record;
+                slot.sequence.store(position + 1, std::memory_order_release); // Publish
+                return true;
+            }
+        } else if (difference < 0) { // Ring full: the drain task is behind
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else { // Another writer claimed this position
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Logger::pop(LogRecord& record) {
+    Slot& slot = slots[tail & (LOG_QUEUE_SIZE - 1)];
+    uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != tail + 1) return false; // Empty, or the writer has not published yet
+
+    record = slot.record;
+    slot.sequence.store(tail + LOG_QUEUE_SIZE, std::memory_order_release); // Free for the next lap
+    tail++;
+    return true;
+}
+
+void Logger::format(const LogRecord& record) {
+    const char* prefix = record.level == LOG_LEVEL_ERROR ? "ERROR: " : record.level == LOG_LEVEL_WARN ? "WARNING: " : "";
+    int length = snprintf(line, sizeof(line), "[%s] %s", moduleNames[record.module], prefix);
+    uint8_t arg = 0;
+
+    // Each conversion is formatted on its own with the argument type recorded at the call
+    for (const char* p = record.format; *p && length < (int)sizeof(line) - 1; ) {
+        if (*p != '%') {
+            line[length++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[length++] = '%';
+            p += 2;
+            continue;
+        }
+
+        char spec[16];
+        uint8_t specLength = 0;
+        do {
+            spec[specLength++] = *p++;
+        } while (*p && specLength < sizeof(spec) - 2 && !strchr("diouxXcsfFeEgGp", *p));
+        if (!*p) break;
+        char conversion = *p++;
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+
+        size_t space = sizeof(line) - length;
+        if (arg >= record.argCount) {
+            length += snprintf(line + length, space, "%s", spec); // Missing argument: shown as written
+            continue;
+        }
+        uint8_t type = record.types[arg];
+        const auto& value = record.args[arg++];
+        if (conversion == 's') {
+            length += snprintf(line + length, space, spec, type == LOG_ARG_STRING ? record.text + value.u : "?");
+        } else if (strchr("fFeEgG", conversion)) {
+            double number = type == LOG_ARG_FLOAT ? value.f : type == LOG_ARG_INT ? value.i : value.u;
+            length += snprintf(line + length, space, spec, number);
+        } else if (type == LOG_ARG_FLOAT) {
+            length += snprintf(line + length, space, spec, (int32_t)value.f);
+        } else {
+            length += snprintf(line + length, space, spec, value.u);
+        }
+    }
+
+    if (length > (int)sizeof(line) - 2) length = sizeof(line) - 2; // Truncated line
+    line[length++] = '\n';
+    Serial.write((const uint8_t*)line, length);
+}
+
+void Logger::drain() {
+    LogRecord record;
+    while (pop(record)) {
+        format(record);
+    }
+
+    uint32_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost != reportedDropped) {
+        Serial.printf("[LOG] WARNING: %lu records dropped\n", (unsigned long)(lost - reportedDropped));
+        reportedDropped = lost;
+    }
+}
+
+void Logger::task(void* parameter) {
+    Logger* self = static_cast<Logger*>(parameter);
+    for (;;) {
+        self->drain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_TASK_PERIOD_MS));
+    }
+}
+
+void Logger::set_level(LOG_MODULE module, uint8_t level) {
+    if (module < LOG_MODULE_COUNT && level <= LOG_LEVEL_DEBUG) levels[module] = level;
+}
+
+uint8_t Logger::get_level(LOG_MODULE module) const { return levels[module]; }
+
+bool Logger::find_module(const char* name, LOG_MODULE& module) {
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (strcasecmp(name, moduleNames[i]) == 0) {
+            module = (LOG_MODULE)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* Logger::get_module_name(LOG_MODULE module) {
+    return module < LOG_MODULE_COUNT ? moduleNames[module] : "?";
+}
+
+const char* Logger::get_level_name(uint8_t level) {
+    return level <= LOG_LEVEL_DEBUG ? levelNames[level] : "?";
+}
+
+bool Logger::parse_level(const char* name, uint8_t& level) {
+    for (uint8_t i = 0; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcasecmp(name, levelNames[i]) == 0) {
+            level = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t Logger::get_dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
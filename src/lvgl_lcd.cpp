@@ -158,7 +158,7 @@ void LVGL_LCD::close_main_menu() {
     }
 }
 
-void LVGL_LCD::create_cx_screen(int selection, String unit) {
+void LVGL_LCD::create_cx_screen(int selection, const char* unit) {
     // Normal style
     lv_style_init(&styleDigitNormal);
     lv_style_set_text_color(&styleDigitNormal, lv_color_black()); // Common black
@@ -298,11 +298,21 @@ void LVGL_LCD::create_cx_screen(int selection, String unit) {
     dutTemperature = create_button("°C", dutContainerRow3, false, COLOR_GRAY);
     lv_obj_set_flex_grow(dutTemperature, 1);
     // DUT Energy
-    dutEnergy = create_button("kJ", dutContainerRow3, false, COLOR_GRAY);
+    dutEnergy = create_button("Wh", dutContainerRow3, false, COLOR_GRAY);
     lv_obj_set_flex_grow(dutEnergy, 1);
+    // DUT Charge
+    dutCharge = create_button("Ah", dutContainerRow3, false, COLOR_GRAY);
+    lv_obj_set_flex_grow(dutCharge, 1);
+
+    // Rolling statistics (mean ± deviation and range of V and I)
+    dutStatistics = lv_label_create(dutContainer);
+    lv_obj_set_width(dutStatistics, lv_pct(100)); // Parent width
+    lv_obj_set_style_text_font(dutStatistics, FONT_S, 0);
+    lv_obj_set_style_text_align(dutStatistics, LV_TEXT_ALIGN_CENTER, 0); // Center text
+    lv_label_set_text(dutStatistics, "");
 }
 
-void LVGL_LCD::update_cx_screen(float current, int selection, String unit, float vDUT, float iDUT, int digitsBeforeDecimal, int totalDigits, String targetValueStr, bool output_active, bool is_modifying, float temperatureDUT, float energyDUT) {
+void LVGL_LCD::update_cx_screen(float current, int selection, const char* unit, float vDUT, float iDUT, int digitsBeforeDecimal, int totalDigits, String targetValueStr, bool output_active, bool is_modifying, float temperatureDUT, float energyWh, float chargeAh) {
     // Clean container before adding new digits
     lv_obj_clean(digits);
 
@@ -390,7 +400,7 @@ void LVGL_LCD::update_cx_screen(float current, int selection, String unit, float
 
     // Add Unit
     lv_obj_t* unitLabel = lv_label_create(digits);
-    lv_label_set_text(unitLabel, unit.c_str());
+    lv_label_set_text(unitLabel, unit);
     lv_obj_set_style_text_font(unitLabel, FONT_L, 0);
     lv_obj_add_style(unitLabel, &styleDigitNormal, LV_PART_MAIN); // Never highlighted
     lv_obj_set_style_pad_all(unitLabel, 0, 0); // Remove padding
@@ -443,8 +453,20 @@ void LVGL_LCD::update_cx_screen(float current, int selection, String unit, float
     lv_label_set_text(dutResistance, values.c_str());
     values = String(temperatureDUT, 1) + " °C";
     lv_label_set_text(dutTemperature, values.c_str());
-    values = String(energyDUT, 3) + " kJ";
+    values = String(energyWh, 3) + " Wh";
     lv_label_set_text(dutEnergy, values.c_str());
+    values = String(chargeAh, 3) + " Ah";
+    lv_label_set_text(dutCharge, values.c_str());
+}
+
+void LVGL_LCD::update_cx_statistics(const char* window, const WindowStatistics& voltage, const WindowStatistics& current) {
+    if (dutStatistics == nullptr) return; // CX screen not open
+
+    char text[96]; // snprintf: the LVGL formatter is built without float support
+    snprintf(text, sizeof(text), "%s: %.3f ±%.3f V (%.3f-%.3f)\n%s: %.3f ±%.3f A (%.3f-%.3f)",
+             window, voltage.mean, voltage.stddev, voltage.min, voltage.max,
+             window, current.mean, current.stddev, current.min, current.max);
+    lv_label_set_text(dutStatistics, text);
 }
 
 void LVGL_LCD::close_cx_screen(){
@@ -455,7 +477,7 @@ void LVGL_LCD::close_cx_screen(){
     inputTitle = nullptr;
     digits = nullptr;
     buttons = nullptr; outputButton = nullptr; backButton = nullptr; enable_status_indicator = nullptr;
-    dutContainer = nullptr; dutVoltage = nullptr; dutCurrent = nullptr; dutPower = nullptr; dutResistance = nullptr; dutTemperature = nullptr; dutEnergy = nullptr;
+    dutContainer = nullptr; dutVoltage = nullptr; dutCurrent = nullptr; dutPower = nullptr; dutResistance = nullptr; dutTemperature = nullptr; dutEnergy = nullptr; dutCharge = nullptr; dutStatistics = nullptr;
     dutContainerRow1 = nullptr; dutContainerRow2 = nullptr; dutContainerRow3 = nullptr;
     // Clear header pointers as they were children of inputScreen
     headerContainer = nullptr; 
@@ -576,6 +598,243 @@ void LVGL_LCD::close_settings_menu() {
     headerContainer = nullptr; //
 }
 
+void LVGL_LCD::create_calibration_screen() {
+    if (calibrationScreen != nullptr) return; // Already open
+
+    calibrationScreen = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(calibrationScreen, lv_disp_get_hor_res(NULL), lv_disp_get_ver_res(NULL));
+    lv_obj_align(calibrationScreen, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_pad_all(calibrationScreen, PADDING, 0);
+    lv_obj_set_flex_flow(calibrationScreen, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(calibrationScreen, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_START);
+    lv_obj_set_style_pad_gap(calibrationScreen, PADDING, 0);
+
+    // Header
+    create_header(calibrationScreen);
+    create_section_header("Calibration", calibrationScreen, COLOR1_DARK);
+
+    // Status and progress
+    calibrationStatusLabel = lv_label_create(calibrationScreen);
+    lv_label_set_text(calibrationStatusLabel, "Waiting for web interface");
+    lv_obj_set_style_text_font(calibrationStatusLabel, FONT_S, 0);
+    lv_obj_set_width(calibrationStatusLabel, lv_pct(100));
+
+    calibrationProgressLabel = lv_label_create(calibrationScreen);
+    lv_label_set_text(calibrationProgressLabel, "Point: -/-");
+    lv_obj_set_style_text_font(calibrationProgressLabel, FONT_S, 0);
+    lv_obj_set_width(calibrationProgressLabel, lv_pct(100));
+
+    // Raw readings
+    calibrationVoltage = create_button("V", calibrationScreen, false, COLOR_GRAY);
+    lv_obj_set_width(calibrationVoltage, lv_pct(100));
+    calibrationCurrent = create_button("A", calibrationScreen, false, COLOR_GRAY);
+    lv_obj_set_width(calibrationCurrent, lv_pct(100));
+
+    // Back button
+    calibrationBackButton = create_button("Abort / Back", calibrationScreen, true, COLOR1_DARK);
+    lv_obj_set_style_text_color(calibrationBackButton, lv_color_white(), 0);
+    lv_obj_set_width(calibrationBackButton, lv_pct(100));
+}
+
+void LVGL_LCD::update_calibration_screen(const char* status, int completedPoints, int totalPoints, float vDUT, float iDUT) {
+    if (calibrationScreen == nullptr) return;
+    lv_label_set_text(calibrationStatusLabel, status);
+    lv_label_set_text_fmt(calibrationProgressLabel, "Point: %d/%d", completedPoints, totalPoints);
+    String values = String(vDUT, CV_DIGITS_AFTER_DECIMAL + 1) + " V";
+    lv_label_set_text(calibrationVoltage, values.c_str());
+    values = String(iDUT, CC_DIGITS_AFTER_DECIMAL + 1) + " A";
+    lv_label_set_text(calibrationCurrent, values.c_str());
+}
+
+void LVGL_LCD::close_calibration_screen() {
+    if (calibrationScreen == nullptr) return;
+    lv_obj_del(calibrationScreen);
+    calibrationScreen = nullptr;
+    calibrationStatusLabel = nullptr;
+    calibrationProgressLabel = nullptr;
+    calibrationVoltage = nullptr;
+    calibrationCurrent = nullptr;
+    calibrationBackButton = nullptr;
+    headerContainer = nullptr;
+    fanLabel = nullptr;
+    uptimeLabel = nullptr;
+}
+
+void LVGL_LCD::create_battery_screen() {
+    if (batteryScreen != nullptr) return; // Already open
+
+    batteryScreen = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(batteryScreen, lv_disp_get_hor_res(NULL), lv_disp_get_ver_res(NULL));
+    lv_obj_align(batteryScreen, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_pad_all(batteryScreen, PADDING, 0);
+    lv_obj_set_flex_flow(batteryScreen, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(batteryScreen, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_START);
+    lv_obj_set_style_pad_gap(batteryScreen, PADDING, 0);
+
+    // Header
+    create_header(batteryScreen);
+    create_section_header("Battery Test", batteryScreen, COLOR1_DARK);
+
+    // Status and elapsed time
+    batteryStatusLabel = lv_label_create(batteryScreen);
+    lv_label_set_text(batteryStatusLabel, "Waiting for web interface");
+    lv_obj_set_style_text_font(batteryStatusLabel, FONT_S, 0);
+    lv_obj_set_width(batteryStatusLabel, lv_pct(100));
+
+    batteryTimeLabel = lv_label_create(batteryScreen);
+    lv_label_set_text(batteryTimeLabel, "Time: 00:00:00");
+    lv_obj_set_style_text_font(batteryTimeLabel, FONT_S, 0);
+    lv_obj_set_width(batteryTimeLabel, lv_pct(100));
+
+    // Capacity and readings
+    batteryCapacity = create_button("mAh", batteryScreen, false, COLOR_GRAY);
+    lv_obj_set_width(batteryCapacity, lv_pct(100));
+    batteryReadings = create_button("V", batteryScreen, false, COLOR_GRAY);
+    lv_obj_set_width(batteryReadings, lv_pct(100));
+
+    // Back button
+    batteryBackButton = create_button("Stop / Back", batteryScreen, true, COLOR1_DARK);
+    lv_obj_set_style_text_color(batteryBackButton, lv_color_white(), 0);
+    lv_obj_set_width(batteryBackButton, lv_pct(100));
+}
+
+void LVGL_LCD::update_battery_screen(const char* status, uint32_t elapsedMs, float capacityMah, float energyWh, float vDUT, float iDUT) {
+    if (batteryScreen == nullptr) return;
+    uint32_t seconds = elapsedMs / 1000;
+    lv_label_set_text(batteryStatusLabel, status);
+    lv_label_set_text_fmt(batteryTimeLabel, "Time: %02lu:%02lu:%02lu", (unsigned long)(seconds / 3600), (unsigned long)(seconds / 60 % 60), (unsigned long)(seconds % 60));
+    String values = String(capacityMah, 1) + " mAh  " + String(energyWh, 3) + " Wh";
+    lv_label_set_text(batteryCapacity, values.c_str());
+    values = String(vDUT, CV_DIGITS_AFTER_DECIMAL + 1) + " V  " + String(iDUT, CC_DIGITS_AFTER_DECIMAL + 1) + " A";
+    lv_label_set_text(batteryReadings, values.c_str());
+}
+
+void LVGL_LCD::close_battery_screen() {
+    if (batteryScreen == nullptr) return;
+    lv_obj_del(batteryScreen);
+    batteryScreen = nullptr;
+    batteryStatusLabel = nullptr;
+    batteryTimeLabel = nullptr;
+    batteryCapacity = nullptr;
+    batteryReadings = nullptr;
+    batteryBackButton = nullptr;
+    headerContainer = nullptr;
+    fanLabel = nullptr;
+    uptimeLabel = nullptr;
+}
+
+void LVGL_LCD::create_sweep_screen() {
+    if (sweepScreen != nullptr) return; // Already open
+
+    sweepScreen = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(sweepScreen, lv_disp_get_hor_res(NULL), lv_disp_get_ver_res(NULL));
+    lv_obj_align(sweepScreen, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_pad_all(sweepScreen, PADDING, 0);
+    lv_obj_set_flex_flow(sweepScreen, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(sweepScreen, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_START);
+    lv_obj_set_style_pad_gap(sweepScreen, PADDING, 0);
+
+    // Header
+    create_header(sweepScreen);
+    create_section_header("I-V Sweep", sweepScreen, COLOR1_DARK);
+
+    // Status and progress
+    sweepStatusLabel = lv_label_create(sweepScreen);
+    lv_label_set_text(sweepStatusLabel, "Waiting for web interface");
+    lv_obj_set_style_text_font(sweepStatusLabel, FONT_S, 0);
+    lv_obj_set_width(sweepStatusLabel, lv_pct(100));
+
+    sweepProgressLabel = lv_label_create(sweepScreen);
+    lv_label_set_text(sweepProgressLabel, "Point: -/-");
+    lv_obj_set_style_text_font(sweepProgressLabel, FONT_S, 0);
+    lv_obj_set_width(sweepProgressLabel, lv_pct(100));
+
+    // Live readings
+    sweepReadings = create_button("V", sweepScreen, false, COLOR_GRAY);
+    lv_obj_set_width(sweepReadings, lv_pct(100));
+
+    // Back button
+    sweepBackButton = create_button("Abort / Back", sweepScreen, true, COLOR1_DARK);
+    lv_obj_set_style_text_color(sweepBackButton, lv_color_white(), 0);
+    lv_obj_set_width(sweepBackButton, lv_pct(100));
+}
+
+void LVGL_LCD::update_sweep_screen(const char* status, int completedPoints, int totalPoints, float vDUT, float iDUT) {
+    if (sweepScreen == nullptr) return;
+    lv_label_set_text(sweepStatusLabel, status);
+    lv_label_set_text_fmt(sweepProgressLabel, "Point: %d/%d", completedPoints, totalPoints);
+    String values = String(vDUT, CV_DIGITS_AFTER_DECIMAL + 1) + " V  " + String(iDUT, CC_DIGITS_AFTER_DECIMAL + 1) + " A";
+    lv_label_set_text(sweepReadings, values.c_str());
+}
+
+void LVGL_LCD::close_sweep_screen() {
+    if (sweepScreen == nullptr) return;
+    lv_obj_del(sweepScreen);
+    sweepScreen = nullptr;
+    sweepStatusLabel = nullptr;
+    sweepProgressLabel = nullptr;
+    sweepReadings = nullptr;
+    sweepBackButton = nullptr;
+    headerContainer = nullptr;
+    fanLabel = nullptr;
+    uptimeLabel = nullptr;
+}
+
+void LVGL_LCD::create_mppt_screen() {
+    if (mpptScreen != nullptr) return; // Already open
+
+    mpptScreen = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(mpptScreen, lv_disp_get_hor_res(NULL), lv_disp_get_ver_res(NULL));
+    lv_obj_align(mpptScreen, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_pad_all(mpptScreen, PADDING, 0);
+    lv_obj_set_flex_flow(mpptScreen, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_flex_align(mpptScreen, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_START);
+    lv_obj_set_style_pad_gap(mpptScreen, PADDING, 0);
+
+    // Header
+    create_header(mpptScreen);
+    create_section_header("MPPT", mpptScreen, COLOR1_DARK);
+
+    // Status
+    mpptStatusLabel = lv_label_create(mpptScreen);
+    lv_label_set_text(mpptStatusLabel, "Waiting for web interface");
+    lv_obj_set_style_text_font(mpptStatusLabel, FONT_S, 0);
+    lv_obj_set_width(mpptStatusLabel, lv_pct(100));
+
+    // Power and readings
+    mpptPower = create_button("W", mpptScreen, false, COLOR_GRAY);
+    lv_obj_set_width(mpptPower, lv_pct(100));
+    mpptReadings = create_button("V", mpptScreen, false, COLOR_GRAY);
+    lv_obj_set_width(mpptReadings, lv_pct(100));
+
+    // Back button
+    mpptBackButton = create_button("Stop / Back", mpptScreen, true, COLOR1_DARK);
+    lv_obj_set_style_text_color(mpptBackButton, lv_color_white(), 0);
+    lv_obj_set_width(mpptBackButton, lv_pct(100));
+}
+
+void LVGL_LCD::update_mppt_screen(const char* status, float power, float powerRipple, float vDUT, float iDUT) {
+    if (mpptScreen == nullptr) return;
+    lv_label_set_text(mpptStatusLabel, status);
+    String values = String(power, CW_DIGITS_AFTER_DECIMAL + 1) + " W  (+/-" + String(powerRipple / 2, CW_DIGITS_AFTER_DECIMAL + 1) + ")";
+    lv_label_set_text(mpptPower, values.c_str());
+    values = String(vDUT, CV_DIGITS_AFTER_DECIMAL + 1) + " V  " + String(iDUT, CC_DIGITS_AFTER_DECIMAL + 1) + " A";
+    lv_label_set_text(mpptReadings, values.c_str());
+}
+
+void LVGL_LCD::close_mppt_screen() {
+    if (mpptScreen == nullptr) return;
+    lv_obj_del(mpptScreen);
+    mpptScreen = nullptr;
+    mpptStatusLabel = nullptr;
+    mpptPower = nullptr;
+    mpptReadings = nullptr;
+    mpptBackButton = nullptr;
+    headerContainer = nullptr;
+    fanLabel = nullptr;
+    uptimeLabel = nullptr;
+}
+
 void LVGL_LCD::show_warning_popup(const String& message, uint32_t timeout_ms) {
     // Create a modal container (centered, with adaptive height)
     lv_obj_t* popup = lv_obj_create(lv_scr_act());
@@ -3,6 +3,7 @@
 /* ------- Global Variables ------- */
 WebServerESP32 webServer(SSID.c_str(), PASSWORD.c_str());
 
+EventQueue events;
 Encoder encoder = Encoder();
 BuiltInLed led = BuiltInLed();
 I2C i2c = I2C();
@@ -14,26 +15,31 @@ Fan fan(PWM_FAN_PIN, EN_FAN_PIN, LOCK_FAN_PIN);
 PIDFanController pidController(fan, PID_KP, PID_KI, PID_KD);
 RTC rtc = RTC();
 I2CScanner scanner;
-FSM fsm = FSM();
+Calibration calibration = Calibration();
+BatteryTest batteryTest = BatteryTest();
+IvSweep ivSweep = IvSweep();
+MpptTracker mpptTracker = MpptTracker();
+StopConditions stopConditions = StopConditions();
+SoaLimiter soaLimiter = SoaLimiter();
+FastTrip fastTrip = FastTrip();
+FSM fsm(dac, analogSws, calibration, batteryTest, ivSweep, mpptTracker, stopConditions, soaLimiter, fastTrip, encoder, events);
+Sequencer sequencer = Sequencer();
+SafetySupervisor safety = SafetySupervisor();
+BlackBox blackBox = BlackBox();
+RollingStatistics rollingStats = RollingStatistics(); // Written by the control task only
+Distribution distribution = Distribution();
+BroadcastScheduler broadcastScheduler(BROADCAST_INTERVAL);
+SampleStream sampleStream = SampleStream();
 
 
 // --- Global Variables for State Management ---
-float input = 0.0;
-float dutVoltage = 0.0; // Track DUT voltage
-float dutCurrent = 0.0; // Track DUT current
-float dutPower = 0.0;   // Track DUT power
-float dutResistance = 0.0; // Track DUT resistance
-float dutEnergy = 0.0;  // Track DUT energy
-
-bool outputActive = false; // Track output state
-float temperature = 0.0;   // Track temperature
-int fanSpeed = 0;          // Get current fan speed percentage
-
-uint64_t timeMs = 0;       // Track RTC time
+Measurements measurements = {};   // UI task copy of the latest control task snapshot
 String uptimeString = "00:00:00"; // Track uptime string
 
-// --- Global Variables for WS/UI Sync ---
-bool wsDeleteMainMenu = false; // Track if in main menu
+// --- Handoff between the control and UI tasks ---
+QueueHandle_t measurementsMailbox = nullptr; // Length 1, overwritten by the control task every period
+QueueHandle_t safetyAlertQueue = nullptr;    // Safety trips waiting for the UI task
+QueueHandle_t statisticsMailbox = nullptr;   // Length 1, overwritten by the control task every CONTROL_STATISTICS_DIVIDER periods
 
 // Helper function to format uptime
 String format_uptime(uint64_t ms) {
@@ -54,6 +60,7 @@ String format_uptime(uint64_t ms) {
 
 void setup() {
   Serial.begin(115200);
+  logger.init(); // Drains LOG_* records to the serial port from a low-priority task
 
   Serial.println("[MAIN] Starting Electronic Load System...");
   Serial.println("[MAIN] Firmware Version: " + String(FIRMWARE_VERSION));
@@ -73,7 +80,7 @@ void setup() {
 
   // Initialize encoder
   Serial.println("[MAIN] Initializing encoder...");
-  encoder.init();
+  encoder.init(&events);
   // Initialize builtin led
   Serial.println("[MAIN] Initializing built-in LED...");
   led.init();
@@ -87,8 +94,16 @@ void setup() {
   // Initialize I2C devices
   Serial.println("[MAIN] Initializing I2C devices...");
   i2c.init();
-  dac.init(&i2c);
-  adc.init(&i2c);
+  dac.init(&i2c, &calibration);
+  adc.init(&i2c, &calibration);
+  // Load calibration tables (needs SPIFFS)
+  Serial.println("[MAIN] Loading calibration...");
+  calibration.init(&dac, &adc, &analogSws);
+  // Load the last battery test result (needs SPIFFS)
+  Serial.println("[MAIN] Loading battery test result...");
+  batteryTest.init(&dac, &analogSws, &soaLimiter);
+  ivSweep.init(&dac, &analogSws, &soaLimiter);
+  mpptTracker.init(&dac, &analogSws, &soaLimiter);
   // Initialize RTC
   Serial.println("[MAIN] Initializing RTC...");
   rtc.init(&i2c);
@@ -107,107 +122,322 @@ void setup() {
   Serial.println("[MAIN] Initializing fan control and PID controller...");
   pidController.init(PID_SETPOINT); // Set target temperature for fan
   fan.set_speed(0); // Set initial speed to 0
+  // Tabulate the MOSFET safe operating area before any load mode runs
+  Serial.println("[MAIN] Initializing SOA limiter...");
+  soaLimiter.init();
   // Initialize FSM
   Serial.println("[MAIN] Initializing Finite State Machine...");
   fsm.init();
+  // Load the stored test program (needs SPIFFS)
+  Serial.println("[MAIN] Loading test sequence...");
+  sequencer.init(&fsm);
+  // Restore the index of the recorded safety trips
+  Serial.println("[MAIN] Initializing black box recorder...");
+  blackBox.init(&rtc);
 
   // Start web server and WebSocket
   Serial.println("[MAIN] Starting web server and WebSocket...");
   webServer.set_default_file("index.html");
   webServer.attachWsHandler(on_ws_event); // Attach the WebSocket handler
+  webServer.on("/sequence", HTTP_POST, handle_sequence_upload, handle_sequence_body); // Script upload
+  webServer.on("/blackbox", HTTP_GET, handle_blackbox_request); // Recorded safety trips
+  webServer.on("/profile", HTTP_GET, handle_profile_request); // Loop stage timings
+  webServer.on("/distribution", HTTP_GET, handle_distribution_request); // V and I quantiles and histograms
+  webServer.on("/telemetry/schema", HTTP_GET, handle_telemetry_schema_request); // Field table of the state messages
   webServer.begin();
 
   // Initial relay state
   analogSws.relay_dut_disable();
-  outputActive = false; // Ensure output is off
+
+  // Start the safety supervisor before anything can enable the output
+  Serial.println("[MAIN] Starting safety supervisor...");
+  safetyAlertQueue = xQueueCreate(SAFETY_ALERT_QUEUE_LENGTH, sizeof(SafetyAlert));
+  SafetyLimits limits = {SAFETY_MAX_VOLTAGE, SAFETY_MAX_CURRENT, SAFETY_MAX_POWER, SAFETY_MAX_TEMPERATURE,
+                         SAFETY_DEFAULT_MARGIN, SAFETY_DEFAULT_MARGIN, SAFETY_DEFAULT_MARGIN, SAFETY_DEFAULT_MARGIN};
+  safety.init(&dac, &analogSws, &fsm, &fastTrip, &blackBox, safetyAlertQueue, limits);
+  // Arm the hardware over-current trip (ADS1115 comparator on the ALERT pin)
+  Serial.println("[MAIN] Arming over-current trip...");
+  fastTrip.init(&adc, &safety, SAFETY_MAX_CURRENT * (1 + SAFETY_DEFAULT_MARGIN));
+
+  // Start tasks: control on the application core at high priority, UI next to the Wi-Fi stack
+  Serial.println("[MAIN] Starting control and UI tasks...");
+  measurementsMailbox = xQueueCreate(1, sizeof(Measurements));
+  Measurements initial = {};
+  xQueueOverwrite(measurementsMailbox, &initial);
+  statisticsMailbox = xQueueCreate(1, sizeof(StatisticsSnapshot));
+  StatisticsSnapshot initialStatistics = {};
+  xQueueOverwrite(statisticsMailbox, &initialStatistics);
+  xTaskCreatePinnedToCore(control_task, "control", CONTROL_TASK_STACK, nullptr, CONTROL_TASK_PRIORITY, nullptr, CONTROL_TASK_CORE);
+  xTaskCreatePinnedToCore(ui_task, "ui", UI_TASK_STACK, nullptr, UI_TASK_PRIORITY, nullptr, UI_TASK_CORE);
   Serial.println("[MAIN] System initialization completed successfully");
 }
 
 void loop() {
-  // Handle WebSocket clients
-  webServer.cleanupClients(); // Important for AsyncWebServer
+  vTaskDelete(nullptr); // All work runs in control_task() and ui_task()
+}
 
-  // Update all global variables
-  fanSpeed = fan.get_speed_percentage(); // Get current fan speed percentage
-  temperature = adc.read_temperature(); // Read temperature from ADC
-  dutVoltage = adc.read_v_dut(); // Read DUT voltage
-  dutCurrent = adc.read_i_dut(); // Read DUT current
-  dutPower = dutVoltage * dutCurrent; // Calculate DUT power
-  dutResistance = (dutCurrent != 0) ? (dutVoltage / dutCurrent) : 0; // Calculate DUT resistance
+void control_task(void* parameter) {
+  const TickType_t period = pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS);
+  TickType_t lastWake = xTaskGetTickCount();
+
+  Measurements m = {};
+  uint32_t cycle = 0;
+  FSM_MAIN_STATES lastState = FSM_MAIN_STATES::INITAL;
+  EnergyIntegrator integrator;
+  StatisticsSnapshot statistics;
+  uint32_t lastTripCount = safety.get_trip_count();
+
+  // Timing statistics over the current window
+  int64_t lastStartUs = 0;
+  int32_t maxLateUs = 0, maxEarlyUs = 0;
+  uint32_t maxExecUs = 0, overruns = 0, cycles = 0;
+  int64_t windowStartUs = esp_timer_get_time();
+
+  for (;;) {
+    vTaskDelayUntil(&lastWake, period);
+    int64_t startUs = esp_timer_get_time();
+
+    // Period jitter: deviation of the wake-up interval from the nominal period
+    if (lastStartUs != 0) {
+      int32_t deviation = (int32_t)(startUs - lastStartUs) - CONTROL_TASK_PERIOD_MS * 1000;
+      if (deviation > maxLateUs) maxLateUs = deviation;
+      if (-deviation > maxEarlyUs) maxEarlyUs = -deviation;
+    }
+    lastStartUs = startUs;
+    PROFILE_BEGIN(cycleStart);
 
-  // Safety monitoring - check if DUT readings exceed safe levels
-  check_safety_limits();
+    // Measure
+    if (cycle++ % CONTROL_TEMPERATURE_DIVIDER == 0) { // Slow signal
+      PROFILE_SCOPE(PROFILE_ADC_TEMPERATURE);
+      m.temperature = adc.read_temperature();
+    }
+    { PROFILE_SCOPE(PROFILE_ADC_VOLTAGE); m.voltage = adc.read_v_dut(); }
+    { PROFILE_SCOPE(PROFILE_ADC_CURRENT); m.current = adc.read_i_dut(); }
+    int64_t sampleUs = esp_timer_get_time();
+    m.power = m.voltage * m.current;
+    m.resistance = (m.current != 0) ? (m.voltage / m.current) : 0;
+    m.fanSpeed = fan.get_speed_percentage();
+
+    // Pre-trip history, recorded first so a tripping sample is the last one in the ring
+    blackBox.record({(uint32_t)sampleUs, m.voltage, m.current, m.temperature, fsm.get_setpoint(), fsm.is_output_active()});
+    sampleStream.push({(uint32_t)sampleUs, m.voltage, m.current});
+
+    // Safety monitoring - the supervisor preempts this task and checks the sample right away
+    { PROFILE_SCOPE(PROFILE_SAFETY); safety.submit({m.voltage, m.current, m.power, m.temperature, sampleUs}); }
+    if (safety.get_trip_count() != lastTripCount) {
+      lastTripCount = safety.get_trip_count();
+      sequencer.abort("Safety trip");
+    }
 
-  lcd.update();
-  lcd.update_header(temperature, fanSpeed, uptimeString.c_str()); // Update header with temperature, fan speed, and uptime
+    // Test sequence steps post their requests before the FSM drains them
+    { PROFILE_SCOPE(PROFILE_SEQUENCER); sequencer.run(m.voltage, m.current, m.temperature); }
 
-  // Store previous state to detect changes
-  FSM_MAIN_STATES prevState = fsm.get_current_state();
-  float prevInput = input;
-  bool prevOutputActive = outputActive;
+    // Allowed-power envelope for this period, used by the FSM to clamp CC/CR/CW
+    soaLimiter.update(m.temperature, m.voltage, m.current);
 
-  // Run FSM which might change state or apply 'input'
-  fsm.run(input, dac, analogSws, &outputActive, adc);
+    // Apply state transitions, setpoint and relay
+    { PROFILE_SCOPE(PROFILE_FSM_CONTROL); fsm.run_control(m.voltage, m.current, sampleUs); }
 
-  // Compute and adjust fan speed based on temperature
-  pidController.compute(temperature);
+    // Compute and adjust fan speed based on temperature
+    { PROFILE_SCOPE(PROFILE_PID); pidController.compute(m.temperature); }
 
-  unsigned long lastBroadcastTime = 0;
+    // Energy, charge and output time over every sample, reset on every state change
+    FSM_MAIN_STATES state = fsm.get_current_state();
+    if (state != lastState || state == FSM_MAIN_STATES::MAIN_MENU) {
+      integrator.reset();
+      rollingStats.reset_session();
+      distribution.reset();
+      lastState = state;
+    }
+    integrator.add_sample(m.voltage, m.current, sampleUs, fsm.is_output_active());
+    m.energyJ = integrator.get_energy_j();
+    m.energyWh = integrator.get_energy_wh();
+    m.chargeC = integrator.get_charge_c();
+    m.chargeAh = integrator.get_charge_ah();
+    m.outputTimeMs = integrator.get_active_ms();
+
+    // Rolling min/max/mean/deviation of every channel, published a few times per second, and the V/I distributions
+    {
+      PROFILE_SCOPE(PROFILE_STATISTICS);
+      rollingStats.add_sample(m.voltage, m.current, m.power, m.temperature);
+      distribution.add_sample(m.voltage, m.current);
+      if (cycle % CONTROL_STATISTICS_DIVIDER == 0) {
+        rollingStats.get_snapshot(statistics);
+        xQueueOverwrite(statisticsMailbox, &statistics);
+      }
+    }
 
-  // Broadcast state periodically or if changed
-  unsigned long currentTime = millis();
-  bool stateChanged = (fsm.get_current_state() != prevState) ||
-                      (input != prevInput) ||
-                      (outputActive != prevOutputActive);
+    // Discipline the cached wall clock; the RTC shares the I2C bus with the ADC and DAC
+    if (cycle % CONTROL_RTC_DIVIDER == 0) rtc.sync();
 
-  // Log state changes
-  if (fsm.get_current_state() != prevState) {
-    Serial.printf("[MAIN] FSM state changed from %d to %d\n", prevState, fsm.get_current_state());
-  }
-  
-  if (outputActive != prevOutputActive) {
-    Serial.printf("[MAIN] Output state changed: %s\n", outputActive ? "ENABLED" : "DISABLED");
-  }
+    xQueueOverwrite(measurementsMailbox, &m);
+    PROFILE_END(cycleStart, PROFILE_CONTROL_CYCLE);
 
-  if (stateChanged || (currentTime - lastBroadcastTime >= BROADCAST_INTERVAL)) {
-    broadcast_state();
-    lastBroadcastTime = currentTime;
-  }
+    uint32_t execUs = esp_timer_get_time() - startUs;
+    if (execUs > maxExecUs) maxExecUs = execUs;
+    if (execUs > CONTROL_TASK_PERIOD_MS * 1000) overruns++;
+    cycles++;
 
-  if (wsDeleteMainMenu) {
-    Serial.println("[MAIN] Closing CX screen due to WebSocket request");
-    lcd.close_cx_screen(); // Close CX screen if in main menu, moved here because it was taking too long to close
-    wsDeleteMainMenu = false; // Reset the flag
+    if (startUs - windowStartUs >= CONTROL_STATS_INTERVAL_MS * 1000LL) {
+      LOG_I(LOG_CONTROL, "%lu cycles @ %dms - jitter +%ld/-%ld us, max exec %lu us, overruns %lu",
+                    (unsigned long)cycles, CONTROL_TASK_PERIOD_MS, (long)maxLateUs, (long)maxEarlyUs,
+                    (unsigned long)maxExecUs, (unsigned long)overruns);
+      maxLateUs = maxEarlyUs = 0;
+      maxExecUs = overruns = cycles = 0;
+      windowStartUs = startUs;
+    }
   }
+}
 
-  static uint64_t lastMillis = 0;
-  static uint64_t lastStatusLog = 0;
-  uint64_t currentMillis = rtc.get_timestamp_ms();
-  
-  // Periodic system status logging (every 30 seconds)
-  if (currentMillis - lastStatusLog >= 30000) {
-    Serial.printf("[STATUS] Temp: %.1f°C, Fan: %d%%, V: %.3fV, I: %.3fA, P: %.3fW\n", 
-                  temperature, fanSpeed, dutVoltage, dutCurrent, dutPower);
-    lastStatusLog = currentMillis;
-  }
-  
-  if (currentMillis - lastMillis >= 1000) { // Update every second
-    lastMillis = currentMillis;
-    if (outputActive) {
-      dutEnergy += dutPower / 1000; // Update DUT energy
-      timeMs += 1000;
-      uptimeString = format_uptime(timeMs); // Format uptime string
+void ui_task(void* parameter) {
+  unsigned long lastStatusLog = 0;
+  SEQ_STATUS prevSeqStatus = sequencer.get_status();
+  uint32_t prevSeqLogCount = sequencer.get_log_count();
+  uint32_t prevStopRevision = stopConditions.get_revision();
+  uint32_t prevStopFireCount = stopConditions.get_fire_count();
+  FSM_MAIN_STATES prevState = fsm.get_current_state();
+  float prevInput = fsm.get_setpoint();
+  bool prevOutputActive = fsm.is_output_active();
+
+  for (;;) {
+    PROFILE_BEGIN(passStart);
+
+    // Handle WebSocket clients
+    webServer.cleanupClients(); // Important for AsyncWebServer
+
+    // Commands typed on the serial monitor
+    handle_serial_input();
+
+    // Latest snapshot from the control task
+    measurements = get_measurements();
+    uptimeString = format_uptime(measurements.outputTimeMs);
+
+    // Shutdowns by the safety supervisor (limits, hardware over-current, stalled control task)
+    SafetyAlert alert;
+    while (xQueueReceive(safetyAlertQueue, &alert, 0) == pdTRUE) {
+      // Show warning on LCD if in CX mode
+      if (fsm.get_current_state() >= FSM_MAIN_STATES::CC && fsm.get_current_state() <= FSM_MAIN_STATES::CW) {
+        lcd.show_warning_popup("Safety limit: " + String(alert.message), 5000);
+      }
+      broadcastScheduler.request(BROADCAST_URGENT);
+      webServer.notifyClients(get_safety_json());
+    }
+
+    // Frozen black box histories are written here, away from the shutdown path
+    if (blackBox.save_pending()) {
+      webServer.notifyClients(get_blackbox_json());
+    }
+
+    // Fitted or reset calibration tables are written here, away from the control task
+    if (calibration.save_pending()) {
+      webServer.notifyClients(get_calibration_json());
+    }
+
+    // Results of finished battery tests are written here, away from the control task
+    if (batteryTest.save_pending()) {
+      webServer.notifyClients(get_battery_json());
+    }
+
+    // Stop conditions: list changes and hits
+    if (stopConditions.get_fire_count() != prevStopFireCount) {
+      prevStopFireCount = stopConditions.get_fire_count();
+      int8_t fired = stopConditions.get_fired_index();
+      if (fired >= 0 && fsm.get_current_state() >= FSM_MAIN_STATES::CC && fsm.get_current_state() <= FSM_MAIN_STATES::CW) {
+        const StopCondition& condition = stopConditions.get_condition(fired);
+        lcd.show_warning_popup("Stop: " + String(StopConditions::get_variable_name(condition.variable)) +
+                               (condition.sign > 0 ? " > " : " < ") + String(condition.threshold, 3), 5000);
+      }
+      webServer.notifyClients(get_stops_json());
+    }
+    if (stopConditions.get_revision() != prevStopRevision) {
+      prevStopRevision = stopConditions.get_revision();
+      webServer.notifyClients(get_stops_json());
     }
+
+    // Sequencer progress: status changes and LOG messages
+    if (sequencer.get_status() != prevSeqStatus || sequencer.get_log_count() != prevSeqLogCount) {
+      prevSeqStatus = sequencer.get_status();
+      prevSeqLogCount = sequencer.get_log_count();
+      webServer.notifyClients(get_sequence_json());
+    }
+
+    // Finished I-V curves are pushed as one binary frame
+    size_t frameSize;
+    const uint8_t* frame = ivSweep.take_frame(frameSize);
+    if (frame) {
+      webServer.notifyClientsBinary(frame, frameSize);
+    }
+
+    // Subscribed V/I sample streams; slow clients lose batches instead of holding up the others
+    sampleStream.service([](uint32_t clientId, const uint8_t* data, size_t length) {
+      return webServer.try_send_binary(clientId, data, length, STREAM_MAX_QUEUED_FRAMES);
+    });
+
+    { PROFILE_SCOPE(PROFILE_LCD_UPDATE); lcd.update(); }
+    {
+      PROFILE_SCOPE(PROFILE_LCD_HEADER);
+      lcd.update_header(measurements.temperature, measurements.fanSpeed, uptimeString.c_str()); // Update header with temperature, fan speed, and uptime
+    }
+
+    // Run the screen of the current state; its requests are applied by the control task
+    { PROFILE_SCOPE(PROFILE_FSM_UI); fsm.run_ui(); }
+    FSM_MAIN_STATES state = fsm.get_current_state();
+    float input = fsm.get_setpoint();
+    bool outputActive = fsm.is_output_active();
+
+    // Mode and output changes go out on this pass, setpoint changes at the scheduler's rate
+    unsigned long currentTime = millis();
+    if (state != prevState || outputActive != prevOutputActive) {
+      broadcastScheduler.request(BROADCAST_URGENT);
+    } else if (input != prevInput) {
+      broadcastScheduler.request();
+    }
+
+    // Log state changes
+    if (state != prevState) {
+      LOG_I(LOG_MAIN, "FSM state changed from %d to %d", (int)prevState, (int)state);
+    }
+
+    if (outputActive != prevOutputActive) {
+      LOG_I(LOG_MAIN, "Output state changed: %s", outputActive ? "ENABLED" : "DISABLED");
+    }
+
+    if (broadcastScheduler.poll(currentTime)) {
+      PROFILE_SCOPE(PROFILE_BROADCAST);
+      broadcast_state();
+    }
+    prevState = state;
+    prevInput = input;
+    prevOutputActive = outputActive;
+
+    // Periodic system status logging (every 30 seconds)
+    if (currentTime - lastStatusLog >= 30000) {
+      Serial.printf("[STATUS] Temp: %.1f°C, Fan: %d%%, V: %.3fV, I: %.3fA, P: %.3fW, dropped events: %lu\n",
+                    measurements.temperature, measurements.fanSpeed, measurements.voltage, measurements.current, measurements.power,
+                    (unsigned long)events.get_dropped());
+      lastStatusLog = currentTime;
+    }
+    PROFILE_END(passStart, PROFILE_UI_CYCLE);
+
+    // Short delay to prevent busy-waiting
+    vTaskDelay(pdMS_TO_TICKS(UI_TASK_PERIOD_MS));
   }
-  // Short delay to prevent busy-waiting
-  delay(10);
+}
+
+Measurements get_measurements() {
+  Measurements m = {};
+  xQueuePeek(measurementsMailbox, &m, 0);
+  return m;
+}
+
+StatisticsSnapshot get_statistics() {
+  StatisticsSnapshot s = {};
+  xQueuePeek(statisticsMailbox, &s, 0);
+  return s;
 }
 
 void main_menu() {
-  static int pos = 0;
-  timeMs = 0.0; // Reset time when entering main menu
-  uptimeString = format_uptime(timeMs); // Format uptime string
-  dutEnergy = 0.0; // Reset DUT energy when entering main menu
+  static int pos = 0; // Energy and uptime are reset by the control task while in the menu
 
   if (fsm.has_changed()) { // First time entering main menu
     #ifdef DEBUG_ENCODER
@@ -233,17 +463,15 @@ void main_menu() {
   if (encoder.is_button_pressed()) {
     Serial.println("[MAIN_MENU] Button pressed - Main Menu Selection");
     fsm.change_state(static_cast<FSM_MAIN_STATES>(FSM_MAIN_STATES::CC + pos)); // Change to selected option
-    // Reset vars and close main menu
     Serial.println("[MAIN_MENU] Exiting main menu to option " + String(FSM_MAIN_STATES::CC + pos));
-    lcd.close_main_menu();
-    input = 0.0; // Reset input when changing mode
-    outputActive = false; // Ensure output is off
-    // No return here, let loop handle broadcast
+    // The menu is closed by main_menu_exit() once the FSM has left MAIN_MENU
   }
 
-  // If state changed relevant to WS, broadcast
-  // Note: FSM change is handled in loop(), but menu selection itself isn't broadcasted yet.
-  // We rely on the FSM state change broadcast in loop().
+  // The state change is broadcast by ui_task() once the control task has applied it
+}
+
+void main_menu_exit() {
+  lcd.close_main_menu();
 }
 
 void setting() {
@@ -260,11 +488,153 @@ void setting() {
   if (encoder.is_button_pressed()) {
     Serial.println("[SETTINGS] Button pressed - Back to Main Menu");
     fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Change to selected main menu
-    lcd.close_settings_menu();
   }
 
 }
 
+void setting_exit() {
+  lcd.close_settings_menu();
+}
+
+void calibration_menu() {
+  static CAL_STATUS lastStatus = CAL_IDLE;
+  static uint8_t lastCompleted = 0;
+
+  if (fsm.has_changed()) { // First time entering calibration (started from the web UI)
+    Serial.println("[CALIBRATION] Entering calibration screen");
+    encoder.set_min_position(0);
+    encoder.set_max_position(0);
+    encoder.set_position(0);
+    lcd.create_calibration_screen();
+  }
+
+  // The sweep itself is advanced by the FSM in the control task
+
+  // Check if encoder button is pressed
+  if (encoder.is_button_pressed()) {
+    Serial.println("[CALIBRATION] Button pressed - Back to Main Menu");
+    fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Leaving CALIBRATION aborts the sweep
+    return;
+  }
+
+  if (calibration.get_status() != lastStatus || calibration.get_completed_points() != lastCompleted) {
+    lastStatus = calibration.get_status();
+    lastCompleted = calibration.get_completed_points();
+    webServer.notifyClients(get_calibration_json());
+  }
+
+  lcd.update_calibration_screen(calibration.get_status_name(), calibration.get_completed_points(), calibration.get_point_count(), measurements.voltage, measurements.current);
+}
+
+void calibration_menu_exit() {
+  lcd.close_calibration_screen();
+}
+
+void battery_menu() {
+  static BAT_STATUS lastStatus = BAT_IDLE;
+  static unsigned long lastBroadcast = 0;
+
+  if (fsm.has_changed()) { // First time entering the battery test (started from the web UI)
+    Serial.println("[BATTERY] Entering battery test screen");
+    encoder.set_min_position(0);
+    encoder.set_max_position(0);
+    encoder.set_position(0);
+    lcd.create_battery_screen();
+  }
+
+  // The test itself is run by the FSM in the control task
+
+  // Check if encoder button is pressed
+  if (encoder.is_button_pressed()) {
+    Serial.println("[BATTERY] Button pressed - Back to Main Menu");
+    fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Leaving BATTERY stops the test
+    return;
+  }
+
+  unsigned long now = millis();
+  if (batteryTest.get_status() != lastStatus || (batteryTest.is_running() && now - lastBroadcast >= BATTERY_BROADCAST_INTERVAL)) {
+    lastStatus = batteryTest.get_status();
+    lastBroadcast = now;
+    webServer.notifyClients(get_battery_json());
+  }
+
+  lcd.update_battery_screen(batteryTest.get_status_name(), batteryTest.get_elapsed_ms(), batteryTest.get_capacity_mah(),
+                            batteryTest.get_energy_wh(), measurements.voltage, measurements.current);
+}
+
+void battery_menu_exit() {
+  lcd.close_battery_screen();
+}
+
+void sweep_menu() {
+  static IV_STATUS lastStatus = IV_IDLE;
+  static uint8_t lastCompleted = 0;
+
+  if (fsm.has_changed()) { // First time entering the sweep (started from the web UI)
+    Serial.println("[IV_SWEEP] Entering I-V sweep screen");
+    encoder.set_min_position(0);
+    encoder.set_max_position(0);
+    encoder.set_position(0);
+    lcd.create_sweep_screen();
+  }
+
+  // The sweep itself is advanced by the FSM in the control task
+
+  // Check if encoder button is pressed
+  if (encoder.is_button_pressed()) {
+    Serial.println("[IV_SWEEP] Button pressed - Back to Main Menu");
+    fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Leaving SWEEP aborts the sweep
+    return;
+  }
+
+  if (ivSweep.get_status() != lastStatus || ivSweep.get_completed_points() != lastCompleted) {
+    lastStatus = ivSweep.get_status();
+    lastCompleted = ivSweep.get_completed_points();
+    webServer.notifyClients(get_sweep_json());
+  }
+
+  lcd.update_sweep_screen(ivSweep.get_status_name(), ivSweep.get_completed_points(), ivSweep.get_point_count(), measurements.voltage, measurements.current);
+}
+
+void sweep_menu_exit() {
+  lcd.close_sweep_screen();
+}
+
+void mppt_menu() {
+  static MPPT_STATUS lastStatus = MPPT_IDLE;
+  static unsigned long lastBroadcast = 0;
+
+  if (fsm.has_changed()) { // First time entering MPPT (started from the web UI)
+    Serial.println("[MPPT] Entering MPPT screen");
+    encoder.set_min_position(0);
+    encoder.set_max_position(0);
+    encoder.set_position(0);
+    lcd.create_mppt_screen();
+  }
+
+  // Tracking itself runs in the control task
+
+  // Check if encoder button is pressed
+  if (encoder.is_button_pressed()) {
+    Serial.println("[MPPT] Button pressed - Back to Main Menu");
+    fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Leaving MPPT stops tracking
+    return;
+  }
+
+  unsigned long now = millis();
+  if (mpptTracker.get_status() != lastStatus || now - lastBroadcast >= MPPT_BROADCAST_INTERVAL) {
+    lastStatus = mpptTracker.get_status();
+    lastBroadcast = now;
+    webServer.notifyClients(get_mppt_json());
+  }
+
+  lcd.update_mppt_screen(mpptTracker.get_status_name(), mpptTracker.get_power(), mpptTracker.get_power_ripple(), measurements.voltage, measurements.current);
+}
+
+void mppt_menu_exit() {
+  lcd.close_mppt_screen();
+}
+
 int get_digit_value(int selected_item, int digitsBeforeDecimal, int digitsAfterDecimal, float input) {
   int digit_value = 0;
   if (selected_item < digitsBeforeDecimal) { // Before decimal point
@@ -277,7 +647,7 @@ int get_digit_value(int selected_item, int digitsBeforeDecimal, int digitsAfterD
   return digit_value;
 }
 
-void constant_x(String unit, int digitsBeforeDecimal, int digitsAfterDecimal, int totalDigits, int maxInputValue) {
+void constant_x(const char* unit, int digitsBeforeDecimal, int digitsAfterDecimal, int totalDigits, float maxInputValue) {
   enum CX_EDIT_STATES {
     SELECTING_ITEM,
     MODIFYING_DIGIT
@@ -285,16 +655,12 @@ void constant_x(String unit, int digitsBeforeDecimal, int digitsAfterDecimal, in
 
   static int selected_item = 0;
   static CX_EDIT_STATES edit_state = CX_EDIT_STATES::SELECTING_ITEM;
+  float input = fsm.get_setpoint();
 
   if (fsm.has_changed()) {
-    timeMs = 0.0;
-    uptimeString = format_uptime(timeMs);
-    dutEnergy = 0.0;
     encoder.set_position(0);
     selected_item = 0;
     edit_state = CX_EDIT_STATES::SELECTING_ITEM;
-    input = 0.0;
-    outputActive = false;
     encoder.set_min_position(0);
     encoder.set_max_position(totalDigits + 1);
     lcd.create_cx_screen(selected_item, unit);
@@ -313,18 +679,11 @@ void constant_x(String unit, int digitsBeforeDecimal, int digitsAfterDecimal, in
           encoder.set_max_position(1); // positive increases
           Serial.println("[CX_MODE] Starting modify digit " + String(selected_item));
         } else if (selected_item == totalDigits) {
-          outputActive = !outputActive;
-          if (outputActive) {
-            Serial.println("[CX_MODE] Output activated: " + String(input, digitsAfterDecimal));
-          } else {
-            Serial.println("[CX_MODE] Output deactivated");
-          }
+          fsm.toggle_output();
+          Serial.println("[CX_MODE] Output toggle requested at " + String(input, digitsAfterDecimal));
         } else {
           Serial.println("[CX_MODE] Exiting CX mode");
-          fsm.change_state(FSM_MAIN_STATES::MAIN_MENU);
-          input = 0.0;
-          outputActive = false;
-          lcd.close_cx_screen();
+          fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // The screen is closed by constant_x_exit()
           return;
         }
         break;
@@ -350,51 +709,55 @@ void constant_x(String unit, int digitsBeforeDecimal, int digitsAfterDecimal, in
         break;
       case CX_EDIT_STATES::MODIFYING_DIGIT: {
         int encValue = encoder.get_position(); // can be -1, 0, or 1
-        input += encValue * pow(10, digitsBeforeDecimal - selected_item - 1); // Adjust input based on selected item
+        float step = encValue * pow(10, digitsBeforeDecimal - selected_item - 1); // Adjust input based on selected item
         encoder.set_position(0); // Reset encoder position
         encoder.set_position(0); // Twice to also reset has_changed
-        
-        if (input < 0) input = 0;
 
-        Serial.println("[CX_MODE] Digit " + String(selected_item) + " changed | New Value: " + String(input));
+        if (input + step > maxInputValue) { // The FSM clamps the setpoint, only warn here
+          Serial.println("[CX_MODE] Input clamped to max value: " + String(maxInputValue));
+          lcd.show_warning_popup("Input limit: " + String(maxInputValue) + unit, 2000);
+        }
+        fsm.adjust_setpoint(step);
+
+        Serial.println("[CX_MODE] Digit " + String(selected_item) + " changed by " + String(step));
         break;
       }
     }
   }
 
-  if (input > maxInputValue) {
-    input = maxInputValue;
-    Serial.println("[CX_MODE] Input clamped to max value: " + String(maxInputValue));
-    lcd.show_warning_popup("Input limit: " + String(maxInputValue) + unit, 2000);
-  }
+  lcd.update_cx_screen(input, selected_item, unit, measurements.voltage, measurements.current, digitsBeforeDecimal, totalDigits, String(input, digitsAfterDecimal), fsm.is_output_active(), (edit_state == CX_EDIT_STATES::MODIFYING_DIGIT), measurements.temperature, measurements.energyWh, measurements.chargeAh);
+  StatisticsSnapshot statistics = get_statistics();
+  lcd.update_cx_statistics("10 s", statistics.values[STAT_VOLTAGE][STAT_WINDOW_10S], statistics.values[STAT_CURRENT][STAT_WINDOW_10S]);
+}
 
-  lcd.update_cx_screen(input, selected_item, unit, dutVoltage, dutCurrent, digitsBeforeDecimal, totalDigits, String(input, digitsAfterDecimal), outputActive, (edit_state == CX_EDIT_STATES::MODIFYING_DIGIT), temperature, dutEnergy);
+void constant_x_exit() {
+  lcd.close_cx_screen();
 }
 
 // --- WebSocket Handler ---
 void on_ws_event(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
   switch (type) {
     case WS_EVT_CONNECT: {
-      Serial.printf("[WEBSOCKET] Client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+      LOG_I(LOG_WEBSOCKET, "Client #%u connected from %s", client->id(), client->remoteIP().toString().c_str());
       // Send current state to the newly connected client
       client->text(get_current_state_json());
       break;
     case WS_EVT_DISCONNECT:
-      Serial.printf("[WEBSOCKET] Client #%u disconnected\n", client->id());
+      LOG_I(LOG_WEBSOCKET, "Client #%u disconnected", client->id());
+      sampleStream.unsubscribe(client->id());
       break;
     case WS_EVT_DATA:
       AwsFrameInfo *info = (AwsFrameInfo*)arg;
       if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
         data[len] = 0; // Null-terminate
-        Serial.printf("[WEBSOCKET] Received message from client #%u: %s\n", client->id(), (char*)data);
+        LOG_D(LOG_WEBSOCKET, "Received message from client #%u: %s", client->id(), (char*)data);
 
         // Parse JSON command
-        StaticJsonDocument<256> doc; // Adjust size as needed
+        JsonDocument doc;
         DeserializationError error = deserializeJson(doc, (char*)data);
 
         if (error) {
-          Serial.print("[WEBSOCKET] ERROR: deserializeJson() failed: ");
-          Serial.println(error.f_str());
+          LOG_E(LOG_WEBSOCKET, "deserializeJson() failed: %s", error.c_str());
           client->text("{\"error\":\"Invalid JSON\"}");
           return;
         }
@@ -420,155 +783,716 @@ void handle_ws_command(AsyncWebSocketClient *client, JsonDocument& doc) {
   }
 
   if (strcmp(command, "getMeasurements") == 0) handle_get_measurements(client);
+  else if (strcmp(command, "telemetry") == 0) handle_telemetry_format(client, doc);
+  else if (strcmp(command, "streamStart") == 0) handle_stream_start(client, doc);
+  else if (strcmp(command, "streamStop") == 0) handle_stream_stop(client);
   else if (strcmp(command, "setMode") == 0) handle_set_mode(doc);
   else if (strcmp(command, "setValue") == 0) handle_set_value(doc);
   else if (strcmp(command, "setRelay") == 0) handle_set_relay(doc);
   else if (strcmp(command, "exit") == 0) handle_exit();
+  else if (strcmp(command, "calStart") == 0) handle_cal_start(client, doc);
+  else if (strcmp(command, "calReference") == 0) handle_cal_reference(client, doc);
+  else if (strcmp(command, "calFit") == 0) handle_cal_fit(client, doc);
+  else if (strcmp(command, "calAbort") == 0) fsm.abort_calibration();
+  else if (strcmp(command, "calReset") == 0) {
+    if (calibration.is_running()) client->text("{\"error\":\"Cannot reset calibration while sweeping\"}");
+    else fsm.reset_calibration(); // The UI task broadcasts the status once the file is deleted
+  }
+  else if (strcmp(command, "getCalibration") == 0) client->text(get_calibration_json());
+  else if (strcmp(command, "batStart") == 0) handle_bat_start(client, doc);
+  else if (strcmp(command, "batStop") == 0) fsm.stop_battery_test();
+  else if (strcmp(command, "getBattery") == 0) client->text(get_battery_json());
+  else if (strcmp(command, "sweepStart") == 0) handle_sweep_start(client, doc);
+  else if (strcmp(command, "sweepAbort") == 0) fsm.abort_sweep();
+  else if (strcmp(command, "mpptStart") == 0) handle_mppt_start(client, doc);
+  else if (strcmp(command, "getMppt") == 0) client->text(get_mppt_json());
+  else if (strcmp(command, "stopSet") == 0) handle_stop_set(client, doc);
+  else if (strcmp(command, "getStops") == 0) client->text(get_stops_json());
+  else if (strcmp(command, "seqStart") == 0) {
+    if (fsm.get_current_state() != FSM_MAIN_STATES::MAIN_MENU) client->text("{\"error\":\"Exit the current mode before running a sequence\"}");
+    else if (!sequencer.request_start()) client->text("{\"error\":\"No sequence loaded or already running\"}");
+  }
+  else if (strcmp(command, "seqStop") == 0) sequencer.request_stop();
+  else if (strcmp(command, "getSequence") == 0) client->text(get_sequence_json());
+  else if (strcmp(command, "safetySet") == 0) handle_safety_set(client, doc);
+  else if (strcmp(command, "getSafety") == 0) client->text(get_safety_json());
+  else if (strcmp(command, "getBlackbox") == 0) client->text(get_blackbox_json());
+  else if (strcmp(command, "getSweep") == 0) {
+    client->text(get_sweep_json());
+    size_t frameSize;
+    const uint8_t* frame = ivSweep.get_frame(frameSize);
+    if (frameSize > 0) client->binary(frame, frameSize); // Last finished curve
+  }
   else client->text("{\"error\":\"Unknown command\"}");
 
-  // After handling command, broadcast the updated state
-  broadcast_state();
+  // After handling command, broadcast the updated state from the UI task
+  broadcastScheduler.request();
 }
 
 void handle_get_measurements(AsyncWebSocketClient *client) {
   // Measurements are sent periodically via broadcastState,
   // but we can send an immediate update if requested.
-  client->text(get_current_state_json());
+  send_state(client);
+}
+
+void handle_telemetry_format(AsyncWebSocketClient *client, JsonDocument& doc) {
+  const char* format = doc["format"] | "json";
+  bool binary = strcmp(format, "binary") == 0;
+  if (!binary && strcmp(format, "json") != 0) {
+    client->text("{\"error\":\"Unknown telemetry format\"}");
+    return;
+  }
+  webServer.set_client_format(client->id(), binary ? WS_FORMAT_BINARY : WS_FORMAT_JSON);
+  LOG_I(LOG_WEBSOCKET, "Client #%u telemetry format: %s", client->id(), binary ? "binary" : "JSON");
+  send_state(client);
 }
 
 void handle_set_mode(JsonDocument& doc) {
   const char* modeStr = doc["value"];
   if (!modeStr) return;
 
-  Serial.printf("[WEBSOCKET] Setting mode to %s\n", modeStr);
+  LOG_I(LOG_WEBSOCKET, "Setting mode to %s", modeStr);
+  // The FSM transition table rejects mode changes during calibration
   if (strcmp(modeStr, "CC") == 0) fsm.change_state(FSM_MAIN_STATES::CC);
   else if (strcmp(modeStr, "CV") == 0) fsm.change_state(FSM_MAIN_STATES::CV);
   else if (strcmp(modeStr, "CR") == 0) fsm.change_state(FSM_MAIN_STATES::CR);
   else if (strcmp(modeStr, "CW") == 0) fsm.change_state(FSM_MAIN_STATES::CW);
-  // Reset input value when changing mode via WS
-  input = 0.0;
-  outputActive = false; // Turn off output when changing mode
-  // Update physical interface if necessary (e.g., LCD screen)
-  // Note: The FSM state change should trigger screen updates in the main loop
+  // Setpoint and output are reset when the control task enters the new mode; the UI task then switches screens
 }
 
 void handle_set_value(JsonDocument& doc) {
   if (!doc["value"].is<float>() && !doc["value"].is<int>()) return;
   float newValue = doc["value"];
-  Serial.printf("[WEBSOCKET] Setting value to %.3f\n", newValue);
-  input = newValue;
+  LOG_I(LOG_WEBSOCKET, "Setting value to %.3f", newValue);
+  fsm.set_setpoint(newValue); // Clamped to the limit of the mode by the FSM
 }
 
 void handle_set_relay(JsonDocument& doc) {
   if (!doc["value"].is<bool>()) return;
   
-  outputActive = doc["value"];
-  Serial.printf("[WEBSOCKET] Setting relay %s\n", outputActive ? "ON" : "OFF");
-  if (outputActive) analogSws.relay_dut_enable();
-  else analogSws.relay_dut_disable();
+  bool active = doc["value"];
+  LOG_I(LOG_WEBSOCKET, "Setting relay %s", active ? "ON" : "OFF");
+  fsm.set_output_active(active); // Relay is switched by the FSM
+}
+
+void handle_cal_start(AsyncWebSocketClient *client, JsonDocument& doc) {
+  if (fsm.get_current_state() != FSM_MAIN_STATES::MAIN_MENU) { // Only reachable from the main menu
+    client->text("{\"error\":\"Exit the current mode before calibrating\"}");
+    return;
+  }
+
+  const char* modeStr = doc["mode"];
+  CAL_MODE mode = (modeStr && strcmp(modeStr, "CV") == 0) ? CAL_MODE_CV : CAL_MODE_CC;
+  int points = doc["points"] | 0; // Range-checked before it is narrowed to uint8_t
+  float maxValue = doc["max"] | 0.0f;
+
+  if (points < CAL_MIN_POINTS || points > CAL_MAX_POINTS || !Calibration::is_valid_sweep(mode, points, maxValue)) {
+    client->text("{\"error\":\"Invalid calibration sweep\"}");
+    return;
+  }
+  fsm.start_calibration(mode, points, maxValue); // Started and entered by the control task
+}
+
+void handle_bat_start(AsyncWebSocketClient *client, JsonDocument& doc) {
+  if (fsm.get_current_state() != FSM_MAIN_STATES::MAIN_MENU) { // Only reachable from the main menu
+    client->text("{\"error\":\"Exit the current mode before a battery test\"}");
+    return;
+  }
+
+  const char* modeStr = doc["mode"];
+  BAT_MODE mode = (modeStr && strcmp(modeStr, "CW") == 0) ? BAT_MODE_CW : BAT_MODE_CC;
+  float value = doc["value"] | 0.0f;
+  float cutoff = doc["cutoff"] | 0.0f;
+
+  if (!BatteryTest::is_valid_test(mode, value, cutoff)) {
+    client->text("{\"error\":\"Invalid battery test\"}");
+    return;
+  }
+  fsm.start_battery_test(mode, value, cutoff); // Started and entered by the control task
+}
+
+void handle_sweep_start(AsyncWebSocketClient *client, JsonDocument& doc) {
+  if (fsm.get_current_state() != FSM_MAIN_STATES::MAIN_MENU) { // Only reachable from the main menu
+    client->text("{\"error\":\"Exit the current mode before an I-V sweep\"}");
+    return;
+  }
+
+  const char* modeStr = doc["mode"];
+  IV_MODE mode = (modeStr && strcmp(modeStr, "CV") == 0) ? IV_MODE_CV : IV_MODE_CC;
+  float startValue = doc["start"] | 0.0f;
+  float stopValue = doc["stop"] | 0.0f;
+  int points = doc["points"] | 0;
+
+  if (points < IV_MIN_POINTS || points > IV_MAX_POINTS || !IvSweep::is_valid_sweep(mode, startValue, stopValue, points)) {
+    client->text("{\"error\":\"Invalid I-V sweep\"}");
+    return;
+  }
+  fsm.start_sweep(mode, startValue, stopValue, points); // Started and entered by the control task
+}
+
+void handle_mppt_start(AsyncWebSocketClient *client, JsonDocument& doc) {
+  if (fsm.get_current_state() != FSM_MAIN_STATES::MAIN_MENU) { // Only reachable from the main menu
+    client->text("{\"error\":\"Exit the current mode before MPPT\"}");
+    return;
+  }
+
+  const char* algorithmStr = doc["algorithm"];
+  MPPT_ALGORITHM algorithm = (algorithmStr && strcmp(algorithmStr, "INC") == 0) ? MPPT_INCREMENTAL_CONDUCTANCE : MPPT_PERTURB_OBSERVE;
+  float step = doc["step"] | 0.0f;
+  float maxCurrent = doc["max"] | 0.0f;
+
+  if (!MpptTracker::is_valid(algorithm, step, maxCurrent)) {
+    client->text("{\"error\":\"Invalid MPPT parameters\"}");
+    return;
+  }
+  fsm.start_mppt(algorithm, step, maxCurrent); // Started and entered by the control task
+}
+
+void handle_stop_set(AsyncWebSocketClient *client, JsonDocument& doc) {
+  JsonArray list = doc["conditions"];
+  if (list.isNull() || list.size() > STOP_MAX_CONDITIONS) {
+    client->text("{\"error\":\"Invalid stop condition list\"}");
+    return;
+  }
+
+  // Validate the whole list before replacing the current one
+  STOP_VARIABLE variables[STOP_MAX_CONDITIONS];
+  char comparisons[STOP_MAX_CONDITIONS];
+  float thresholds[STOP_MAX_CONDITIONS];
+  uint8_t count = 0;
+  for (JsonVariant entry : list) {
+    JsonArray item = entry.as<JsonArray>();
+    const char* name = item[0];
+    const char* comparison = item[1];
+    uint8_t variable = STOP_VAR_COUNT;
+    for (uint8_t v = 0; name && v < STOP_VAR_COUNT; v++) {
+      if (strcmp(name, StopConditions::get_variable_name((STOP_VARIABLE)v)) == 0) variable = v;
+    }
+    if (!comparison || !item[2].is<float>() ||
+        !StopConditions::is_valid((STOP_VARIABLE)variable, comparison[0]) || comparison[1] != 0) {
+      client->text("{\"error\":\"Invalid stop condition\"}");
+      return;
+    }
+    variables[count] = (STOP_VARIABLE)variable;
+    comparisons[count] = comparison[0];
+    thresholds[count] = item[2];
+    count++;
+  }
+
+  // Applied in order by the control task
+  fsm.clear_stop_conditions();
+  for (uint8_t i = 0; i < count; i++) {
+    fsm.add_stop_condition(variables[i], comparisons[i], thresholds[i]);
+  }
+}
+
+void handle_safety_set(AsyncWebSocketClient *client, JsonDocument& doc) {
+  // Missing fields stay NAN and are kept; the supervisor merges the change into the applied limits
+  SafetyLimits changes = {
+    doc["voltage"] | NAN,
+    doc["current"] | NAN,
+    doc["power"] | NAN,
+    doc["temperature"] | NAN,
+    doc["voltageMargin"] | NAN,
+    doc["currentMargin"] | NAN,
+    doc["powerMargin"] | NAN,
+    doc["temperatureMargin"] | NAN,
+  };
+
+  // Limits can only be tightened below the hardware ratings
+  const float maxima[4] = {SAFETY_MAX_VOLTAGE, SAFETY_MAX_CURRENT, SAFETY_MAX_POWER, SAFETY_MAX_TEMPERATURE};
+  const float values[4] = {changes.maxVoltage, changes.maxCurrent, changes.maxPower, changes.maxTemperature};
+  const float margins[4] = {changes.voltageMargin, changes.currentMargin, changes.powerMargin, changes.temperatureMargin};
+  for (uint8_t i = 0; i < 4; i++) {
+    if ((!isnan(values[i]) && !(values[i] > 0 && values[i] <= maxima[i])) ||
+        (!isnan(margins[i]) && !(margins[i] >= 0 && margins[i] <= SAFETY_MAX_MARGIN))) {
+      client->text("{\"error\":\"Invalid safety limits\"}");
+      return;
+    }
+  }
+  safety.update_limits(changes); // Applied by the supervisor task, which also re-arms the fast trip
+  LOG_I(LOG_WEBSOCKET, "Safety limits update requested");
+}
+
+// Script bodies may arrive in several chunks; only the AsyncTCP task touches these
+static char sequenceSource[SEQ_MAX_SOURCE_SIZE];
+static size_t sequenceSourceLength = 0;
+static bool sequenceSourceTooLarge = false;
+
+void handle_sequence_body(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (index == 0) {
+    sequenceSourceLength = 0;
+    sequenceSourceTooLarge = total > SEQ_MAX_SOURCE_SIZE;
+  }
+  if (sequenceSourceTooLarge || index + len > SEQ_MAX_SOURCE_SIZE) return;
+  memcpy(&sequenceSource[index], data, len);
+  sequenceSourceLength = index + len;
+}
+
+void handle_sequence_upload(AsyncWebServerRequest *request) {
+  if (sequenceSourceTooLarge) {
+    request->send(413, "application/json", "{\"error\":\"Script too large\"}");
+    return;
+  }
+  if (!sequencer.compile(sequenceSource, sequenceSourceLength)) {
+    request->send(400, "application/json", get_sequence_json());
+    return;
+  }
+  if (!sequencer.save()) {
+    Serial.println("[SEQUENCER] ERROR: Failed to save program to " SEQ_PROGRAM_PATH);
+  }
+  request->send(200, "application/json", get_sequence_json());
+  webServer.notifyClients(get_sequence_json());
+}
+
+void handle_blackbox_request(AsyncWebServerRequest *request) {
+  if (!request->hasParam("trip")) {
+    request->send(200, "application/json", get_blackbox_json());
+    return;
+  }
+
+  char path[24];
+  uint32_t number = request->getParam("trip")->value().toInt();
+  if (!blackBox.get_trip_path(number, path)) {
+    request->send(404, "application/json", "{\"error\":\"Trip not stored\"}");
+    return;
+  }
+  request->send(SPIFFS, path, "text/csv", true); // Sent as a download
+}
+
+void handle_profile_request(AsyncWebServerRequest *request) {
+  if (request->hasParam("reset")) {
+    profiler.reset();
+  }
+  request->send(200, "application/json", get_profile_json());
+}
+
+void handle_distribution_request(AsyncWebServerRequest *request) {
+  if (request->hasParam("reset")) {
+    distribution.reset();
+  }
+
+  static const char* const channelNames[DIST_CHANNEL_COUNT] = {"voltage", "current"};
+  static const char* const quantileNames[DIST_QUANTILE_COUNT] = {"p50", "p95", "p99", "p999"};
+  JsonDocument doc;
+  DistributionSnapshot snapshot;
+  for (uint8_t c = 0; c < DIST_CHANNEL_COUNT; c++) {
+    distribution.get_snapshot((DIST_CHANNEL)c, snapshot);
+    JsonObject channel = doc[channelNames[c]].to<JsonObject>();
+    channel["count"] = snapshot.count;
+    channel["min"] = snapshot.min;
+    channel["max"] = snapshot.max;
+    for (uint8_t q = 0; q < DIST_QUANTILE_COUNT; q++) {
+      channel[quantileNames[q]] = snapshot.quantiles[q];
+    }
+    if (!snapshot.histogramReady) continue; // Range not placed yet
+
+    JsonObject histogram = channel["histogram"].to<JsonObject>();
+    histogram["low"] = snapshot.histogramLow;
+    histogram["width"] = snapshot.binWidth;
+    histogram["underflow"] = snapshot.underflow;
+    histogram["overflow"] = snapshot.overflow;
+    JsonArray bins = histogram["bins"].to<JsonArray>();
+    for (uint8_t b = 0; b < DIST_HISTOGRAM_BINS; b++) bins.add(snapshot.bins[b]);
+  }
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  request->send(200, "application/json", jsonString);
+}
+
+void handle_serial_input() {
+  static char line[48];
+  static uint8_t length = 0;
+
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (length < sizeof(line) - 1) line[length++] = c;
+      continue;
+    }
+    if (length == 0) continue;
+    line[length] = '\0';
+    length = 0;
+
+    if (strcmp(line, "profile") == 0) {
+      profiler.print_report();
+    } else if (strcmp(line, "profile reset") == 0) {
+      profiler.reset();
+      Serial.println("[PROFILE] Statistics cleared");
+    } else if (strcmp(line, "broadcast") == 0) {
+      broadcastScheduler.print_report();
+      webServer.print_fanout_report();
+    } else if (strcmp(line, "broadcast reset") == 0) {
+      broadcastScheduler.reset_stats();
+      webServer.reset_fanout_stats();
+      Serial.println("[BROADCAST] Counters cleared");
+    } else if (strncmp(line, "broadcast rate ", 15) == 0) {
+      int hz = atoi(line + 15);
+      if (broadcastScheduler.set_max_rate(hz > 0 && hz <= 255 ? hz : 0)) {
+        Serial.printf("[BROADCAST] Max rate set to %d Hz\n", hz);
+      } else {
+        Serial.printf("[BROADCAST] Rate must be %d to %d Hz\n", BROADCAST_MIN_RATE_HZ, BROADCAST_MAX_RATE_HZ);
+      }
+    } else if (strncmp(line, "log", 3) == 0 && (line[3] == '\0' || line[3] == ' ')) {
+      handle_log_command(line + 3);
+    } else {
+      Serial.printf("[MAIN] Unknown serial command: %s\n", line);
+    }
+  }
+}
+
+void handle_log_command(const char* args) {
+  char moduleName[16], levelName[8];
+  if (sscanf(args, "%15s %7s", moduleName, levelName) == 2) {
+    LOG_MODULE module;
+    uint8_t level;
+    if (!Logger::find_module(moduleName, module) || !Logger::parse_level(levelName, level)) {
+      Serial.println("[LOG] Usage: log <module> <none|error|warn|info|debug>");
+      return;
+    }
+    logger.set_level(module, level);
+  }
+
+  for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+    Serial.printf("[LOG] %-11s %s\n", Logger::get_module_name((LOG_MODULE)i), Logger::get_level_name(logger.get_level((LOG_MODULE)i)));
+  }
+  Serial.printf("[LOG] Compiled up to %s, %lu records dropped\n", Logger::get_level_name(LOG_LEVEL_MAX), (unsigned long)logger.get_dropped());
+}
+
+void handle_stream_start(AsyncWebSocketClient *client, JsonDocument& doc) {
+  int decimation = doc["decimation"] | 1; // Range-checked before they are narrowed
+  int batch = doc["batch"] | 10;
+  if (decimation < 1 || decimation > STREAM_MAX_DECIMATION || batch < 1 || batch > STREAM_MAX_BATCH) {
+    client->text("{\"error\":\"Invalid stream parameters\"}");
+    return;
+  }
+  if (!sampleStream.subscribe(client->id(), decimation, batch)) {
+    client->text("{\"error\":\"Too many stream subscribers\"}");
+    return;
+  }
+  uint16_t rateHz = 1000 / CONTROL_TASK_PERIOD_MS / decimation;
+  LOG_I(LOG_WEBSOCKET, "Client #%u streaming V/I, decimation %u, %u samples per frame", client->id(), decimation, batch);
+  client->text("{\"stream\":{\"active\":true,\"decimation\":" + String(decimation) + ",\"batch\":" + String(batch) +
+               ",\"rateHz\":" + String(rateHz) + "}}");
+}
+
+void handle_stream_stop(AsyncWebSocketClient *client) {
+  uint32_t dropped = sampleStream.unsubscribe(client->id());
+  client->text("{\"stream\":{\"active\":false,\"dropped\":" + String(dropped) + "}}");
+}
+
+void handle_cal_reference(AsyncWebSocketClient *client, JsonDocument& doc) {
+  if (!doc["index"].is<int>() || (!doc["value"].is<float>() && !doc["value"].is<int>())) return;
+  if (!calibration.set_reference(doc["index"].as<int>(), doc["value"].as<float>())) {
+    client->text("{\"error\":\"Invalid reference value\"}");
+    return;
+  }
+  client->text(get_calibration_json());
+}
+
+void handle_cal_fit(AsyncWebSocketClient *client, JsonDocument& doc) {
+  uint8_t degree = doc["degree"] | 1;
+  if (calibration.get_status() != CAL_DONE) {
+    client->text("{\"error\":\"No completed calibration sweep to fit\"}");
+    return;
+  }
+  fsm.fit_calibration(degree); // The control task swaps the tables, the UI task saves and broadcasts them
 }
 
 void handle_exit() {
-  Serial.println("[WEBSOCKET] Exiting current mode to Main Menu");
-  fsm.change_state(FSM_MAIN_STATES::MAIN_MENU);
-  input = 0.0;
-  outputActive = false;
-  analogSws.relay_dut_disable(); // Physically disable the relay
-  wsDeleteMainMenu = true; // Set flag to close main menu
-  broadcast_state(); // Broadcast the state after exiting
+  LOG_I(LOG_WEBSOCKET, "Exiting current mode to Main Menu");
+  fsm.change_state(FSM_MAIN_STATES::MAIN_MENU); // Exit handlers abort calibration and disable the relay
+  // The UI task broadcasts the mode change as soon as it sees it
 }
 
 
 // --- State Management ---
 String get_current_state_json() {
-  StaticJsonDocument<512> doc; // Adjust size as needed
-
-  // Measurements
-  JsonObject measurements = doc.createNestedObject("measurements");
-  measurements["voltage"] = dutVoltage;
-  measurements["current"] = dutCurrent;
-  measurements["power"] = dutPower;
-  measurements["resistance"] = dutResistance; // Assuming kOhm, adjust if needed
-  measurements["temperature"] = temperature;
-  measurements["fanSpeed"] = fanSpeed;
-  measurements["uptime"] = uptimeString; // Uptime string
-  measurements["energy"] = dutEnergy; // Energy in kJ
-
-  // State
-  JsonObject state = doc.createNestedObject("state");
-  const char* modeStr = "UNKNOWN";
-  switch (fsm.get_current_state()) {
-    case FSM_MAIN_STATES::MAIN_MENU: modeStr = "MENU"; break; // Or handle differently
-    case FSM_MAIN_STATES::CC: modeStr = "CC"; break;
-    case FSM_MAIN_STATES::CV: modeStr = "CV"; break;
-    case FSM_MAIN_STATES::CR: modeStr = "CR"; break;
-    case FSM_MAIN_STATES::CW: modeStr = "CW"; break;
-    case FSM_MAIN_STATES::SETTINGS: modeStr = "SETTINGS"; break; // Add if needed
-  }
-  state["mode"] = modeStr;
-  state["outputActive"] = outputActive;
-  state["value"] = input;
+  TelemetryFrame frame;
+  build_telemetry_frame(frame);
+  char json[TELEMETRY_JSON_MAX_SIZE];
+  if (telemetry_write_json(frame, json, sizeof(json)) == 0) {
+    LOG_E(LOG_WEBSOCKET, "State JSON larger than %u bytes", (unsigned)TELEMETRY_JSON_MAX_SIZE);
+    return "{}";
+  }
+  return String(json);
+}
+
+void handle_telemetry_schema_request(AsyncWebServerRequest *request) {
+  // The schema is constant: written once, then served from flash-like static storage
+  static char schema[TELEMETRY_SCHEMA_MAX_SIZE];
+  static size_t length = telemetry_write_schema(schema, sizeof(schema));
+  request->send(request->beginResponse(200, "application/json", (const uint8_t*)schema, length));
+}
+
+String get_calibration_json() {
+  JsonDocument doc;
+
+  JsonObject cal = doc["calibration"].to<JsonObject>();
+  cal["status"] = calibration.get_status_name();
+  cal["mode"] = calibration.get_mode() == CAL_MODE_CC ? "CC" : "CV";
+  cal["stored"] = calibration.is_stored();
+  cal["completed"] = calibration.get_completed_points();
+  cal["total"] = calibration.get_point_count();
+
+  JsonArray points = cal["points"].to<JsonArray>();
+  for (uint8_t i = 0; i < calibration.get_completed_points(); i++) {
+    const CalPoint& point = calibration.get_point(i);
+    JsonObject p = points.add<JsonObject>();
+    p["code"] = point.code;
+    p["voltage"] = point.rawVoltage;
+    p["current"] = point.rawCurrent;
+    if (point.hasReference) p["reference"] = point.reference;
+  }
 
   String jsonString;
   serializeJson(doc, jsonString);
   return jsonString;
 }
 
-void broadcast_state() {
-  webServer.notifyClients(get_current_state_json());
+String get_sweep_json() {
+  JsonDocument doc;
+
+  JsonObject sweep = doc["sweep"].to<JsonObject>();
+  sweep["status"] = ivSweep.get_status_name();
+  sweep["mode"] = ivSweep.get_mode() == IV_MODE_CC ? "CC" : "CV";
+  sweep["completed"] = ivSweep.get_completed_points();
+  sweep["total"] = ivSweep.get_point_count();
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_stops_json() {
+  JsonDocument doc;
+
+  JsonObject stops = doc["stops"].to<JsonObject>();
+  JsonArray list = stops["conditions"].to<JsonArray>();
+  for (uint8_t i = 0; i < stopConditions.get_count(); i++) {
+    const StopCondition& condition = stopConditions.get_condition(i);
+    JsonArray item = list.add<JsonArray>();
+    item.add(StopConditions::get_variable_name(condition.variable));
+    item.add(condition.sign > 0 ? ">" : "<");
+    item.add(condition.threshold);
+  }
+  stops["fired"] = stopConditions.get_fired_index();
+  stops["firedValue"] = stopConditions.get_fired_value();
+  stops["elapsed"] = stopConditions.get_elapsed_s();
+  stops["Ah"] = stopConditions.get_charge_ah();
+  stops["dVdt"] = stopConditions.get_dvdt();
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
 }
 
-// --- Safety Monitoring ---
-bool check_safety_limits() {
-  bool limitExceeded = false;
-  String alertMessage = "";
+String get_safety_json() {
+  JsonDocument doc;
+
+  JsonObject obj = doc["safety"].to<JsonObject>();
+  SafetyLimits limits = safety.get_limits();
+  JsonObject limitsObj = obj["limits"].to<JsonObject>();
+  limitsObj["voltage"] = limits.maxVoltage;
+  limitsObj["current"] = limits.maxCurrent;
+  limitsObj["power"] = limits.maxPower;
+  limitsObj["temperature"] = limits.maxTemperature;
+  JsonObject margins = obj["margins"].to<JsonObject>();
+  margins["voltage"] = limits.voltageMargin;
+  margins["current"] = limits.currentMargin;
+  margins["power"] = limits.powerMargin;
+  margins["temperature"] = limits.temperatureMargin;
+
+  obj["trips"] = safety.get_trip_count();
+  obj["checks"] = safety.get_check_count();
+  obj["maxCheckUs"] = safety.get_max_check_us();
+  obj["timeouts"] = safety.get_timeout_count();
+
+  SafetyLatency latency = safety.get_latency();
+  JsonObject latencyObj = obj["latency"].to<JsonObject>();
+  latencyObj["count"] = latency.count;
+  latencyObj["lastUs"] = latency.lastUs;
+  latencyObj["minUs"] = latency.count ? latency.minUs : 0;
+  latencyObj["maxUs"] = latency.maxUs;
+  latencyObj["meanUs"] = latency.count ? (uint32_t)(latency.totalUs / latency.count) : 0;
+
+  JsonObject fast = obj["fastTrip"].to<JsonObject>();
+  fast["limit"] = fastTrip.get_trip_current();
+  fast["trips"] = fastTrip.get_trip_count();
+  fast["detectUs"] = fastTrip.get_detect_us();
+  fast["relayUs"] = fastTrip.get_relay_us();
+  fast["dacUs"] = fastTrip.get_dac_us();
+  fast["maxDacUs"] = fastTrip.get_max_dac_us();
 
-  // Check voltage limit
-  if (dutVoltage > SAFETY_MAX_VOLTAGE * 1.1) { // 10% margin
-    limitExceeded = true;
-    alertMessage = String(SAFETY_MAX_VOLTAGE, 1) + "V";
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_profile_json() {
+  JsonDocument doc;
+
+  doc["cpuMHz"] = ESP.getCpuFreqMHz();
+  JsonArray stages = doc["stages"].to<JsonArray>();
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    if (!profiler.has_samples((PROFILE_STAGE)i)) continue;
+    const ProfileStats& stats = profiler.get_stats((PROFILE_STAGE)i);
+    JsonObject item = stages.add<JsonObject>();
+    item["name"] = Profiler::get_stage_name((PROFILE_STAGE)i);
+    item["count"] = stats.count;
+    item["minUs"] = Profiler::cycles_to_us(stats.minCycles);
+    item["avgUs"] = Profiler::cycles_to_us(stats.totalCycles / stats.count);
+    item["maxUs"] = Profiler::cycles_to_us(stats.maxCycles);
+
+    // Only the populated bucket range; bucket b holds durations of [2^b, 2^(b+1)) cycles
+    uint8_t first = 31 - __builtin_clz(stats.minCycles | 1);
+    uint8_t last = 31 - __builtin_clz(stats.maxCycles | 1);
+    item["histFirst"] = first;
+    JsonArray histogram = item["hist"].to<JsonArray>();
+    for (uint8_t b = first; b <= last; b++) histogram.add(stats.histogram[b]);
   }
-  
-  // Check current limit
-  if (dutCurrent > SAFETY_MAX_CURRENT * 1.1) { // 10% margin
-    limitExceeded = true;
-    alertMessage = String(SAFETY_MAX_CURRENT, 1) + "A";
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_blackbox_json() {
+  JsonDocument doc;
+
+  JsonObject obj = doc["blackbox"].to<JsonObject>();
+  JsonArray list = obj["trips"].to<JsonArray>();
+  for (uint8_t slot = 0; slot < BLACKBOX_MAX_TRIPS; slot++) {
+    const BlackBoxTrip& trip = blackBox.get_trip(slot);
+    if (trip.number == 0) continue;
+    JsonObject item = list.add<JsonObject>();
+    item["trip"] = trip.number;
+    item["time"] = trip.timestampMs;
+    item["samples"] = trip.samples;
+    item["reason"] = trip.reason;
   }
-  
-  // Check power limit
-  if (dutPower > SAFETY_MAX_POWER * 1.1) { // 10% margin
-    limitExceeded = true;
-    alertMessage = String(SAFETY_MAX_POWER, 1) + "W";
+  obj["pending"] = blackBox.is_frozen();
+  obj["dropped"] = blackBox.get_dropped_count();
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_sequence_json() {
+  JsonDocument doc;
+
+  JsonObject sequence = doc["sequence"].to<JsonObject>();
+  sequence["status"] = sequencer.get_status_name();
+  sequence["loaded"] = sequencer.is_loaded();
+  sequence["size"] = sequencer.get_code_size();
+  sequence["pc"] = sequencer.get_pc();
+  sequence["log"] = sequencer.get_last_log();
+  sequence["error"] = sequencer.get_error();
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_mppt_json() {
+  JsonDocument doc;
+
+  JsonObject tracker = doc["mppt"].to<JsonObject>();
+  tracker["status"] = mpptTracker.get_status_name();
+  tracker["algorithm"] = mpptTracker.get_algorithm() == MPPT_PERTURB_OBSERVE ? "PO" : "INC";
+  tracker["setpoint"] = mpptTracker.get_setpoint();
+  tracker["power"] = mpptTracker.get_power();
+  tracker["trackingMs"] = mpptTracker.get_tracking_ms(); // 0 until the MPP is reached
+  tracker["powerRipple"] = mpptTracker.get_power_ripple();
+  tracker["currentRipple"] = mpptTracker.get_current_ripple();
+  tracker["iterations"] = mpptTracker.get_iterations();
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+String get_battery_json() {
+  JsonDocument doc;
+
+  JsonObject bat = doc["battery"].to<JsonObject>();
+  bat["status"] = batteryTest.get_status_name();
+  bat["mode"] = batteryTest.get_mode() == BAT_MODE_CC ? "CC" : "CW";
+  bat["value"] = batteryTest.get_setpoint();
+  bat["cutoff"] = batteryTest.get_cutoff();
+  bat["elapsedMs"] = batteryTest.get_elapsed_ms();
+  bat["mAh"] = batteryTest.get_capacity_mah();
+  bat["Wh"] = batteryTest.get_energy_wh();
+
+  if (batteryTest.has_stored_result()) {
+    const BatteryResult& result = batteryTest.get_last_result();
+    JsonObject last = bat["last"].to<JsonObject>();
+    last["mode"] = result.mode == BAT_MODE_CC ? "CC" : "CW";
+    last["value"] = result.setpoint;
+    last["cutoff"] = result.cutoff;
+    last["elapsedMs"] = result.elapsedMs;
+    last["mAh"] = result.capacityMah;
+    last["Wh"] = result.energyWh;
+    last["endVoltage"] = result.endVoltage;
+    last["cutoffReached"] = result.status == BAT_DONE;
   }
-  
-  // Check temperature limit
-  if (temperature > SAFETY_MAX_TEMPERATURE * 1.1) { // 10% margin
-    limitExceeded = true;
-    alertMessage = String(SAFETY_MAX_TEMPERATURE, 1) + "°C";
-  }
-
-  if (limitExceeded && outputActive) {
-    Serial.println("[SAFETY] " + alertMessage);
-    Serial.println("[SAFETY] Emergency disconnect - DUT disabled for safety");
-    
-    // Immediately disable output and relay
-    outputActive = false;
-    analogSws.relay_dut_disable();
-    
-    // Set input to zero for safety
-    input = 0.0;
-    dac.cc_mode_set_current(0.0);
-    
-    // Show warning on LCD if in CX mode
-    if (fsm.get_current_state() >= FSM_MAIN_STATES::CC && fsm.get_current_state() <= FSM_MAIN_STATES::CW) {
-      lcd.show_warning_popup("Safety limit: " + alertMessage, 5000);
+
+  String jsonString;
+  serializeJson(doc, jsonString);
+  return jsonString;
+}
+
+static_assert(FSM_MAIN_STATES::FINAL + 1 == TELEMETRY_MODE_COUNT, "Telemetry mode names must cover FSM_MAIN_STATES");
+
+void build_telemetry_frame(TelemetryFrame& frame) {
+  Measurements m = get_measurements();
+  StatisticsSnapshot statistics = get_statistics();
+
+  frame.magic[0] = 'T';
+  frame.magic[1] = 'M';
+  frame.schema = TELEMETRY_SCHEMA_ID;
+  frame.state = fsm.get_current_state();
+  frame.flags = (fsm.is_output_active() ? TELEMETRY_FLAG_OUTPUT_ACTIVE : 0) | (soaLimiter.is_limiting() ? TELEMETRY_FLAG_SOA_LIMITING : 0);
+  frame.fanSpeed = m.fanSpeed;
+  frame.reserved = 0;
+  frame.outputTimeMs = m.outputTimeMs;
+  frame.setpoint = fsm.get_setpoint();
+  frame.voltage = m.voltage;
+  frame.current = m.current;
+  frame.power = m.power;
+  frame.resistance = m.resistance;
+  frame.temperature = m.temperature;
+  frame.energyJ = m.energyJ;
+  frame.energyWh = m.energyWh;
+  frame.chargeC = m.chargeC;
+  frame.chargeAh = m.chargeAh;
+  frame.soaAllowed = soaLimiter.get_allowed_power();
+  frame.soaJunction = soaLimiter.get_junction_temperature();
+  for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+    for (uint8_t w = 0; w < STAT_WINDOW_COUNT; w++) {
+      const WindowStatistics& value = statistics.values[c][w];
+      frame.statistics[c][w][0] = value.min;
+      frame.statistics[c][w][1] = value.max;
+      frame.statistics[c][w][2] = value.mean;
+      frame.statistics[c][w][3] = value.stddev;
     }
-    
-    // Broadcast updated state
-    broadcast_state();
-    
-    return true;
   }
-  
-  return false;
-}
\ No newline at end of file
+}
+
+void send_state(AsyncWebSocketClient *client) {
+  if (webServer.get_client_format(client->id()) == WS_FORMAT_BINARY) {
+    // Binary clients hold a delta baseline, which only the UI task updates
+    webServer.request_keyframe(client->id());
+    broadcastScheduler.request(BROADCAST_URGENT);
+  } else {
+    client->text(get_current_state_json());
+  }
+}
+
+void broadcast_state() {
+  TelemetryFrame frame;
+  build_telemetry_frame(frame);
+  webServer.notifyClientsState(frame);
+}
@@ -0,0 +1,170 @@
+#include "mppt.h"
+#include "dac.h"
+#include "analog_sws.h"
+#include "soa.h"
+
+MpptTracker::MpptTracker()
+    : dac(nullptr), sws(nullptr), soa(nullptr), algorithm(MPPT_PERTURB_OBSERVE), status(MPPT_IDLE), step(0), maxCurrent(0),
+      setpoint(0), direction(1), lastVoltage(0), lastCurrent(0), lastPower(0), power(0), startMs(0), reversals(0),
+      trackingMs(0), iterations(0), rippleCount(0), rippleIndex(0), powerRipple(0), currentRipple(0) {}
+
+void MpptTracker::init(DAC* dacPointer, AnalogSws* swsPointer, SoaLimiter* soaPointer) {
+    dac = dacPointer;
+    sws = swsPointer;
+    soa = soaPointer;
+}
+
+bool MpptTracker::is_valid(MPPT_ALGORITHM trackAlgorithm, float trackStep, float trackMaxCurrent) {
+    return (trackAlgorithm == MPPT_PERTURB_OBSERVE || trackAlgorithm == MPPT_INCREMENTAL_CONDUCTANCE) &&
+           trackStep >= MPPT_MIN_STEP && trackStep <= MPPT_MAX_STEP &&
+           trackMaxCurrent > trackStep && trackMaxCurrent <= DAC_CC_MAX_CURRENT;
+}
+
+bool MpptTracker::start(MPPT_ALGORITHM trackAlgorithm, float trackStep, float trackMaxCurrent) {
+    if (is_running()) {
+        LOG_E(LOG_MPPT, "Tracker already running");
+        return false;
+    }
+    if (!is_valid(trackAlgorithm, trackStep, trackMaxCurrent)) {
+        LOG_E(LOG_MPPT, "Invalid parameters - step: %.3fA (%.3f-%.1f), max: %.3fA",
+          trackStep, MPPT_MIN_STEP, MPPT_MAX_STEP, trackMaxCurrent);
+        return false;
+    }
+
+    algorithm = trackAlgorithm;
+    step = trackStep;
+    maxCurrent = trackMaxCurrent;
+    setpoint = 0;
+    direction = 1;
+    power = 0;
+    reversals = 0;
+    trackingMs = 0;
+    iterations = 0;
+    rippleCount = 0;
+    rippleIndex = 0;
+    powerRipple = 0;
+    currentRipple = 0;
+    status = MPPT_STARTING; // Hardware is configured by run()
+
+    LOG_I(LOG_MPPT, "Starting %s tracking: step %.3fA, max %.3fA",
+          algorithm == MPPT_PERTURB_OBSERVE ? "P&O" : "IncCond", step, maxCurrent);
+    return true;
+}
+
+void MpptTracker::run(float voltage, float current) {
+    float samplePower = voltage * current;
+
+    switch (status) {
+        case MPPT_STARTING:
+            sws->mosfet_input_cc_mode();
+            sws->v_dac_enable();
+            setpoint = soa->clamp_current(step, voltage);
+            dac->cc_mode_set_current(setpoint);
+            lastVoltage = voltage;
+            lastCurrent = current;
+            lastPower = samplePower;
+            startMs = millis();
+            status = MPPT_TRACKING;
+            break;
+        case MPPT_TRACKING:
+        case MPPT_LOCKED: {
+            int8_t nextDirection = next_direction(voltage, current, samplePower);
+            if (nextDirection != direction) {
+                direction = nextDirection;
+                if (status == MPPT_TRACKING && ++reversals >= MPPT_REVERSALS_TO_LOCK) {
+                    trackingMs = millis() - startMs;
+                    status = MPPT_LOCKED;
+                    LOG_I(LOG_MPPT, "Locked after %lu ms: %.3fW at %.3fV, %.3fA",
+                          (unsigned long)trackingMs, samplePower, voltage, current);
+                }
+            }
+
+            lastVoltage = voltage;
+            lastCurrent = current;
+            lastPower = samplePower;
+            power = samplePower;
+            update_ripple(samplePower);
+            iterations++;
+
+            float next = setpoint + direction * step;
+            float limit = soa->clamp_current(maxCurrent, voltage); // SOA envelope at the panel voltage
+            if (next < 0) next = 0;
+            if (next > limit) next = limit;
+            setpoint = next;
+            dac->cc_mode_set_current(setpoint);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MpptTracker::stop() {
+    if (!is_running()) return;
+    if (status != MPPT_STARTING) {
+        dac->cc_mode_set_current(0.0);
+        LOG_I(LOG_MPPT, "Stopped after %lu iterations - ripple %.3fW / %.3fA",
+              (unsigned long)iterations, (float)powerRipple, (float)currentRipple);
+    }
+    status = MPPT_STOPPED;
+}
+
+bool MpptTracker::is_running() const {
+    return status == MPPT_STARTING || status == MPPT_TRACKING || status == MPPT_LOCKED;
+}
+
+MPPT_STATUS MpptTracker::get_status() const { return status; }
+
+const char* MpptTracker::get_status_name() const {
+    switch (status) {
+        case MPPT_STARTING: return "STARTING";
+        case MPPT_TRACKING: return "TRACKING";
+        case MPPT_LOCKED: return "LOCKED";
+        case MPPT_STOPPED: return "STOPPED";
+        default: return "IDLE";
+    }
+}
+
+MPPT_ALGORITHM MpptTracker::get_algorithm() const { return algorithm; }
+
+float MpptTracker::get_setpoint() const { return setpoint; }
+
+float MpptTracker::get_power() const { return power; }
+
+uint32_t MpptTracker::get_tracking_ms() const { return trackingMs; }
+
+float MpptTracker::get_power_ripple() const { return powerRipple; }
+
+float MpptTracker::get_current_ripple() const { return currentRipple; }
+
+uint32_t MpptTracker::get_iterations() const { return iterations; }
+
+int8_t MpptTracker::next_direction(float voltage, float current, float samplePower) const {
+    if (algorithm == MPPT_PERTURB_OBSERVE) {
+        return (samplePower < lastPower) ? -direction : direction; // Reverse when the last step lost power
+    }
+
+    // Incremental conductance: sign of dP/dV = I + V * dI/dV
+    float dV = voltage - lastVoltage;
+    if (fabsf(dV) < MPPT_DV_EPSILON) return direction; // No slope information, keep perturbing
+    float slope = current + voltage * (current - lastCurrent) / dV;
+    return (slope > 0) ? -1 : 1; // Left of the MPP: lower the current to raise the voltage
+}
+
+void MpptTracker::update_ripple(float samplePower) {
+    ripplePower[rippleIndex] = samplePower;
+    rippleCurrent[rippleIndex] = setpoint;
+    rippleIndex = (rippleIndex + 1) % MPPT_RIPPLE_WINDOW;
+    if (rippleCount < MPPT_RIPPLE_WINDOW) rippleCount++;
+
+    float lowPower = ripplePower[0], highPower = ripplePower[0];
+    float lowCurrent = rippleCurrent[0], highCurrent = rippleCurrent[0];
+    for (uint8_t i = 1; i < rippleCount; i++) {
+        lowPower = fminf(lowPower, ripplePower[i]);
+        highPower = fmaxf(highPower, ripplePower[i]);
+        lowCurrent = fminf(lowCurrent, rippleCurrent[i]);
+        highCurrent = fmaxf(highCurrent, rippleCurrent[i]);
+    }
+    powerRipple = highPower - lowPower;
+    currentRipple = highCurrent - lowCurrent;
+}
@@ -0,0 +1,67 @@
+#include "profiler.h"
+
+Profiler profiler;
+
+Profiler::Profiler() : stats(), resetRequested() {
+    for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) stats[i].minCycles = UINT32_MAX;
+}
+
+void IRAM_ATTR Profiler::record(PROFILE_STAGE stage, uint32_t cycles) {
+    ProfileStats& s = stats[stage];
+    if (resetRequested[stage]) {
+        memset(&s, 0, sizeof(s));
+        s.minCycles = UINT32_MAX;
+        resetRequested[stage] = false;
+    }
+
+    s.count++;
+    s.totalCycles += cycles;
+    if (cycles < s.minCycles) s.minCycles = cycles;
+    if (cycles > s.maxCycles) s.maxCycles = cycles;
+    uint8_t bucket = cycles ? 31 - __builtin_clz(cycles) : 0; // floor(log2), one instruction on Xtensa
+    s.histogram[bucket]++;
+}
+
+void Profiler::reset() {
+    for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) resetRequested[i] = true;
+}
+
+bool Profiler::has_samples(PROFILE_STAGE stage) const {
+    return stats[stage].count > 0 && !resetRequested[stage];
+}
+
+const ProfileStats& Profiler::get_stats(PROFILE_STAGE stage) const { return stats[stage]; }
+
+const char* Profiler::get_stage_name(PROFILE_STAGE stage) {
+    switch (stage) {
+        case PROFILE_CONTROL_CYCLE: return "control";
+        case PROFILE_ADC_VOLTAGE: return "adc_v";
+        case PROFILE_ADC_CURRENT: return "adc_i";
+        case PROFILE_ADC_TEMPERATURE: return "adc_t";
+        case PROFILE_SAFETY: return "safety";
+        case PROFILE_SEQUENCER: return "sequencer";
+        case PROFILE_FSM_CONTROL: return "fsm_control";
+        case PROFILE_PID: return "pid";
+        case PROFILE_STATISTICS: return "statistics";
+        case PROFILE_UI_CYCLE: return "ui";
+        case PROFILE_LCD_UPDATE: return "lcd_update";
+        case PROFILE_LCD_HEADER: return "lcd_header";
+        case PROFILE_FSM_UI: return "fsm_ui";
+        case PROFILE_BROADCAST: return "broadcast";
+        default: return "?";
+    }
+}
+
+float Profiler::cycles_to_us(uint64_t cycles) {
+    return (float)cycles / ESP.getCpuFreqMHz();
+}
+
+void Profiler::print_report() const {
+    Serial.printf("[PROFILE] %-12s %10s %10s %10s %10s\n", "stage", "count", "min us", "avg us", "max us");
+    for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        if (!has_samples((PROFILE_STAGE)i)) continue;
+        const ProfileStats& s = stats[i];
+        Serial.printf("[PROFILE] %-12s %10lu %10.1f %10.1f %10.1f\n", get_stage_name((PROFILE_STAGE)i), (unsigned long)s.count,
+                      cycles_to_us(s.minCycles), cycles_to_us(s.totalCycles / s.count), cycles_to_us(s.maxCycles));
+    }
+}
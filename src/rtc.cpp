@@ -1,6 +1,7 @@
 #include "rtc.h"
+#include <esp_timer.h>
 
-RTC::RTC() : i2c(nullptr) {}
+RTC::RTC() : i2c(nullptr), baseMs(0), baseUs(0), slewPpm(0), synced(false), clockLock(portMUX_INITIALIZER_UNLOCKED) {}
 
 void RTC::init(I2C* i2cPointer) {
     i2c = i2cPointer;
@@ -31,6 +32,8 @@ void RTC::set_time(const DateTime &dt) {
         i2c->write(MCP7941X_ADDRESS, data, 8);
         Serial.printf("[RTC] Time set: %02d:%02d:%02d %02d/%02d/%04d\n", 
                      dt.hours, dt.minutes, dt.seconds, dt.date, dt.month, 2000 + dt.year);
+        synced = false; // La próxima sincronización toma la nueva hora, aunque retroceda
+        sync();
     } else {
         Serial.println("[RTC] Error: Cannot set time, I2C not initialized");
     }
@@ -57,7 +60,7 @@ DateTime RTC::get_time() {
         dt.month = bcd_to_dec(data[5] & 0x1F); // Mask out any control bits
         dt.year = bcd_to_dec(data[6]);
     } else {
-        Serial.println("[RTC] Error: Cannot read time, I2C not initialized");
+        LOG_E(LOG_RTC, "Cannot read time, I2C not initialized");
         // Return zero DateTime if I2C not available
         dt.seconds = dt.minutes = dt.hours = dt.date = dt.month = dt.year = dt.dayOfWeek = 0;
     }
@@ -66,8 +69,59 @@ DateTime RTC::get_time() {
 }
 
 uint64_t RTC::get_timestamp_ms() {
+    return get_timestamp_ms_at(esp_timer_get_time());
+}
+
+uint64_t RTC::get_timestamp_ms_at(int64_t timeUs) {
+    portENTER_CRITICAL(&clockLock);
+    uint64_t ms = clock_ms_at(timeUs);
+    portEXIT_CRITICAL(&clockLock);
+    return ms;
+}
+
+void RTC::sync() {
     DateTime dt = get_time();
-    return datetime_to_ms(dt);
+    int64_t nowUs = esp_timer_get_time();
+    if (dt.month < 1 || dt.month > 12 || dt.date < 1 || dt.date > 31) {
+        LOG_W(LOG_RTC, "Invalid date read, clock not synchronized");
+        return;
+    }
+    uint64_t rtcMs = datetime_to_ms(dt);
+
+    portENTER_CRITICAL(&clockLock);
+    int64_t errorMs = 0;
+    if (!synced) { // Primera lectura: se adopta la hora del RTC
+        baseMs = rtcMs;
+        slewPpm = 0;
+        synced = true;
+    } else {
+        // Nueva base en el instante actual, para que el reloj sea continuo
+        baseMs = clock_ms_at(nowUs);
+        errorMs = (int64_t)rtcMs - (int64_t)baseMs;
+        if (errorMs > RTC_STEP_THRESHOLD_MS) {
+            baseMs = rtcMs; // Solo se salta hacia adelante
+            slewPpm = 0;
+        } else if (errorMs > RTC_DEADBAND_MS || errorMs < -RTC_DEADBAND_MS) {
+            // Corrige el error a lo largo del próximo intervalo, sin retroceder nunca
+            int64_t ppm = errorMs * 1000000LL / RTC_SYNC_INTERVAL_MS;
+            slewPpm = constrain(ppm, (int64_t)-RTC_MAX_SLEW_PPM, (int64_t)RTC_MAX_SLEW_PPM);
+        } else {
+            slewPpm = 0;
+        }
+    }
+    baseUs = nowUs;
+    int32_t slew = slewPpm;
+    portEXIT_CRITICAL(&clockLock);
+
+    if (errorMs > RTC_DEADBAND_MS || errorMs < -RTC_DEADBAND_MS) {
+        LOG_I(LOG_RTC, "Clock error %ld ms, slew %ld ppm", (long)errorMs, (long)slew);
+    }
+}
+
+uint64_t RTC::clock_ms_at(int64_t timeUs) const {
+    int64_t elapsedUs = timeUs - baseUs;
+    if (elapsedUs < 0) elapsedUs = 0; // Instantes anteriores a la base (p. ej. un disparo ya registrado)
+    return baseMs + (elapsedUs + elapsedUs * slewPpm / 1000000) / 1000;
 }
 
 uint64_t RTC::elapsed_ms(uint64_t start_time, uint64_t end_time) {
@@ -81,30 +135,17 @@ uint64_t RTC::elapsed_ms(uint64_t start_time, uint64_t end_time) {
 }
 
 uint64_t RTC::datetime_to_ms(const DateTime &dt) {
-    // Número de días en cada mes (sin considerar años bisiestos)
-    static const uint16_t days_in_month[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    
-    // Calcular años completos desde 2000
-    uint16_t year = 2000 + dt.year;
-    uint64_t timestamp = 0;
-    
-    // Agregar días de años completos (considerando años bisiestos)
-    for (uint16_t y = 2000; y < year; y++) {
-        timestamp += (365 + (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0) ? 1 : 0)) * 24ULL * 60ULL * 60ULL * 1000ULL;
-    }
-    
-    // Agregar días de meses completos en el año actual
-    for (uint8_t m = 1; m < dt.month; m++) {
-        uint16_t days = days_in_month[m];
-        // Añadir un día en febrero si el año actual es bisiesto
-        if (m == 2 && (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))) {
-            days++;
-        }
-        timestamp += days * 24ULL * 60ULL * 60ULL * 1000ULL;
-    }
-    
-    // Agregar días del mes actual
-    timestamp += (dt.date - 1) * 24ULL * 60ULL * 60ULL * 1000ULL;
+    // Días desde 1970-01-01 por el algoritmo "days from civil" (sin bucles):
+    // los años empiezan en marzo, así febrero queda al final y los bisiestos no afectan a los meses
+    int32_t year = 2000 + dt.year - (dt.month <= 2 ? 1 : 0);
+    int32_t era = year / 400;
+    int32_t yearOfEra = year - era * 400;                                   // [0, 399]
+    int32_t month = dt.month + (dt.month > 2 ? -3 : 9);                      // Marzo = 0
+    int32_t dayOfYear = (153 * month + 2) / 5 + dt.date - 1;                 // [0, 365]
+    int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = (int64_t)era * 146097 + dayOfEra - 719468 - 10957;       // 10957 días de 1970 a 2000
+
+    uint64_t timestamp = days * 24ULL * 60ULL * 60ULL * 1000ULL;
     
     // Agregar horas, minutos y segundos
     timestamp += dt.hours * 60ULL * 60ULL * 1000ULL;
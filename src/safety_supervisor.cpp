@@ -0,0 +1,188 @@
+#include "safety_supervisor.h"
+#include "dac.h"
+#include "analog_sws.h"
+#include "fsm.h"
+#include "fast_trip.h"
+#include "black_box.h"
+#include <esp_timer.h>
+
+static float SafetyLimits::* const limitFields[] = {
+    &SafetyLimits::maxVoltage, &SafetyLimits::maxCurrent, &SafetyLimits::maxPower, &SafetyLimits::maxTemperature,
+    &SafetyLimits::voltageMargin, &SafetyLimits::currentMargin, &SafetyLimits::powerMargin, &SafetyLimits::temperatureMargin
+};
+
+SafetySupervisor::SafetySupervisor()
+    : dac(nullptr), sws(nullptr), fsm(nullptr), fastTrip(nullptr), blackBox(nullptr), alertQueue(nullptr), sampleMailbox(nullptr),
+      taskHandle(nullptr), limits(), pendingLimits({NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN}), limitsPending(false),
+      limitsLock(portMUX_INITIALIZER_UNLOCKED), thresholds(), tripCount(0), checkCount(0), maxCheckUs(0),
+      timeoutCount(0), latency({0, 0, UINT32_MAX, 0, 0}), latencyLock(portMUX_INITIALIZER_UNLOCKED) {}
+
+void SafetySupervisor::init(DAC* dacPointer, AnalogSws* swsPointer, FSM* fsmPointer, FastTrip* fastTripPointer,
+                            BlackBox* blackBoxPointer, QueueHandle_t alerts, const SafetyLimits& initialLimits) {
+    dac = dacPointer;
+    sws = swsPointer;
+    fsm = fsmPointer;
+    fastTrip = fastTripPointer;
+    blackBox = blackBoxPointer;
+    alertQueue = alerts;
+    apply_limits(initialLimits);
+
+    sampleMailbox = xQueueCreate(1, sizeof(SafetySample));
+    xTaskCreatePinnedToCore(task, "safety", SAFETY_TASK_STACK, this, SAFETY_TASK_PRIORITY, &taskHandle, SAFETY_TASK_CORE);
+
+    Serial.printf("[SAFETY] Supervisor started - limits %.1fV, %.1fA, %.1fW, %.1f°C\n",
+                  limits.maxVoltage, limits.maxCurrent, limits.maxPower, limits.maxTemperature);
+}
+
+void SafetySupervisor::submit(const SafetySample& sample) {
+    xQueueOverwrite(sampleMailbox, &sample);
+    xTaskNotify(taskHandle, SAFETY_NOTIFY_SAMPLE, eSetBits); // Preempts the caller right here
+}
+
+void IRAM_ATTR SafetySupervisor::notify_alert_from_isr() {
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(taskHandle, SAFETY_NOTIFY_ALERT, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void SafetySupervisor::update_limits(const SafetyLimits& changes) {
+    portENTER_CRITICAL(&limitsLock);
+    for (auto field : limitFields) {
+        if (!isnan(changes.*field)) pendingLimits.*field = changes.*field;
+    }
+    limitsPending = true;
+    portEXIT_CRITICAL(&limitsLock);
+    xTaskNotify(taskHandle, 0, eNoAction); // Applied on the next wake-up at the latest
+}
+
+SafetyLimits SafetySupervisor::get_limits() const {
+    portENTER_CRITICAL(&limitsLock);
+    SafetyLimits copy = limits;
+    portEXIT_CRITICAL(&limitsLock);
+    return copy;
+}
+
+uint32_t SafetySupervisor::get_trip_count() const { return tripCount; }
+
+uint32_t SafetySupervisor::get_check_count() const { return checkCount; }
+
+uint32_t SafetySupervisor::get_max_check_us() const { return maxCheckUs; }
+
+uint32_t SafetySupervisor::get_timeout_count() const { return timeoutCount; }
+
+SafetyLatency SafetySupervisor::get_latency() const {
+    portENTER_CRITICAL(&latencyLock);
+    SafetyLatency copy = latency;
+    portEXIT_CRITICAL(&latencyLock);
+    return copy;
+}
+
+void SafetySupervisor::task(void* parameter) {
+    SafetySupervisor* self = static_cast<SafetySupervisor*>(parameter);
+    int64_t lastSampleUs = esp_timer_get_time();
+
+    for (;;) {
+        uint32_t bits = 0;
+        BaseType_t notified = xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(SAFETY_SAMPLE_TIMEOUT_MS));
+
+        self->apply_pending_limits();
+
+        if (bits & SAFETY_NOTIFY_ALERT) { // Relay already opened by the FastTrip ISR
+            char message[32];
+            snprintf(message, sizeof(message), "Over-current %.1fA", self->fastTrip->get_trip_current());
+            self->fastTrip->record_shutdown(self->shutdown(message));
+        }
+
+        SafetySample sample;
+        if ((bits & SAFETY_NOTIFY_SAMPLE) && xQueueReceive(self->sampleMailbox, &sample, 0) == pdTRUE) {
+            lastSampleUs = sample.timeUs;
+            self->check(sample);
+        } else if (notified != pdTRUE || esp_timer_get_time() - lastSampleUs >= SAFETY_SAMPLE_TIMEOUT_MS * 1000LL) {
+            // The control task stopped publishing: nothing watches the load any more
+            if (self->fsm->is_output_active()) {
+                self->timeoutCount = self->timeoutCount + 1;
+                self->shutdown("Control task stalled");
+            }
+            lastSampleUs = esp_timer_get_time();
+        }
+    }
+}
+
+void SafetySupervisor::apply_pending_limits() {
+    portENTER_CRITICAL(&limitsLock);
+    if (!limitsPending) {
+        portEXIT_CRITICAL(&limitsLock);
+        return;
+    }
+    SafetyLimits merged = limits; // Only this task writes limits
+    for (auto field : limitFields) {
+        if (!isnan(pendingLimits.*field)) merged.*field = pendingLimits.*field;
+        pendingLimits.*field = NAN;
+    }
+    limitsPending = false;
+    portEXIT_CRITICAL(&limitsLock);
+
+    float previousTrip = thresholds[1];
+    apply_limits(merged);
+    if (thresholds[1] != previousTrip) fsm->set_current_trip(thresholds[1]); // Comparator reprogrammed by the control task
+    LOG_I(LOG_SAFETY, "Limits set to %.1fV, %.1fA, %.1fW, %.1f°C",
+          merged.maxVoltage, merged.maxCurrent, merged.maxPower, merged.maxTemperature);
+}
+
+void SafetySupervisor::apply_limits(const SafetyLimits& newLimits) {
+    portENTER_CRITICAL(&limitsLock);
+    limits = newLimits;
+    portEXIT_CRITICAL(&limitsLock);
+    thresholds[0] = limits.maxVoltage * (1 + limits.voltageMargin);
+    thresholds[1] = limits.maxCurrent * (1 + limits.currentMargin);
+    thresholds[2] = limits.maxPower * (1 + limits.powerMargin);
+    thresholds[3] = limits.maxTemperature * (1 + limits.temperatureMargin);
+}
+
+void SafetySupervisor::check(const SafetySample& sample) {
+    int64_t startUs = esp_timer_get_time();
+    uint32_t checkUs = (uint32_t)(startUs - sample.timeUs);
+    if (checkUs > maxCheckUs) maxCheckUs = checkUs;
+    checkCount = checkCount + 1;
+
+    if (!fsm->is_output_active()) return;
+
+    char message[32];
+    if (sample.voltage > thresholds[0]) snprintf(message, sizeof(message), "%.1fV", limits.maxVoltage);
+    else if (sample.current > thresholds[1]) snprintf(message, sizeof(message), "%.1fA", limits.maxCurrent);
+    else if (sample.power > thresholds[2]) snprintf(message, sizeof(message), "%.1fW", limits.maxPower);
+    else if (sample.temperature > thresholds[3]) snprintf(message, sizeof(message), "%.1f°C", limits.maxTemperature);
+    else return;
+
+    record_latency(sample.timeUs, shutdown(message));
+}
+
+int64_t SafetySupervisor::shutdown(const char* message) {
+    // Relay first: it disconnects the DUT even if the DAC write is delayed on the I2C bus
+    sws->relay_dut_disable();
+    dac->digital_write(0);
+    int64_t doneUs = esp_timer_get_time(); // The load is off: the rest is bookkeeping
+
+    // The FSM aborts the running mode and clears output and setpoint in the next control period
+    fsm->trip();
+    tripCount = tripCount + 1;
+    blackBox->freeze(message, doneUs); // Only flags the ring, the UI task writes it
+
+    SafetyAlert alert = {};
+    snprintf(alert.message, sizeof(alert.message), "%s", message);
+    xQueueSend(alertQueue, &alert, 0); // LCD warning and broadcast are done by the UI task
+    LOG_E(LOG_SAFETY, "%s - emergency shutdown, DUT disabled", message);
+    return doneUs;
+}
+
+void SafetySupervisor::record_latency(int64_t detectUs, int64_t doneUs) {
+    uint32_t us = (uint32_t)(doneUs - detectUs);
+    portENTER_CRITICAL(&latencyLock);
+    latency.count++;
+    latency.lastUs = us;
+    if (us < latency.minUs) latency.minUs = us;
+    if (us > latency.maxUs) latency.maxUs = us;
+    latency.totalUs += us;
+    portEXIT_CRITICAL(&latencyLock);
+    LOG_I(LOG_SAFETY, "Shutdown completed %lu us after the sample", (unsigned long)us);
+}
@@ -0,0 +1,129 @@
+#include "sample_stream.h"
+
+#define STREAM_RING_MASK (STREAM_RING_SAMPLES - 1)
+
+SampleStream::SampleStream() : ring(), head(0), subscriptions(), nextGeneration(0), lock(portMUX_INITIALIZER_UNLOCKED), readers() {}
+
+void IRAM_ATTR SampleStream::push(const StreamSample& sample) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    ring[position & STREAM_RING_MASK] = sample;
+    head.store(position + 1, std::memory_order_release);
+}
+
+bool SampleStream::subscribe(uint32_t clientId, uint16_t decimation, uint8_t batch) {
+    if (clientId == 0 || decimation < 1 || decimation > STREAM_MAX_DECIMATION || batch < 1 || batch > STREAM_MAX_BATCH) return false;
+
+    bool subscribed = false;
+    portENTER_CRITICAL(&lock);
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (subscriptions[i].clientId == clientId) { // Changing the parameters restarts the stream
+            slot = i;
+            break;
+        }
+        if (slot < 0 && subscriptions[i].clientId == 0) slot = i;
+    }
+    if (slot >= 0) {
+        subscriptions[slot] = {clientId, decimation, batch, ++nextGeneration, 0};
+        subscribed = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    return subscribed;
+}
+
+uint32_t SampleStream::unsubscribe(uint32_t clientId) {
+    uint32_t dropped = 0;
+    portENTER_CRITICAL(&lock);
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (subscriptions[i].clientId == clientId) {
+            dropped = subscriptions[i].dropped;
+            subscriptions[i].clientId = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    return dropped;
+}
+
+uint8_t SampleStream::get_subscriber_count() const {
+    uint8_t count = 0;
+    portENTER_CRITICAL(&lock);
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (subscriptions[i].clientId != 0) count++;
+    }
+    portEXIT_CRITICAL(&lock);
+    return count;
+}
+
+void SampleStream::add_dropped(uint8_t slot, uint32_t clientId, uint32_t samples) {
+    if (samples == 0) return;
+    portENTER_CRITICAL(&lock);
+    if (subscriptions[slot].clientId == clientId) subscriptions[slot].dropped += samples;
+    portEXIT_CRITICAL(&lock);
+}
+
+size_t SampleStream::finish_frame(Reader& reader, uint16_t decimation, uint32_t dropped) {
+    uint8_t* frame = reader.frame;
+    frame[0] = 'S';
+    frame[1] = 'S';
+    frame[2] = STREAM_FRAME_VERSION;
+    frame[3] = reader.count;
+    memcpy(frame + 4, &decimation, 2);
+    frame[6] = 0;
+    frame[7] = 0;
+    memcpy(frame + 8, &dropped, 4);
+    return STREAM_FRAME_HEADER_SIZE + reader.count * sizeof(StreamSample);
+}
+
+void SampleStream::service(StreamSendFunction send) {
+    Subscription active[STREAM_MAX_CLIENTS];
+    portENTER_CRITICAL(&lock);
+    memcpy(active, subscriptions, sizeof(active));
+    portEXIT_CRITICAL(&lock);
+
+    uint32_t end = head.load(std::memory_order_acquire);
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        Subscription& subscription = active[i];
+        if (subscription.clientId == 0) continue;
+        Reader& reader = readers[i];
+        if (reader.generation != subscription.generation) { // New subscription: start with the next sample
+            reader.generation = subscription.generation;
+            reader.cursor = end;
+            reader.phase = 0;
+            reader.count = 0;
+        }
+
+        // Samples overwritten before they were read
+        if (end - reader.cursor > STREAM_RING_SAMPLES) {
+            uint32_t lost = (end - reader.cursor - STREAM_RING_SAMPLES) / subscription.decimation;
+            add_dropped(i, subscription.clientId, lost);
+            subscription.dropped += lost;
+            reader.cursor = end - STREAM_RING_SAMPLES;
+        }
+
+        while (reader.cursor != end) {
+            StreamSample sample = ring[reader.cursor & STREAM_RING_MASK];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            bool overwritten = head.load(std::memory_order_relaxed) - reader.cursor >= STREAM_RING_SAMPLES; // Torn by the control task
+            reader.cursor++;
+            bool keep = reader.phase == 0;
+            reader.phase = (reader.phase + 1) % subscription.decimation;
+            if (!keep) continue;
+            if (overwritten) {
+                add_dropped(i, subscription.clientId, 1);
+                subscription.dropped++;
+                continue;
+            }
+
+            memcpy(reader.frame + STREAM_FRAME_HEADER_SIZE + reader.count * sizeof(StreamSample), &sample, sizeof(StreamSample));
+            if (++reader.count < subscription.batch) continue;
+
+            size_t length = finish_frame(reader, subscription.decimation, subscription.dropped);
+            if (!send(subscription.clientId, reader.frame, length)) { // Slow client: this batch is lost, the others are not held up
+                add_dropped(i, subscription.clientId, reader.count);
+                subscription.dropped += reader.count;
+            }
+            reader.count = 0;
+        }
+    }
+}
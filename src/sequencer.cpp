@@ -0,0 +1,426 @@
+#include "sequencer.h"
+#include "fsm.h"
+
+// Operand bytes following each opcode (LOG adds its message length)
+static uint8_t operand_size(uint8_t opcode) {
+    switch (opcode) {
+        case SEQ_OP_MODE: return 1;
+        case SEQ_OP_SET: return 4;
+        case SEQ_OP_OUTPUT: return 1;
+        case SEQ_OP_WAIT: return 4;
+        case SEQ_OP_UNTIL: return 10;
+        case SEQ_OP_LOOP: return 2;
+        case SEQ_OP_LOG: return 1;
+        default: return 0;
+    }
+}
+
+Sequencer::Sequencer()
+    : fsm(nullptr), codeSize(0), status(SEQ_IDLE), startRequested(false), stopRequested(false), pc(0),
+      expectedState(FSM_MAIN_STATES::MAIN_MENU), waitStart(0), waiting(false), loopDepth(0), logCount(0) {
+    lastLog[0] = 0;
+    error[0] = 0;
+}
+
+void Sequencer::init(FSM* fsmPointer) {
+    fsm = fsmPointer;
+
+    if (load()) {
+        Serial.printf("[SEQUENCER] Loaded %u byte program from " SEQ_PROGRAM_PATH "\n", codeSize);
+    } else {
+        Serial.println("[SEQUENCER] No stored program");
+    }
+}
+
+bool Sequencer::compile(const char* source, size_t length) {
+    static uint8_t staging[SEQ_MAX_CODE_SIZE]; // Only used by the AsyncTCP task
+    uint16_t size = 0;
+    uint8_t depth = 0;
+    bool modeSet = false;
+    uint16_t lineNumber = 0;
+
+    if (is_running()) {
+        snprintf(error, sizeof(error), "Stop the running program first");
+        return false;
+    }
+
+    auto emit = [&](const void* data, size_t bytes) {
+        if (size + bytes > SEQ_MAX_CODE_SIZE) return false;
+        memcpy(&staging[size], data, bytes);
+        size += bytes;
+        return true;
+    };
+    auto emit_op = [&](uint8_t opcode) { return emit(&opcode, 1); };
+
+    size_t pos = 0;
+    while (pos < length) {
+        // Copy one line, drop comments
+        char line[96];
+        size_t lineLength = 0;
+        lineNumber++;
+        while (pos < length && source[pos] != '\n') {
+            if (lineLength < sizeof(line) - 1) line[lineLength++] = source[pos];
+            pos++;
+        }
+        pos++;
+        line[lineLength] = 0;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = 0;
+
+        char* rest;
+        char* keyword = strtok_r(line, " \t\r", &rest);
+        if (!keyword) continue; // Empty line
+
+        bool ok = true;
+        bool isLog = strcasecmp(keyword, "LOG") == 0;
+        char* arg = isLog ? nullptr : strtok_r(nullptr, " \t\r", &rest);
+        char* end = nullptr;
+
+        if (isLog) {
+            // The message is the rest of the line
+            char* message = rest + strspn(rest, " \t");
+            size_t messageLength = strcspn(message, "\r");
+            while (messageLength > 0 && message[messageLength - 1] == ' ') messageLength--;
+            uint8_t logLength = min(messageLength, (size_t)SEQ_MAX_LOG_LENGTH);
+            ok = emit_op(SEQ_OP_LOG) && emit(&logLength, 1) && emit(message, logLength);
+        } else if (strcasecmp(keyword, "MODE") == 0) {
+            uint8_t state = 0;
+            if (!arg) ok = false;
+            else if (strcasecmp(arg, "CC") == 0) state = FSM_MAIN_STATES::CC;
+            else if (strcasecmp(arg, "CV") == 0) state = FSM_MAIN_STATES::CV;
+            else if (strcasecmp(arg, "CR") == 0) state = FSM_MAIN_STATES::CR;
+            else if (strcasecmp(arg, "CW") == 0) state = FSM_MAIN_STATES::CW;
+            else ok = false;
+            ok = ok && emit_op(SEQ_OP_MODE) && emit(&state, 1);
+            modeSet = true;
+        } else if (strcasecmp(keyword, "SET") == 0) {
+            float value = arg ? strtof(arg, &end) : 0;
+            ok = arg && *end == 0 && value >= 0 && modeSet && emit_op(SEQ_OP_SET) && emit(&value, 4);
+        } else if (strcasecmp(keyword, "OUTPUT") == 0) {
+            uint8_t on = (arg && strcasecmp(arg, "ON") == 0) ? 1 : 0;
+            ok = arg && (on || strcasecmp(arg, "OFF") == 0) && modeSet && emit_op(SEQ_OP_OUTPUT) && emit(&on, 1);
+        } else if (strcasecmp(keyword, "WAIT") == 0) {
+            uint32_t ms = arg ? strtoul(arg, &end, 10) : 0;
+            ok = arg && *end == 0 && emit_op(SEQ_OP_WAIT) && emit(&ms, 4);
+        } else if (strcasecmp(keyword, "UNTIL") == 0) {
+            // UNTIL <variable> <'<' or '>'> <threshold> [timeout ms]
+            char* cmp = strtok_r(nullptr, " \t\r", &rest);
+            char* threshold = strtok_r(nullptr, " \t\r", &rest);
+            char* timeout = strtok_r(nullptr, " \t\r", &rest);
+            uint8_t variable = SEQ_VAR_VOLTAGE;
+            if (!arg || !cmp || !threshold || (cmp[0] != '<' && cmp[0] != '>') || cmp[1] != 0) ok = false;
+            else if (strcasecmp(arg, "V") == 0) variable = SEQ_VAR_VOLTAGE;
+            else if (strcasecmp(arg, "I") == 0) variable = SEQ_VAR_CURRENT;
+            else if (strcasecmp(arg, "P") == 0) variable = SEQ_VAR_POWER;
+            else if (strcasecmp(arg, "T") == 0) variable = SEQ_VAR_TEMPERATURE;
+            else ok = false;
+            if (ok) {
+                float value = strtof(threshold, &end);
+                ok = *end == 0;
+                uint32_t ms = 0;
+                if (ok && timeout) {
+                    ms = strtoul(timeout, &end, 10);
+                    ok = *end == 0;
+                }
+                uint8_t comparison = cmp[0];
+                ok = ok && emit_op(SEQ_OP_UNTIL) && emit(&variable, 1) && emit(&comparison, 1) && emit(&value, 4) && emit(&ms, 4);
+            }
+        } else if (strcasecmp(keyword, "LOOP") == 0) {
+            unsigned long count = arg ? strtoul(arg, &end, 10) : 0;
+            uint16_t repetitions = count;
+            ok = arg && *end == 0 && count >= 1 && count <= UINT16_MAX && depth < SEQ_MAX_LOOP_DEPTH &&
+                 emit_op(SEQ_OP_LOOP) && emit(&repetitions, 2);
+            depth++;
+        } else if (strcasecmp(keyword, "END") == 0) {
+            ok = depth > 0 && emit_op(SEQ_OP_END);
+            depth--;
+        } else if (strcasecmp(keyword, "STOP") == 0) {
+            ok = emit_op(SEQ_OP_STOP);
+        } else {
+            ok = false;
+        }
+
+        if (ok && !isLog && strtok_r(nullptr, " \t\r", &rest)) ok = false; // Trailing tokens
+        if (!ok) {
+            snprintf(error, sizeof(error), "Line %u: invalid or misplaced %s", lineNumber, keyword);
+            return false;
+        }
+    }
+
+    if (depth != 0) {
+        snprintf(error, sizeof(error), "LOOP without END");
+        return false;
+    }
+    if (size == 0) {
+        snprintf(error, sizeof(error), "Empty program");
+        return false;
+    }
+
+    memcpy(&program[SEQ_HEADER_SIZE], staging, size);
+    codeSize = size;
+    status = SEQ_IDLE;
+    error[0] = 0;
+    Serial.printf("[SEQUENCER] Compiled %u lines into %u bytes\n", lineNumber, codeSize);
+    return true;
+}
+
+bool Sequencer::save() {
+    program[0] = 'S';
+    program[1] = 'Q';
+    program[2] = SEQ_VERSION;
+    program[3] = 0;
+    memcpy(&program[4], &codeSize, sizeof(codeSize)); // ESP32 is little endian
+
+    File file = SPIFFS.open(SEQ_PROGRAM_PATH, FILE_WRITE);
+    if (!file) return false;
+    size_t written = file.write(program, SEQ_HEADER_SIZE + codeSize);
+    file.close();
+    return written == SEQ_HEADER_SIZE + codeSize;
+}
+
+bool Sequencer::request_start() {
+    if (!is_loaded() || is_running()) return false;
+    error[0] = 0;
+    startRequested = true;
+    return true;
+}
+
+void Sequencer::request_stop() {
+    if (is_running()) stopRequested = true;
+}
+
+void Sequencer::run(float voltage, float current, float temperature) {
+    if (stopRequested) {
+        stopRequested = false;
+        startRequested = false;
+        if (status == SEQ_RUNNING) {
+            finish(SEQ_STOPPED);
+            LOG_I(LOG_SEQUENCER, "Program stopped");
+        }
+        return;
+    }
+
+    if (startRequested) {
+        startRequested = false;
+        if (fsm->get_current_state() != FSM_MAIN_STATES::MAIN_MENU) {
+            snprintf(error, sizeof(error), "Start from the main menu");
+            status = SEQ_ABORTED;
+            return;
+        }
+        pc = 0;
+        loopDepth = 0;
+        waiting = false;
+        expectedState = FSM_MAIN_STATES::MAIN_MENU;
+        status = SEQ_RUNNING;
+        LOG_I(LOG_SEQUENCER, "Running %u byte program", codeSize);
+    }
+
+    if (status != SEQ_RUNNING) return;
+
+    // Leaving the mode entered by the program (encoder, web UI or a rejected MODE) ends it
+    if (fsm->get_current_state() != expectedState) {
+        abort("Load mode left");
+        return;
+    }
+
+    for (uint8_t i = 0; i < SEQ_MAX_STEPS_PER_CYCLE; i++) {
+        if (!step(voltage, current, temperature)) break;
+    }
+}
+
+void Sequencer::abort(const char* reason) {
+    if (status != SEQ_RUNNING && !startRequested) return;
+    startRequested = false;
+    status = SEQ_ABORTED;
+    waiting = false;
+    snprintf(error, sizeof(error), "%s", reason);
+    LOG_W(LOG_SEQUENCER, "Program aborted at %u: %s", pc, reason);
+}
+
+bool Sequencer::is_running() const {
+    return status == SEQ_RUNNING || startRequested;
+}
+
+bool Sequencer::is_loaded() const { return codeSize > 0; }
+
+SEQ_STATUS Sequencer::get_status() const { return status; }
+
+const char* Sequencer::get_status_name() const {
+    switch (status) {
+        case SEQ_RUNNING: return "RUNNING";
+        case SEQ_DONE: return "DONE";
+        case SEQ_STOPPED: return "STOPPED";
+        case SEQ_ABORTED: return "ABORTED";
+        default: return "IDLE";
+    }
+}
+
+uint16_t Sequencer::get_code_size() const { return codeSize; }
+
+uint16_t Sequencer::get_pc() const { return pc; }
+
+uint32_t Sequencer::get_log_count() const { return logCount; }
+
+const char* Sequencer::get_last_log() const { return lastLog; }
+
+const char* Sequencer::get_error() const { return error; }
+
+bool Sequencer::load() {
+    File file = SPIFFS.open(SEQ_PROGRAM_PATH, FILE_READ);
+    if (!file) return false;
+
+    size_t size = file.read(program, sizeof(program));
+    file.close();
+
+    uint16_t storedSize;
+    memcpy(&storedSize, &program[4], sizeof(storedSize));
+    if (size < SEQ_HEADER_SIZE || program[0] != 'S' || program[1] != 'Q' || program[2] != SEQ_VERSION ||
+        storedSize != size - SEQ_HEADER_SIZE || !verify(&program[SEQ_HEADER_SIZE], storedSize)) {
+        Serial.println("[SEQUENCER] WARNING: Ignoring invalid " SEQ_PROGRAM_PATH);
+        return false;
+    }
+    codeSize = storedSize;
+    return true;
+}
+
+bool Sequencer::verify(const uint8_t* bytecode, uint16_t size) {
+    uint16_t offset = 0;
+    uint8_t depth = 0;
+    while (offset < size) {
+        uint8_t opcode = bytecode[offset];
+        if (opcode < SEQ_OP_MODE || opcode > SEQ_OP_STOP) return false;
+        uint16_t length = 1 + operand_size(opcode);
+        if (offset + length > size) return false;
+
+        const uint8_t* operands = &bytecode[offset + 1];
+        switch (opcode) {
+            case SEQ_OP_MODE:
+                if (operands[0] < FSM_MAIN_STATES::CC || operands[0] > FSM_MAIN_STATES::CW) return false;
+                break;
+            case SEQ_OP_UNTIL:
+                if (operands[0] > SEQ_VAR_TEMPERATURE || (operands[1] != '<' && operands[1] != '>')) return false;
+                break;
+            case SEQ_OP_LOOP:
+                if (++depth > SEQ_MAX_LOOP_DEPTH) return false;
+                break;
+            case SEQ_OP_END:
+                if (depth-- == 0) return false;
+                break;
+            case SEQ_OP_LOG:
+                if (operands[0] > SEQ_MAX_LOG_LENGTH) return false;
+                length += operands[0];
+                if (offset + length > size) return false;
+                break;
+        }
+        offset += length;
+    }
+    return depth == 0;
+}
+
+bool Sequencer::step(float voltage, float current, float temperature) {
+    if (pc >= codeSize) { // Implicit STOP
+        finish(SEQ_DONE);
+        return false;
+    }
+
+    const uint8_t* instruction = &code()[pc];
+    const uint8_t* operands = instruction + 1;
+    uint16_t next = pc + 1 + operand_size(instruction[0]);
+
+    switch (instruction[0]) {
+        case SEQ_OP_MODE:
+            expectedState = operands[0];
+            fsm->change_state(static_cast<FSM_MAIN_STATES>(expectedState));
+            break;
+        case SEQ_OP_SET: {
+            float value;
+            memcpy(&value, operands, sizeof(value));
+            fsm->set_setpoint(value); // Clamped to the limit of the mode by the FSM
+            break;
+        }
+        case SEQ_OP_OUTPUT:
+            fsm->set_output_active(operands[0] != 0);
+            break;
+        case SEQ_OP_WAIT: {
+            uint32_t ms;
+            memcpy(&ms, operands, sizeof(ms));
+            if (!waiting) {
+                waiting = true;
+                waitStart = millis();
+            }
+            if (millis() - waitStart < ms) return false;
+            waiting = false;
+            break;
+        }
+        case SEQ_OP_UNTIL: {
+            // Not evaluated in the period it is reached: the preceding steps are applied after run()
+            if (!waiting) {
+                waiting = true;
+                waitStart = millis();
+                return false;
+            }
+            float threshold;
+            uint32_t timeoutMs;
+            memcpy(&threshold, &operands[2], sizeof(threshold));
+            memcpy(&timeoutMs, &operands[6], sizeof(timeoutMs));
+
+            float value;
+            switch (operands[0]) {
+                case SEQ_VAR_CURRENT: value = current; break;
+                case SEQ_VAR_POWER: value = voltage * current; break;
+                case SEQ_VAR_TEMPERATURE: value = temperature; break;
+                default: value = voltage; break;
+            }
+            bool reached = (operands[1] == '<') ? (value < threshold) : (value > threshold);
+            if (!reached) {
+                if (timeoutMs != 0 && millis() - waitStart >= timeoutMs) {
+                    snprintf(error, sizeof(error), "UNTIL timed out at %u", pc);
+                    finish(SEQ_ABORTED);
+                }
+                return false;
+            }
+            waiting = false;
+            break;
+        }
+        case SEQ_OP_LOOP: {
+            uint16_t repetitions;
+            memcpy(&repetitions, operands, sizeof(repetitions));
+            loops[loopDepth++] = {next, repetitions};
+            break;
+        }
+        case SEQ_OP_END:
+            if (--loops[loopDepth - 1].remaining > 0) {
+                next = loops[loopDepth - 1].bodyStart;
+            } else {
+                loopDepth--;
+            }
+            break;
+        case SEQ_OP_LOG: {
+            uint8_t length = operands[0];
+            memcpy(lastLog, &operands[1], length);
+            lastLog[length] = 0;
+            next += length;
+            logCount++;
+            LOG_I(LOG_SEQUENCER, "%s", lastLog);
+            break;
+        }
+        case SEQ_OP_STOP:
+            finish(SEQ_DONE);
+            return false;
+    }
+
+    pc = next;
+    return true;
+}
+
+void Sequencer::finish(SEQ_STATUS finalStatus) {
+    status = finalStatus;
+    waiting = false;
+    fsm->change_state(FSM_MAIN_STATES::MAIN_MENU); // Disables the output and resets the setpoint
+    if (finalStatus == SEQ_DONE) LOG_I(LOG_SEQUENCER, "Program completed");
+    else if (finalStatus == SEQ_ABORTED) LOG_W(LOG_SEQUENCER, "Program aborted: %s", error);
+}
+
+const uint8_t* Sequencer::code() const {
+    return &program[SEQ_HEADER_SIZE];
+}
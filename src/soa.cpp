@@ -0,0 +1,78 @@
+#include "soa.h"
+#include "dac.h"
+
+SoaLimiter::SoaLimiter()
+    : dcPower(), alpha(0), inverseBeta(0), rise(0), junctionTemperature(25), allowedPower(0), limiting(false) {}
+
+void SoaLimiter::init() {
+    // DC SOA: current limit at low voltage, constant power, then the secondary breakdown line
+    for (int v = 0; v <= SOA_TABLE_MAX_VOLTAGE; v++) {
+        float power = min((float)(v * SOA_DC_CURRENT), (float)SOA_DC_POWER);
+        if (v > SOA_SB_VOLTAGE) power = SOA_DC_POWER * powf(SOA_SB_VOLTAGE / v, SOA_SB_EXPONENT);
+        dcPower[v] = power;
+    }
+
+    alpha = 1 - expf(-SOA_PERIOD_S / SOA_TAU_S);
+    inverseBeta = 1 / (1 - expf(-SOA_HORIZON_S / SOA_TAU_S));
+    allowedPower = 0; // Nothing is allowed until the first update()
+
+    Serial.printf("[SOA] Initialized - %d MOSFETs, %.0f W DC at 25 °C, %.0f W at %d V, Tj max %.0f °C\n",
+                  CANT_MOSFET, CANT_MOSFET * SOA_DC_POWER, CANT_MOSFET * dcPower[SOA_TABLE_MAX_VOLTAGE],
+                  SOA_TABLE_MAX_VOLTAGE, SOA_TJ_MAX);
+}
+
+void SoaLimiter::update(float heatsinkTemperature, float voltage, float current) {
+    // Current shares evenly between the MOSFETs (one sense resistor each)
+    float power = voltage * current / CANT_MOSFET;
+    if (!(power > 0)) power = 0; // Also rejects NaN
+    rise += alpha * (power * SOA_RTH_JH - rise);
+    junctionTemperature = heatsinkTemperature + rise;
+
+    // DC SOA derated linearly from 25 °C to SOA_TJ_MAX at the heatsink temperature
+    float headroom = SOA_TJ_MAX - heatsinkTemperature;
+    float derating = constrain(headroom / (float)(SOA_TJ_MAX - 25), 0.0f, 1.0f);
+    float dcLimit = dc_power_at(voltage) * derating;
+
+    // Power that brings the junction exactly to SOA_TJ_MAX after SOA_HORIZON_S
+    float thermalLimit = (rise + (headroom - rise) * inverseBeta) / SOA_RTH_JH;
+    if (thermalLimit < 0) thermalLimit = 0;
+
+    allowedPower = min(min(dcLimit, thermalLimit) * CANT_MOSFET, (float)DAC_CW_MAX_POWER);
+}
+
+float SoaLimiter::clamp_current(float current, float voltage) {
+    float limit = voltage > SOA_MIN_VOLTAGE ? allowedPower / voltage : current;
+    limiting = current > limit;
+    return limiting ? limit : current;
+}
+
+float SoaLimiter::clamp_power(float power) {
+    limiting = power > allowedPower;
+    return limiting ? allowedPower : power;
+}
+
+float SoaLimiter::clamp_resistance(float resistance, float voltage, float maxResistance) {
+    if (!(voltage > SOA_MIN_VOLTAGE)) { // Like clamp_current: no power to limit near 0 V
+        limiting = false;
+        return resistance;
+    }
+    // P = V^2 / R, so the smallest allowed resistance grows with V^2
+    float minResistance = allowedPower > 0 ? voltage * voltage / (allowedPower * 1000) : maxResistance;
+    if (minResistance > maxResistance) minResistance = maxResistance;
+    limiting = resistance < minResistance;
+    return limiting ? minResistance : resistance;
+}
+
+float SoaLimiter::get_allowed_power() const { return allowedPower; }
+
+float SoaLimiter::get_junction_temperature() const { return junctionTemperature; }
+
+bool SoaLimiter::is_limiting() const { return limiting; }
+
+float SoaLimiter::dc_power_at(float voltage) const {
+    if (!(voltage > 0)) return dcPower[0];
+    if (voltage >= SOA_TABLE_MAX_VOLTAGE) return dcPower[SOA_TABLE_MAX_VOLTAGE];
+    int index = (int)voltage;
+    float fraction = voltage - index;
+    return dcPower[index] + fraction * (dcPower[index + 1] - dcPower[index]);
+}
@@ -0,0 +1,86 @@
+#include "statistics.h"
+
+void StatAccumulator::reset() {
+    count = 0;
+    mean = 0;
+    m2 = 0;
+    min = INFINITY;
+    max = -INFINITY;
+}
+
+void StatAccumulator::add(const StatSummary& summary) {
+    if (summary.count == 0) return;
+    uint32_t total = count + summary.count;
+    double delta = summary.mean - mean;
+    mean += delta * summary.count / total;
+    m2 += summary.m2 + delta * delta * ((double)count * summary.count / total);
+    count = total;
+    if (summary.min < min) min = summary.min;
+    if (summary.max > max) max = summary.max;
+}
+
+void StatAccumulator::remove(const StatSummary& summary) {
+    if (summary.count >= count) {
+        reset();
+        return;
+    }
+    uint32_t remaining = count - summary.count;
+    double remainingMean = (mean * count - (double)summary.mean * summary.count) / remaining;
+    double delta = summary.mean - remainingMean;
+    m2 -= summary.m2 + delta * delta * ((double)remaining * summary.count / count);
+    if (m2 < 0) m2 = 0; // Rounding
+    mean = remainingMean;
+    count = remaining;
+}
+
+StatSummary StatAccumulator::to_summary() const {
+    return {count, (float)mean, (float)m2, min, max};
+}
+
+WindowStatistics StatAccumulator::result(float minValue, float maxValue) const {
+    if (count == 0) return {0, 0, 0, 0, 0};
+    float stddev = count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    return {minValue, maxValue, (float)mean, stddev, count};
+}
+
+RollingStatistics::RollingStatistics() : blockSamples(0) {
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+        channels[c].block.reset();
+        channels[c].session.reset();
+    }
+}
+
+void RollingStatistics::add_sample(float voltage, float current, float power, float temperature) {
+    const float values[STAT_CHANNEL_COUNT] = {voltage, current, power, temperature};
+    bool blockDone = ++blockSamples >= STATISTICS_BLOCK_SAMPLES;
+    if (blockDone) blockSamples = 0;
+
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+        Channel& channel = channels[c];
+        StatSummary sample = {1, values[c], 0, values[c], values[c]};
+        channel.fast.add(sample);
+        channel.block.add(sample);
+        channel.session.add(sample);
+
+        if (blockDone) {
+            StatSummary block = channel.block.to_summary();
+            channel.medium.add(block);
+            channel.slow.add(block);
+            channel.block.reset();
+        }
+    }
+}
+
+void RollingStatistics::reset_session() {
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) channels[c].session.reset();
+}
+
+void RollingStatistics::get_snapshot(StatisticsSnapshot& snapshot) const {
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+        const Channel& channel = channels[c];
+        snapshot.values[c][STAT_WINDOW_1S] = channel.fast.result();
+        snapshot.values[c][STAT_WINDOW_10S] = channel.medium.result();
+        snapshot.values[c][STAT_WINDOW_60S] = channel.slow.result();
+        snapshot.values[c][STAT_WINDOW_SESSION] = channel.session.result(channel.session.min, channel.session.max);
+    }
+}
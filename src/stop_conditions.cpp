@@ -0,0 +1,101 @@
+#include "stop_conditions.h"
+
+StopConditions::StopConditions()
+    : count(0), revision(0), startUs(0), integrator(), historyCount(0), historyIndex(0),
+      elapsedS(0), chargeAh(0), dvdt(0), fireCount(0), firedIndex(-1), firedValue(0) {}
+
+bool StopConditions::is_valid(STOP_VARIABLE variable, char comparison) {
+    return variable < STOP_VAR_COUNT && (comparison == '<' || comparison == '>');
+}
+
+bool StopConditions::add(STOP_VARIABLE variable, char comparison, float threshold) {
+    if (!is_valid(variable, comparison) || count >= STOP_MAX_CONDITIONS) {
+        LOG_E(LOG_STOP, "Invalid stop condition or list full");
+        return false;
+    }
+    conditions[count] = {variable, comparison == '>' ? 1.0f : -1.0f, threshold};
+    count = count + 1;
+    revision = revision + 1;
+    LOG_I(LOG_STOP, "Condition %d: %s %c %.3f", count, get_variable_name(variable), comparison, threshold);
+    return true;
+}
+
+void StopConditions::clear() {
+    count = 0;
+    revision = revision + 1;
+}
+
+void StopConditions::begin_session(float voltage, float current, int64_t timeUs) {
+    startUs = timeUs;
+    integrator.reset();
+    integrator.add_sample(voltage, current, timeUs, true); // First point of the first interval
+    historyCount = 0;
+    historyIndex = 0;
+    elapsedS = 0;
+    chargeAh = 0;
+    dvdt = 0;
+    firedIndex = -1;
+}
+
+bool StopConditions::evaluate(float voltage, float current, int64_t timeUs) {
+    // Derived quantities since the output was enabled, over the sample timestamps
+    integrator.add_sample(voltage, current, timeUs, true);
+    elapsedS = (timeUs - startUs) * 1e-6f;
+    chargeAh = integrator.get_charge_ah();
+
+    // Slope over the last STOP_DVDT_SAMPLES samples, which smooths single-sample noise
+    uint8_t oldest = (historyCount < STOP_DVDT_SAMPLES) ? 0 : historyIndex;
+    if (historyCount > 0 && timeUs != timeHistory[oldest]) {
+        dvdt = (voltage - voltageHistory[oldest]) / ((timeUs - timeHistory[oldest]) * 1e-6f);
+    }
+    voltageHistory[historyIndex] = voltage;
+    timeHistory[historyIndex] = timeUs;
+    historyIndex = (historyIndex + 1) % STOP_DVDT_SAMPLES;
+    if (historyCount < STOP_DVDT_SAMPLES) historyCount++;
+
+    const float values[STOP_VAR_COUNT] = {voltage, current, voltage * current, elapsedS, chargeAh, dvdt};
+    bool slopeReady = historyCount >= STOP_DVDT_SAMPLES;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const StopCondition& condition = conditions[i];
+        if (condition.variable == STOP_VAR_DVDT && !slopeReady) continue;
+        float value = values[condition.variable];
+        if (condition.sign * (value - condition.threshold) > 0) {
+            firedIndex = i;
+            firedValue = value;
+            fireCount = fireCount + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t StopConditions::get_revision() const { return revision; }
+
+uint8_t StopConditions::get_count() const { return count; }
+
+const StopCondition& StopConditions::get_condition(uint8_t index) const { return conditions[index]; }
+
+uint32_t StopConditions::get_fire_count() const { return fireCount; }
+
+int8_t StopConditions::get_fired_index() const { return firedIndex; }
+
+float StopConditions::get_fired_value() const { return firedValue; }
+
+float StopConditions::get_elapsed_s() const { return elapsedS; }
+
+float StopConditions::get_charge_ah() const { return chargeAh; }
+
+float StopConditions::get_dvdt() const { return dvdt; }
+
+const char* StopConditions::get_variable_name(STOP_VARIABLE variable) {
+    switch (variable) {
+        case STOP_VAR_VOLTAGE: return "V";
+        case STOP_VAR_CURRENT: return "I";
+        case STOP_VAR_POWER: return "P";
+        case STOP_VAR_TIME: return "t";
+        case STOP_VAR_CHARGE: return "Ah";
+        case STOP_VAR_DVDT: return "dV/dt";
+        default: return "?";
+    }
+}
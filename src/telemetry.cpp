@@ -0,0 +1,261 @@
+#include "telemetry.h"
+
+// JSON names of the groups and modes (FSM_MAIN_STATES order, INITAL and FINAL have no mode)
+static const char* const groupNames[TELEMETRY_GROUP_COUNT] = {"measurements", "state", "soa", "stats"};
+static const char* const modeNames[TELEMETRY_MODE_COUNT] = {
+    "UNKNOWN", "MENU", "CC", "CV", "CR", "CW", "SETTINGS", "CAL", "BAT", "IV", "MPPT", "UNKNOWN"
+};
+static const char* const typeNames[] = {"f32", "u8", "flag", "mode", "duration", "stats"};
+static const uint64_t powersOfTen[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+/**
+ * @brief Bounded writer into a caller buffer; remembers overflow instead of failing each call.
+ */
+struct JsonWriter {
+    char* p;
+    char* end;      ///< Last usable byte, kept for the terminating null
+    bool overflow;
+
+    JsonWriter(char* out, size_t size) : p(out), end(out + size - 1), overflow(size == 0) {}
+
+    void put(char c) {
+        if (p < end) *p++ = c;
+        else overflow = true;
+    }
+
+    void puts(const char* text) {
+        while (*text) put(*text++);
+    }
+
+    void string(const char* text) {
+        put('"');
+        puts(text);
+        put('"');
+    }
+
+    void key(const char* name) {
+        string(name);
+        put(':');
+    }
+
+    void integer(uint64_t value) {
+        char digits[20];
+        uint8_t n = 0;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        while (n > 0) put(digits[--n]);
+    }
+
+    // Fixed decimals with trailing zeros removed; non-finite values are null, as ArduinoJson writes them
+    void number(float value, uint8_t decimals) {
+        if (!isfinite(value)) {
+            puts("null");
+            return;
+        }
+        double scaled = fabs((double)value) * powersOfTen[decimals];
+        if (scaled >= 1e15) { // Beyond the fixed-point range
+            char text[24];
+            snprintf(text, sizeof(text), "%.9g", value);
+            puts(text);
+            return;
+        }
+        uint64_t fixed = (uint64_t)(scaled + 0.5);
+        if (value < 0 && fixed > 0) put('-');
+        integer(fixed / powersOfTen[decimals]);
+        uint64_t fraction = fixed % powersOfTen[decimals];
+        if (fraction == 0) return;
+        while (fraction % 10 == 0) {
+            fraction /= 10;
+            decimals--;
+        }
+        put('.');
+        for (uint8_t d = decimals; d > 0; d--) put('0' + (fraction / powersOfTen[d - 1]) % 10);
+    }
+
+    size_t finish(char* out) {
+        *p = '\0';
+        return overflow ? 0 : p - out;
+    }
+};
+
+const char* telemetry_get_mode_name(uint8_t state) {
+    return state < TELEMETRY_MODE_COUNT ? modeNames[state] : "UNKNOWN";
+}
+
+static float read_float(const uint8_t* frame, uint16_t offset) {
+    float value;
+    memcpy(&value, frame + offset, sizeof(value));
+    return value;
+}
+
+static void write_duration(JsonWriter& json, uint32_t ms) {
+    uint32_t totalSeconds = ms / 1000;
+    uint32_t hours = totalSeconds / 3600;
+    char text[16]; // HHH:MM:SS above 99 hours, like format_uptime()
+    snprintf(text, sizeof(text), hours > 99 ? "%03lu:%02u:%02u" : "%02lu:%02u:%02u",
+             (unsigned long)hours, (unsigned)(totalSeconds / 60 % 60), (unsigned)(totalSeconds % 60));
+    json.string(text);
+}
+
+size_t telemetry_write_json(const TelemetryFrame& frame, char* out, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)&frame;
+    JsonWriter json(out, size);
+    int8_t group = -1;
+
+    json.put('{');
+    for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        const TelemetryField& field = telemetryFields[i];
+        if (field.group != group) { // Fields of a group are contiguous
+            if (group >= 0) json.puts("},");
+            group = field.group;
+            json.key(groupNames[group]);
+            json.put('{');
+        } else {
+            json.put(',');
+        }
+        json.key(field.name);
+
+        switch (field.type) {
+            case TELEMETRY_F32:
+                json.number(read_float(bytes, field.offset), field.argument);
+                break;
+            case TELEMETRY_U8:
+                json.integer(bytes[field.offset]);
+                break;
+            case TELEMETRY_FLAG:
+                json.puts((bytes[field.offset] & (1 << field.argument)) ? "true" : "false");
+                break;
+            case TELEMETRY_MODE:
+                json.string(telemetry_get_mode_name(bytes[field.offset]));
+                break;
+            case TELEMETRY_DURATION: {
+                uint32_t ms;
+                memcpy(&ms, bytes + field.offset, sizeof(ms));
+                write_duration(json, ms);
+                break;
+            }
+            case TELEMETRY_STATISTICS:
+                json.put('[');
+                for (uint8_t w = 0; w < STAT_WINDOW_COUNT; w++) {
+                    json.puts(w ? ",[" : "[");
+                    for (uint8_t k = 0; k < 4; k++) {
+                        if (k) json.put(',');
+                        json.number(read_float(bytes, field.offset + (w * 4 + k) * sizeof(float)), field.argument);
+                    }
+                    json.put(']');
+                }
+                json.put(']');
+                break;
+        }
+    }
+    json.puts("}}");
+    return json.finish(out);
+}
+
+size_t telemetry_write_schema(char* out, size_t size) {
+    JsonWriter json(out, size);
+    json.puts("{\"schema\":");
+    json.integer(TELEMETRY_SCHEMA_ID);
+    json.puts(",\"frameSize\":");
+    json.integer(TELEMETRY_FRAME_SIZE);
+    json.puts(",\"statistics\":{\"windows\":[\"1s\",\"10s\",\"60s\",\"session\"],\"values\":[\"min\",\"max\",\"mean\",\"stddev\"]}");
+
+    json.puts(",\"modes\":[");
+    for (uint8_t i = 0; i < TELEMETRY_MODE_COUNT; i++) {
+        if (i) json.put(',');
+        json.string(modeNames[i]);
+    }
+
+    json.puts("],\"fields\":[");
+    for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        const TelemetryField& field = telemetryFields[i];
+        if (i) json.put(',');
+        json.puts("{\"group\":");
+        json.string(groupNames[field.group]);
+        json.puts(",\"name\":");
+        json.string(field.name);
+        json.puts(",\"type\":");
+        json.string(typeNames[field.type]);
+        json.puts(",\"offset\":");
+        json.integer(field.offset);
+        json.puts(field.type == TELEMETRY_FLAG ? ",\"bit\":" : ",\"precision\":");
+        json.integer(field.argument);
+        if (field.unit[0]) {
+            json.puts(",\"unit\":");
+            json.string(field.unit);
+        }
+        json.put('}');
+    }
+    json.puts("]}");
+    return json.finish(out);
+}
+
+/**
+ * @brief Deadband of every 32-bit word of the frame, expanded once from telemetryFields.
+ */
+struct WordDeadbands {
+    float values[TELEMETRY_WORD_COUNT];
+    bool isDuration[TELEMETRY_WORD_COUNT];
+
+    WordDeadbands() : values(), isDuration() {
+        for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+            const TelemetryField& field = telemetryFields[i];
+            if (field.offset < TELEMETRY_WORD_OFFSET) continue; // Header bytes are in every delta
+            uint8_t first = (field.offset - TELEMETRY_WORD_OFFSET) / 4;
+            for (uint8_t w = 0; w < telemetry_field_size(field) / 4; w++) {
+                bool stddev = field.type == TELEMETRY_STATISTICS && w % 4 == 3;
+                values[first + w] = stddev ? field.deadband / 10 : field.deadband;
+                isDuration[first + w] = field.type == TELEMETRY_DURATION;
+            }
+        }
+    }
+};
+
+static const WordDeadbands deadbands;
+
+static bool word_changed(uint8_t word, uint32_t current, uint32_t previous) {
+    if (current == previous) return false;
+    if (deadbands.isDuration[word]) { // uint32 ms, resent when the shown unit changes
+        uint32_t resolution = (uint32_t)deadbands.values[word];
+        return current / resolution != previous / resolution;
+    }
+    float a, b;
+    memcpy(&a, &current, sizeof(a));
+    memcpy(&b, &previous, sizeof(b));
+    if (!isfinite(a) || !isfinite(b)) return true;
+    return fabsf(a - b) > deadbands.values[word];
+}
+
+size_t telemetry_encode_delta(const TelemetryFrame& frame, TelemetryFrame& baseline, uint8_t* out) {
+    const uint8_t* current = (const uint8_t*)&frame + TELEMETRY_WORD_OFFSET;
+    uint8_t* previous = (uint8_t*)&baseline + TELEMETRY_WORD_OFFSET;
+    uint8_t* bitmap = out + 8;
+    uint8_t* words = out + TELEMETRY_DELTA_HEADER_SIZE;
+    uint16_t count = 0;
+
+    memset(bitmap, 0, TELEMETRY_BITMAP_SIZE);
+    for (uint8_t w = 0; w < TELEMETRY_WORD_COUNT; w++) {
+        uint32_t a, b;
+        memcpy(&a, current + w * 4, 4);
+        memcpy(&b, previous + w * 4, 4);
+        if (!word_changed(w, a, b)) continue;
+        if (TELEMETRY_DELTA_HEADER_SIZE + (count + 1) * 4 >= TELEMETRY_FRAME_SIZE) return 0; // A keyframe is smaller
+        bitmap[w / 8] |= 1 << (w % 8);
+        memcpy(words + count * 4, &a, 4);
+        count++;
+    }
+
+    // The baseline only takes the words that were written
+    for (uint8_t w = 0; w < TELEMETRY_WORD_COUNT; w++) {
+        if (bitmap[w / 8] & (1 << (w % 8))) memcpy(previous + w * 4, current + w * 4, 4);
+    }
+    memcpy(&baseline, &frame, TELEMETRY_WORD_OFFSET);
+
+    out[0] = 'T';
+    out[1] = 'D';
+    memcpy(out + 2, &frame.schema, 4); // Schema, state, flags, fan speed
+    memcpy(out + 6, &count, sizeof(count));
+    return TELEMETRY_DELTA_HEADER_SIZE + count * 4;
+}
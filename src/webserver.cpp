@@ -1,7 +1,10 @@
 #include "webserver.h"
+#include <esp_timer.h>
 
 WebServerESP32::WebServerESP32(const char* ssidAP, const char* passwordAP, uint16_t port)
-    : _ssidAP(ssidAP), _passwordAP(passwordAP), _port(port), _server(port), _ws("/ws") { // Initialize _ws
+    : _ssidAP(ssidAP), _passwordAP(passwordAP), _port(port), _server(port), _ws("/ws"), // Initialize _ws
+      _clients(), _clientsLock(portMUX_INITIALIZER_UNLOCKED), _baselines(), _fanout(), _fanoutLock(portMUX_INITIALIZER_UNLOCKED) {
+    _fanout.minUs = UINT32_MAX;
 }
 
 void WebServerESP32::begin() {
@@ -49,7 +52,9 @@ void WebServerESP32::setup_wifi() {
 void WebServerESP32::setup_server() {
     // Attach the WebSocket event handler if it's set
     if (_wsHandler) {
-        _ws.onEvent(_wsHandler);
+        _ws.onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+            handle_ws_event(server, client, type, arg, data, len);
+        });
         Serial.println("[WEBSERVER] WebSocket handler attached");
     } else {
          Serial.println("[WEBSERVER] WARNING: WebSocket handler not set!");
@@ -61,6 +66,10 @@ void WebServerESP32::on(const char* uri, WebRequestMethodComposite method, ArReq
     _server.on(uri, method, onRequest);
 }
 
+void WebServerESP32::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArBodyHandlerFunction onBody) {
+    _server.on(uri, method, onRequest, nullptr, onBody);
+}
+
 void WebServerESP32::serve_static(const char* uri, fs::FS& fs, const char* path, const char* cache_control) {
     _server.serveStatic(uri, fs, path, cache_control);
 }
@@ -80,11 +89,217 @@ void WebServerESP32::attachWsHandler(WsEventHandler handler) {
     // Note: Typically, attachWsHandler should be called before begin().
     // If called after begin(), this ensures the handler is attached immediately.
     // Calling onEvent multiple times (here and in setup_server) is generally safe.
-    _ws.onEvent(_wsHandler);
+    _ws.onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+        handle_ws_event(server, client, type, arg, data, len);
+    });
+}
+
+void WebServerESP32::handle_ws_event(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+    // Track clients for the per-client state format; new clients start with JSON
+    if (type == WS_EVT_CONNECT || type == WS_EVT_DISCONNECT) {
+        uint32_t id = client->id();
+        portENTER_CRITICAL(&_clientsLock);
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+            if (type == WS_EVT_DISCONNECT && _clients[i].id == id) {
+                _clients[i].id = 0;
+                break;
+            }
+            if (type == WS_EVT_CONNECT && _clients[i].id == 0) {
+                _clients[i] = {id, WS_FORMAT_JSON, true};
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_clientsLock);
+    }
+
+    if (_wsHandler) _wsHandler(server, client, type, arg, data, len);
+}
+
+bool WebServerESP32::set_client_format(uint32_t id, WS_FORMAT format) {
+    bool found = false;
+    portENTER_CRITICAL(&_clientsLock);
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (_clients[i].id == id) {
+            _clients[i].format = format;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_clientsLock);
+    return found;
+}
+
+WS_FORMAT WebServerESP32::get_client_format(uint32_t id) {
+    WS_FORMAT format = WS_FORMAT_JSON;
+    portENTER_CRITICAL(&_clientsLock);
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (_clients[i].id == id) {
+            format = _clients[i].format;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_clientsLock);
+    return format;
+}
+
+void WebServerESP32::request_keyframe(uint32_t id) {
+    portENTER_CRITICAL(&_clientsLock);
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (_clients[i].id == id) {
+            _clients[i].keyframeRequested = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_clientsLock);
+}
+
+void WebServerESP32::notifyClientsState(const TelemetryFrame& frame) {
+    ClientSlot clients[WS_MAX_CLIENTS];
+    portENTER_CRITICAL(&_clientsLock);
+    memcpy(clients, _clients, sizeof(clients));
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) _clients[i].keyframeRequested = false;
+    portEXIT_CRITICAL(&_clientsLock);
+
+    int64_t startUs = esp_timer_get_time();
+    uint32_t now = millis();
+    uint8_t delta[TELEMETRY_DELTA_MAX_SIZE];
+    // Built on first use and shared by every client that needs them: JSON is not serialized when every client is binary
+    AsyncWebSocketMessageBuffer* json = nullptr;
+    AsyncWebSocketMessageBuffer* keyframe = nullptr;
+    bool jsonFailed = false, keyframeFailed = false;
+    uint32_t deliveries = 0, maxQueued = 0;
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (clients[i].id == 0) continue;
+        AsyncWebSocketClient* client = _ws.client(clients[i].id);
+        if (client == nullptr || client->status() != WS_CONNECTED) continue;
+        maxQueued = max(maxQueued, (uint32_t)client->queueLen());
+
+        if (clients[i].format == WS_FORMAT_BINARY) {
+            TelemetryBaseline& baseline = _baselines[i];
+            bool sendKeyframe = clients[i].keyframeRequested || baseline.id != clients[i].id ||
+                                now - baseline.keyframeMs >= TELEMETRY_KEYFRAME_INTERVAL_MS;
+            if (client->queueIsFull()) {
+                // Dropped by the library otherwise; the baseline stays at the last queued frame
+                if (sendKeyframe) request_keyframe(clients[i].id);
+                continue;
+            }
+            size_t length = sendKeyframe ? 0 : telemetry_encode_delta(frame, baseline.frame, delta);
+            if (length > 0) {
+                client->binary(delta, length); // Deltas differ per client
+            } else {
+                if (keyframe == nullptr && !keyframeFailed) {
+                    keyframe = make_shared_buffer((const uint8_t*)&frame, sizeof(frame));
+                    keyframeFailed = keyframe == nullptr;
+                }
+                if (keyframe == nullptr) {
+                    request_keyframe(clients[i].id);
+                    continue;
+                }
+                client->binary(keyframe);
+                deliveries++;
+                baseline.frame = frame;
+                baseline.id = clients[i].id;
+                baseline.keyframeMs = now;
+            }
+        } else {
+            if (json == nullptr && !jsonFailed) {
+                size_t length = telemetry_write_json(frame, _stateJson, sizeof(_stateJson));
+                json = length > 0 ? make_shared_buffer((const uint8_t*)_stateJson, length) : nullptr;
+                jsonFailed = json == nullptr;
+            }
+            if (json == nullptr) continue;
+            client->text(json);
+            deliveries++;
+        }
+    }
+
+    // Queued messages now hold their own references; the library frees each buffer after its last send
+    if (json) json->unlock();
+    if (keyframe) keyframe->unlock();
+    if (json || keyframe) _ws._cleanBuffers();
+    if (deliveries > 0) record_fanout(startUs, deliveries, maxQueued);
+}
+
+AsyncWebSocketMessageBuffer* WebServerESP32::make_shared_buffer(const uint8_t* data, size_t length) {
+    AsyncWebSocketMessageBuffer* buffer = _ws.makeBuffer(length);
+    if (buffer) buffer->lock(); // Kept alive until every client has queued it
+    portENTER_CRITICAL(&_fanoutLock);
+    if (buffer) {
+        _fanout.buffers++;
+        _fanout.bytes += length;
+    } else {
+        _fanout.allocationFailures++;
+    }
+    portEXIT_CRITICAL(&_fanoutLock);
+    if (buffer == nullptr) return nullptr;
+    memcpy(buffer->get(), data, length);
+    return buffer;
+}
+
+void WebServerESP32::record_fanout(int64_t startUs, uint32_t deliveries, uint32_t maxQueued) {
+    uint32_t elapsedUs = esp_timer_get_time() - startUs;
+    portENTER_CRITICAL(&_fanoutLock);
+    _fanout.broadcasts++;
+    _fanout.deliveries += deliveries;
+    _fanout.maxQueued = max(_fanout.maxQueued, maxQueued);
+    _fanout.minUs = min(_fanout.minUs, elapsedUs);
+    _fanout.maxUs = max(_fanout.maxUs, elapsedUs);
+    _fanout.totalUs += elapsedUs;
+    portEXIT_CRITICAL(&_fanoutLock);
+}
+
+FanoutStats WebServerESP32::get_fanout_stats() {
+    portENTER_CRITICAL(&_fanoutLock);
+    FanoutStats copy = _fanout;
+    portEXIT_CRITICAL(&_fanoutLock);
+    return copy;
+}
+
+void WebServerESP32::reset_fanout_stats() {
+    portENTER_CRITICAL(&_fanoutLock);
+    _fanout = FanoutStats();
+    _fanout.minUs = UINT32_MAX;
+    portEXIT_CRITICAL(&_fanoutLock);
+}
+
+void WebServerESP32::print_fanout_report() {
+    FanoutStats stats = get_fanout_stats();
+    Serial.printf("[WEBSERVER] Fan-out: %lu broadcasts, %lu buffers (%lu failed), %lu client messages, %lu bytes serialized\n",
+                  (unsigned long)stats.broadcasts, (unsigned long)stats.buffers, (unsigned long)stats.allocationFailures,
+                  (unsigned long)stats.deliveries, (unsigned long)stats.bytes);
+    if (stats.broadcasts > 0) {
+        Serial.printf("[WEBSERVER] Fan-out time min/avg/max %lu/%lu/%lu us, longest client queue %lu\n",
+                      (unsigned long)stats.minUs, (unsigned long)(stats.totalUs / stats.broadcasts), (unsigned long)stats.maxUs,
+                      (unsigned long)stats.maxQueued);
+    }
+}
+
+bool WebServerESP32::try_send_binary(uint32_t id, const uint8_t* data, size_t length, size_t maxQueued) {
+    AsyncWebSocketClient* client = _ws.client(id);
+    if (client == nullptr || client->status() != WS_CONNECTED) return false;
+    if (client->queueIsFull() || client->queueLen() >= maxQueued) return false;
+    client->binary(data, length);
+    return true;
 }
 
 void WebServerESP32::notifyClients(const String& message) {
-    _ws.textAll(message);
+    if (_ws.count() == 0) return;
+    int64_t startUs = esp_timer_get_time();
+    uint32_t deliveries = _ws.count();
+    AsyncWebSocketMessageBuffer* buffer = make_shared_buffer((const uint8_t*)message.c_str(), message.length());
+    if (buffer == nullptr) return;
+    _ws.textAll(buffer); // Unlocks the buffer after the fan-out; freed after the last send
+    record_fanout(startUs, deliveries, 0);
+}
+
+void WebServerESP32::notifyClientsBinary(const uint8_t* data, size_t length) {
+    if (_ws.count() == 0) return;
+    int64_t startUs = esp_timer_get_time();
+    uint32_t deliveries = _ws.count();
+    AsyncWebSocketMessageBuffer* buffer = make_shared_buffer(data, length);
+    if (buffer == nullptr) return;
+    _ws.binaryAll(buffer);
+    record_fanout(startUs, deliveries, 0);
 }
 
 void WebServerESP32::cleanupClients() {
@@ -0,0 +1,37 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core used by the native test environment.
+ *
+ * Only what the modules under test touch is provided: fixed-width types, math,
+ * Serial printing to stdout and millis(), which each test defines so that it can
+ * drive time itself.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <algorithm>
+
+#define IRAM_ATTR
+
+using std::min;
+using std::max;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+
+class HostSerial {
+public:
+    template <typename... Args>
+    int printf(const char* format, Args... args) { return ::printf(format, args...); }
+    size_t print(const char* text) { return ::printf("%s", text); }
+    size_t println(const char* text = "") { return ::printf("%s\n", text); }
+    size_t write(const uint8_t* buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+};
+
+inline HostSerial Serial;
@@ -0,0 +1,7 @@
+/**
+ * @file SPIFFS.h
+ * @brief Host stand-in for the SPIFFS driver; the modules under test never touch flash.
+ */
+#pragma once
+
+#include <Arduino.h>
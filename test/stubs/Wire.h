@@ -0,0 +1,9 @@
+/**
+ * @file Wire.h
+ * @brief Host stand-in for the Arduino I2C driver; only the type is needed.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire;
@@ -0,0 +1,188 @@
+/**
+ * @file test_main.cpp
+ * @brief Native simulation of the MPPT tracker against a PV panel model.
+ *
+ * The panel is a single-diode model, I = Isc - I0 * (exp(V / (n * Ns * Vt)) - 1),
+ * loaded in CC mode: the current written to the DAC is sunk and the panel
+ * settles at the voltage the model gives for it. MpptTracker::run() is called
+ * once per simulated control period (20 ms) with the sample produced by the
+ * setpoint of the previous period, as on the board. The DAC, analog switches,
+ * SOA limiter and logger are replaced by link seams below.
+ *
+ * Run with: pio test -e native -f test_mppt
+ */
+#include <unity.h>
+
+#include "../../src/mppt.cpp"
+
+#define CONTROL_PERIOD_MS 20
+#define PANEL_CELLS 36          /*!< Cells in series, 12 V nominal panel */
+#define PANEL_IDEALITY 1.3
+#define PANEL_THERMAL_VOLTAGE 0.02569 /*!< kT/q at 25 °C */
+
+static unsigned long nowMs = 0;
+static float loadCurrent = 0;   ///< Last current written to the DAC
+
+unsigned long millis() { return nowMs; }
+
+// Link seams for the peripherals used by the tracker
+DAC::DAC() {}
+void DAC::cc_mode_set_current(float current) { loadCurrent = current; }
+AnalogSws::AnalogSws() {}
+void AnalogSws::mosfet_input_cc_mode() {}
+void AnalogSws::v_dac_enable() {}
+SoaLimiter::SoaLimiter() {}
+float SoaLimiter::clamp_current(float current, float voltage) { return current; }
+Logger::Logger() : head(0), tail(0), dropped(0), reportedDropped(0), levels() {}
+void Logger::pack(LogRecord& record, const char* value) {}
+bool Logger::push(const LogRecord& record) { return true; }
+Logger logger;      ///< Every module level is LOG_LEVEL_NONE: records are never built
+
+void setUp() {}
+void tearDown() {}
+
+/**
+ * @struct PvPanel
+ * @brief Single-diode PV panel with a short-circuit current set by the irradiance.
+ */
+struct PvPanel {
+    double isc;
+    double i0;
+    double thermal;     ///< n * Ns * Vt
+
+    PvPanel(double shortCircuitCurrent, double openCircuitVoltage)
+        : isc(shortCircuitCurrent), thermal(PANEL_IDEALITY * PANEL_CELLS * PANEL_THERMAL_VOLTAGE) {
+        i0 = isc / (exp(openCircuitVoltage / thermal) - 1);
+    }
+
+    /** @brief Panel voltage while sinking the given current; above Isc the panel collapses. */
+    double voltage(double current) const {
+        if (current >= isc) return 0;
+        return thermal * log((isc - current) / i0 + 1);
+    }
+
+    /** @brief Maximum power found by scanning the I-V curve in 1 mA steps. */
+    double max_power() const {
+        double best = 0;
+        for (double current = 0; current < isc; current += 0.001) {
+            best = fmax(best, current * voltage(current));
+        }
+        return best;
+    }
+};
+
+/**
+ * @struct Run
+ * @brief Result of a simulated tracking run.
+ */
+struct Run {
+    bool locked;
+    uint32_t trackingMs;
+    float meanPower;    ///< Mean power over the last MPPT_RIPPLE_WINDOW iterations
+};
+
+static uint32_t noiseState = 1;
+
+/** @brief Deterministic ADC noise in [-amplitude, amplitude]. */
+static float noise(float amplitude) {
+    noiseState = noiseState * 1664525u + 1013904223u;
+    return amplitude * (2.0f * (noiseState >> 8) / (float)(1u << 24) - 1.0f);
+}
+
+/** @brief Advances one control period: samples the panel at the last setpoint and runs the tracker. */
+static float step_period(MpptTracker& tracker, const PvPanel& panel) {
+    nowMs += CONTROL_PERIOD_MS;
+    float current = fmin(loadCurrent, panel.isc);
+    float voltage = panel.voltage(current);
+    tracker.run(voltage + noise(0.002f), current + noise(0.001f));
+    return voltage * current;
+}
+
+/** @brief Tracks until locked (or the timeout), then keeps running for one ripple window. */
+static Run track(MpptTracker& tracker, const PvPanel& panel, uint32_t timeoutMs) {
+    uint32_t startMs = nowMs;
+    while (tracker.get_status() != MPPT_LOCKED && nowMs - startMs < timeoutMs) {
+        step_period(tracker, panel);
+    }
+
+    Run run = {tracker.get_status() == MPPT_LOCKED, tracker.get_tracking_ms(), 0};
+    double sum = 0;
+    for (int i = 0; i < MPPT_RIPPLE_WINDOW; i++) sum += step_period(tracker, panel);
+    run.meanPower = sum / MPPT_RIPPLE_WINDOW;
+    return run;
+}
+
+static void report(const char* name, const Run& run, const MpptTracker& tracker, double maxPower) {
+    printf("[MPPT] %s: tracking %lu ms, efficiency %.2f %%, ripple %.3f W / %.3f A\n",
+           name, (unsigned long)run.trackingMs, 100.0 * run.meanPower / maxPower,
+           tracker.get_power_ripple(), tracker.get_current_ripple());
+}
+
+static void check_tracking(MPPT_ALGORITHM algorithm, const char* name) {
+    PvPanel panel(5.5, 21.6);
+    double maxPower = panel.max_power();
+    MpptTracker tracker;
+    DAC dac;
+    AnalogSws sws;
+    SoaLimiter soa;
+    tracker.init(&dac, &sws, &soa);
+    nowMs = 0;
+    loadCurrent = 0;
+
+    TEST_ASSERT_TRUE(tracker.start(algorithm, 0.05, 8.0));
+    Run run = track(tracker, panel, 10000);
+    report(name, run, tracker, maxPower);
+
+    TEST_ASSERT_TRUE(run.locked);
+    TEST_ASSERT_LESS_THAN_UINT32(5000, run.trackingMs);     // 0 to Imp at 50 mA per 20 ms takes about 2 s
+    TEST_ASSERT_GREATER_OR_EQUAL_FLOAT(0.97 * maxPower, run.meanPower);
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(4 * 0.05 + 0.001, tracker.get_current_ripple()); // Oscillation of a few steps
+}
+
+void test_perturb_observe_reaches_mpp() {
+    check_tracking(MPPT_PERTURB_OBSERVE, "P&O");
+}
+
+void test_incremental_conductance_reaches_mpp() {
+    check_tracking(MPPT_INCREMENTAL_CONDUCTANCE, "IncCond");
+}
+
+void test_irradiance_step_is_followed() {
+    PvPanel panel(4.0, 21.0);
+    MpptTracker tracker;
+    DAC dac;
+    AnalogSws sws;
+    SoaLimiter soa;
+    tracker.init(&dac, &sws, &soa);
+    nowMs = 0;
+    loadCurrent = 0;
+
+    TEST_ASSERT_TRUE(tracker.start(MPPT_PERTURB_OBSERVE, 0.05, 8.0));
+    TEST_ASSERT_TRUE(track(tracker, panel, 10000).locked);
+
+    // Irradiance rises by 40 %: the operating point is left of the new MPP
+    PvPanel brighter(5.6, 21.3);
+    double maxPower = brighter.max_power();
+    for (int i = 0; i < 3000 / CONTROL_PERIOD_MS; i++) step_period(tracker, brighter);
+    Run run = track(tracker, brighter, 0);
+    report("P&O after irradiance step", run, tracker, maxPower);
+
+    TEST_ASSERT_GREATER_OR_EQUAL_FLOAT(0.97 * maxPower, run.meanPower);
+}
+
+void test_invalid_parameters_are_rejected() {
+    MpptTracker tracker;
+    TEST_ASSERT_FALSE(tracker.start(MPPT_PERTURB_OBSERVE, 0.0005, 8.0));  // Step below MPPT_MIN_STEP
+    TEST_ASSERT_FALSE(tracker.start(MPPT_PERTURB_OBSERVE, 0.05, 0.01));   // Maximum below the step
+    TEST_ASSERT_FALSE(tracker.start(MPPT_PERTURB_OBSERVE, 0.05, DAC_CC_MAX_CURRENT + 1));
+    TEST_ASSERT_FALSE(tracker.is_running());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_perturb_observe_reaches_mpp);
+    RUN_TEST(test_incremental_conductance_reaches_mpp);
+    RUN_TEST(test_irradiance_step_is_followed);
+    RUN_TEST(test_invalid_parameters_are_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,358 @@
+/**
+ * @file test_main.cpp
+ * @brief Native round-trip tests of the telemetry encoders and a JSON writer benchmark.
+ *
+ * The JSON state document is parsed back with ArduinoJson and compared with
+ * the frame field by field; the delta encoder is checked by patching a client
+ * copy of the frame the way applyTelemetryDelta() in data/index.js does. The
+ * benchmark times telemetry_write_json() against building and serializing the
+ * same document with ArduinoJson, as get_current_state_json() used to.
+ *
+ * Run with: pio test -e native -f test_telemetry
+ */
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <chrono>
+
+#include "../../src/telemetry.cpp"
+
+#define BENCHMARK_ITERATIONS 20000
+
+static uint32_t randomState = 1;
+
+void setUp() {
+    randomState = 1;
+}
+
+void tearDown() {}
+
+/** @brief Deterministic value in [low, high). */
+static float random_float(float low, float high) {
+    randomState = randomState * 1664525u + 1013904223u;
+    return low + (high - low) * (randomState >> 8) / (float)(1u << 24);
+}
+
+/** @brief Frame with plausible readings; the 60 s window of temperature is still empty (NaN). */
+static void fill_frame(TelemetryFrame& frame, uint32_t outputTimeMs) {
+    memset(&frame, 0, sizeof(frame));
+    frame.magic[0] = 'T';
+    frame.magic[1] = 'M';
+    frame.schema = TELEMETRY_SCHEMA_ID;
+    frame.state = 2; // CC
+    frame.flags = TELEMETRY_FLAG_OUTPUT_ACTIVE;
+    frame.fanSpeed = 40;
+    frame.outputTimeMs = outputTimeMs;
+    frame.setpoint = 2.5f;
+    frame.voltage = random_float(11.9f, 12.1f);
+    frame.current = random_float(2.49f, 2.51f);
+    frame.power = frame.voltage * frame.current;
+    frame.resistance = frame.voltage / frame.current;
+    frame.temperature = random_float(35.0f, 36.0f);
+    frame.energyJ = frame.power * outputTimeMs / 1000.0f;
+    frame.energyWh = frame.energyJ / 3600.0f;
+    frame.chargeC = frame.current * outputTimeMs / 1000.0f;
+    frame.chargeAh = frame.chargeC / 3600.0f;
+    frame.soaAllowed = random_float(150.0f, 160.0f);
+    frame.soaJunction = random_float(50.0f, 52.0f);
+
+    const float centers[STAT_CHANNEL_COUNT] = {frame.voltage, frame.current, frame.power, frame.temperature};
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+        for (uint8_t w = 0; w < STAT_WINDOW_COUNT; w++) {
+            frame.statistics[c][w][0] = centers[c] - random_float(0, 0.01f);
+            frame.statistics[c][w][1] = centers[c] + random_float(0, 0.01f);
+            frame.statistics[c][w][2] = centers[c] + random_float(-0.001f, 0.001f);
+            frame.statistics[c][w][3] = random_float(0, 0.004f);
+        }
+    }
+    for (uint8_t k = 0; k < 4; k++) frame.statistics[STAT_TEMPERATURE][STAT_WINDOW_60S][k] = NAN;
+}
+
+static void format_uptime(uint32_t ms, char* text, size_t size) {
+    uint32_t totalSeconds = ms / 1000;
+    uint32_t hours = totalSeconds / 3600;
+    snprintf(text, size, hours > 99 ? "%03lu:%02u:%02u" : "%02lu:%02u:%02u",
+             (unsigned long)hours, (unsigned)(totalSeconds / 60 % 60), (unsigned)(totalSeconds % 60));
+}
+
+/** @brief The state document as get_current_state_json() built it before telemetry_write_json(). */
+static size_t write_arduinojson(const TelemetryFrame& frame, char* out, size_t size) {
+    JsonDocument doc;
+    char uptime[16];
+    format_uptime(frame.outputTimeMs, uptime, sizeof(uptime));
+
+    JsonObject measurements = doc["measurements"].to<JsonObject>();
+    measurements["voltage"] = frame.voltage;
+    measurements["current"] = frame.current;
+    measurements["power"] = frame.power;
+    measurements["resistance"] = frame.resistance;
+    measurements["temperature"] = frame.temperature;
+    measurements["fanSpeed"] = frame.fanSpeed;
+    measurements["uptime"] = uptime;
+    measurements["energy"] = frame.energyJ;
+    measurements["Wh"] = frame.energyWh;
+    measurements["charge"] = frame.chargeC;
+    measurements["Ah"] = frame.chargeAh;
+
+    JsonObject state = doc["state"].to<JsonObject>();
+    state["mode"] = telemetry_get_mode_name(frame.state);
+    state["outputActive"] = (frame.flags & TELEMETRY_FLAG_OUTPUT_ACTIVE) != 0;
+    state["value"] = frame.setpoint;
+
+    JsonObject soa = doc["soa"].to<JsonObject>();
+    soa["allowed"] = frame.soaAllowed;
+    soa["junction"] = frame.soaJunction;
+    soa["limiting"] = (frame.flags & TELEMETRY_FLAG_SOA_LIMITING) != 0;
+
+    static const char* const channelNames[STAT_CHANNEL_COUNT] = {"V", "I", "P", "T"};
+    JsonObject stats = doc["stats"].to<JsonObject>();
+    for (uint8_t c = 0; c < STAT_CHANNEL_COUNT; c++) {
+        JsonArray windows = stats[channelNames[c]].to<JsonArray>();
+        for (uint8_t w = 0; w < STAT_WINDOW_COUNT; w++) {
+            JsonArray item = windows.add<JsonArray>();
+            for (uint8_t k = 0; k < 4; k++) item.add(frame.statistics[c][w][k]);
+        }
+    }
+    return serializeJson(doc, out, size);
+}
+
+/** @brief Checks a parsed number against a frame float written with the given decimals. */
+static void check_number(JsonVariantConst value, float expected, uint8_t decimals, const char* name) {
+    if (!isfinite(expected)) {
+        TEST_ASSERT_TRUE_MESSAGE(value.isNull(), name);
+        return;
+    }
+    double tolerance = 0.5 / powersOfTen[decimals] + fabs(expected) * 1e-9;
+    TEST_ASSERT_TRUE_MESSAGE(fabs(value.as<double>() - expected) <= tolerance, name); // Compared as double
+}
+
+static void check_json(const TelemetryFrame& frame) {
+    const uint8_t* bytes = (const uint8_t*)&frame;
+    char json[TELEMETRY_JSON_MAX_SIZE];
+    size_t length = telemetry_write_json(frame, json, sizeof(json));
+    TEST_ASSERT_GREATER_THAN(0, length);
+    TEST_ASSERT_EQUAL(strlen(json), length);
+
+    JsonDocument doc;
+    TEST_ASSERT_TRUE(deserializeJson(doc, json, length) == DeserializationError::Ok);
+    for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        const TelemetryField& field = telemetryFields[i];
+        JsonVariantConst value = doc[groupNames[field.group]][field.name];
+
+        switch (field.type) {
+            case TELEMETRY_F32:
+                check_number(value, read_float(bytes, field.offset), field.argument, field.name);
+                break;
+            case TELEMETRY_U8:
+                TEST_ASSERT_EQUAL_INT_MESSAGE(bytes[field.offset], value.as<int>(), field.name);
+                break;
+            case TELEMETRY_FLAG:
+                TEST_ASSERT_TRUE_MESSAGE(value.is<bool>(), field.name);
+                TEST_ASSERT_EQUAL_MESSAGE((bytes[field.offset] >> field.argument) & 1, value.as<bool>(), field.name);
+                break;
+            case TELEMETRY_MODE:
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(telemetry_get_mode_name(bytes[field.offset]), value.as<const char*>(), field.name);
+                break;
+            case TELEMETRY_DURATION: {
+                char uptime[16];
+                format_uptime(frame.outputTimeMs, uptime, sizeof(uptime));
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(uptime, value.as<const char*>(), field.name);
+                break;
+            }
+            case TELEMETRY_STATISTICS:
+                TEST_ASSERT_EQUAL_MESSAGE(STAT_WINDOW_COUNT, value.size(), field.name);
+                for (uint8_t w = 0; w < STAT_WINDOW_COUNT; w++) {
+                    TEST_ASSERT_EQUAL_MESSAGE(4, value[w].size(), field.name);
+                    for (uint8_t k = 0; k < 4; k++) {
+                        check_number(value[w][k], read_float(bytes, field.offset + (w * 4 + k) * sizeof(float)),
+                                     field.argument, field.name);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+void test_json_round_trip() {
+    TelemetryFrame frame;
+    for (uint32_t i = 0; i < 200; i++) {
+        fill_frame(frame, i * 3701);
+        check_json(frame);
+    }
+
+    // Edge values: negative numbers, rounding up to the next integer, the 100 h uptime format
+    fill_frame(frame, 360000000);
+    frame.setpoint = -0.00004f;
+    frame.voltage = 9.99996f;
+    frame.current = -1.5f;
+    frame.flags = TELEMETRY_FLAG_SOA_LIMITING;
+    frame.state = TELEMETRY_MODE_COUNT + 3;
+    check_json(frame);
+}
+
+void test_json_buffer_too_small() {
+    TelemetryFrame frame;
+    fill_frame(frame, 1000);
+    char json[TELEMETRY_JSON_MAX_SIZE];
+    size_t length = telemetry_write_json(frame, json, sizeof(json));
+    TEST_ASSERT_EQUAL(0, telemetry_write_json(frame, json, length)); // No room for the terminating null
+    TEST_ASSERT_EQUAL(length, telemetry_write_json(frame, json, length + 1));
+}
+
+/** @brief Patches the client copy with a delta, as applyTelemetryDelta() in data/index.js. */
+static void apply_delta(TelemetryFrame& client, const uint8_t* delta, size_t size) {
+    uint8_t* bytes = (uint8_t*)&client;
+    uint16_t count;
+    memcpy(&count, delta + 6, sizeof(count));
+    TEST_ASSERT_EQUAL(TELEMETRY_DELTA_HEADER_SIZE + count * 4, size);
+    TEST_ASSERT_EQUAL('T', delta[0]);
+    TEST_ASSERT_EQUAL('D', delta[1]);
+
+    memcpy(bytes + 2, delta + 2, 4); // Schema, state, flags, fan speed
+    size_t source = TELEMETRY_DELTA_HEADER_SIZE;
+    for (uint8_t w = 0; w < TELEMETRY_WORD_COUNT; w++) {
+        if (!(delta[8 + w / 8] & (1 << (w % 8)))) continue;
+        memcpy(bytes + TELEMETRY_WORD_OFFSET + w * 4, delta + source, 4);
+        source += 4;
+    }
+    TEST_ASSERT_EQUAL(size, source);
+}
+
+/** @brief Every word the client holds is within its deadband of the current frame. */
+static void check_words(const TelemetryFrame& client, const TelemetryFrame& frame) {
+    const uint8_t* have = (const uint8_t*)&client;
+    const uint8_t* want = (const uint8_t*)&frame;
+    TEST_ASSERT_EQUAL_MEMORY(want + 2, have + 2, 4);
+
+    for (uint8_t w = 0; w < TELEMETRY_WORD_COUNT; w++) {
+        uint16_t offset = TELEMETRY_WORD_OFFSET + w * 4;
+        if (deadbands.isDuration[w]) {
+            uint32_t a, b;
+            memcpy(&a, have + offset, 4);
+            memcpy(&b, want + offset, 4);
+            TEST_ASSERT_EQUAL_UINT32(b / TELEMETRY_TIME_RESOLUTION_MS, a / TELEMETRY_TIME_RESOLUTION_MS);
+            continue;
+        }
+        float a = read_float(have, offset), b = read_float(want, offset);
+        if (!isfinite(b) || deadbands.values[w] == 0) {
+            TEST_ASSERT_EQUAL_MEMORY(want + offset, have + offset, 4);
+        } else {
+            TEST_ASSERT_FLOAT_WITHIN(deadbands.values[w], b, a);
+        }
+    }
+}
+
+void test_delta_round_trip() {
+    TelemetryFrame frame, baseline, client;
+    uint8_t delta[TELEMETRY_DELTA_MAX_SIZE];
+    fill_frame(frame, 0);
+    baseline = frame; // Keyframe
+    client = frame;
+    uint32_t deltas = 0, keyframes = 0;
+    size_t deltaBytes = 0;
+
+    for (uint32_t i = 1; i <= 500; i++) {
+        TelemetryFrame next;
+        fill_frame(next, i * 20);
+        if (i % 50 == 0) { // Mostly unchanged: only the noise-free fields and a mode change
+            frame.state = (frame.state % 10) + 1;
+            frame.outputTimeMs = i * 20;
+        } else if (i % 7 == 0) { // Small drift that stays inside the deadbands
+            frame.voltage += 0.0001f;
+            frame.outputTimeMs = i * 20;
+        } else {
+            frame = next;
+        }
+
+        size_t size = telemetry_encode_delta(frame, baseline, delta);
+        if (size == 0) {
+            baseline = frame;
+            client = frame;
+            keyframes++;
+        } else {
+            TEST_ASSERT_LESS_THAN_UINT32(TELEMETRY_FRAME_SIZE, size);
+            apply_delta(client, delta, size);
+            deltas++;
+            deltaBytes += size;
+        }
+        TEST_ASSERT_EQUAL_MEMORY(&baseline, &client, TELEMETRY_FRAME_SIZE); // The baseline is what the client has
+        check_words(client, frame);
+    }
+    printf("[TELEMETRY] %lu deltas (%.1f bytes average), %lu keyframes of %d bytes\n",
+           (unsigned long)deltas, deltas ? (double)deltaBytes / deltas : 0.0, (unsigned long)keyframes,
+           TELEMETRY_FRAME_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, deltas);
+}
+
+void test_delta_resends_non_finite_values() {
+    TelemetryFrame frame, baseline, client;
+    uint8_t delta[TELEMETRY_DELTA_MAX_SIZE];
+    fill_frame(frame, 0);
+    baseline = frame;
+    client = frame;
+
+    frame.voltage = INFINITY;
+    frame.statistics[STAT_TEMPERATURE][STAT_WINDOW_60S][0] = 35.5f; // Window filled: NaN to a number
+    size_t size = telemetry_encode_delta(frame, baseline, delta);
+    TEST_ASSERT_GREATER_THAN(0, size);
+    apply_delta(client, delta, size);
+    TEST_ASSERT_TRUE(isinf(client.voltage));
+    TEST_ASSERT_EQUAL_FLOAT(35.5f, client.statistics[STAT_TEMPERATURE][STAT_WINDOW_60S][0]);
+
+    // Unchanged: an empty delta
+    size = telemetry_encode_delta(frame, baseline, delta);
+    TEST_ASSERT_EQUAL(TELEMETRY_DELTA_HEADER_SIZE, size);
+}
+
+void test_delta_falls_back_to_keyframe() {
+    TelemetryFrame frame, baseline;
+    uint8_t delta[TELEMETRY_DELTA_MAX_SIZE];
+    fill_frame(frame, 0);
+    baseline = frame;
+
+    // Every word moves: a delta would not be smaller than the frame
+    uint8_t* bytes = (uint8_t*)&frame;
+    frame.outputTimeMs += TELEMETRY_TIME_RESOLUTION_MS;
+    for (uint16_t offset = TELEMETRY_WORD_OFFSET + 4; offset < TELEMETRY_FRAME_SIZE; offset += 4) {
+        float value = read_float(bytes, offset);
+        value = isfinite(value) ? value + 1.0f : 0.0f;
+        memcpy(bytes + offset, &value, sizeof(value));
+    }
+    TelemetryFrame unchanged = baseline;
+    TEST_ASSERT_EQUAL(0, telemetry_encode_delta(frame, baseline, delta));
+    TEST_ASSERT_EQUAL_MEMORY(&unchanged, &baseline, TELEMETRY_FRAME_SIZE); // The caller sends the keyframe
+}
+
+void test_json_benchmark() {
+    static TelemetryFrame frames[64];
+    for (uint8_t i = 0; i < 64; i++) fill_frame(frames[i], i * 1000);
+    char json[TELEMETRY_JSON_MAX_SIZE];
+    size_t writerBytes = 0, arduinoJsonBytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; i++) writerBytes += telemetry_write_json(frames[i % 64], json, sizeof(json));
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; i++) arduinoJsonBytes += write_arduinojson(frames[i % 64], json, sizeof(json));
+    auto end = std::chrono::steady_clock::now();
+
+    double writerUs = std::chrono::duration<double, std::micro>(middle - start).count() / BENCHMARK_ITERATIONS;
+    double arduinoJsonUs = std::chrono::duration<double, std::micro>(end - middle).count() / BENCHMARK_ITERATIONS;
+    printf("[TELEMETRY] telemetry_write_json: %.2f us, %lu bytes per document\n",
+           writerUs, (unsigned long)(writerBytes / BENCHMARK_ITERATIONS));
+    printf("[TELEMETRY] ArduinoJson:          %.2f us, %lu bytes per document (%.1fx)\n",
+           arduinoJsonUs, (unsigned long)(arduinoJsonBytes / BENCHMARK_ITERATIONS), arduinoJsonUs / writerUs);
+
+    // Host timings only show the ratio; the board numbers come from the [PROFILER] broadcast stage
+    TEST_ASSERT_GREATER_THAN(0, writerBytes);
+    TEST_ASSERT_GREATER_THAN(0, arduinoJsonBytes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_json_round_trip);
+    RUN_TEST(test_json_buffer_too_small);
+    RUN_TEST(test_delta_round_trip);
+    RUN_TEST(test_delta_resends_non_finite_values);
+    RUN_TEST(test_delta_falls_back_to_keyframe);
+    RUN_TEST(test_json_benchmark);
+    return UNITY_END();
+}